@@ -0,0 +1,215 @@
+#!/usr/bin/env bash
+# Compare the epoll and io_uring modes of the echo server on loopback, and the HTTP server next to them.
+#
+# Every combination of mode, connection count, message size and pipelining depth gets a fresh server which is driven by
+# the in-tree client. The http mode runs the HTTP server with GETs of /health instead of echoes, its message size is the
+# size of the request, so it runs once per connection count and depth and the size column shows the request size.
+# Results go to stdout (or --out) as CSV or JSON, one record per combination, with throughput, latency percentiles and
+# the CPU time the server spent per echoed message.
+#
+# The echo modes also run over every transport in --transports: loopback TCP, a unix domain socket, which skips the
+# TCP stack for clients on the same host, or shared memory, which skips the kernel altogether while both sides are
+# busy and is only served by the io_uring mode. The HTTP server only listens on TCP.
+#
+#   bazel run //src/benchmarks:echo_compare -- --connections="1 100 10000" --format=json --out=results.json
+set -euo pipefail
+
+modes="epoll io_uring http"
+transports="tcp"
+connections="1 10 100 1000 10000"
+sizes="64 1024"
+depths="1 16"
+threads=1
+duration=5
+port=9100
+format=csv
+out=""
+
+usage() {
+  cat <<USAGE
+Usage: echo_compare [options]
+  --modes="LIST"        server modes to compare (default "${modes}")
+  --transports="LIST"   tcp|unix|shm transports of the echo modes (default "${transports}")
+  --connections="LIST"  connection counts to sweep (default "${connections}")
+  --sizes="LIST"        message sizes to sweep (default "${sizes}")
+  --depths="LIST"       pipelining depths to sweep (default "${depths}")
+  --threads=N           client threads (default ${threads})
+  --duration=SECONDS    duration of each run (default ${duration})
+  --port=PORT           server port (default ${port})
+  --format=FORMAT       csv|json (default ${format})
+  --out=FILE            where to write the results (default stdout)
+USAGE
+}
+
+for arg in "$@"; do
+  case "${arg}" in
+    --modes=*) modes="${arg#*=}" ;;
+    --transports=*) transports="${arg#*=}" ;;
+    --connections=*) connections="${arg#*=}" ;;
+    --sizes=*) sizes="${arg#*=}" ;;
+    --depths=*) depths="${arg#*=}" ;;
+    --threads=*) threads="${arg#*=}" ;;
+    --duration=*) duration="${arg#*=}" ;;
+    --port=*) port="${arg#*=}" ;;
+    --format=*) format="${arg#*=}" ;;
+    --out=*) out="${arg#*=}" ;;
+    -h | --help) usage; exit 0 ;;
+    *) echo "unknown argument: ${arg}" >&2; usage >&2; exit 1 ;;
+  esac
+done
+
+# `bazel run` executes from the runfiles tree, resolve relative output paths against the caller's directory.
+if [[ -n "${out}" && "${out}" != /* && -n "${BUILD_WORKING_DIRECTORY:-}" ]]; then
+  out="${BUILD_WORKING_DIRECTORY}/${out}"
+fi
+
+runfiles="${RUNFILES_DIR:-${BASH_SOURCE[0]}.runfiles}/__main__"
+find_binary() {
+  for candidate in "${runfiles}/$1" "$1"; do
+    if [[ -x "${candidate}" ]]; then
+      echo "${candidate}"
+      return
+    fi
+  done
+  echo "unable to find $1" >&2
+  exit 1
+}
+server_bin="$(find_binary src/examples/echo_server)"
+http_bin="$(find_binary src/server/server)"
+client_bin="$(find_binary src/client/client)"
+
+# 10k connections need 10k descriptors on each side.
+ulimit -n "$(ulimit -Hn)" 2>/dev/null || true
+clock_ticks="$(getconf CLK_TCK)"
+
+# utime + stime of a process in clock ticks.
+cpu_ticks() {
+  awk '{ print $14 + $15 }' "/proc/$1/stat"
+}
+
+wait_for_socket() {
+  for _ in $(seq 100); do
+    if [[ -S "$1" ]]; then
+      return
+    fi
+    sleep 0.05
+  done
+  echo "server did not come up on $1" >&2
+  exit 1
+}
+
+wait_for_port() {
+  for _ in $(seq 100); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$1") 2>/dev/null; then
+      return
+    fi
+    sleep 0.05
+  done
+  echo "server did not come up on port $1" >&2
+  exit 1
+}
+
+server_pid=""
+socket_path="${TMPDIR:-/tmp}/echo_compare.$$.sock"
+stop_server() {
+  if [[ -n "${server_pid}" ]]; then
+    kill "${server_pid}" 2>/dev/null || true
+    wait "${server_pid}" 2>/dev/null || true
+    server_pid=""
+  fi
+  # A killed server leaves its socket behind, the next one must not be mistaken as up because of it.
+  rm -f "${socket_path}"
+}
+trap stop_server EXIT
+
+header="mode,transport,connections,size,depth,threads,seconds,messages,errors,msgs_per_s,mib_per_s,p50_us,p90_us,p99_us,p999_us,max_us,server_cpu_s,server_cpu_us_per_msg"
+rows=()
+
+for mode in ${modes}; do
+  mode_sizes="${sizes}"
+  mode_transports="${transports}"
+  client_args=()
+  if [[ "${mode}" == "http" ]]; then
+    mode_sizes="request"
+    mode_transports="tcp"
+    client_args=(--protocol=http)
+  fi
+  for transport in ${mode_transports}; do
+    if [[ "${transport}" == "shm" && "${mode}" != "io_uring" ]]; then
+      continue
+    fi
+    for conns in ${connections}; do
+      for size in ${mode_sizes}; do
+        for depth in ${depths}; do
+          address="${port}"
+          target=(--port="${port}")
+          server_args=()
+          if [[ "${transport}" == "unix" ]]; then
+            address="${socket_path}"
+            target=(--unix="${socket_path}")
+          elif [[ "${transport}" == "shm" ]]; then
+            address="${socket_path}"
+            target=(--shm="${socket_path}")
+            server_args=(shm)
+          fi
+          if [[ "${mode}" == "http" ]]; then
+            "${http_bin}" "${port}" >/dev/null &
+          else
+            "${server_bin}" "${address}" "${mode}" "${server_args[@]}" >/dev/null &
+            client_args=(--size="${size}")
+          fi
+          server_pid=$!
+          if [[ "${transport}" != "tcp" ]]; then
+            wait_for_socket "${socket_path}"
+          else
+            wait_for_port "${port}"
+            # The probe connection above counts as a client, let the server settle before measuring.
+            sleep 0.1
+          fi
+
+          cpu_before="$(cpu_ticks "${server_pid}")"
+          result="$("${client_bin}" "${target[@]}" --connections="${conns}" --threads="${threads}" \
+            --depth="${depth}" "${client_args[@]}" --duration="${duration}" --format=csv | tail -n 1)" || true
+          if ! cpu_after="$(cpu_ticks "${server_pid}" 2>/dev/null)" || [[ -z "${result}" ]]; then
+            echo "server or client failed: mode=${mode} transport=${transport} connections=${conns} size=${size}" \
+              "depth=${depth}" >&2
+            stop_server
+            continue
+          fi
+          stop_server
+
+          # Client columns: target_rate,connections,threads,depth,size_min,size_max,seconds,messages,errors,msgs_per_s,
+          # mib_per_s,p50_us,p90_us,p99_us,p999_us,max_us
+          rows+=("$(echo "${result}" | awk -F, -v mode="${mode}" -v transport="${transport}" \
+            -v cpu_ticks="$((cpu_after - cpu_before))" -v hz="${clock_ticks}" '{
+              cpu_s = cpu_ticks / hz
+              per_msg = $8 > 0 ? cpu_s * 1e6 / $8 : 0
+              printf "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%.3f,%.3f\n",
+                mode, transport, $2, $5, $4, $3, $7, $8, $9, $10, $11, $12, $13, $14, $15, $16, cpu_s, per_msg
+            }')")
+          echo "done: mode=${mode} transport=${transport} connections=${conns} size=${size} depth=${depth}" >&2
+        done
+      done
+    done
+  done
+done
+
+if [[ -n "${out}" ]]; then
+  exec >"${out}"
+fi
+if [[ "${format}" == "json" ]]; then
+  printf '%s\n' "${rows[@]}" | awk -F, -v header="${header}" '
+    BEGIN { split(header, keys, ","); print "[" }
+    {
+      printf "%s  {", (NR > 1 ? ",\n" : "")
+      for (i = 1; i <= NF; ++i) {
+        value = (i <= 2) ? "\"" $i "\"" : $i
+        printf "%s\"%s\": %s", (i > 1 ? ", " : ""), keys[i], value
+      }
+      printf "}"
+    }
+    END { print "\n]" }'
+else
+  echo "${header}"
+  printf '%s\n' "${rows[@]}"
+fi
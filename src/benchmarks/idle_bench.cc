@@ -0,0 +1,289 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "src/lib/histogram.hh"
+#include "src/lib/log.hh"
+#include "src/lib/tsc.hh"
+
+/// Opens a large number of connections to an echo server, leaves almost all of them idle and reports what holding
+/// them costs the server: its resident memory and mappings, the kernel's slab memory and the CPU time it spent
+/// accepting them. A few connections spread over all of them keep sending small echoes meanwhile, their latency shows
+/// whether the idle ones get in the way.
+///
+/// Connections come from a range of loopback source addresses, so their number is not limited by the ephemeral
+/// ports of a single one, but by the descriptors each side may open.
+
+namespace
+{
+
+namespace lib = spinscale::nwprog::lib;
+namespace log = spinscale::nwprog::log;
+
+constexpr auto usage = R"(Usage: idle_bench [options]
+  --port=PORT          echo server port on 127.0.0.1 (default 9100)
+  --connections=N      connections to open and hold (default 500000)
+  --active=N           connections that keep sending echoes while the rest are idle (default 10)
+  --duration=SECONDS   how long the active ones send (default 5)
+  --server-pid=PID     server process to measure, nothing is measured without it
+)";
+
+/// Source addresses are 127.0.0.2 and up, each used for this many connections.
+constexpr uint32_t connections_per_source = 20000U;
+/// Connections opened before waiting for the server to catch up, so the listen backlog never overflows.
+constexpr uint32_t connect_batch = 256U;
+constexpr size_t probe_size = 64U;
+
+struct Options
+{
+  uint16_t port{9100U};
+  uint32_t connections{500000U};
+  uint32_t active{10U};
+  std::chrono::seconds duration{5};
+  int server_pid{0};
+};
+
+/// What the server costs at a point in time.
+struct Sample
+{
+  uint64_t rss_kib{0U};
+  uint64_t maps{0U};
+  uint64_t slab_kib{0U};
+  uint64_t cpu_ticks{0U};
+};
+
+[[noreturn]] void usage_error(const std::string_view message)
+{
+  log::error(message);
+  std::cerr << usage;
+  exit(1);
+}
+
+uint32_t parse_number(const std::string_view key, const std::string_view value)
+{
+  uint32_t result = 0;
+  const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+  if (ec != std::errc{} || end != value.data() + value.size())
+  {
+    usage_error(std::string("invalid value for --").append(key).append(": ").append(value));
+  }
+  return result;
+}
+
+Options parse_options(const int argc, char* argv[])
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string_view arg = argv[i];
+    const auto equals = arg.find('=');
+    if (!arg.starts_with("--") || equals == std::string_view::npos)
+    {
+      usage_error(std::string("unexpected argument: ").append(arg));
+    }
+    const std::string_view key = arg.substr(2, equals - 2);
+    const std::string_view value = arg.substr(equals + 1);
+    if (key == "port")
+    {
+      options.port = static_cast<uint16_t>(parse_number(key, value));
+    }
+    else if (key == "connections")
+    {
+      options.connections = parse_number(key, value);
+    }
+    else if (key == "active")
+    {
+      options.active = parse_number(key, value);
+    }
+    else if (key == "duration")
+    {
+      options.duration = std::chrono::seconds(parse_number(key, value));
+    }
+    else if (key == "server-pid")
+    {
+      options.server_pid = static_cast<int>(parse_number(key, value));
+    }
+    else
+    {
+      usage_error(std::string("unknown option: --").append(key));
+    }
+  }
+  if (options.connections == 0 || options.active == 0 || options.active > options.connections)
+  {
+    usage_error("--active must be between 1 and --connections.");
+  }
+  return options;
+}
+
+/// Value of the line starting with `key` in a /proc file of `key: value` lines, in the unit the file uses.
+uint64_t proc_value(const std::string& path, const std::string_view key)
+{
+  std::ifstream file(path);
+  std::string line;
+  while (std::getline(file, line))
+  {
+    if (line.starts_with(key))
+    {
+      return std::stoull(line.substr(key.size()));
+    }
+  }
+  return 0U;
+}
+
+Sample sample(const int pid)
+{
+  Sample result;
+  result.slab_kib = proc_value("/proc/meminfo", "Slab:");
+  if (pid == 0)
+  {
+    return result;
+  }
+  const std::string proc = "/proc/" + std::to_string(pid);
+  result.rss_kib = proc_value(proc + "/status", "VmRSS:");
+  std::ifstream maps(proc + "/maps");
+  std::string line;
+  while (std::getline(maps, line))
+  {
+    ++result.maps;
+  }
+  // utime and stime are the 14th and 15th fields, the 2nd is the command in parentheses, which may hold spaces.
+  std::ifstream stat(proc + "/stat");
+  std::string fields;
+  std::getline(stat, fields);
+  std::istringstream rest(fields.substr(fields.rfind(')') + 2U));
+  std::string skipped;
+  for (int i = 3; i < 14; ++i)
+  {
+    rest >> skipped;
+  }
+  uint64_t utime = 0;
+  uint64_t stime = 0;
+  rest >> utime >> stime;
+  result.cpu_ticks = utime + stime;
+  return result;
+}
+
+/// Send a probe and wait for its echo, false when the connection broke.
+bool round_trip(const int fd)
+{
+  char probe[probe_size] = {'p'};
+  if (send(fd, probe, sizeof(probe), MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(probe)))
+  {
+    return false;
+  }
+  size_t received = 0;
+  while (received < sizeof(probe))
+  {
+    const ssize_t count = recv(fd, probe + received, sizeof(probe) - received, 0);
+    if (count <= 0)
+    {
+      return false;
+    }
+    received += static_cast<size_t>(count);
+  }
+  return true;
+}
+
+int open_connection(const Options& options, const uint32_t index)
+{
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  log::expects(fd >= 0, "unable to create a socket, raise the descriptor limit.");
+  const int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  // The port is picked at connect then, with the server's address known, so it may be shared with other servers.
+  setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+  struct sockaddr_in source
+  {
+  };
+  source.sin_family = AF_INET;
+  source.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1U + index / connections_per_source);
+  log::expects(bind(fd, (struct sockaddr*)&source, sizeof(source)) == 0, "unable to bind a source address.");
+  struct sockaddr_in server
+  {
+  };
+  server.sin_family = AF_INET;
+  server.sin_port = htons(options.port);
+  server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  log::expects(connect(fd, (struct sockaddr*)&server, sizeof(server)) == 0, "unable to connect to the server.");
+  return fd;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  const Options options = parse_options(argc, argv);
+  struct rlimit limit
+  {
+  };
+  getrlimit(RLIMIT_NOFILE, &limit);
+  limit.rlim_cur = limit.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &limit);
+  const double ticks_per_s = static_cast<double>(sysconf(_SC_CLK_TCK));
+  const double ticks_per_us = lib::tsc::ticks_per_ns() * 1000.0;
+
+  const Sample before = sample(options.server_pid);
+  const auto connect_start = std::chrono::steady_clock::now();
+  std::vector<int> fds;
+  fds.reserve(options.connections);
+  for (uint32_t i = 0; i < options.connections; ++i)
+  {
+    fds.push_back(open_connection(options, i));
+    // An echo on the newest connection means the server accepted all before it.
+    if (fds.size() % connect_batch == 0 || fds.size() == options.connections)
+    {
+      log::expects(round_trip(fds.back()), "the server dropped a connection.");
+    }
+  }
+  const std::chrono::duration<double> connect_time = std::chrono::steady_clock::now() - connect_start;
+  // Let the server settle, then look at what the idle connections cost.
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  const Sample idle = sample(options.server_pid);
+
+  lib::Histogram latency;
+  const auto stop = std::chrono::steady_clock::now() + options.duration;
+  while (std::chrono::steady_clock::now() < stop)
+  {
+    for (uint32_t i = 0; i < options.active; ++i)
+    {
+      const uint64_t start = lib::tsc::now();
+      log::expects(round_trip(fds[i * (options.connections / options.active)]), "an active connection broke.");
+      latency.record(lib::tsc::now() - start);
+    }
+  }
+  const Sample active = sample(options.server_pid);
+  for (const int fd : fds)
+  {
+    close(fd);
+  }
+
+  const auto cpu_us_per_echo = latency.count() == 0
+                                 ? 0.0
+                                 : static_cast<double>(active.cpu_ticks - idle.cpu_ticks) / ticks_per_s * 1e6 /
+                                     static_cast<double>(latency.count());
+  const auto percentile_us = [&](const double percentile)
+  { return static_cast<double>(latency.percentile(percentile)) / ticks_per_us; };
+  std::cout << "connections,connect_s,server_rss_kib,server_maps,slab_kib,connect_cpu_s,echoes,p50_us,p99_us,p999_us,"
+               "server_cpu_us_per_echo\n";
+  std::cout << std::fixed << std::setprecision(2) << options.connections << ',' << connect_time.count() << ','
+            << idle.rss_kib << ',' << idle.maps << ',' << static_cast<int64_t>(idle.slab_kib - before.slab_kib)
+            << ',' << static_cast<double>(idle.cpu_ticks - before.cpu_ticks) / ticks_per_s << ','
+            << latency.count() << ',' << percentile_us(50.0) << ',' << percentile_us(99.0) << ','
+            << percentile_us(99.9) << ',' << cpu_us_per_echo << '\n';
+  return 0;
+}
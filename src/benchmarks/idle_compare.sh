@@ -0,0 +1,109 @@
+#!/usr/bin/env bash
+# Compare what holding mostly idle connections costs the io_uring echo server when every client has a read in flight
+# and when it waits for data with a multishot poll.
+#
+# Each mode gets a fresh server which idle_bench fills with connections, then a few of them keep sending small echoes.
+# Results go to stdout as CSV, one row per mode and connection count, with the server's memory and mappings, the
+# kernel's slab growth and the server's CPU time to accept, and the latency and server CPU time of the echoes.
+#
+# Both sides need a descriptor per connection, so the hard limit on open files caps the connection counts.
+#
+#   bazel run //src/benchmarks:idle_compare -- --connections="10000 100000 500000"
+set -euo pipefail
+
+modes="read poll"
+connections="1000 10000"
+active=10
+duration=5
+port=9100
+
+usage() {
+  cat <<USAGE
+Usage: idle_compare [options]
+  --modes="LIST"        read|poll ways of the server to wait for data (default "${modes}")
+  --connections="LIST"  connection counts to sweep (default "${connections}")
+  --active=N            connections that keep sending echoes (default ${active})
+  --duration=SECONDS    how long they send (default ${duration})
+  --port=PORT           server port (default ${port})
+USAGE
+}
+
+for arg in "$@"; do
+  case "${arg}" in
+    --modes=*) modes="${arg#*=}" ;;
+    --connections=*) connections="${arg#*=}" ;;
+    --active=*) active="${arg#*=}" ;;
+    --duration=*) duration="${arg#*=}" ;;
+    --port=*) port="${arg#*=}" ;;
+    -h | --help) usage; exit 0 ;;
+    *) echo "unknown argument: ${arg}" >&2; usage >&2; exit 1 ;;
+  esac
+done
+
+runfiles="${RUNFILES_DIR:-${BASH_SOURCE[0]}.runfiles}/__main__"
+find_binary() {
+  for candidate in "${runfiles}/$1" "$1"; do
+    if [[ -x "${candidate}" ]]; then
+      echo "${candidate}"
+      return
+    fi
+  done
+  echo "unable to find $1" >&2
+  exit 1
+}
+server_bin="$(find_binary src/examples/echo_server)"
+bench_bin="$(find_binary src/benchmarks/idle_bench)"
+
+ulimit -n "$(ulimit -Hn)" 2>/dev/null || true
+
+wait_for_port() {
+  for _ in $(seq 100); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$1") 2>/dev/null; then
+      return
+    fi
+    sleep 0.05
+  done
+  echo "server did not come up on port $1" >&2
+  exit 1
+}
+
+server_pid=""
+stop_server() {
+  if [[ -n "${server_pid}" ]]; then
+    kill "${server_pid}" 2>/dev/null || true
+    wait "${server_pid}" 2>/dev/null || true
+    server_pid=""
+  fi
+}
+trap stop_server EXIT
+
+header="mode,connections,connect_s,server_rss_kib,server_maps,slab_kib,connect_cpu_s,echoes,p50_us,p99_us,p999_us,server_cpu_us_per_echo"
+rows=()
+
+for mode in ${modes}; do
+  server_args=()
+  if [[ "${mode}" == "poll" ]]; then
+    server_args=(poll)
+  fi
+  for conns in ${connections}; do
+    "${server_bin}" "${port}" io_uring "${server_args[@]}" >/dev/null &
+    server_pid=$!
+    wait_for_port "${port}"
+    sleep 0.1
+
+    if ! result="$("${bench_bin}" --port="${port}" --connections="${conns}" --active="${active}" \
+      --duration="${duration}" --server-pid="${server_pid}" | tail -n 1)" || [[ -z "${result}" ]]; then
+      echo "server or benchmark failed: mode=${mode} connections=${conns}" >&2
+      stop_server
+      continue
+    fi
+    stop_server
+    rows+=("${mode},${result}")
+    echo "done: mode=${mode} connections=${conns}" >&2
+    # The closed connections linger in TIME_WAIT for a while, the next server must still get its port.
+    sleep 1
+  done
+done
+
+echo "${header}"
+printf '%s\n' "${rows[@]}"
@@ -0,0 +1,469 @@
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "src/io/mailbox.hh"
+#include "src/io/uring.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/histogram.hh"
+#include "src/lib/log.hh"
+#include "src/lib/thread_pool.hh"
+#include "src/lib/tsc.hh"
+
+/// Mixes cheap, io bound requests with expensive, compute bound ones on a single ring and reports the latency of the
+/// cheap ones, once with the compute handled on the ring thread and once offloaded to a `lib::ThreadPool`.
+/// Connections are socket pairs so the numbers do not depend on the network stack.
+
+namespace
+{
+
+namespace io = spinscale::nwprog::io;
+namespace lib = spinscale::nwprog::lib;
+namespace log = spinscale::nwprog::log;
+
+constexpr auto usage = R"(Usage: offload_bench [options]
+  --io-connections=N       connections sending cheap requests (default 8)
+  --compute-connections=N  connections sending expensive requests (default 2)
+  --compute-us=N           cost of an expensive request in microseconds (default 500)
+  --workers=N              thread pool size when offloading (default 2)
+  --duration=SECONDS       duration of every mode (default 5)
+  --modes=LIST             comma separated list of ring|offload (default ring,offload)
+)";
+
+enum class Mode : uint8_t
+{
+  /// Compute on the ring thread, blocking every other connection meanwhile.
+  ring,
+  /// Compute on the thread pool and post the reply back to the ring.
+  offload,
+};
+
+struct Options
+{
+  uint32_t io_connections{8U};
+  uint32_t compute_connections{2U};
+  uint32_t compute_us{500U};
+  uint32_t workers{2U};
+  std::chrono::seconds duration{5};
+  std::vector<Mode> modes{Mode::ring, Mode::offload};
+};
+
+[[noreturn]] void usage_error(const std::string_view message)
+{
+  log::error(message);
+  std::cerr << usage;
+  exit(1);
+}
+
+uint32_t parse_number(const std::string_view key, const std::string_view value)
+{
+  uint32_t result = 0;
+  const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+  if (ec != std::errc{} || end != value.data() + value.size())
+  {
+    usage_error(std::string("invalid value for --").append(key).append(": ").append(value));
+  }
+  return result;
+}
+
+std::vector<Mode> parse_modes(std::string_view value)
+{
+  std::vector<Mode> modes;
+  while (!value.empty())
+  {
+    const auto comma = value.find(',');
+    const auto mode = value.substr(0, comma);
+    if (mode == "ring")
+    {
+      modes.push_back(Mode::ring);
+    }
+    else if (mode == "offload")
+    {
+      modes.push_back(Mode::offload);
+    }
+    else
+    {
+      usage_error("--modes must be a list of ring|offload.");
+    }
+    value = comma == std::string_view::npos ? std::string_view{} : value.substr(comma + 1);
+  }
+  return modes;
+}
+
+Options parse_options(const int argc, char* argv[])
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string_view arg = argv[i];
+    const auto equals = arg.find('=');
+    if (!arg.starts_with("--") || equals == std::string_view::npos)
+    {
+      usage_error(std::string("unexpected argument: ").append(arg));
+    }
+    const std::string_view key = arg.substr(2, equals - 2);
+    const std::string_view value = arg.substr(equals + 1);
+    if (key == "io-connections")
+    {
+      options.io_connections = parse_number(key, value);
+    }
+    else if (key == "compute-connections")
+    {
+      options.compute_connections = parse_number(key, value);
+    }
+    else if (key == "compute-us")
+    {
+      options.compute_us = parse_number(key, value);
+    }
+    else if (key == "workers")
+    {
+      options.workers = parse_number(key, value);
+    }
+    else if (key == "duration")
+    {
+      options.duration = std::chrono::seconds(parse_number(key, value));
+    }
+    else if (key == "modes")
+    {
+      options.modes = parse_modes(value);
+    }
+    else
+    {
+      usage_error(std::string("unknown option: --").append(key));
+    }
+  }
+  if (options.io_connections == 0)
+  {
+    usage_error("--io-connections must be positive.");
+  }
+  return options;
+}
+
+/// Requests and replies on the wire, a reply echoes its request.
+struct Message
+{
+  enum Kind : uint64_t
+  {
+    io,
+    compute,
+  };
+
+  Kind kind;
+  uint64_t sent_tsc;
+};
+
+/// Stands in for a CPU bound request handler.
+void compute_for(const uint64_t ticks)
+{
+  const uint64_t end = lib::tsc::now() + ticks;
+  uint64_t x = 1;
+  while (lib::tsc::now() < end)
+  {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+  }
+  asm volatile("" : : "r"(x));
+}
+
+/// Serves all connections from a single ring on the calling thread until every client hung up.
+class Server
+{
+  enum class OpType : uint8_t
+  {
+    read,
+    write,
+    mailbox,
+  };
+
+  union OpData
+  {
+    struct
+    {
+      OpType type : 8;
+      uint32_t connection;
+    } unpacked;
+    uint64_t packed;
+  };
+
+  struct Connection
+  {
+    int fd;
+    Message message{};
+    bool open{true};
+  };
+
+  /// Posted by the pool once an offloaded request is done.
+  struct Reply
+  {
+    uint32_t connection;
+  };
+
+public:
+  Server(const Options& options, const Mode mode, const std::vector<int>& fds, lib::ThreadPool& pool)
+    : mode_(mode)
+    , compute_ticks_(static_cast<uint64_t>(options.compute_us * 1000.0 * lib::tsc::ticks_per_ns()))
+    , ring_(1024U, {})
+    , mailbox_(1024U)
+    , pool_(pool)
+  {
+    for (const int fd : fds)
+    {
+      connections_.push_back({fd});
+    }
+    open_connections_ = static_cast<uint32_t>(connections_.size());
+  }
+
+  void run()
+  {
+    prepare(mailbox_.arm(ring_, make_user_data(OpType::mailbox, 0)));
+    for (uint32_t id = 0; id < connections_.size(); ++id)
+    {
+      start_read(id);
+    }
+    while (open_connections_ > 0 || offloaded_ > 0)
+    {
+      ring_.submit_or_defer();
+      const auto handled = ring_.for_every_completion(*this);
+      log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+    }
+  }
+
+  void operator()(void* user_data, const io::IoResult result)
+  {
+    const OpData op{.packed = reinterpret_cast<uint64_t>(user_data)};
+    const uint32_t id = op.unpacked.connection;
+    switch (op.unpacked.type)
+    {
+      case OpType::read:
+      {
+        if (result.value_or(0) != static_cast<int32_t>(sizeof(Message)))
+        {
+          // Clients hang up between requests, a partial message means they are gone as well.
+          close_connection(id);
+          break;
+        }
+        on_request(id);
+        break;
+      }
+      case OpType::write:
+      {
+        if (result.value_or(0) != static_cast<int32_t>(sizeof(Message)))
+        {
+          close_connection(id);
+          break;
+        }
+        start_read(id);
+        break;
+      }
+      case OpType::mailbox:
+      {
+        mailbox_.drain(
+          [this](const Reply reply)
+          {
+            --offloaded_;
+            start_write(reply.connection);
+          });
+        prepare(mailbox_.arm(ring_, make_user_data(OpType::mailbox, 0)));
+        break;
+      }
+    }
+  }
+
+private:
+  static void* make_user_data(const OpType type, const uint32_t id)
+  {
+    return reinterpret_cast<void*>(OpData{.unpacked{.type = type, .connection = id}}.packed);
+  }
+
+  void prepare(const io::IoResult result)
+  {
+    log::expects(result.is_ok(), "unable to get a submission queue entry.");
+  }
+
+  void start_read(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    prepare(ring_.prepare_read(
+      connection.fd, reinterpret_cast<char*>(&connection.message), sizeof(Message), 0,
+      make_user_data(OpType::read, id)));
+  }
+
+  void start_write(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    if (!connection.open)
+    {
+      return;
+    }
+    prepare(ring_.prepare_write(
+      connection.fd, reinterpret_cast<const char*>(&connection.message), sizeof(Message), 0,
+      make_user_data(OpType::write, id)));
+  }
+
+  void on_request(const uint32_t id)
+  {
+    if (connections_[id].message.kind == Message::io)
+    {
+      start_write(id);
+      return;
+    }
+    if (mode_ == Mode::ring)
+    {
+      compute_for(compute_ticks_);
+      start_write(id);
+      return;
+    }
+    lib::ThreadPool::Task task(
+      [this, id]()
+      {
+        compute_for(compute_ticks_);
+        while (!mailbox_.post({id}))
+        {
+          std::this_thread::yield();
+        }
+      });
+    ++offloaded_;
+    if (!pool_.submit(std::move(task)))
+    {
+      // The pool is saturated, push back by computing here.
+      task();
+    }
+  }
+
+  void close_connection(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    if (connection.open)
+    {
+      connection.open = false;
+      --open_connections_;
+    }
+  }
+
+  const Mode mode_;
+  const uint64_t compute_ticks_;
+  io::Uring ring_;
+  io::Mailbox<Reply> mailbox_;
+  lib::ThreadPool& pool_;
+  std::vector<Connection> connections_;
+  uint32_t open_connections_{0U};
+  /// Requests on the pool whose reply was not posted back yet.
+  uint32_t offloaded_{0U};
+};
+
+/// A closed loop client with one request in flight, on a thread of its own.
+void run_client(const int fd, const Message::Kind kind, const std::chrono::seconds duration, lib::Histogram& latency)
+{
+  const auto deadline = std::chrono::steady_clock::now() + duration;
+  while (std::chrono::steady_clock::now() < deadline)
+  {
+    Message message{kind, lib::tsc::now()};
+    log::expects(write(fd, &message, sizeof(message)) == sizeof(message), "client write failed.");
+    size_t received = 0;
+    while (received < sizeof(message))
+    {
+      const ssize_t res = read(fd, reinterpret_cast<char*>(&message) + received, sizeof(message) - received);
+      log::expects(res > 0, "client read failed.");
+      received += static_cast<size_t>(res);
+    }
+    latency.record(lib::tsc::now() - message.sent_tsc);
+  }
+  close(fd);
+}
+
+struct ModeResult
+{
+  lib::Histogram io_latency{};
+  lib::Histogram compute_latency{};
+  double seconds{0.0};
+};
+
+ModeResult run_mode(const Options& options, const Mode mode)
+{
+  const uint32_t num_connections = options.io_connections + options.compute_connections;
+  std::vector<int> server_fds;
+  std::vector<int> client_fds;
+  for (uint32_t i = 0; i < num_connections; ++i)
+  {
+    int fds[2];
+    log::expects(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == 0, "unable to create a socket pair.");
+    server_fds.push_back(fds[0]);
+    client_fds.push_back(fds[1]);
+  }
+
+  lib::ThreadPool pool(options.workers);
+  Server server(options, mode, server_fds, pool);
+
+  std::vector<lib::Histogram> latencies(num_connections);
+  std::vector<std::thread> clients;
+  const auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < num_connections; ++i)
+  {
+    const auto kind = i < options.io_connections ? Message::io : Message::compute;
+    clients.emplace_back([&, i, kind]() { run_client(client_fds[i], kind, options.duration, latencies[i]); });
+  }
+  server.run();
+  for (auto& client : clients)
+  {
+    client.join();
+  }
+
+  ModeResult result;
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  for (uint32_t i = 0; i < num_connections; ++i)
+  {
+    (i < options.io_connections ? result.io_latency : result.compute_latency).merge(latencies[i]);
+  }
+  for (const int fd : server_fds)
+  {
+    close(fd);
+  }
+  return result;
+}
+
+void report_header()
+{
+  std::cout << std::setw(10) << "mode" << std::setw(12) << "io req/s" << std::setw(10) << "io p50" << std::setw(10)
+            << "io p99" << std::setw(10) << "io p99.9" << std::setw(10) << "io max" << std::setw(14) << "compute req/s"
+            << std::setw(12) << "compute p99" << "   (latencies in us)\n";
+}
+
+void report(const Mode mode, const ModeResult& result)
+{
+  const double ticks_per_us = lib::tsc::ticks_per_ns() * 1000.0;
+  std::cout << std::fixed << std::setprecision(1) << std::setw(10) << (mode == Mode::ring ? "ring" : "offload")
+            << std::setw(12) << result.io_latency.count() / result.seconds;
+  for (const double p : {50.0, 99.0, 99.9})
+  {
+    std::cout << std::setw(10) << result.io_latency.percentile(p) / ticks_per_us;
+  }
+  std::cout << std::setw(10) << result.io_latency.max() / ticks_per_us << std::setw(14)
+            << result.compute_latency.count() / result.seconds << std::setw(12)
+            << result.compute_latency.percentile(99.0) / ticks_per_us << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  const Options options = parse_options(argc, argv);
+  // Replies to clients that already hung up must not kill the server.
+  signal(SIGPIPE, SIG_IGN);
+  lib::tsc::ticks_per_ns();
+
+  report_header();
+  for (const Mode mode : options.modes)
+  {
+    report(mode, run_mode(options, mode));
+  }
+  return 0;
+}
@@ -0,0 +1,168 @@
+#!/usr/bin/env bash
+# Compare the splice and copy modes of the TCP proxy on loopback, with clients talking to the backend directly as the
+# baseline.
+#
+# The backend is the io_uring echo server. Every combination of mode, connection count, message size and pipelining
+# depth gets a fresh proxy in front of it which is driven by the in-tree client. Results go to stdout (or --out) as
+# CSV, one record per combination, with throughput, latency percentiles and the CPU time the proxy spent per echoed
+# message; the direct mode has no proxy and reports none.
+#
+#   bazel run //src/benchmarks:proxy_compare -- --sizes="64 16384" --depths="1 4" --out=results.csv
+set -euo pipefail
+
+modes="direct copy splice"
+connections="1 10 100"
+sizes="64 16384"
+depths="1 16"
+threads=1
+duration=5
+port=9200
+out=""
+
+usage() {
+  cat <<USAGE
+Usage: proxy_compare [options]
+  --modes="LIST"        direct|copy|splice modes to compare (default "${modes}")
+  --connections="LIST"  connection counts to sweep (default "${connections}")
+  --sizes="LIST"        message sizes to sweep (default "${sizes}")
+  --depths="LIST"       pipelining depths to sweep (default "${depths}")
+  --threads=N           client threads (default ${threads})
+  --duration=SECONDS    duration of each run (default ${duration})
+  --port=PORT           backend port, the proxy listens on the next one (default ${port})
+  --out=FILE            where to write the results (default stdout)
+USAGE
+}
+
+for arg in "$@"; do
+  case "${arg}" in
+    --modes=*) modes="${arg#*=}" ;;
+    --connections=*) connections="${arg#*=}" ;;
+    --sizes=*) sizes="${arg#*=}" ;;
+    --depths=*) depths="${arg#*=}" ;;
+    --threads=*) threads="${arg#*=}" ;;
+    --duration=*) duration="${arg#*=}" ;;
+    --port=*) port="${arg#*=}" ;;
+    --out=*) out="${arg#*=}" ;;
+    -h | --help) usage; exit 0 ;;
+    *) echo "unknown argument: ${arg}" >&2; usage >&2; exit 1 ;;
+  esac
+done
+
+# `bazel run` executes from the runfiles tree, resolve relative output paths against the caller's directory.
+if [[ -n "${out}" && "${out}" != /* && -n "${BUILD_WORKING_DIRECTORY:-}" ]]; then
+  out="${BUILD_WORKING_DIRECTORY}/${out}"
+fi
+
+runfiles="${RUNFILES_DIR:-${BASH_SOURCE[0]}.runfiles}/__main__"
+find_binary() {
+  for candidate in "${runfiles}/$1" "$1"; do
+    if [[ -x "${candidate}" ]]; then
+      echo "${candidate}"
+      return
+    fi
+  done
+  echo "unable to find $1" >&2
+  exit 1
+}
+backend_bin="$(find_binary src/examples/echo_server)"
+proxy_bin="$(find_binary src/server/proxy)"
+client_bin="$(find_binary src/client/client)"
+
+# Every client connection costs the proxy two descriptors and a pipe pair.
+ulimit -n "$(ulimit -Hn)" 2>/dev/null || true
+clock_ticks="$(getconf CLK_TCK)"
+proxy_port=$((port + 1))
+
+# utime + stime of a process in clock ticks.
+cpu_ticks() {
+  awk '{ print $14 + $15 }' "/proc/$1/stat"
+}
+
+wait_for_port() {
+  for _ in $(seq 100); do
+    if (exec 3<>"/dev/tcp/127.0.0.1/$1") 2>/dev/null; then
+      return
+    fi
+    sleep 0.05
+  done
+  echo "server did not come up on port $1" >&2
+  exit 1
+}
+
+backend_pid=""
+proxy_pid=""
+stop_proxy() {
+  if [[ -n "${proxy_pid}" ]]; then
+    kill "${proxy_pid}" 2>/dev/null || true
+    wait "${proxy_pid}" 2>/dev/null || true
+    proxy_pid=""
+  fi
+}
+stop_all() {
+  stop_proxy
+  if [[ -n "${backend_pid}" ]]; then
+    kill "${backend_pid}" 2>/dev/null || true
+    wait "${backend_pid}" 2>/dev/null || true
+    backend_pid=""
+  fi
+}
+trap stop_all EXIT
+
+# One backend serves every run, the proxy is what is compared.
+"${backend_bin}" "${port}" io_uring >/dev/null &
+backend_pid=$!
+wait_for_port "${port}"
+
+header="mode,connections,size,depth,threads,seconds,messages,errors,msgs_per_s,mib_per_s,p50_us,p90_us,p99_us,p999_us,max_us,proxy_cpu_s,proxy_cpu_us_per_msg"
+rows=()
+
+for mode in ${modes}; do
+  for conns in ${connections}; do
+    for size in ${sizes}; do
+      for depth in ${depths}; do
+        target_port="${port}"
+        if [[ "${mode}" != "direct" ]]; then
+          "${proxy_bin}" "${proxy_port}" "127.0.0.1:${port}" "${mode}" >/dev/null &
+          proxy_pid=$!
+          wait_for_port "${proxy_port}"
+          # The probe connection above counts as a client, let the proxy settle before measuring.
+          sleep 0.1
+          target_port="${proxy_port}"
+        fi
+
+        cpu_before=0
+        if [[ -n "${proxy_pid}" ]]; then
+          cpu_before="$(cpu_ticks "${proxy_pid}")"
+        fi
+        result="$("${client_bin}" --port="${target_port}" --connections="${conns}" --threads="${threads}" \
+          --depth="${depth}" --size="${size}" --duration="${duration}" --format=csv | tail -n 1)" || true
+        cpu_after=0
+        if [[ -n "${proxy_pid}" ]] && ! cpu_after="$(cpu_ticks "${proxy_pid}" 2>/dev/null)"; then
+          result=""
+        fi
+        stop_proxy
+        if [[ -z "${result}" ]]; then
+          echo "proxy or client failed: mode=${mode} connections=${conns} size=${size} depth=${depth}" >&2
+          continue
+        fi
+
+        # Client columns: target_rate,connections,threads,depth,size_min,size_max,seconds,messages,errors,msgs_per_s,
+        # mib_per_s,p50_us,p90_us,p99_us,p999_us,max_us
+        rows+=("$(echo "${result}" | awk -F, -v mode="${mode}" -v cpu_ticks="$((cpu_after - cpu_before))" \
+          -v hz="${clock_ticks}" '{
+            cpu_s = cpu_ticks / hz
+            per_msg = $8 > 0 ? cpu_s * 1e6 / $8 : 0
+            printf "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%.3f,%.3f\n",
+              mode, $2, $5, $4, $3, $7, $8, $9, $10, $11, $12, $13, $14, $15, $16, cpu_s, per_msg
+          }')")
+        echo "done: mode=${mode} connections=${conns} size=${size} depth=${depth}" >&2
+      done
+    done
+  done
+done
+
+if [[ -n "${out}" ]]; then
+  exec >"${out}"
+fi
+echo "${header}"
+printf '%s\n' "${rows[@]}"
@@ -0,0 +1,931 @@
+#include "src/client/load_generator.hh"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "src/io/shm_channel.hh"
+#include "src/io/unix_socket.hh"
+#include "src/io/uring.hh"
+#include "src/lib/byte_ring.hh"
+#include "src/lib/byte_scan.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/framing.hh"
+#include "src/lib/log.hh"
+#include "src/lib/resp.hh"
+#include "src/lib/tsc.hh"
+
+namespace spinscale::nwprog::client
+{
+
+namespace
+{
+
+/// Echoed bytes are only counted, never inspected, so all connections of a worker read into the same buffer.
+constexpr uint32_t sink_buffer_size = 64U * 1024U;
+constexpr uint32_t max_ring_size = 32768U;
+/// Upper bound of a single write, queued bytes beyond that go out with the next one.
+constexpr uint32_t min_payload_size = 64U * 1024U;
+constexpr size_t trace_capacity = 1U << 20U;
+/// HTTP and RESP replies are parsed in place, so each connection reads into its own mirrored buffer.
+constexpr uint32_t response_buffer_size = 64U * 1024U;
+/// Upper bound of a RESP command without its value.
+constexpr uint32_t resp_command_overhead = 64U;
+
+enum class OpType : uint8_t
+{
+  read,
+  write,
+  deadline,
+  /// Open loop only, fires when the next message is due.
+  timer,
+  /// Shared memory only, the server wrote or made room while the connection slept.
+  doorbell,
+};
+
+union OpData
+{
+  struct
+  {
+    OpType type : 8;
+    uint32_t connection;
+  } unpacked;
+  uint64_t packed;
+};
+
+/// xorshift64*, plenty for picking message sizes.
+class Rng
+{
+public:
+  explicit Rng(const uint64_t seed) : state_(seed | 1U)
+  {
+  }
+
+  uint64_t next()
+  {
+    state_ ^= state_ >> 12U;
+    state_ ^= state_ << 25U;
+    state_ ^= state_ >> 27U;
+    return state_ * 0x2545F4914F6CDD1DULL;
+  }
+
+  uint32_t uniform(const uint32_t min, const uint32_t max)
+  {
+    return min == max ? min : min + static_cast<uint32_t>(next() % (uint64_t{max} - min + 1U));
+  }
+
+  /// Uniformly distributed in [0, 1), from 53 random bits.
+  double unit()
+  {
+    return static_cast<double>(next() >> 11U) * 0x1.0p-53;
+  }
+
+  /// Exponentially distributed value with the given mean.
+  double exponential(const double mean)
+  {
+    return -mean * std::log1p(-unit());
+  }
+
+private:
+  uint64_t state_;
+};
+
+/// Case insensitive prefix check against a lower case `prefix`.
+bool starts_with_lower(const std::string_view value, const std::string_view prefix)
+{
+  if (value.size() < prefix.size())
+  {
+    return false;
+  }
+  for (size_t i = 0; i < prefix.size(); ++i)
+  {
+    const char c = value[i] >= 'A' && value[i] <= 'Z' ? static_cast<char>(value[i] + ('a' - 'A')) : value[i];
+    if (c != prefix[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Size of the HTTP response at the front of `data` including its body, zero while it is incomplete. Only bodies
+/// delimited by Content-Length are understood, which is all the in-tree server sends.
+size_t http_response_size(const std::string_view data)
+{
+  constexpr std::string_view content_length = "content-length:";
+  size_t content_size = 0;
+  size_t line_start = 0;
+  while (true)
+  {
+    const size_t line_end = line_start + lib::find_first_of<'\r'>(data.substr(line_start));
+    if (line_end + 1U >= data.size())
+    {
+      return 0;
+    }
+    const std::string_view line = data.substr(line_start, line_end - line_start);
+    if (line.empty())
+    {
+      const size_t size = line_end + 2U + content_size;
+      return size <= data.size() ? size : 0;
+    }
+    if (starts_with_lower(line, content_length))
+    {
+      std::string_view value = line.substr(content_length.size());
+      while (!value.empty() && value.front() == ' ')
+      {
+        value.remove_prefix(1);
+      }
+      std::from_chars(value.data(), value.data() + value.size(), content_size);
+    }
+    line_start = line_end + 2U;
+  }
+}
+
+struct Message
+{
+  /// Size on the wire, including the frame header when framed. In resp mode the size of the value of a SET, zero for
+  /// a GET.
+  uint32_t size;
+  /// When the message was meant to be sent. Equal to the actual send time in closed loop mode.
+  uint64_t start_tsc;
+  /// Resp only: index of the key.
+  uint32_t key{0};
+};
+
+struct Connection
+{
+  io::FD fd{-1};
+  /// Messages sent but not fully echoed yet, oldest first.
+  std::deque<Message> in_flight{};
+  /// Bytes of the oldest message echoed so far.
+  uint32_t received{0};
+  /// Bytes of queued messages not handed to a write yet.
+  uint32_t unsent{0};
+  /// Bytes of the write currently in flight.
+  uint32_t writing{0};
+  /// Framed and resp only: messages are encoded here and written from here. The newest `unencoded` messages of
+  /// `in_flight` were not encoded yet because the buffer was full.
+  std::optional<lib::ByteRing> outgoing{};
+  uint32_t unencoded{0};
+  struct iovec write_iovecs[2];
+  /// HTTP and resp only: replies are collected here until they are complete.
+  std::optional<lib::ByteRing> incoming{};
+  struct iovec read_iovecs[2];
+  /// Bytes written so far. HTTP requests have to go out in one piece, so it tells where the next write starts.
+  uint64_t sent{0};
+  bool alive{true};
+  /// Shared memory only: all data goes through the channel, the socket is only kept open until the end.
+  std::optional<io::ShmChannel> channel{};
+  /// Shared memory only: iovecs of the read and the write that wait for the channel, zero when there is none.
+  uint32_t pending_read{0};
+  uint32_t pending_write{0};
+  bool doorbell_armed{false};
+};
+
+io::FD connect_to(const Options& options)
+{
+  if (!options.unix_path.empty())
+  {
+    const auto connected = io::connect_unix(options.unix_path, io::UnixSocketType::stream);
+    log::expects(connected.is_ok(), "Error connecting to the unix domain socket.");
+    return connected.value();
+  }
+
+  struct sockaddr_in server_addr
+  {
+  };
+  server_addr.sin_family = AF_INET;
+  server_addr.sin_port = htons(options.port);
+  log::expects(inet_pton(AF_INET, options.host.c_str(), &server_addr.sin_addr) == 1, "invalid server address.");
+
+  const io::FD fd = socket(AF_INET, SOCK_STREAM, 0);
+  log::expects(fd >= 0, "Error creating socket.");
+  log::expects(connect(fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == 0, "Error connecting to server.");
+  // Pipelined small messages must not wait for Nagle.
+  const int no_delay = 1;
+  log::expects(
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay)) == 0, "Error setting TCP_NODELAY");
+  return fd;
+}
+
+uint32_t ring_size_for(const uint32_t num_connections)
+{
+  // One read and one write per connection plus the deadline.
+  return std::min(std::bit_ceil(2U * num_connections + 1U), max_ring_size);
+}
+
+class Worker
+{
+public:
+  Worker(const Options& options, const uint32_t num_connections, const uint32_t worker_id, const double rate)
+    : options_(options)
+    , connections_(num_connections)
+    , request_(options.protocol == Protocol::http ? http_request(options) : std::string{})
+    , payload_(make_payload(options, request_))
+    , sink_(sink_buffer_size)
+    , rng_(0x9E3779B97F4A7C15ULL * (worker_id + 1U))
+    , mean_interval_ns_(rate > 0.0 ? 1e9 / rate : 0.0)
+    , ring_(ring_size_for(num_connections), {})
+  {
+    for (auto& connection : connections_)
+    {
+      connection.fd = connect_to(options_);
+      if (options_.shared_memory)
+      {
+        auto channel = io::ShmChannel::accept(connection.fd);
+        log::expects(channel.has_value(), "the server did not offer a shared memory channel.");
+        connection.channel.emplace(std::move(*channel));
+      }
+      if (encoded())
+      {
+        // Large enough for the largest message, and for a full pipeline of them when it is not too large.
+        connection.outgoing.emplace(
+          std::max<size_t>(size_t{max_encoded_size()} * options.depth, min_payload_size),
+          lib::ByteRing::Mapping::single);
+      }
+      if (parses_replies())
+      {
+        connection.incoming.emplace(response_buffer_size);
+        log::expects(connection.incoming->mirrored(), "responses are parsed in place and need a mirrored buffer.");
+      }
+    }
+    if (worker_id == 0 && !options_.trace_file.empty())
+    {
+      ring_.tracer().enable(trace_capacity);
+    }
+  }
+
+  ~Worker()
+  {
+    for (const auto& connection : connections_)
+    {
+      close(connection.fd);
+    }
+  }
+
+  Stats run()
+  {
+    deadline_.tv_sec = options_.duration.count();
+    prepare([&](void* user_data) { return ring_.prepare_timeout(&deadline_, 0, user_data); }, OpType::deadline, 0);
+    for (uint32_t id = 0; id < connections_.size(); ++id)
+    {
+      if (!open_loop())
+      {
+        fill_pipeline(id);
+      }
+      start_read(id);
+    }
+    start_tsc_ = lib::tsc::now();
+    log::expects(clock_gettime(CLOCK_MONOTONIC, &start_time_) == 0, "unable to read the monotonic clock.");
+    if (open_loop())
+    {
+      send_due();
+    }
+    ring_.submit_or_defer();
+
+    const auto duration_ns = static_cast<double>(std::chrono::nanoseconds(options_.duration).count());
+    const uint64_t stop_tsc = start_tsc_ + static_cast<uint64_t>(duration_ns * lib::tsc::ticks_per_ns());
+    const auto spin_ticks = static_cast<uint64_t>(
+      static_cast<double>(io::ShmChannel::spin_time().count()) * lib::tsc::ticks_per_ns());
+    uint64_t last_progress_tsc = start_tsc_;
+    while (!stopping_)
+    {
+      // Shared memory connections make progress without the ring. It is only waited on once all of them were idle
+      // for a while and sleep.
+      bool busy = false;
+      if (options_.shared_memory)
+      {
+        const uint64_t now = lib::tsc::now();
+        if (progress_channels())
+        {
+          last_progress_tsc = now;
+        }
+        busy = now - last_progress_tsc < spin_ticks || !park_channels();
+        // A loop that never enters the kernel may never see the deadline complete.
+        stopping_ = now >= stop_tsc;
+      }
+      if (!busy || ring_.ready_completions() > 0U)
+      {
+        const auto handled = ring_.for_every_completion(*this);
+        log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+      }
+      if (open_loop() && !stopping_)
+      {
+        send_due();
+      }
+      ring_.submit_or_defer();
+    }
+    stats_.seconds = lib::tsc::to_ns(lib::tsc::now() - start_tsc_) / 1e9;
+
+    if (ring_.tracer().enabled())
+    {
+      ring_.tracer().disable();
+      std::ofstream out(options_.trace_file);
+      ring_.tracer().export_chrome_trace(out);
+    }
+    return std::move(stats_);
+  }
+
+  /// Completion callback.
+  void operator()(void* user_data, const io::IoResult result)
+  {
+    const OpData op{.packed = reinterpret_cast<uint64_t>(user_data)};
+    switch (op.unpacked.type)
+    {
+      case OpType::read:
+      {
+        on_read(op.unpacked.connection, result);
+        break;
+      }
+      case OpType::write:
+      {
+        on_write(op.unpacked.connection, result);
+        break;
+      }
+      case OpType::deadline:
+      {
+        stopping_ = true;
+        break;
+      }
+      case OpType::timer:
+      {
+        timer_armed_ = false;
+        break;
+      }
+      case OpType::doorbell:
+      {
+        connections_[op.unpacked.connection].doorbell_armed = false;
+        break;
+      }
+    }
+  }
+
+private:
+  /// Prepare an op, flushing the submission queue first if it is full.
+  template <class PrepareFn>
+  void prepare(PrepareFn&& prepare_fn, const OpType type, const uint32_t id)
+  {
+    const OpData op{.unpacked{.type = type, .connection = id}};
+    void* user_data = reinterpret_cast<void*>(op.packed);
+    if (prepare_fn(user_data).is_error())
+    {
+      ring_.submit_or_defer();
+      log::expects(prepare_fn(user_data).is_ok(), "unable to get a submission queue entry.");
+    }
+  }
+
+  [[nodiscard]] bool open_loop() const
+  {
+    return mean_interval_ns_ > 0.0;
+  }
+
+  [[nodiscard]] bool http() const
+  {
+    return options_.protocol == Protocol::http;
+  }
+
+  /// Every write starts at the front of the payload. The echo server does not look at it, so it is filler. In http mode
+  /// it repeats the request, with one extra copy so a write can start in the middle of one.
+  static std::vector<char> make_payload(const Options& options, const std::string& request)
+  {
+    const size_t size = std::max<size_t>(size_t{options.size.max} * options.depth, min_payload_size);
+    if (request.empty())
+    {
+      return std::vector<char>(size, 'x');
+    }
+    std::vector<char> payload;
+    while (payload.size() < size + request.size())
+    {
+      payload.insert(payload.end(), request.begin(), request.end());
+    }
+    return payload;
+  }
+
+  [[nodiscard]] bool resp() const
+  {
+    return options_.protocol == Protocol::resp;
+  }
+
+  /// Replies are collected and parsed instead of counted.
+  [[nodiscard]] bool parses_replies() const
+  {
+    return http() || resp();
+  }
+
+  [[nodiscard]] bool framed() const
+  {
+    return options_.framing == Framing::length;
+  }
+
+  /// Messages are encoded into the outgoing buffer instead of being written from the payload.
+  [[nodiscard]] bool encoded() const
+  {
+    return framed() || resp();
+  }
+
+  [[nodiscard]] uint32_t max_encoded_size() const
+  {
+    return (resp() ? resp_command_overhead : lib::framing::header_size) + options_.size.max;
+  }
+
+  void enqueue(Connection& connection, const uint64_t start_tsc)
+  {
+    const uint32_t size = rng_.uniform(options_.size.min, options_.size.max);
+    if (resp())
+    {
+      const bool set = rng_.unit() < options_.set_ratio;
+      connection.in_flight.push_back({set ? size : 0U, start_tsc, rng_.uniform(0U, options_.keys - 1U)});
+      ++connection.unencoded;
+    }
+    else if (framed())
+    {
+      connection.in_flight.push_back({lib::framing::header_size + size, start_tsc});
+      ++connection.unencoded;
+    }
+    else
+    {
+      connection.in_flight.push_back({size, start_tsc});
+      connection.unsent += size;
+    }
+  }
+
+  /// Closed loop: top up the connection to `depth` messages in flight.
+  void fill_pipeline(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    const uint64_t now = lib::tsc::now();
+    while (connection.in_flight.size() < options_.depth)
+    {
+      enqueue(connection, now);
+    }
+    if (connection.writing == 0)
+    {
+      start_write(id);
+    }
+  }
+
+  /// Open loop: send every message whose intended send time has passed, round robin over the connections, and arm
+  /// the timer for the next one. Messages keep their intended send time as start time even when the schedule is
+  /// behind, so stalls of the server show up in the latencies instead of silently lowering the offered load.
+  void send_due()
+  {
+    const double ticks_per_ns = lib::tsc::ticks_per_ns();
+    const double now_ns = static_cast<double>(lib::tsc::now() - start_tsc_) / ticks_per_ns;
+    while (next_send_ns_ <= now_ns)
+    {
+      const uint32_t id = next_connection();
+      if (id == connections_.size())
+      {
+        return;
+      }
+      enqueue(connections_[id], start_tsc_ + static_cast<uint64_t>(next_send_ns_ * ticks_per_ns));
+      if (connections_[id].writing == 0)
+      {
+        touched_.push_back(id);
+      }
+      next_send_ns_ += options_.arrival == Arrival::poisson ? rng_.exponential(mean_interval_ns_) : mean_interval_ns_;
+    }
+    for (const uint32_t id : touched_)
+    {
+      if (connections_[id].writing == 0)
+      {
+        start_write(id);
+      }
+    }
+    touched_.clear();
+    arm_timer();
+  }
+
+  /// Next live connection in round robin order, `connections_.size()` if there is none.
+  uint32_t next_connection()
+  {
+    for (size_t attempts = 0; attempts < connections_.size(); ++attempts)
+    {
+      const uint32_t id = next_connection_;
+      next_connection_ = (next_connection_ + 1U) % connections_.size();
+      if (connections_[id].alive)
+      {
+        return id;
+      }
+    }
+    return connections_.size();
+  }
+
+  void arm_timer()
+  {
+    if (timer_armed_)
+    {
+      return;
+    }
+    const auto due_ns = static_cast<int64_t>(next_send_ns_) + start_time_.tv_nsec;
+    timer_.tv_sec = start_time_.tv_sec + due_ns / 1000000000;
+    timer_.tv_nsec = due_ns % 1000000000;
+    prepare(
+      [&](void* user_data) { return ring_.prepare_timeout(&timer_, IORING_TIMEOUT_ABS, user_data); }, OpType::timer, 0);
+    timer_armed_ = true;
+  }
+
+  void start_write(const uint32_t id)
+  {
+    if (encoded())
+    {
+      start_encoded_write(id);
+      return;
+    }
+    Connection& connection = connections_[id];
+    if (connection.unsent == 0)
+    {
+      return;
+    }
+    // After a short write an HTTP request continues where it was cut off.
+    const size_t offset = http() ? connection.sent % request_.size() : 0U;
+    connection.writing = std::min<uint32_t>(connection.unsent, payload_.size() - request_.size());
+    connection.unsent -= connection.writing;
+    if (connection.channel)
+    {
+      connection.write_iovecs[0] = {.iov_base = payload_.data() + offset, .iov_len = connection.writing};
+      connection.pending_write = 1U;
+      return;
+    }
+    prepare(
+      [&](void* user_data)
+      { return ring_.prepare_write(connection.fd, payload_.data() + offset, connection.writing, 0, user_data); },
+      OpType::write, id);
+  }
+
+  /// Encode `message` into `outgoing` unless it does not fit.
+  bool encode(const Message& message, lib::ByteRing& outgoing)
+  {
+    if (resp())
+    {
+      if (outgoing.free_space() < resp_command_overhead + message.size)
+      {
+        return false;
+      }
+      char key[16];
+      const auto key_size = static_cast<size_t>(std::snprintf(key, sizeof(key), "key:%08u", message.key));
+      lib::resp::append_array_header(outgoing, message.size > 0 ? 3U : 2U);
+      lib::resp::append_bulk(outgoing, message.size > 0 ? "SET" : "GET");
+      lib::resp::append_bulk(outgoing, std::string_view(key, key_size));
+      if (message.size > 0)
+      {
+        lib::resp::append_bulk(outgoing, std::string_view(payload_.data(), message.size));
+      }
+      return true;
+    }
+    if (outgoing.free_space() < message.size)
+    {
+      return false;
+    }
+    const uint32_t payload_size = message.size - lib::framing::header_size;
+    char header[lib::framing::header_size];
+    lib::framing::encode_header(payload_size, header);
+    outgoing.append({header, lib::framing::header_size});
+    outgoing.append({payload_.data(), payload_size});
+    return true;
+  }
+
+  /// Encode as many queued messages as fit into the outgoing buffer and write all of it with a single writev.
+  void start_encoded_write(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    lib::ByteRing& outgoing = *connection.outgoing;
+    while (connection.unencoded > 0 &&
+           encode(connection.in_flight[connection.in_flight.size() - connection.unencoded], outgoing))
+    {
+      --connection.unencoded;
+    }
+    const uint32_t count = outgoing.readable(connection.write_iovecs);
+    if (count == 0)
+    {
+      return;
+    }
+    connection.writing = outgoing.size();
+    if (connection.channel)
+    {
+      connection.pending_write = count;
+      return;
+    }
+    prepare(
+      [&](void* user_data)
+      { return ring_.prepare_writev(connection.fd, connection.write_iovecs, count, 0, user_data); },
+      OpType::write, id);
+  }
+
+  void start_read(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    if (parses_replies())
+    {
+      const uint32_t count = connection.incoming->writable(connection.read_iovecs);
+      if (count == 0)
+      {
+        drop(id, "reply does not fit into the receive buffer.");
+        return;
+      }
+      if (connection.channel)
+      {
+        connection.pending_read = count;
+        return;
+      }
+      prepare(
+        [&](void* user_data)
+        { return ring_.prepare_readv(connection.fd, connection.read_iovecs, count, 0, user_data); },
+        OpType::read, id);
+      return;
+    }
+    if (connection.channel)
+    {
+      connection.read_iovecs[0] = {.iov_base = sink_.data(), .iov_len = sink_buffer_size};
+      connection.pending_read = 1U;
+      return;
+    }
+    prepare(
+      [&](void* user_data)
+      { return ring_.prepare_read(connections_[id].fd, sink_.data(), sink_buffer_size, 0, user_data); },
+      OpType::read, id);
+  }
+
+  /// Shared memory connections have no reads and writes on the ring. Theirs wait for the channel instead and complete
+  /// here, through the same callbacks as ring completions, as soon as it has bytes or room for them. Returns whether
+  /// any did.
+  bool progress_channels()
+  {
+    bool progressed = false;
+    for (uint32_t id = 0; id < connections_.size(); ++id)
+    {
+      Connection& connection = connections_[id];
+      if (connection.alive && connection.channel->broken())
+      {
+        drop(id, "the server corrupted the shared memory channel.");
+      }
+      if (connection.alive && connection.pending_write > 0U)
+      {
+        const size_t written = connection.channel->write(connection.write_iovecs, connection.pending_write);
+        if (written > 0U)
+        {
+          connection.pending_write = 0U;
+          on_write(id, lib::Ok(static_cast<int32_t>(written)));
+          progressed = true;
+        }
+      }
+      if (connection.alive && connection.pending_read > 0U)
+      {
+        const size_t read = connection.channel->read(connection.read_iovecs, connection.pending_read);
+        if (read > 0U)
+        {
+          connection.pending_read = 0U;
+          on_read(id, lib::Ok(static_cast<int32_t>(read)));
+          progressed = true;
+        }
+      }
+    }
+    return progressed;
+  }
+
+  /// Let every shared memory connection that can not make progress sleep on its doorbell. Returns false when one of
+  /// them can after all, the loop must not block then.
+  bool park_channels()
+  {
+    bool idle = true;
+    bool armed = false;
+    for (uint32_t id = 0; id < connections_.size(); ++id)
+    {
+      Connection& connection = connections_[id];
+      if (!connection.alive)
+      {
+        continue;
+      }
+      io::ShmChannel& channel = *connection.channel;
+      const auto has_work = [&]()
+      {
+        return (connection.pending_read > 0U && channel.readable() > 0U) ||
+               (connection.pending_write > 0U && channel.writable() > 0U);
+      };
+      if (connection.doorbell_armed)
+      {
+        idle = idle && !has_work();
+      }
+      else if (channel.sleep_unless(has_work))
+      {
+        prepare([&](void* user_data) { return channel.arm(ring_, user_data); }, OpType::doorbell, id);
+        connection.doorbell_armed = true;
+        armed = true;
+      }
+      else
+      {
+        idle = false;
+      }
+    }
+    if (armed)
+    {
+      // The doorbell reads have to be in flight before the loop blocks.
+      ring_.submit_or_defer();
+    }
+    return idle;
+  }
+
+  void on_write(const uint32_t id, const io::IoResult result)
+  {
+    Connection& connection = connections_[id];
+    if (result.value_or(0) <= 0)
+    {
+      drop(id, "write failed.");
+      return;
+    }
+    connection.sent += static_cast<uint64_t>(result.value());
+    // Short writes hand the remainder back to the queue.
+    if (encoded())
+    {
+      connection.outgoing->consume(result.value());
+    }
+    else
+    {
+      connection.unsent += connection.writing - static_cast<uint32_t>(result.value());
+    }
+    connection.writing = 0;
+    if (connection.alive)
+    {
+      start_write(id);
+    }
+  }
+
+  void on_read(const uint32_t id, const io::IoResult result)
+  {
+    Connection& connection = connections_[id];
+    if (result.value_or(0) <= 0)
+    {
+      drop(id, "connection closed by server.");
+      return;
+    }
+    stats_.bytes += static_cast<uint64_t>(result.value());
+    if (parses_replies())
+    {
+      on_replies(id, result.value());
+      return;
+    }
+
+    const uint64_t now = lib::tsc::now();
+    auto bytes = static_cast<uint32_t>(result.value());
+    while (bytes > 0 && !connection.in_flight.empty())
+    {
+      const Message& message = connection.in_flight.front();
+      const uint32_t missing = message.size - connection.received;
+      if (bytes < missing)
+      {
+        connection.received += bytes;
+        bytes = 0;
+        break;
+      }
+      bytes -= missing;
+      stats_.latency.record(now - message.start_tsc);
+      ++stats_.messages;
+      connection.received = 0;
+      connection.in_flight.pop_front();
+    }
+    if (bytes > 0)
+    {
+      drop(id, "server sent more bytes than were sent to it.");
+      return;
+    }
+
+    if (!stopping_ && !open_loop())
+    {
+      fill_pipeline(id);
+    }
+    start_read(id);
+  }
+
+  /// Size of the reply at the front of `data`, zero while it is incomplete, or nothing when it is malformed.
+  [[nodiscard]] std::optional<size_t> reply_size(const std::string_view data) const
+  {
+    if (http())
+    {
+      return http_response_size(data);
+    }
+    const auto size = lib::resp::reply_size(data);
+    if (size.is_error())
+    {
+      return std::nullopt;
+    }
+    return static_cast<size_t>(size.value());
+  }
+
+  /// Every complete reply completes the oldest request. HTTP responses with an error status and RESP errors count as
+  /// errors.
+  void on_replies(const uint32_t id, const int32_t num_bytes)
+  {
+    Connection& connection = connections_[id];
+    connection.incoming->commit(num_bytes);
+    const uint64_t now = lib::tsc::now();
+    while (true)
+    {
+      const auto size = reply_size(connection.incoming->filled());
+      if (!size)
+      {
+        drop(id, "server sent a malformed reply.");
+        return;
+      }
+      if (*size == 0)
+      {
+        break;
+      }
+      if (connection.in_flight.empty())
+      {
+        drop(id, "server sent a reply nobody asked for.");
+        return;
+      }
+      const std::string_view reply = connection.incoming->filled();
+      if (http() ? !reply.starts_with("HTTP/1.1 2") : reply.starts_with('-'))
+      {
+        ++stats_.errors;
+      }
+      stats_.latency.record(now - connection.in_flight.front().start_tsc);
+      ++stats_.messages;
+      connection.in_flight.pop_front();
+      connection.incoming->consume(*size);
+    }
+
+    if (!stopping_ && !open_loop())
+    {
+      fill_pipeline(id);
+    }
+    start_read(id);
+  }
+
+  void drop(const uint32_t id, const std::string_view reason)
+  {
+    Connection& connection = connections_[id];
+    if (connection.alive)
+    {
+      log::warn(reason);
+      connection.alive = false;
+      ++stats_.errors;
+    }
+  }
+
+  const Options& options_;
+  std::vector<Connection> connections_;
+  const std::string request_;
+  std::vector<char> payload_;
+  std::vector<char> sink_;
+  Rng rng_;
+  Stats stats_{};
+  bool stopping_{false};
+  struct __kernel_timespec deadline_
+  {
+  };
+  uint64_t start_tsc_{0};
+
+  /// Open loop state.
+  const double mean_interval_ns_;
+  /// Intended send time of the next message, relative to `start_tsc_`.
+  double next_send_ns_{0.0};
+  uint32_t next_connection_{0};
+  std::vector<uint32_t> touched_{};
+  struct timespec start_time_
+  {
+  };
+  struct __kernel_timespec timer_
+  {
+  };
+  bool timer_armed_{false};
+  /// Declared last so it is destroyed first. Tearing it down cancels the ops that are still in flight, which point
+  /// into the buffers and timespecs above.
+  io::Uring ring_;
+};
+
+}  // namespace
+
+void Stats::merge(const Stats& other)
+{
+  latency.merge(other.latency);
+  messages += other.messages;
+  bytes += other.bytes;
+  errors += other.errors;
+  seconds = std::max(seconds, other.seconds);
+}
+
+Stats run_worker(const Options& options, const uint32_t num_connections, const uint32_t worker_id, const double rate)
+{
+  Worker worker(options, num_connections, worker_id, rate);
+  return worker.run();
+}
+
+}  // namespace spinscale::nwprog::client
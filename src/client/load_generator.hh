@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "src/client/options.hh"
+#include "src/lib/histogram.hh"
+
+namespace spinscale::nwprog::client
+{
+
+/// Measurements of one or more workers.
+struct Stats
+{
+  /// Round trip latencies of individual messages in TSC ticks.
+  lib::Histogram latency{};
+  uint64_t messages{0};
+  uint64_t bytes{0};
+  uint64_t errors{0};
+  /// Time spent generating load. The longest of all workers when merged.
+  double seconds{0.0};
+
+  void merge(const Stats& other);
+};
+
+/// Drive `num_connections` connections from the calling thread with a dedicated ring until the configured duration
+/// has elapsed.
+///
+/// With a `rate` of zero the worker runs closed loop: every connection keeps up to `Options::depth` messages in flight
+/// and sends a new one as soon as an echo completes. Otherwise it runs open loop and sends `rate` messages per second
+/// according to `Options::arrival`, independent of how fast the server answers, and measures latency from the
+/// intended send time.
+Stats run_worker(const Options& options, uint32_t num_connections, uint32_t worker_id, double rate);
+
+}  // namespace spinscale::nwprog::client
@@ -1,27 +1,131 @@
-#include <arpa/inet.h>
-#include <errno.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <sys/ioctl.h>
-#include <sys/socket.h>
-#include <unistd.h>
-
+#include <iomanip>
 #include <iostream>
-#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "src/client/load_generator.hh"
+#include "src/client/options.hh"
+#include "src/lib/tsc.hh"
+
+namespace
+{
+
+namespace client = spinscale::nwprog::client;
+namespace lib = spinscale::nwprog::lib;
+
+/// Run all workers for one phase. `rate` is the open loop rate over all threads, zero for closed loop.
+client::Stats run(const client::Options& options, const double rate)
+{
+  std::vector<client::Stats> stats(options.threads);
+  std::vector<std::thread> workers;
+  for (uint32_t i = 0; i < options.threads; ++i)
+  {
+    const uint32_t num_connections =
+      options.connections / options.threads + (i < options.connections % options.threads ? 1U : 0U);
+    workers.emplace_back(
+      [&options, &stats, num_connections, i, rate]()
+      { stats[i] = client::run_worker(options, num_connections, i, rate / options.threads); });
+  }
+  for (auto& worker : workers)
+  {
+    worker.join();
+  }
+
+  client::Stats total;
+  for (const auto& worker_stats : stats)
+  {
+    total.merge(worker_stats);
+  }
+  return total;
+}
 
-#include "liburing.h"
+void report(const client::Options& options, const client::Stats& stats, const double rate)
+{
+  const double elapsed_seconds = stats.seconds;
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "threads: " << options.threads << "  connections: " << options.connections
+            << "  depth: " << options.depth << "  size: " << options.size.min << '-' << options.size.max
+            << "  duration: " << elapsed_seconds << "s\n";
+  if (rate > 0.0)
+  {
+    std::cout << "open loop target: " << rate << " msg/s ("
+              << (options.arrival == client::Arrival::poisson ? "poisson" : "fixed") << ")\n";
+  }
+  std::cout << "messages: " << stats.messages << "  errors: " << stats.errors << '\n';
+  std::cout << "throughput: " << stats.messages / elapsed_seconds << " msg/s  "
+            << stats.bytes / elapsed_seconds / (1024.0 * 1024.0) << " MiB/s\n";
+  std::cout << "latency:\n";
+  stats.latency.print(std::cout, lib::tsc::ticks_per_ns() * 1000.0, "us");
+}
 
-namespace client
+void report_csv_header()
 {
+  std::cout << "target_rate,connections,threads,depth,size_min,size_max,seconds,messages,errors,msgs_per_s,"
+               "mib_per_s,p50_us,p90_us,p99_us,p999_us,max_us\n";
+}
 
-void connect(std::string_view server_addr)
+void report_csv(const client::Options& options, const client::Stats& stats, const double rate)
 {
+  const double ticks_per_us = lib::tsc::ticks_per_ns() * 1000.0;
+  std::cout << std::fixed << std::setprecision(2) << rate << ',' << options.connections << ',' << options.threads
+            << ',' << options.depth << ',' << options.size.min << ',' << options.size.max << ',' << stats.seconds
+            << ',' << stats.messages << ',' << stats.errors << ',' << stats.messages / stats.seconds << ','
+            << stats.bytes / stats.seconds / (1024.0 * 1024.0);
+  for (const double p : {50.0, 90.0, 99.0, 99.9})
+  {
+    std::cout << ',' << stats.latency.percentile(p) / ticks_per_us;
+  }
+  std::cout << ',' << stats.latency.max() / ticks_per_us << std::endl;
 }
 
-}  // namespace client
+/// One line per rate of a sweep, latencies in microseconds.
+void report_sweep(const std::vector<double>& rates, const std::vector<client::Stats>& results)
+{
+  const double ticks_per_us = lib::tsc::ticks_per_ns() * 1000.0;
+  std::cout << "\nlatency vs throughput (us):\n";
+  std::cout << std::setw(14) << "target" << std::setw(14) << "achieved" << std::setw(12) << "p50" << std::setw(12)
+            << "p90" << std::setw(12) << "p99" << std::setw(12) << "p99.9" << std::setw(12) << "max" << '\n';
+  for (size_t i = 0; i < rates.size(); ++i)
+  {
+    const auto& latency = results[i].latency;
+    std::cout << std::setw(14) << rates[i] << std::setw(14) << results[i].messages / results[i].seconds;
+    for (const double p : {50.0, 90.0, 99.0, 99.9})
+    {
+      std::cout << std::setw(12) << latency.percentile(p) / ticks_per_us;
+    }
+    std::cout << std::setw(12) << latency.max() / ticks_per_us << '\n';
+  }
+}
 
-int main()
+}  // namespace
+
+int main(int argc, char* argv[])
 {
-  std::cout << "hello from client_lib. I do nothing." << std::endl;
+  const auto options = client::parse_options(argc, argv);
+  // Calibrate before any thread starts measuring.
+  lib::tsc::ticks_per_ns();
+
+  const bool csv = options.format == client::OutputFormat::csv;
+  if (csv)
+  {
+    report_csv_header();
+  }
+
+  if (options.rates.empty())
+  {
+    const auto stats = run(options, 0.0);
+    csv ? report_csv(options, stats, 0.0) : report(options, stats, 0.0);
+    return 0;
+  }
+
+  std::vector<client::Stats> results;
+  for (const double rate : options.rates)
+  {
+    results.push_back(run(options, rate));
+    csv ? report_csv(options, results.back(), rate) : report(options, results.back(), rate);
+  }
+  if (!csv && results.size() > 1)
+  {
+    report_sweep(options.rates, results);
+  }
 }
@@ -0,0 +1,288 @@
+#include "src/client/options.hh"
+
+#include <charconv>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+#include "src/lib/log.hh"
+
+namespace spinscale::nwprog::client
+{
+
+namespace
+{
+
+constexpr auto usage = R"(Usage: client [options]
+  --host=ADDR         server address (default 127.0.0.1)
+  --port=PORT         server port (default 8080)
+  --unix=PATH         connect to the unix domain socket at PATH instead, '@' starts an abstract name
+  --shm=PATH          like --unix, then move all data through shared memory the server offers over the socket
+  --connections=N     total number of connections (default 1)
+  --depth=N           messages in flight per connection (default 1)
+  --size=N[-M]        message size in bytes, uniform in [N, M] when a range is given (default 64)
+  --framing=KIND      message framing: raw|length, length prefixes every message with its size (default raw)
+  --protocol=KIND     what the server speaks: echo|http|resp (default echo)
+  --path=PATH         target of the requests in http mode (default /health)
+  --keys=N            number of distinct keys in resp mode, --size is the value size there (default 100000)
+  --set-ratio=F       share of SETs among the commands in resp mode, the rest are GETs (default 0.1)
+  --duration=SECONDS  how long to generate load (default 10)
+  --threads=N         number of threads, each with its own ring (default 1)
+  --rate=R[,R...]     run open loop at R messages per second instead of closed loop, a list sweeps the rates
+  --arrival=KIND      gaps between open loop sends: fixed|poisson (default fixed)
+  --format=FORMAT     output format: text|csv (default text)
+  --trace=FILE        write a Chrome trace of the first thread's ring to FILE
+)";
+
+[[noreturn]] void usage_error(const std::string_view message)
+{
+  log::error(message);
+  std::cerr << usage;
+  exit(1);
+}
+
+template <class T>
+T parse_number(const std::string_view key, const std::string_view value)
+{
+  T result{};
+  const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+  if (ec != std::errc{} || end != value.data() + value.size())
+  {
+    usage_error(std::string("invalid value for --").append(key).append(": ").append(value));
+  }
+  return result;
+}
+
+SizeDistribution parse_size(const std::string_view value)
+{
+  SizeDistribution size;
+  if (const auto dash = value.find('-'); dash != std::string_view::npos)
+  {
+    size.min = parse_number<uint32_t>("size", value.substr(0, dash));
+    size.max = parse_number<uint32_t>("size", value.substr(dash + 1));
+  }
+  else
+  {
+    size.min = size.max = parse_number<uint32_t>("size", value);
+  }
+  if (size.min == 0 || size.min > size.max)
+  {
+    usage_error("--size must be a positive size or an increasing range.");
+  }
+  return size;
+}
+
+std::vector<double> parse_rates(std::string_view value)
+{
+  std::vector<double> rates;
+  while (!value.empty())
+  {
+    const auto comma = value.find(',');
+    const auto rate = parse_number<double>("rate", value.substr(0, comma));
+    if (rate <= 0.0)
+    {
+      usage_error("--rate must be positive.");
+    }
+    rates.push_back(rate);
+    value = comma == std::string_view::npos ? std::string_view{} : value.substr(comma + 1);
+  }
+  return rates;
+}
+
+Framing parse_framing(const std::string_view value)
+{
+  if (value == "raw")
+  {
+    return Framing::raw;
+  }
+  if (value == "length")
+  {
+    return Framing::length;
+  }
+  usage_error("--framing must be one of raw|length.");
+}
+
+Protocol parse_protocol(const std::string_view value)
+{
+  if (value == "echo")
+  {
+    return Protocol::echo;
+  }
+  if (value == "http")
+  {
+    return Protocol::http;
+  }
+  if (value == "resp")
+  {
+    return Protocol::resp;
+  }
+  usage_error("--protocol must be one of echo|http|resp.");
+}
+
+Arrival parse_arrival(const std::string_view value)
+{
+  if (value == "fixed")
+  {
+    return Arrival::fixed;
+  }
+  if (value == "poisson")
+  {
+    return Arrival::poisson;
+  }
+  usage_error("--arrival must be one of fixed|poisson.");
+}
+
+OutputFormat parse_format(const std::string_view value)
+{
+  if (value == "text")
+  {
+    return OutputFormat::text;
+  }
+  if (value == "csv")
+  {
+    return OutputFormat::csv;
+  }
+  usage_error("--format must be one of text|csv.");
+}
+
+}  // namespace
+
+Options parse_options(const int argc, char* argv[])
+{
+  Options options;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string_view arg = argv[i];
+    if (arg == "--help" || arg == "-h")
+    {
+      std::cout << usage;
+      exit(0);
+    }
+    const auto equals = arg.find('=');
+    if (!arg.starts_with("--") || equals == std::string_view::npos)
+    {
+      usage_error(std::string("unexpected argument: ").append(arg));
+    }
+    const std::string_view key = arg.substr(2, equals - 2);
+    const std::string_view value = arg.substr(equals + 1);
+
+    if (key == "host")
+    {
+      options.host = value;
+    }
+    else if (key == "port")
+    {
+      options.port = parse_number<uint16_t>(key, value);
+    }
+    else if (key == "unix")
+    {
+      options.unix_path = value;
+    }
+    else if (key == "shm")
+    {
+      options.unix_path = value;
+      options.shared_memory = true;
+    }
+    else if (key == "connections")
+    {
+      options.connections = parse_number<uint32_t>(key, value);
+    }
+    else if (key == "depth")
+    {
+      options.depth = parse_number<uint32_t>(key, value);
+    }
+    else if (key == "size")
+    {
+      options.size = parse_size(value);
+    }
+    else if (key == "framing")
+    {
+      options.framing = parse_framing(value);
+    }
+    else if (key == "protocol")
+    {
+      options.protocol = parse_protocol(value);
+    }
+    else if (key == "path")
+    {
+      options.path = value;
+    }
+    else if (key == "keys")
+    {
+      options.keys = parse_number<uint32_t>(key, value);
+    }
+    else if (key == "set-ratio")
+    {
+      options.set_ratio = parse_number<double>(key, value);
+    }
+    else if (key == "duration")
+    {
+      options.duration = std::chrono::seconds(parse_number<uint32_t>(key, value));
+    }
+    else if (key == "threads")
+    {
+      options.threads = parse_number<uint32_t>(key, value);
+    }
+    else if (key == "rate")
+    {
+      options.rates = parse_rates(value);
+    }
+    else if (key == "arrival")
+    {
+      options.arrival = parse_arrival(value);
+    }
+    else if (key == "format")
+    {
+      options.format = parse_format(value);
+    }
+    else if (key == "trace")
+    {
+      options.trace_file = value;
+    }
+    else
+    {
+      usage_error(std::string("unknown option: --").append(key));
+    }
+  }
+
+  if (options.connections == 0 || options.depth == 0 || options.threads == 0)
+  {
+    usage_error("--connections, --depth and --threads must be positive.");
+  }
+  if (options.protocol == Protocol::http)
+  {
+    if (options.framing != Framing::raw)
+    {
+      usage_error("--framing does not apply to --protocol=http.");
+    }
+    if (!options.path.starts_with('/'))
+    {
+      usage_error("--path must start with a slash.");
+    }
+    options.size.min = options.size.max = http_request(options).size();
+  }
+  if (options.protocol == Protocol::resp)
+  {
+    if (options.framing != Framing::raw)
+    {
+      usage_error("--framing does not apply to --protocol=resp.");
+    }
+    if (options.keys == 0 || options.set_ratio < 0.0 || options.set_ratio > 1.0)
+    {
+      usage_error("--keys must be positive and --set-ratio within [0, 1].");
+    }
+  }
+  if (options.threads > options.connections)
+  {
+    log::warn("more threads than connections, some threads will stay idle.");
+    options.threads = options.connections;
+  }
+  return options;
+}
+
+std::string http_request(const Options& options)
+{
+  return "GET " + options.path + " HTTP/1.1\r\nHost: " + options.host + "\r\n\r\n";
+}
+
+}  // namespace spinscale::nwprog::client
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace spinscale::nwprog::client
+{
+
+/// Message sizes are drawn uniformly from [min, max]. Fixed size when both are equal.
+struct SizeDistribution
+{
+  uint32_t min{64U};
+  uint32_t max{64U};
+};
+
+/// Distribution of the gaps between sends in open loop mode.
+enum class Arrival : uint8_t
+{
+  fixed,
+  poisson,
+};
+
+/// How messages are delimited on the wire.
+enum class Framing : uint8_t
+{
+  /// Messages are plain bytes, only their total count matters to the echo.
+  raw,
+  /// Every message is a frame with a 4 byte length prefix, see `lib::framing`.
+  length,
+};
+
+/// What the server on the other end speaks.
+enum class Protocol : uint8_t
+{
+  /// Messages come back as they were sent.
+  echo,
+  /// Every message is a GET of `Options::path`, answered with a response of any size.
+  http,
+  /// Every message is a Redis GET or SET of a random key out of `Options::keys`, values are `Options::size` bytes.
+  resp,
+};
+
+/// How results are printed.
+enum class OutputFormat : uint8_t
+{
+  /// Human readable report with the full latency distribution.
+  text,
+  /// A header and one line per phase, for scripts.
+  csv,
+};
+
+/// Knobs of the load generator.
+struct Options
+{
+  std::string host{"127.0.0.1"};
+  uint16_t port{8080U};
+  /// Connect to this unix domain socket instead of host and port when set.
+  std::string unix_path{};
+  /// Move the data through a shared memory channel that the server at `unix_path` offers.
+  bool shared_memory{false};
+  /// Total number of connections, spread evenly over the threads.
+  uint32_t connections{1U};
+  /// Maximum number of messages in flight per connection in closed loop mode.
+  uint32_t depth{1U};
+  SizeDistribution size{};
+  Framing framing{Framing::raw};
+  Protocol protocol{Protocol::echo};
+  /// Target of the HTTP requests.
+  std::string path{"/health"};
+  /// Number of distinct keys in resp mode.
+  uint32_t keys{100000U};
+  /// Share of SETs among the commands in resp mode, the rest are GETs.
+  double set_ratio{0.1};
+  std::chrono::seconds duration{10};
+  uint32_t threads{1U};
+  /// Open loop target rates in messages per second over all threads. Runs closed loop when empty. Every rate is run
+  /// for `duration` in the given order, which gives one point of a latency vs throughput curve each.
+  std::vector<double> rates{};
+  Arrival arrival{Arrival::fixed};
+  OutputFormat format{OutputFormat::text};
+  /// When set, the first thread traces its ring and writes a Chrome trace here.
+  std::string trace_file{};
+};
+
+/// Parse `--key=value` style arguments. Terminates with a usage message on bad input. In http mode the message size
+/// is the size of the request.
+Options parse_options(int argc, char* argv[]);
+
+/// The request every message is made of in http mode.
+std::string http_request(const Options& options);
+
+}  // namespace spinscale::nwprog::client
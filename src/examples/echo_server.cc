@@ -1,20 +1,40 @@
 #include <errno.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <signal.h>
 #include <stdio.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstring>
 #include <deque>
 #include <iostream>
+#include <optional>
 #include <source_location>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "src/io/buffer_ring.hh"
+#include "src/io/shm_channel.hh"
+#include "src/io/tcp_socket.hh"
+#include "src/io/unix_socket.hh"
 #include "src/io/uring.hh"
+#include "src/io/uring_capabilities.hh"
+#include "src/lib/byte_ring.hh"
+#include "src/lib/dirty_list.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/framing.hh"
 #include "src/lib/log.hh"
 #include "src/lib/scope_guard.hh"
+#include "src/lib/tsc.hh"
 
 namespace
 {
@@ -25,7 +45,24 @@ namespace io = spinscale::nwprog::io;
 
 constexpr auto max_events = 1024U;
 constexpr auto ring_size = max_events * 2;
+/// Completion queue of the io_uring mode, the most the kernel allows. Every client may have a read and a write in
+/// flight, so it holds 32k of them.
+constexpr auto completion_queue_size = 64U * 1024U;
 constexpr auto max_message_size = 2048U;
+/// Echoes of a connection the epoll mode keeps when its socket does not take them, it stops reading from the
+/// connection until they got out.
+constexpr auto max_staged_size = 64U * 1024U;
+/// Per connection and direction buffer of the io_uring mode.
+constexpr auto connection_buffer_size = 16U * 1024U;
+/// A read into less free input space waits until writes made room, unless nothing that is in the input can leave.
+constexpr auto min_read_size = 4U * 1024U;
+/// Datagrams handled per recvmmsg and sendmmsg in the epoll mode.
+constexpr auto datagram_batch_size = 64U;
+/// Room for the largest datagram, and for the largest batch of datagrams GRO coalesces into one receive.
+constexpr auto max_datagram_size = 64U * 1024U;
+/// Receive buffers of the io_uring mode, shared by all datagrams in flight.
+constexpr auto datagram_buffers = 256U;
+constexpr uint16_t datagram_buffer_group = 0U;
 
 enum class IoMode : uint8_t
 {
@@ -34,6 +71,45 @@ enum class IoMode : uint8_t
 };
 
 using Event = struct epoll_event;
+
+/// Control data of a receive or send that carries a GRO or GSO segment size.
+using SegmentControl = std::array<char, CMSG_SPACE(sizeof(int))>;
+
+/// Size of the datagrams a receive was coalesced from by GRO, 0 for a single datagram.
+uint16_t gro_segment_size(const struct msghdr& msg)
+{
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg), cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+    {
+      int size = 0;
+      memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+      return static_cast<uint16_t>(size);
+    }
+  }
+  return 0U;
+}
+
+/// Echo a coalesced receive with a single send that GSO splits into datagrams of `segment_size` again, so the peer
+/// sees the datagrams it sent. Single datagrams go out without control data.
+void set_gso_segment_size(struct msghdr& msg, SegmentControl& control, const uint16_t segment_size, const size_t length)
+{
+  if (segment_size == 0U || segment_size >= length)
+  {
+    msg.msg_control = nullptr;
+    msg.msg_controllen = 0U;
+    return;
+  }
+  msg.msg_control = control.data();
+  msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_UDP;
+  cmsg->cmsg_type = UDP_SEGMENT;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+  memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+}
+
 // epoll specific stuff.
 namespace epoll
 {
@@ -54,33 +130,153 @@ void handle_new_connection(int listen_fd, int epollfd)
   // We use static storage here so that it is reusable across invocations. Since its overwritten every time this does
   // not cause overlaps.
   // 1. create a non blocking socket
-  struct sockaddr_in client_addr;
+  struct sockaddr_storage client_addr;
   socklen_t socklen = sizeof(client_addr);
   int sock_conn_fd = ::accept4(listen_fd, (struct sockaddr*)&client_addr, &socklen, SOCK_NONBLOCK);
   log::expects(sock_conn_fd >= 0, "Error accepting new connection.");
 
-  // 1. register the connected socket to epoll.
+  // 1. register the connected socket to epoll. Edge triggered, writability is only reported when a full send buffer
+  // got room again.
   static Event event;
-  event.events = EPOLLIN | EPOLLET;
+  event.events = EPOLLIN | EPOLLOUT | EPOLLET;
   event.data.fd = sock_conn_fd;
   log::expects(epoll_ctl(epollfd, EPOLL_CTL_ADD, sock_conn_fd, &event) == 0, "Error adding new event to epoll.");
 }
 
-[[nodiscard]] bool handle_echo(int sock_conn_fd, int epollfd, char buffer[])
+/// Echoes of a connection that its socket did not take yet.
+struct Staged
+{
+  std::string data{};
+  /// Bytes at the front of `data` that were sent already.
+  size_t sent{0U};
+  /// Reading stopped at `max_staged_size`, the socket may still hold data.
+  bool throttled{false};
+  /// The client shut down its side, the connection is closed once its echoes are out.
+  bool closing{false};
+
+  [[nodiscard]] size_t size() const
+  {
+    return data.size() - sent;
+  }
+};
+
+/// Echoes received during one loop iteration leave with a single send per connection before the loop waits again.
+/// What the socket does not take stays staged until epoll reports it writable, so a client that reads slowly does not
+/// stall the loop.
+class OutputStage
 {
-  int bytes_received = recv(sock_conn_fd, buffer, max_message_size, 0);
-  // handle client shutdown.
-  if (bytes_received <= 0)
+public:
+  Staged& operator[](const int fd)
+  {
+    if (static_cast<size_t>(fd) >= staged_.size())
+    {
+      staged_.resize(fd + 1U);
+    }
+    return staged_[fd];
+  }
+
+  void append(const int fd, const std::string_view data)
   {
-    // MUST delete before shutdown otherwise zombie fd.
-    epoll_ctl(epollfd, EPOLL_CTL_DEL, sock_conn_fd, NULL);
-    shutdown(sock_conn_fd, SHUT_RDWR);
+    (*this)[fd].data.append(data);
+    dirty_.mark(fd);
   }
-  else
+
+  /// Send as much as the socket takes. False when the connection broke, its echoes are dropped then.
+  bool flush(const int fd)
   {
-    log::expects(send(sock_conn_fd, buffer, bytes_received, 0) != -1, "failed to send echo back.");
-    static constexpr auto exit_bytes = "bye\n";
-    if (bytes_received == 4 && std::strcmp(buffer, exit_bytes) == 0)
+    Staged& staged = (*this)[fd];
+    while (staged.size() > 0U)
+    {
+      const ssize_t sent = send(fd, staged.data.data() + staged.sent, staged.size(), MSG_NOSIGNAL);
+      if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      {
+        return true;
+      }
+      if (sent < 0)
+      {
+        log::expects(errno == ECONNRESET || errno == EPIPE, "failed to send echo back.");
+        staged = Staged{};
+        return false;
+      }
+      staged.sent += static_cast<size_t>(sent);
+    }
+    // The capacity is kept for the next echoes.
+    staged.data.clear();
+    staged.sent = 0U;
+    return true;
+  }
+
+  /// Call `fn(fd)` for every connection that got echoes since the last call.
+  template <class Fn>
+  void flush_all(Fn&& fn)
+  {
+    dirty_.drain([&fn](const uint32_t fd) { fn(static_cast<int>(fd)); });
+  }
+
+private:
+  /// Indexed by fd, they keep their capacity across iterations.
+  std::vector<Staged> staged_{};
+  lib::DirtyList dirty_{};
+};
+
+void close_connection(const int sock_conn_fd, const int epollfd, OutputStage& stage)
+{
+  stage[sock_conn_fd] = Staged{};
+  // MUST delete before shutdown otherwise zombie fd.
+  epoll_ctl(epollfd, EPOLL_CTL_DEL, sock_conn_fd, NULL);
+  shutdown(sock_conn_fd, SHUT_RDWR);
+}
+
+/// Send the staged echoes of a connection. Closes it when it broke, or when the client shut down its side and all
+/// echoes are out. False when it was closed.
+bool flush_connection(const int sock_conn_fd, const int epollfd, OutputStage& stage)
+{
+  const bool alive = stage.flush(sock_conn_fd);
+  if (!alive || (stage[sock_conn_fd].closing && stage[sock_conn_fd].size() == 0U))
+  {
+    close_connection(sock_conn_fd, epollfd, stage);
+    return false;
+  }
+  return true;
+}
+
+/// Read what the client sent and stage the echoes. False once the client said bye.
+[[nodiscard]] bool handle_echo(int sock_conn_fd, int epollfd, char buffer[], OutputStage& stage)
+{
+  Staged& staged = stage[sock_conn_fd];
+  staged.throttled = false;
+  // The socket is edge triggered so it has to be drained, otherwise pipelined data beyond the first chunk is stuck
+  // until the client sends more. Unless the echoes pile up, then reading resumes once the socket took some of them.
+  while (!staged.closing)
+  {
+    if (staged.size() >= max_staged_size)
+    {
+      if (!flush_connection(sock_conn_fd, epollfd, stage))
+      {
+        break;
+      }
+      if (staged.size() >= max_staged_size)
+      {
+        staged.throttled = true;
+        break;
+      }
+    }
+    int bytes_received = recv(sock_conn_fd, buffer, max_message_size, 0);
+    if (bytes_received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      break;
+    }
+    // handle client shutdown.
+    if (bytes_received <= 0)
+    {
+      // Echoes of earlier chunks still go out.
+      staged.closing = true;
+      flush_connection(sock_conn_fd, epollfd, stage);
+      break;
+    }
+    stage.append(sock_conn_fd, {buffer, static_cast<size_t>(bytes_received)});
+    // The buffer is not NUL terminated.
+    if (std::string_view(buffer, bytes_received) == "bye\n")
     {
       return false;
     }
@@ -94,6 +290,8 @@ void run_event_loop(const int listen_fd, const int epollfd)
   memset(buffer, 0, sizeof(buffer));
   // Preallocated event array for handling for the epoll_wait.
   Event events[max_events];
+  OutputStage stage;
+  const auto flush = [&](const int fd) { flush_connection(fd, epollfd, stage); };
   while (1)
   {
     // maybe new events otherwise -1 on error.
@@ -102,45 +300,156 @@ void run_event_loop(const int listen_fd, const int epollfd)
 
     for (auto i = 0U; i < new_events; ++i)
     {
-      if (events[i].data.fd == listen_fd)
+      const int fd = events[i].data.fd;
+      if (fd == listen_fd)
       {
         handle_new_connection(listen_fd, epollfd);
+        continue;
       }
-      else
+      // Staged echoes go first, the room they leave may resume reading.
+      if ((events[i].events & EPOLLOUT) != 0U && !flush_connection(fd, epollfd, stage))
       {
-        if (const auto should_continue = handle_echo(events[i].data.fd, epollfd, buffer); !should_continue)
-        {
-          return;
-        }
+        continue;
+      }
+      const bool resume = stage[fd].throttled && stage[fd].size() < max_staged_size;
+      if ((events[i].events & ~EPOLLOUT) == 0U && !resume)
+      {
+        continue;
+      }
+      if (const auto should_continue = handle_echo(fd, epollfd, buffer, stage); !should_continue)
+      {
+        stage.flush_all(flush);
+        return;
+      }
+    }
+    stage.flush_all(flush);
+  }
+}
+
+/// Send `count` datagrams, waiting for the socket to become writable when its send buffer is full.
+void send_all(const int sock_fd, struct mmsghdr* messages, const uint32_t count)
+{
+  uint32_t sent = 0U;
+  while (sent < count)
+  {
+    const int res = sendmmsg(sock_fd, messages + sent, count - sent, 0);
+    if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      struct pollfd writable = {.fd = sock_fd, .events = POLLOUT, .revents = 0};
+      poll(&writable, 1, -1);
+      continue;
+    }
+    log::expects(res >= 0, "failed to send datagrams back.");
+    sent += res;
+  }
+}
+
+/// Echo datagrams on `sock_fd`. Every wakeup drains the socket with recvmmsg and echoes each batch with a single
+/// sendmmsg, so the syscalls are shared by up to `datagram_batch_size` datagrams.
+void run_datagram_loop(const int sock_fd, const int epollfd)
+{
+  std::vector<char> buffers(datagram_batch_size * max_datagram_size);
+  std::array<struct mmsghdr, datagram_batch_size> messages{};
+  std::array<struct iovec, datagram_batch_size> iovecs{};
+  std::array<struct sockaddr_in6, datagram_batch_size> peers{};
+  std::array<SegmentControl, datagram_batch_size> receive_controls{};
+  std::array<SegmentControl, datagram_batch_size> send_controls{};
+  Event events[max_events];
+  uint64_t num_datagrams = 0U;
+  uint64_t num_coalesced = 0U;
+  bool stop = false;
+  while (!stop)
+  {
+    const int new_events = epoll_wait(epollfd, events, max_events, -1);
+    log::expects(new_events != -1 || errno == EINTR, "Error during epoll_wait.");
+    while (!stop)
+    {
+      // recvmmsg overwrites lengths with what it received, so every batch starts over.
+      for (uint32_t i = 0; i < datagram_batch_size; ++i)
+      {
+        iovecs[i] = {.iov_base = buffers.data() + i * max_datagram_size, .iov_len = max_datagram_size};
+        messages[i].msg_hdr = {
+          .msg_name = &peers[i],
+          .msg_namelen = sizeof(peers[i]),
+          .msg_iov = &iovecs[i],
+          .msg_iovlen = 1,
+          .msg_control = receive_controls[i].data(),
+          .msg_controllen = receive_controls[i].size(),
+          .msg_flags = 0,
+        };
+      }
+      const int received = recvmmsg(sock_fd, messages.data(), datagram_batch_size, MSG_DONTWAIT, nullptr);
+      if (received < 0)
+      {
+        log::expects(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR, "failed to receive datagrams.");
+        break;
+      }
+      // The received messages are sent back as they are, only lengths and control data change.
+      for (int i = 0; i < received; ++i)
+      {
+        struct msghdr& msg = messages[i].msg_hdr;
+        iovecs[i].iov_len = messages[i].msg_len;
+        const uint16_t segment_size = gro_segment_size(msg);
+        num_datagrams += segment_size == 0U ? 1U : (messages[i].msg_len + segment_size - 1U) / segment_size;
+        num_coalesced += segment_size == 0U ? 0U : 1U;
+        set_gso_segment_size(msg, send_controls[i], segment_size, messages[i].msg_len);
+        stop = stop || std::string_view(static_cast<char*>(iovecs[i].iov_base), messages[i].msg_len) == "bye\n";
+      }
+      send_all(sock_fd, messages.data(), received);
+      if (static_cast<uint32_t>(received) < datagram_batch_size)
+      {
+        break;
       }
     }
   }
+  log::info(
+    "echoed " + std::to_string(num_datagrams) + " datagrams, " + std::to_string(num_coalesced) +
+    " receives were coalesced by GRO.");
 }
 }  // namespace epoll
 
-/// Common TCP socket setup for the server side.
-int setup_server_socket(int portno)
+/// Common TCP socket setup for the server side. Further servers may share the port.
+int setup_server_socket(int portno, io::TcpOptions options)
+{
+  options.reuse_port = true;
+  const auto listening = io::listen_tcp(static_cast<uint16_t>(portno), options);
+  log::expects(listening.is_ok(), "Error listening on the TCP port.");
+  log::info("echo server listening for connections.");
+  return listening.value();
+}
+
+/// Stream socket listening at a unix domain socket `path`, for clients on the same host that can skip the TCP stack.
+int setup_unix_socket(const std::string_view path)
+{
+  const auto listening = io::listen_unix(path, io::UnixSocketType::stream, max_events);
+  log::expects(listening.is_ok(), "Error listening on the unix domain socket.");
+  log::info("echo server listening for connections on " + std::string(path) + ".");
+  return listening.value();
+}
+
+/// UDP socket bound to `portno`. Asks for GRO, so the kernel may hand over a batch of datagrams of the same flow and
+/// size as a single receive.
+int setup_datagram_socket(int portno)
 {
-  // setup socket
   struct sockaddr_in server_addr;
-  int sock_listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-  log::expects(sock_listen_fd >= 0, "Error creating listening socket.");
+  int sock_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+  log::expects(sock_fd >= 0, "Error creating datagram socket.");
   const int reuse_port = 1;
   log::expects(
-    setsockopt(sock_listen_fd, SOL_SOCKET, SO_REUSEPORT, &reuse_port, sizeof(reuse_port)) == 0,
-    "Error setting SO_REUSEPORT");
+    setsockopt(sock_fd, SOL_SOCKET, SO_REUSEPORT, &reuse_port, sizeof(reuse_port)) == 0, "Error setting SO_REUSEPORT");
+  const int gro = 1;
+  if (setsockopt(sock_fd, SOL_UDP, UDP_GRO, &gro, sizeof(gro)) != 0)
+  {
+    log::warn("UDP GRO is not supported, every datagram is received on its own.");
+  }
 
   memset((char*)&server_addr, 0, sizeof(server_addr));
   server_addr.sin_family = AF_INET;
   server_addr.sin_port = htons(portno);
   server_addr.sin_addr.s_addr = INADDR_ANY;
-
-  // bind socket and listen for connections
-  log::expects(
-    bind(sock_listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) >= 0, "Error binding to socket.");
-  log::expects(listen(sock_listen_fd, max_events) >= 0, "Error listening!");
-  log::info("echo server listening for connections.");
-  return sock_listen_fd;
+  log::expects(bind(sock_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) >= 0, "Error binding to socket.");
+  log::info("echo server waiting for datagrams.");
+  return sock_fd;
 }
 
 IoMode get_mode(const char* mode)
@@ -161,11 +470,17 @@ IoMode get_mode(const char* mode)
 namespace uring
 {
 
-enum class RequestType
+enum class RequestType : uint8_t
 {
   accept,
   read,
-  write
+  write,
+  receive,
+  send,
+  doorbell,
+  hangup,
+  poll,
+  cancel
 };
 
 union IORequest
@@ -173,100 +488,820 @@ union IORequest
   struct
   {
     RequestType type : 8;
-    uint16_t fd;
     uint32_t client_id;
   } unpacked;
   uint64_t packed;
 };
 
+/// Per connection state with a buffer per direction. Reads land in the input, echoes move on to the output as soon as
+/// they are complete and writes flush it, so a read stays armed while writes are in flight and a slow write does not
+/// take the room of the next read.
+///
+/// Each direction is throttled by the other one: echoes wait in the input while the output is full, and reading
+/// stops while the input is, until the peer takes its echoes and the kernel's socket buffers push back on it.
+///
+/// In readiness mode a client without anything to echo has no buffers and no read in flight, only a poll.
+/// Buffers are taken from a pool when the poll reports data and go back once all of it was echoed.
+struct Client
+{
+  Client(const int fd, const bool buffered) : fd(fd)
+  {
+    if (buffered)
+    {
+      input.emplace(connection_buffer_size);
+      output.emplace(connection_buffer_size, lib::ByteRing::Mapping::single);
+    }
+  }
+
+  int fd;
+  /// Released once the connection is closed, and in readiness mode while it is idle.
+  std::optional<lib::ByteRing> input;
+  std::optional<lib::ByteRing> output;
+  /// The iovecs have to stay alive until their op was submitted.
+  struct iovec read_iovecs[2];
+  struct iovec write_iovecs[2];
+  /// Readiness mode reads with recvmsg, MSG_DONTWAIT makes it fail instead of waiting for data in the kernel.
+  struct msghdr read_msg
+  {
+  };
+  /// Bytes at the front of the input that may be echoed. In framed mode that excludes a trailing partial frame.
+  size_t complete{0U};
+  bool reading{false};
+  bool writing{false};
+  /// The client shut down its side, pending echoes are still flushed.
+  bool read_done{false};
+  bool failed{false};
+  bool open{true};
+  /// Readiness mode: the poll is armed, a cancel of it is on its way, and it reported data no read picked up yet.
+  bool polling{false};
+  bool cancelling{false};
+  bool readable{false};
+};
+
 struct CompletionCb
 {
   static_assert(sizeof(IORequest) <= sizeof(void*));
 
-  void operator()(void* user_data, int32_t result)
+  void operator()(void* user_data, io::IoResult io_result)
   {
     IORequest request = {.packed = (uint64_t)user_data};
     switch (request.unpacked.type)
     {
       case RequestType::accept:
       {
-        log::expects(result != -1, "accept operation failed.");
-        // A: prepare for a new acceptance.
+        accepting = false;
+        if (io_result.contains_err(lib::Errno(EMFILE)) || io_result.contains_err(lib::Errno(ENFILE)))
         {
-          IORequest next_accept{.unpacked{.type = RequestType::accept, .client_id = num_clients}};
-          ring.prepare_accept(listen_fd, (struct sockaddr*)&client_addr, &socklen, (void*)next_accept.packed);
+          // Further clients wait in the listen backlog until one of the open ones leaves.
+          log::warn("out of descriptors, accepting pauses until a client leaves.");
+          out_of_descriptors = true;
+          start_accept();
+          break;
         }
-        // B: start reads after accept.
+        log::expects(io_result.is_ok(), "accept operation failed.");
+        // A: start reads after accept, or wait for data in readiness mode. On successful accept the result is the
+        // connected socket.
+        const uint32_t client_id = add_client(io_result.value());
+        if (readiness)
         {
-          auto& buffer = read_buffers.emplace_back();
-          IORequest next_read = {
-            .unpacked{.type = RequestType::read, .fd = static_cast<uint16_t>(result), .client_id = num_clients}};
-          // on successful accept the result points to the sock_conn_fd.
-          ring.prepare_read(result, buffer, max_message_size, 0, (void*)next_read.packed);
+          start_poll(client_id);
         }
-        ++num_clients;
+        else
+        {
+          start_read(client_id);
+        }
+        ++num_open;
+        // B: prepare for a new acceptance, unless the client limit is reached.
+        start_accept();
         break;
       }
       case RequestType::read:
       {
-        log::expects(result != -1, "read operation failed.");
-        if (result > 0)
-        {  // start writes after accept.
-          IORequest next = {
-            .unpacked{.type = RequestType::write, .fd = request.unpacked.fd, .client_id = request.unpacked.client_id}};
-          // on successful read the result points to number of bytes read.
-          ring.prepare_write(request.unpacked.fd, read_buffers[next.unpacked.client_id], result, 0, (void*)next.packed);
+        Client& client = clients[request.unpacked.client_id];
+        client.reading = false;
+        const int32_t result = io_result.value_or(0);
+        if (io_result.contains_err(lib::Errno(EAGAIN)))
+        {
+          // Readiness mode, the data the poll reported was taken by the read before. It may have reported more since.
+          start_read(request.unpacked.client_id);
+        }
+        else if (result <= 0)
+        {
+          // Failed reads are treated like a closed connection.
+          client.read_done = true;
         }
         else
         {
-          shutdown(request.unpacked.fd, SHUT_RDWR);
+          client.input->commit(result);
+          // A read that filled the input likely left more behind, the poll does not report that again.
+          client.readable = client.readable || client.input->free_space() == 0U;
+          on_data(client);
+          stage_echoes(client);
+          pending_writes.mark(request.unpacked.client_id);
+          start_read(request.unpacked.client_id);
         }
+        start_poll(request.unpacked.client_id);
+        park_if_idle(client);
+        release_if_done(request.unpacked.client_id);
         break;
       }
       case RequestType::write:
       {
-        log::expects(result != -1, "write operation failed.");
-        // prepare to read again.
+        Client& client = clients[request.unpacked.client_id];
+        client.writing = false;
+        const int32_t result = io_result.value_or(0);
+        if (result <= 0)
+        {
+          client.failed = true;
+        }
+        else
+        {
+          client.output->consume(result);
+          // Echoes that waited for room follow, and the input they leave may take the next read.
+          stage_echoes(client);
+          pending_writes.mark(request.unpacked.client_id);
+          start_read(request.unpacked.client_id);
+        }
+        park_if_idle(client);
+        release_if_done(request.unpacked.client_id);
+        break;
+      }
+      case RequestType::poll:
+      {
+        Client& client = clients[request.unpacked.client_id];
+        client.polling = (ring.completion_flags() & IORING_CQE_F_MORE) != 0U;
+        if (io_result.is_ok())
+        {
+          client.readable = true;
+          start_read(request.unpacked.client_id);
+        }
+        // The kernel ends multishot polls on its own now and then, e.g. when it ran out of completion queue entries. A
+        // read that was started above re-arms the poll once it completes.
+        if (!client.cancelling)
         {
-          IORequest next_read = {
-            .unpacked{.type = RequestType::read, .fd = request.unpacked.fd, .client_id = request.unpacked.client_id}};
-          // on successful read the result points to number of bytes read.
-          ring.prepare_read(
-            request.unpacked.fd, read_buffers[request.unpacked.client_id], max_message_size, 0,
-            (void*)next_read.packed);
+          start_poll(request.unpacked.client_id);
         }
-        // TODO: we should clean up stuff based on result == 0 here.
+        release_if_done(request.unpacked.client_id);
+        break;
+      }
+      default:
+      {
+        // The cancelled poll completes on its own.
         break;
       }
     }
   }
 
+  /// Put a new client into the slot of a released one, or a new slot when there is none.
+  uint32_t add_client(const int fd)
+  {
+    if (free_ids.empty())
+    {
+      clients.emplace_back(fd, !readiness);
+      return clients.size() - 1U;
+    }
+    // Only the cancel of the previous client's poll may still be in flight, and its completion ignores the client.
+    const uint32_t client_id = free_ids.back();
+    free_ids.pop_back();
+    clients[client_id] = Client(fd, !readiness);
+    return client_id;
+  }
+
+  /// Find out how much of the newly read data can be echoed.
+  void on_data(Client& client)
+  {
+    if (!framed)
+    {
+      client.complete = client.input->size();
+      return;
+    }
+    // All complete frames of the read are handled as one batch and their echoes leave in a single writev. The
+    // mirrored buffer makes frames that wrap around contiguous, so they are parsed in place.
+    log::expects(client.input->mirrored(), "framing needs a mirrored connection buffer.");
+    const auto parsed = lib::framing::for_each_frame(
+      client.input->filled().substr(client.complete),
+      [this](const std::string_view payload)
+      {
+        ++num_frames;
+        ready_to_stop = ready_to_stop || payload == "bye";
+      },
+      connection_buffer_size - lib::framing::header_size);
+    if (parsed.is_error())
+    {
+      log::warn("dropping client after a frame larger than the connection buffer.");
+      client.failed = true;
+      return;
+    }
+    client.complete += parsed.value();
+  }
+
+  /// Move as many complete bytes from the input to the output as fit, they leave with the next write.
+  void stage_echoes(Client& client)
+  {
+    while (client.complete > 0U && client.output->free_space() > 0U)
+    {
+      const std::string_view echo = client.input->filled().substr(0, client.complete);
+      const size_t staged = client.output->append(echo);
+      client.input->consume(staged);
+      client.complete -= staged;
+    }
+  }
+
+  /// Read into all free input space unless a read is in flight or too little of it is free. A small read waits for
+  /// writes to make room, unless the input holds nothing they could take and only more data completes a frame. In
+  /// readiness mode only data the poll reported is read, and the client gets its buffers for it.
+  void start_read(const uint32_t client_id)
+  {
+    Client& client = clients[client_id];
+    if (client.reading || client.read_done || client.failed || (readiness && !client.readable))
+    {
+      return;
+    }
+    if (!client.input)
+    {
+      take_buffers(client);
+    }
+    if (client.input->free_space() < min_read_size && client.complete > 0U)
+    {
+      return;
+    }
+    const uint32_t count = client.input->writable(client.read_iovecs);
+    if (count == 0)
+    {
+      return;
+    }
+    IORequest next_read = {.unpacked{.type = RequestType::read, .client_id = client_id}};
+    if (!readiness)
+    {
+      client.reading = ring.prepare_readv(client.fd, client.read_iovecs, count, 0, (void*)next_read.packed).is_ok();
+      return;
+    }
+    client.read_msg.msg_iov = client.read_iovecs;
+    client.read_msg.msg_iovlen = count;
+    client.reading = ring.prepare_recvmsg(client.fd, &client.read_msg, MSG_DONTWAIT, (void*)next_read.packed).is_ok();
+    client.readable = !client.reading;
+  }
+
+  /// Arm the poll of a client in readiness mode unless it is armed already, the client is finished, or data may be
+  /// left on the socket. Kernels without multishot polls get a single shot one, which would complete right away while
+  /// a full input leaves data behind, so the read that drains the socket re-arms it, like a multishot poll the kernel
+  /// ended.
+  void start_poll(const uint32_t client_id)
+  {
+    Client& client = clients[client_id];
+    if (!readiness || client.polling || client.read_done || client.failed || client.readable || client.reading)
+    {
+      return;
+    }
+    IORequest next_poll = {.unpacked{.type = RequestType::poll, .client_id = client_id}};
+    client.polling = (multishot_poll ? ring.prepare_poll_multishot(client.fd, POLLIN, (void*)next_poll.packed)
+                                     : ring.prepare_poll(client.fd, POLLIN, (void*)next_poll.packed))
+                       .is_ok();
+  }
+
+  void take_buffers(Client& client)
+  {
+    if (idle_buffers.empty())
+    {
+      client.input.emplace(connection_buffer_size);
+      client.output.emplace(connection_buffer_size, lib::ByteRing::Mapping::single);
+      return;
+    }
+    client.input.emplace(std::move(idle_buffers.back().first));
+    client.output.emplace(std::move(idle_buffers.back().second));
+    idle_buffers.pop_back();
+  }
+
+  /// Hand the buffers of a client in readiness mode back to the pool once it has nothing left to echo.
+  void park_if_idle(Client& client)
+  {
+    if (!readiness || !client.input || client.reading || client.writing || !client.input->empty() ||
+        !client.output->empty())
+    {
+      return;
+    }
+    idle_buffers.emplace_back(std::move(*client.input), std::move(*client.output));
+    client.input.reset();
+    client.output.reset();
+  }
+
+  /// Start the writes of all clients that got data or finished a write during this iteration. Completions only mark
+  /// their client, so a client that got several completions at once still gets a single writev.
+  void flush_writes()
+  {
+    pending_writes.drain([this](const uint32_t client_id) { start_write(client_id); });
+  }
+
+  /// Flush everything that can be echoed unless a write is in flight.
+  void start_write(const uint32_t client_id)
+  {
+    Client& client = clients[client_id];
+    if (client.writing || client.failed || !client.output)
+    {
+      return;
+    }
+    const uint32_t count = client.output->readable(client.write_iovecs);
+    if (count == 0)
+    {
+      return;
+    }
+    IORequest next_write = {.unpacked{.type = RequestType::write, .client_id = client_id}};
+    client.writing = ring.prepare_writev(client.fd, client.write_iovecs, count, 0, (void*)next_write.packed).is_ok();
+  }
+
+  /// Close the socket and free the buffers once the client is gone and no op refers to them anymore. A partial frame
+  /// the client left behind is dropped. The poll of readiness mode is cancelled first.
+  void release_if_done(const uint32_t client_id)
+  {
+    Client& client = clients[client_id];
+    if (!client.open)
+    {
+      return;
+    }
+    const bool flushed = !client.output || client.output->empty();
+    const bool done = client.failed || (client.read_done && client.complete == 0U && flushed);
+    if (!done || client.reading || client.writing)
+    {
+      return;
+    }
+    if (client.polling)
+    {
+      if (!client.cancelling)
+      {
+        IORequest poll = {.unpacked{.type = RequestType::poll, .client_id = client_id}};
+        IORequest cancel = {.unpacked{.type = RequestType::cancel, .client_id = client_id}};
+        client.cancelling = ring.prepare_cancel((void*)poll.packed, (void*)cancel.packed).is_ok();
+      }
+      return;
+    }
+    close(client.fd);
+    client.input.reset();
+    client.output.reset();
+    client.open = false;
+    free_ids.push_back(client_id);
+    --num_open;
+    // Its descriptor may be what the last accept was missing.
+    out_of_descriptors = false;
+    start_accept();
+  }
+
+  /// Every open client may have a read and a write in flight, one more op is the accept. Beyond that completions
+  /// would overflow the completion queue, so accepting pauses and further clients wait in the listen backlog.
+  ///
+  /// Readiness mode does not limit clients that way. An idle client only has its poll armed, which takes a
+  /// completion queue entry once data arrives, and a burst from more clients than entries overflows into the kernel's
+  /// backlog instead of getting lost. Only running out of descriptors pauses accepting there.
+  void start_accept()
+  {
+    if (accepting)
+    {
+      return;
+    }
+    if (out_of_descriptors || (!readiness && num_open >= (ring.completion_queue_size() - 1U) / 2U))
+    {
+      accept_pauses += accept_paused ? 0U : 1U;
+      accept_paused = true;
+      return;
+    }
+    accept_paused = false;
+    IORequest next_accept{.unpacked{.type = RequestType::accept, .client_id = 0U}};
+    accepting =
+      ring.prepare_accept(listen_fd, (struct sockaddr*)&client_addr, &socklen, (void*)next_accept.packed).is_ok();
+    log::expects(accepting, "unable to prepare the next accept.");
+  }
+
   const int listen_fd;
   io::Uring& ring;
+  /// Echo length prefixed frames instead of raw bytes, a frame with the payload "bye" stops the server.
+  const bool framed;
+  /// Wait for data with a poll per client instead of a read, so idle clients hold no buffers.
+  const bool readiness;
+  const bool multishot_poll = io::UringCapabilities::get().multishot_poll();
 
-  /// Internal members.
-  std::deque<char[max_message_size]> read_buffers{max_events};
-  uint32_t num_clients = 0U;
+  /// Internal members. A deque keeps clients in place while new ones are added.
+  std::deque<Client> clients{};
+  /// Ids of released clients, taken by new ones before `clients` grows.
+  std::vector<uint32_t> free_ids{};
+  /// Clients that were not released yet.
+  uint32_t num_open = 0U;
+  /// The last accept ran out of descriptors, accepting waits for a client to be released.
+  bool out_of_descriptors{false};
+  /// Buffers of idle clients in readiness mode, for the next client that gets data.
+  std::vector<std::pair<lib::ByteRing, lib::ByteRing>> idle_buffers{};
+  bool accepting{false};
+  bool accept_paused{false};
+  uint64_t accept_pauses = 0U;
+  /// Clients with echoes staged in their buffer during the current iteration.
+  lib::DirtyList pending_writes{};
+  uint64_t num_frames = 0U;
   bool ready_to_stop{false};
   // we cannot have two simultaneous accepts in progress so having a single client_addr is fine here.
-  struct sockaddr_in client_addr;
+  struct sockaddr_storage client_addr;
   socklen_t socklen = sizeof(client_addr);
 };
 
-void run_event_loop(const int listen_fd, io::Uring& ring)
+void run_event_loop(const int listen_fd, io::Uring& ring, const bool framed, const bool readiness)
+{
+  CompletionCb completion_cb{listen_fd, ring, framed, readiness};
+  // kick off the first accept.
+  completion_cb.start_accept();
+  ring.submit_or_defer();
+  while (!completion_cb.ready_to_stop)
+  {
+    const auto handled = ring.for_every_completion(completion_cb);
+    log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+    completion_cb.flush_writes();
+    ring.submit_or_defer();
+  };
+  log::info(
+    "echoed " + std::to_string(completion_cb.num_frames) + " frames, accepting paused " +
+    std::to_string(completion_cb.accept_pauses) + " times at the client limit.");
+}
+
+/// Echo of a datagram, it points into the receive buffer, which stays out of the buffer ring until the send completed.
+struct DatagramReply
+{
+  struct msghdr msg;
+  struct iovec iov;
+  SegmentControl control;
+};
+
+struct DatagramCb
 {
-  CompletionCb completion_cb{listen_fd, ring};
-  {  // kick off the first accept.
-    IORequest next_accept = {.unpacked{.type = RequestType::accept, .client_id = 0}};
-    ring.prepare_accept(
-      listen_fd, (struct sockaddr*)&completion_cb.client_addr, &completion_cb.socklen, (void*)next_accept.packed);
-    ring.submit();
+  void operator()(void* user_data, io::IoResult io_result)
+  {
+    IORequest request = {.packed = (uint64_t)user_data};
+    switch (request.unpacked.type)
+    {
+      case RequestType::receive:
+      {
+        on_receive(io_result);
+        break;
+      }
+      case RequestType::send:
+      {
+        buffers.recycle(static_cast<uint16_t>(request.unpacked.client_id));
+        --sends_in_flight;
+        // Waiting for a buffer to come back.
+        if (!receiving)
+        {
+          start_receive();
+        }
+        break;
+      }
+      default:
+        log::expects(false, "unexpected request on a datagram socket.");
+    }
   }
-  while (true)
+
+  void on_receive(const io::IoResult& io_result)
   {
-    ring.for_every_completion(completion_cb);
-    ring.submit();
+    const uint32_t flags = ring.completion_flags();
+    if (const auto id = io::BufferRing::buffer_id(flags); id.has_value())
+    {
+      if (io_result.is_ok())
+      {
+        echo(*id, io_result.value());
+      }
+      else
+      {
+        buffers.recycle(*id);
+      }
+    }
+    if ((flags & IORING_CQE_F_MORE) != 0U)
+    {
+      return;
+    }
+    // The multishot receive ended. Out of buffers it is armed again once a send returns one, otherwise right away.
+    receiving = false;
+    if (io_result.contains_err(lib::Errno(ENOBUFS)) && sends_in_flight > 0U)
+    {
+      ++buffer_stalls;
+      return;
+    }
+    start_receive();
+  }
+
+  void echo(const uint16_t id, const int32_t length)
+  {
+    auto* out = io_uring_recvmsg_validate(buffers.buffer(id), length, &receive_msg);
+    if (out == nullptr)
+    {
+      buffers.recycle(id);
+      return;
+    }
+    DatagramReply& reply = replies[id];
+    const size_t payload_length = io_uring_recvmsg_payload_length(out, length, &receive_msg);
+    reply.iov = {.iov_base = io_uring_recvmsg_payload(out, &receive_msg), .iov_len = payload_length};
+    reply.msg = {};
+    reply.msg.msg_name = io_uring_recvmsg_name(out);
+    reply.msg.msg_namelen = std::min(out->namelen, receive_msg.msg_namelen);
+    reply.msg.msg_iov = &reply.iov;
+    reply.msg.msg_iovlen = 1;
+
+    // The control data of the receive sits between name and payload, wrapped so the CMSG macros can walk it.
+    struct msghdr received_control
+    {
+    };
+    received_control.msg_control = reinterpret_cast<char*>(reply.msg.msg_name) + receive_msg.msg_namelen;
+    received_control.msg_controllen = out->controllen;
+    const uint16_t segment_size = gro_segment_size(received_control);
+    num_datagrams += segment_size == 0U ? 1U : (payload_length + segment_size - 1U) / segment_size;
+    num_coalesced += segment_size == 0U ? 0U : 1U;
+    set_gso_segment_size(reply.msg, reply.control, segment_size, payload_length);
+    const std::string_view payload(static_cast<char*>(reply.iov.iov_base), payload_length);
+    ready_to_stop = ready_to_stop || payload == "bye\n";
+
+    // At most one send per buffer is in flight, far less than the ring holds.
+    IORequest send = {.unpacked{.type = RequestType::send, .client_id = id}};
+    log::expects(ring.prepare_sendmsg(sock_fd, &reply.msg, 0, (void*)send.packed).is_ok(), "unable to prepare a send.");
+    ++sends_in_flight;
+  }
+
+  void start_receive()
+  {
+    IORequest receive = {.unpacked{.type = RequestType::receive, .client_id = 0U}};
+    receiving = ring.prepare_recvmsg_multishot(sock_fd, &receive_msg, buffers.group(), (void*)receive.packed).is_ok();
+    log::expects(receiving, "unable to prepare the datagram receive.");
+  }
+
+  const int sock_fd;
+  io::Uring& ring;
+  io::BufferRing& buffers;
+
+  /// Only the lengths matter, they tell the kernel how much room to leave for name and control data in every buffer.
+  struct msghdr receive_msg
+  {
+    .msg_name = nullptr, .msg_namelen = sizeof(struct sockaddr_in6), .msg_iov = nullptr, .msg_iovlen = 0,
+    .msg_control = nullptr, .msg_controllen = sizeof(SegmentControl), .msg_flags = 0
   };
+  /// Indexed by buffer id.
+  std::vector<DatagramReply> replies = std::vector<DatagramReply>(datagram_buffers);
+  bool receiving{false};
+  uint32_t sends_in_flight{0U};
+  uint64_t buffer_stalls{0U};
+  uint64_t num_datagrams{0U};
+  uint64_t num_coalesced{0U};
+  bool ready_to_stop{false};
+};
+
+/// Echo datagrams on `sock_fd` with a single multishot receive that takes its buffers from a provided buffer ring, so
+/// no op is prepared per datagram on the way in and all echoes of an iteration go out with one submit.
+void run_datagram_loop(const int sock_fd, io::Uring& ring)
+{
+  // A datagram shares its buffer with the receive header, name and control data.
+  io::BufferRing buffers(ring, datagram_buffer_group, datagram_buffers, max_datagram_size + 4096U);
+  DatagramCb completion_cb{sock_fd, ring, buffers};
+  completion_cb.start_receive();
+  ring.submit_or_defer();
+  while (!completion_cb.ready_to_stop)
+  {
+    const auto handled = ring.for_every_completion(completion_cb);
+    log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+    ring.submit_or_defer();
+  }
+  log::info(
+    "echoed " + std::to_string(completion_cb.num_datagrams) + " datagrams, " +
+    std::to_string(completion_cb.num_coalesced) + " receives were coalesced by GRO, ran out of buffers " +
+    std::to_string(completion_cb.buffer_stalls) + " times.");
+}
+
+/// A client that talks through a shared memory channel. The unix domain socket it connected with only serves to
+/// notice when it goes away.
+struct ShmClient
+{
+  ShmClient(const int fd, io::ShmChannel&& channel) : fd(fd), channel(std::move(channel))
+  {
+  }
+
+  int fd;
+  /// Released once the client is gone.
+  std::optional<io::ShmChannel> channel;
+  char hangup_byte{0};
+  bool doorbell_armed{false};
+  bool closed{false};
+  /// Its channel broke and the socket was shut down, the hangup read releases it.
+  bool broken{false};
+};
+
+struct ShmCb
+{
+  void operator()(void* user_data, io::IoResult io_result)
+  {
+    IORequest request = {.packed = (uint64_t)user_data};
+    switch (request.unpacked.type)
+    {
+      case RequestType::accept:
+      {
+        log::expects(io_result.is_ok(), "accept operation failed.");
+        accepting = false;
+        on_accept(io_result.value());
+        start_accept();
+        break;
+      }
+      case RequestType::doorbell:
+      {
+        // The loop echoes whatever the client wrote, only a client that is gone has to be taken care of.
+        ShmClient& client = clients[request.unpacked.client_id];
+        client.doorbell_armed = false;
+        if (client.closed)
+        {
+          release(request.unpacked.client_id);
+        }
+        break;
+      }
+      case RequestType::hangup:
+      {
+        // Clients never write to the socket, anything that completes the read ends the channel.
+        ShmClient& client = clients[request.unpacked.client_id];
+        client.closed = true;
+        if (client.doorbell_armed)
+        {
+          // Completes the doorbell read, which releases the client.
+          client.channel->wake_self();
+        }
+        else
+        {
+          release(request.unpacked.client_id);
+        }
+        break;
+      }
+      default:
+        log::expects(false, "unexpected request on a shared memory client.");
+    }
+  }
+
+  /// Hand the new client its channel and wait for it to hang up.
+  void on_accept(const int fd)
+  {
+    auto channel = io::ShmChannel::offer(fd);
+    if (!channel)
+    {
+      log::warn("unable to set up a shared memory channel.");
+      close(fd);
+      return;
+    }
+    uint32_t client_id = 0U;
+    if (free_ids.empty())
+    {
+      client_id = clients.size();
+      clients.emplace_back(fd, std::move(*channel));
+    }
+    else
+    {
+      // Both reads of the previous client completed before it was released.
+      client_id = free_ids.back();
+      free_ids.pop_back();
+      ShmClient& reused = clients[client_id];
+      reused.fd = fd;
+      reused.channel.emplace(std::move(*channel));
+      reused.closed = false;
+      reused.broken = false;
+    }
+    ShmClient& client = clients[client_id];
+    ++num_open;
+    IORequest hangup = {.unpacked{.type = RequestType::hangup, .client_id = client_id}};
+    log::expects(
+      ring.prepare_read(fd, &client.hangup_byte, sizeof(client.hangup_byte), 0, (void*)hangup.packed).is_ok(),
+      "unable to prepare the hangup read.");
+  }
+
+  static bool has_work(const io::ShmChannel& channel)
+  {
+    return channel.readable() > 0U && channel.writable() > 0U && !channel.broken();
+  }
+
+  /// Echo as much as fits for every client, returns whether there was anything to echo.
+  bool echo_all()
+  {
+    bool echoed = false;
+    for (ShmClient& client : clients)
+    {
+      if (!client.channel || client.closed || client.broken)
+      {
+        continue;
+      }
+      io::ShmChannel& channel = *client.channel;
+      while (has_work(channel))
+      {
+        // Only this side writes to the outgoing ring, so whatever is read into the scratch buffer fits.
+        const struct iovec scratch_iovec
+        {
+          .iov_base = scratch.data(), .iov_len = std::min(scratch.size(), channel.writable())
+        };
+        const size_t size = channel.read(&scratch_iovec, 1U);
+        const struct iovec echo_iovec{.iov_base = scratch.data(), .iov_len = size};
+        channel.write(&echo_iovec, 1U);
+        echoed = true;
+      }
+      if (channel.broken())
+      {
+        // Ends the hangup read, which releases the client like one that went away.
+        log::warn("a shared memory client corrupted its channel, closing it.");
+        shutdown(client.fd, SHUT_RDWR);
+        client.broken = true;
+      }
+    }
+    return echoed;
+  }
+
+  /// Let every client without work sleep on its doorbell. Returns false when one of them has work after all, the
+  /// loop must not block then.
+  bool park_all()
+  {
+    bool idle = true;
+    bool armed = false;
+    for (uint32_t client_id = 0; client_id < clients.size(); ++client_id)
+    {
+      ShmClient& client = clients[client_id];
+      if (!client.channel || client.closed || client.broken)
+      {
+        continue;
+      }
+      io::ShmChannel& channel = *client.channel;
+      if (client.doorbell_armed)
+      {
+        idle = idle && !has_work(channel);
+      }
+      else if (channel.sleep_unless([&channel]() { return has_work(channel); }))
+      {
+        IORequest doorbell = {.unpacked{.type = RequestType::doorbell, .client_id = client_id}};
+        client.doorbell_armed = channel.arm(ring, (void*)doorbell.packed).is_ok();
+        log::expects(client.doorbell_armed, "unable to prepare the doorbell read.");
+        armed = true;
+      }
+      else
+      {
+        idle = false;
+      }
+    }
+    if (armed)
+    {
+      // The doorbell reads have to be in flight before the loop blocks.
+      ring.submit_or_defer();
+    }
+    return idle;
+  }
+
+  void release(const uint32_t client_id)
+  {
+    ShmClient& client = clients[client_id];
+    close(client.fd);
+    client.channel.reset();
+    free_ids.push_back(client_id);
+    --num_open;
+    start_accept();
+  }
+
+  /// Every open client has a doorbell read and a hangup read in flight, as in `CompletionCb::start_accept`.
+  void start_accept()
+  {
+    if (accepting || num_open >= (ring.completion_queue_size() - 1U) / 2U)
+    {
+      return;
+    }
+    IORequest next_accept{.unpacked{.type = RequestType::accept, .client_id = 0U}};
+    accepting = ring.prepare_accept(listen_fd, nullptr, nullptr, (void*)next_accept.packed).is_ok();
+    log::expects(accepting, "unable to prepare the next accept.");
+  }
+
+  const int listen_fd;
+  io::Uring& ring;
+  /// A deque keeps clients, and the doorbell values their channels read into, in place while new ones are added.
+  std::deque<ShmClient> clients{};
+  /// Ids of released clients, taken by new ones before `clients` grows.
+  std::vector<uint32_t> free_ids{};
+  uint32_t num_open{0U};
+  bool accepting{false};
+  std::vector<char> scratch = std::vector<char>(connection_buffer_size);
+};
+
+/// Echo clients that connect to the unix domain socket `listen_fd` through shared memory channels. Busy clients are
+/// served without any syscall: the loop polls their channels and only waits on the ring, for doorbells, hangups and
+/// new clients, once all of them were idle for `io::ShmChannel::spin_time()`.
+void run_shm_loop(const int listen_fd, io::Uring& ring)
+{
+  ShmCb completion_cb{listen_fd, ring};
+  completion_cb.start_accept();
+  ring.submit_or_defer();
+  const auto spin_ticks = static_cast<uint64_t>(
+    static_cast<double>(io::ShmChannel::spin_time().count()) * lib::tsc::ticks_per_ns());
+  uint64_t last_echo_tsc = lib::tsc::now();
+  while (true)
+  {
+    const uint64_t now = lib::tsc::now();
+    if (completion_cb.echo_all())
+    {
+      last_echo_tsc = now;
+    }
+    const bool busy = now - last_echo_tsc < spin_ticks || !completion_cb.park_all();
+    if (!busy || ring.ready_completions() > 0U)
+    {
+      const auto handled = ring.for_every_completion(completion_cb);
+      log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+      ring.submit_or_defer();
+    }
+  }
 }
 
 }  // namespace uring
@@ -275,17 +1310,38 @@ void run_event_loop(const int listen_fd, io::Uring& ring)
 
 int main(int argc, char* argv[])
 {
+  // A trailing `--tcp=OPTIONS` tunes the TCP listener, see `io::parse_tcp_options`.
+  io::TcpOptions tcp_options{.backlog = max_events};
+  log::expects(io::take_tcp_options(argc, argv, tcp_options), "Usage Error: invalid TCP options.");
   if (argc < 3)
   {
-    log::error("Please give a port number and mode: ./epoll_echo_server [port] [mode]");
+    log::error(
+      "Please give a port number or socket path and mode: ./epoll_echo_server [port|path] [mode] "
+      "[framed|udp|shm|poll] [--tcp=OPTIONS]");
     exit(0);
   }
 
   const auto mode = get_mode(argv[2]);
+  // Echoes to clients that already hung up must fail instead of killing the server.
+  signal(SIGPIPE, SIG_IGN);
+  const bool framed = argc > 3 && std::strcmp(argv[3], "framed") == 0;
+  const bool datagrams = argc > 3 && std::strcmp(argv[3], "udp") == 0;
+  const bool shared_memory = argc > 3 && std::strcmp(argv[3], "shm") == 0;
+  const bool readiness = argc > 3 && std::strcmp(argv[3], "poll") == 0;
+  log::expects(!framed || mode == IoMode::io_uring, "Usage Error: framing is only supported by the io_uring mode");
+  log::expects(!readiness || mode == IoMode::io_uring, "Usage Error: poll is only supported by the io_uring mode");
+  log::expects(
+    !shared_memory || mode == IoMode::io_uring, "Usage Error: shared memory is only supported by the io_uring mode");
 
-  // setup socket
-  const int portno = ::strtol(argv[1], NULL, 10);
-  const int sock_listen_fd = setup_server_socket(portno);
+  // setup socket, anything that is not a port number is the path of a unix domain socket.
+  char* port_end = nullptr;
+  const int portno = ::strtol(argv[1], &port_end, 10);
+  const bool unix_socket = *argv[1] == '\0' || *port_end != '\0';
+  log::expects(!unix_socket || !datagrams, "Usage Error: udp needs a port number");
+  log::expects(unix_socket || !shared_memory, "Usage Error: shm needs a socket path");
+  const int sock_listen_fd = unix_socket ? setup_unix_socket(argv[1])
+                             : datagrams ? setup_datagram_socket(portno)
+                                         : setup_server_socket(portno, tcp_options);
   // iofd passed down to close in the shutdown. this multiplexes as fd for both epoll and otherwise.
   int iofd;
 
@@ -295,6 +1351,10 @@ int main(int argc, char* argv[])
       log::info("shutting down echo server.");
       close(iofd);
       close(sock_listen_fd);
+      if (unix_socket)
+      {
+        io::unlink_unix(argv[1]);
+      }
     });
 
   switch (mode)
@@ -303,14 +1363,41 @@ int main(int argc, char* argv[])
     {
       const int epollfd = epoll::setup_epoll(sock_listen_fd);
       iofd = epollfd;
-      epoll::run_event_loop(sock_listen_fd, epollfd);
+      if (datagrams)
+      {
+        epoll::run_datagram_loop(sock_listen_fd, epollfd);
+      }
+      else
+      {
+        epoll::run_event_loop(sock_listen_fd, epollfd);
+      }
       break;
     }
     case IoMode::io_uring:
     {
-      io::Uring ring(ring_size, {});
+      const io::UringCapabilities& capabilities = io::UringCapabilities::get();
+      log::info("io_uring: " + capabilities.summary());
+      if (datagrams && !(capabilities.multishot_receive() && capabilities.provided_buffer_rings()))
+      {
+        log::warn("the kernel lacks multishot receives into provided buffers, echoing datagrams with epoll.");
+        iofd = epoll::setup_epoll(sock_listen_fd);
+        epoll::run_datagram_loop(sock_listen_fd, iofd);
+        break;
+      }
+      io::Uring ring(ring_size, {}, std::nullopt, completion_queue_size);
       // io::Uring ring(max_events, {io::UringFeature::sq_polling});
-      uring::run_event_loop(sock_listen_fd, ring);
+      if (datagrams)
+      {
+        uring::run_datagram_loop(sock_listen_fd, ring);
+      }
+      else if (shared_memory)
+      {
+        uring::run_shm_loop(sock_listen_fd, ring);
+      }
+      else
+      {
+        uring::run_event_loop(sock_listen_fd, ring, framed, readiness);
+      }
       break;
     }
   }
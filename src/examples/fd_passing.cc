@@ -0,0 +1,197 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "src/io/unix_socket.hh"
+#include "src/io/uring.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/log.hh"
+
+// An acceptor process hands the TCP connections it accepts to a worker process over a unix domain socket.
+//
+// The acceptor blocks in accept and passes every connection with SCM_RIGHTS, then closes its copy. The worker, a
+// forked child, receives the descriptors with recvmsg on its ring, greets each connection and closes it. The channel
+// is a seqpacket socket in the abstract namespace, so every handoff is a message of its own and nothing is left in
+// the file system.
+//
+//   ./fd_passing [port] [connections]
+//
+// With a number of connections the acceptor stops after that many, the worker once it has served them all.
+
+namespace
+{
+
+namespace io = spinscale::nwprog::io;
+namespace lib = spinscale::nwprog::lib;
+namespace log = spinscale::nwprog::log;
+
+enum class OpType : uint8_t
+{
+  receive,
+  write,
+  close
+};
+
+union OpData
+{
+  struct
+  {
+    OpType type : 8;
+    int32_t fd;
+  } unpacked;
+  uint64_t packed;
+};
+
+void* user_data(const OpType type, const int32_t fd)
+{
+  const OpData op{.unpacked{.type = type, .fd = fd}};
+  return reinterpret_cast<void*>(op.packed);
+}
+
+int listen_tcp(const uint16_t port)
+{
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  log::expects(fd >= 0, "Error creating listening socket.");
+  const int reuse = 1;
+  log::expects(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) == 0, "Error setting SO_REUSEADDR");
+  struct sockaddr_in address
+  {
+  };
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = INADDR_ANY;
+  log::expects(bind(fd, (struct sockaddr*)&address, sizeof(address)) == 0, "Error binding to socket.");
+  log::expects(listen(fd, 128) == 0, "Error listening!");
+  return fd;
+}
+
+/// The worker side: every completion is a handoff, a greeting that was written or a connection that was closed.
+struct Worker
+{
+  void operator()(void* data, const io::IoResult result)
+  {
+    const OpData op{.packed = reinterpret_cast<uint64_t>(data)};
+    switch (op.unpacked.type)
+    {
+      case OpType::receive:
+      {
+        if (result.value_or(0) <= 0)
+        {
+          // The acceptor is gone.
+          receiving = false;
+          break;
+        }
+        if (message.truncated())
+        {
+          log::warn("descriptors beyond the handoff limit were dropped.");
+        }
+        for (const int fd : message.received_fds())
+        {
+          ++in_flight;
+          log::expects(
+            ring.prepare_write(fd, greeting.data(), greeting.size(), 0, user_data(OpType::write, fd)).is_ok(),
+            "unable to prepare a greeting.");
+        }
+        start_receive();
+        break;
+      }
+      case OpType::write:
+      {
+        log::expects(
+          ring.prepare_close(op.unpacked.fd, user_data(OpType::close, op.unpacked.fd)).is_ok(),
+          "unable to prepare a close.");
+        break;
+      }
+      case OpType::close:
+      {
+        --in_flight;
+        ++served;
+        break;
+      }
+    }
+  }
+
+  void start_receive()
+  {
+    message.prepare_receive(&tag, sizeof(tag));
+    receiving =
+      ring.prepare_recvmsg(channel, message.header(), MSG_CMSG_CLOEXEC, user_data(OpType::receive, 0)).is_ok();
+    log::expects(receiving, "unable to prepare the handoff receive.");
+  }
+
+  io::Uring& ring;
+  const int channel;
+  const std::string greeting;
+  io::FdMessage message{};
+  char tag{0};
+  bool receiving{false};
+  uint32_t in_flight{0U};
+  uint64_t served{0U};
+};
+
+void run_worker(const std::string& channel_name)
+{
+  const auto channel = io::connect_unix(channel_name, io::UnixSocketType::seqpacket);
+  log::expects(channel.is_ok(), "unable to connect to the acceptor.");
+  io::Uring ring(256U, {});
+  Worker worker{ring, channel.value(), "served by worker " + std::to_string(getpid()) + "\n"};
+  worker.start_receive();
+  ring.submit_or_defer();
+  while (worker.receiving || worker.in_flight > 0U)
+  {
+    const auto handled = ring.for_every_completion(worker);
+    log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+    ring.submit_or_defer();
+  }
+  close(channel.value());
+  log::info("worker served " + std::to_string(worker.served) + " connections.");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  const auto port = static_cast<uint16_t>(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8080U);
+  const uint64_t limit = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 0U;
+
+  const std::string channel_name = "@nwprog-fd-passing-" + std::to_string(getpid());
+  const auto channel_listener = io::listen_unix(channel_name, io::UnixSocketType::seqpacket, 1);
+  log::expects(channel_listener.is_ok(), "unable to listen for the worker.");
+  const int listen_fd = listen_tcp(port);
+
+  const pid_t worker = fork();
+  log::expects(worker >= 0, "unable to fork the worker.");
+  if (worker == 0)
+  {
+    close(listen_fd);
+    close(channel_listener.value());
+    run_worker(channel_name);
+    return 0;
+  }
+
+  const int channel = accept4(channel_listener.value(), nullptr, nullptr, SOCK_CLOEXEC);
+  log::expects(channel >= 0, "the worker did not connect.");
+  close(channel_listener.value());
+  log::info("accepting connections on port " + std::to_string(port) + " for worker " + std::to_string(worker) + ".");
+
+  for (uint64_t accepted = 0; limit == 0U || accepted < limit; ++accepted)
+  {
+    const int connection = accept(listen_fd, nullptr, nullptr);
+    log::expects(connection >= 0, "Error accepting new connection.");
+    const int fds[] = {connection};
+    log::expects(io::send_fds(channel, "c", fds).is_ok(), "unable to hand the connection to the worker.");
+    // The worker holds its own descriptor of the connection now.
+    close(connection);
+  }
+
+  close(channel);
+  close(listen_fd);
+  waitpid(worker, nullptr, 0);
+  return 0;
+}
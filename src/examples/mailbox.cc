@@ -0,0 +1,92 @@
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "src/io/mailbox.hh"
+#include "src/io/uring.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/log.hh"
+
+namespace
+{
+
+namespace io = spinscale::nwprog::io;
+namespace lib = spinscale::nwprog::lib;
+namespace log = spinscale::nwprog::log;
+
+constexpr uint32_t num_producers = 4U;
+constexpr uint64_t posts_per_producer = 1000000U;
+constexpr uint64_t total_posts = num_producers * posts_per_producer;
+
+/// A reply computed on an application thread, handed back to the io thread.
+struct Reply
+{
+  uint32_t producer;
+  uint64_t sequence;
+};
+
+/// The io thread: waits on its ring, where the mailbox wakeup is just another completion.
+struct EventLoop
+{
+  void operator()(void* user_data, const io::IoResult result)
+  {
+    log::expects(user_data == &mailbox && result.is_ok(), "unexpected completion.");
+    ++wakeups;
+    received += mailbox.drain([this](const Reply& reply) { checksum += reply.sequence; });
+    log::expects(mailbox.arm(ring, &mailbox).is_ok(), "unable to rearm the mailbox.");
+  }
+
+  io::Uring& ring;
+  io::Mailbox<Reply>& mailbox;
+  uint64_t received{0U};
+  uint64_t wakeups{0U};
+  uint64_t checksum{0U};
+};
+
+}  // namespace
+
+int main()
+{
+  io::Uring ring(64U, {});
+  io::Mailbox<Reply> mailbox(1024U);
+  std::atomic<uint64_t> full{0U};
+
+  std::vector<std::thread> producers;
+  for (uint32_t producer = 0; producer < num_producers; ++producer)
+  {
+    producers.emplace_back(
+      [&mailbox, &full, producer]()
+      {
+        for (uint64_t i = 0; i < posts_per_producer; ++i)
+        {
+          while (!mailbox.post({producer, i}))
+          {
+            full.fetch_add(1U, std::memory_order_relaxed);
+            std::this_thread::yield();
+          }
+        }
+      });
+  }
+
+  EventLoop loop{ring, mailbox};
+  log::expects(mailbox.arm(ring, &mailbox).is_ok(), "unable to arm the mailbox.");
+  while (loop.received < total_posts)
+  {
+    ring.submit_or_defer();
+    const auto handled = ring.for_every_completion(loop);
+    log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+  }
+  for (auto& producer : producers)
+  {
+    producer.join();
+  }
+
+  const uint64_t expected_checksum = num_producers * (posts_per_producer * (posts_per_producer - 1U) / 2U);
+  std::cout << "received " << loop.received << " replies in " << loop.wakeups << " wakeups ("
+            << static_cast<double>(loop.received) / static_cast<double>(loop.wakeups) << " per wakeup), "
+            << full.load() << " posts found the mailbox full, checksum "
+            << (loop.checksum == expected_checksum ? "ok" : "mismatch") << '\n';
+  return loop.checksum == expected_checksum ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+#include "src/io/buffer_ring.hh"
+
+#include <sys/mman.h>
+
+#include <bit>
+
+#include "src/lib/log.hh"
+
+namespace spinscale::nwprog::io
+{
+
+namespace
+{
+
+/// Fill in slot `index` of the ring. Not through `io_uring_buf_ring_add`: older uapi headers declare the `bufs` array
+/// behind an empty struct that has a size in C++, so there the entries start 8 bytes late and the kernel finds none.
+void add_entry(
+  struct io_uring_buf_ring* entries, const uint32_t index, char* data, const uint32_t size, const uint16_t id)
+{
+  struct io_uring_buf* entry = reinterpret_cast<struct io_uring_buf*>(entries) + index;
+  entry->addr = reinterpret_cast<uint64_t>(data);
+  entry->len = size;
+  entry->bid = id;
+}
+
+}  // namespace
+
+BufferRing::BufferRing(Uring& ring, const uint16_t group, const uint32_t count, const uint32_t buffer_size)
+  : ring_(ring)
+  , group_(group)
+  , count_(count)
+  , buffer_size_(buffer_size)
+{
+  log::expects(std::has_single_bit(count_) && count_ <= (1U << 15U), "buffer ring size has to be a power of two.");
+  void* entries =
+    mmap(nullptr, count_ * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void* data = mmap(
+    nullptr, static_cast<size_t>(count_) * buffer_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  log::expects(entries != MAP_FAILED && data != MAP_FAILED, "unable to map the buffer ring.");
+  entries_ = static_cast<struct io_uring_buf_ring*>(entries);
+  data_ = static_cast<char*>(data);
+
+  io_uring_buf_ring_init(entries_);
+  for (uint32_t id = 0; id < count_; ++id)
+  {
+    add_entry(entries_, id, buffer(id), buffer_size_, id);
+  }
+  io_uring_buf_ring_advance(entries_, static_cast<int>(count_));
+  log::expects(
+    ring_.register_buffer_ring(entries_, count_, group_).is_ok(),
+    "unable to register the buffer ring, provided buffer rings need Linux 5.19.");
+}
+
+BufferRing::~BufferRing()
+{
+  static_cast<void>(ring_.unregister_buffer_ring(group_));
+  munmap(data_, static_cast<size_t>(count_) * buffer_size_);
+  munmap(entries_, count_ * sizeof(struct io_uring_buf));
+}
+
+void BufferRing::recycle(const uint16_t id)
+{
+  add_entry(entries_, entries_->tail & (count_ - 1U), buffer(id), buffer_size_, id);
+  io_uring_buf_ring_advance(entries_, 1);
+}
+
+}  // namespace spinscale::nwprog::io
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <liburing.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "src/io/uring.hh"
+
+namespace spinscale::nwprog::io
+{
+
+/// A group of equally sized buffers the kernel picks from when a read or receive completes, instead of every op
+/// pinning a buffer of its own while it waits.
+///
+/// Buffers are owned by the kernel until a completion hands one out with its id, and go back with `recycle` once the
+/// data is no longer needed. A receive that finds the ring empty fails with ENOBUFS. The memory of buffers and ring
+/// is mapped directly, so it is page aligned and first touched by the thread that receives into it.
+class BufferRing
+{
+public:
+  /// `count` has to be a power of two of at most 32768.
+  BufferRing(Uring& ring, uint16_t group, uint32_t count, uint32_t buffer_size);
+  ~BufferRing();
+
+  BufferRing(const BufferRing&) = delete;
+  BufferRing& operator=(const BufferRing&) = delete;
+
+  [[nodiscard]] uint16_t group() const
+  {
+    return group_;
+  }
+
+  [[nodiscard]] uint32_t buffer_size() const
+  {
+    return buffer_size_;
+  }
+
+  [[nodiscard]] char* buffer(const uint16_t id) const
+  {
+    return data_ + static_cast<size_t>(id) * buffer_size_;
+  }
+
+  /// Give buffer `id` back to the kernel.
+  void recycle(uint16_t id);
+
+  /// Id of the buffer a completion with `completion_flags` picked, if any.
+  [[nodiscard]] static std::optional<uint16_t> buffer_id(const uint32_t completion_flags)
+  {
+    if ((completion_flags & IORING_CQE_F_BUFFER) == 0U)
+    {
+      return std::nullopt;
+    }
+    return static_cast<uint16_t>(completion_flags >> IORING_CQE_BUFFER_SHIFT);
+  }
+
+private:
+  Uring& ring_;
+  const uint16_t group_;
+  const uint32_t count_;
+  const uint32_t buffer_size_;
+  struct io_uring_buf_ring* entries_{nullptr};
+  char* data_{nullptr};
+};
+
+}  // namespace spinscale::nwprog::io
@@ -0,0 +1,98 @@
+#include "src/io/file_reader.hh"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+
+#include "src/lib/log.hh"
+
+namespace spinscale::nwprog::io
+{
+
+FileReader::FileReader(const uint32_t chunk_size, const uint32_t depth)
+  : chunk_size_((std::max(chunk_size, 1U) + alignment - 1U) / alignment * alignment)
+  , slots_(depth)
+{
+  log::expects(depth > 0, "a file reader needs at least one buffer.");
+  // Mapped memory is page aligned, which is all O_DIRECT needs of the buffers.
+  void* data = mmap(
+    nullptr, static_cast<size_t>(chunk_size_) * depth, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  log::expects(data != MAP_FAILED, "unable to map the buffers of the file reader.");
+  data_ = static_cast<char*>(data);
+}
+
+FileReader::~FileReader()
+{
+  munmap(data_, static_cast<size_t>(chunk_size_) * slots_.size());
+}
+
+void FileReader::start(const FD fd, const uint64_t size)
+{
+  fd_ = fd;
+  size_ = size;
+  requested_ = 0U;
+  consumed_ = 0U;
+  std::ranges::fill(slots_, Slot{});
+}
+
+std::optional<uint32_t> FileReader::next_slot() const
+{
+  // The buffer is still taken by the chunk `depth` chunks back until that one is consumed.
+  const uint64_t first_unconsumed = consumed_ / chunk_size_ * chunk_size_;
+  if (requested_ >= size_ || requested_ >= first_unconsumed + static_cast<uint64_t>(chunk_size_) * slots_.size())
+  {
+    return std::nullopt;
+  }
+  return slot_of(requested_);
+}
+
+IoResult FileReader::prepare_next(Uring& ring, void* user_data)
+{
+  const auto slot = next_slot();
+  log::expects(slot.has_value(), "no buffer is free for the next read.");
+  // The last chunk is read in full as well, O_DIRECT wants aligned lengths and the read stops at the end of the file.
+  const auto prepared = ring.prepare_read(fd_, buffer(*slot), chunk_size_, static_cast<off_t>(requested_), user_data);
+  if (prepared.is_ok())
+  {
+    slots_[*slot] = Slot{.offset = requested_};
+    requested_ += chunk_size_;
+  }
+  return prepared;
+}
+
+bool FileReader::complete(const uint32_t slot, const IoResult result)
+{
+  Slot& read = slots_[slot];
+  const auto expected = static_cast<uint32_t>(std::min<uint64_t>(chunk_size_, size_ - read.offset));
+  if (result.is_error() || static_cast<uint32_t>(result.value()) < expected)
+  {
+    return false;
+  }
+  // A file that grew since its size was taken is cut off there.
+  read.length = expected;
+  read.ready = true;
+  return true;
+}
+
+std::string_view FileReader::front() const
+{
+  const Slot& current = slots_[slot_of(consumed_)];
+  if (consumed_ == size_ || !current.ready)
+  {
+    return {};
+  }
+  const auto skipped = static_cast<uint32_t>(consumed_ - current.offset);
+  return {buffer(slot_of(consumed_)) + skipped, current.length - skipped};
+}
+
+void FileReader::consume(const size_t bytes)
+{
+  Slot& current = slots_[slot_of(consumed_)];
+  consumed_ += bytes;
+  if (consumed_ == current.offset + current.length)
+  {
+    current.ready = false;
+  }
+}
+
+}  // namespace spinscale::nwprog::io
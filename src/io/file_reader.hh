@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "src/io/uring.hh"
+
+namespace spinscale::nwprog::io
+{
+
+/// Reads a file front to back through a few buffers of its own, with reads of the next chunks in flight while the
+/// consumer still works on the current one.
+///
+/// Chunk `k` of the file goes to buffer `k % depth`, so a buffer is free for the next read once the consumer moved past
+/// the chunk it held, and at most `depth` chunks are read ahead. Buffers, lengths and offsets of the reads are
+/// multiples of `alignment`, which is what O_DIRECT asks for, so descriptors opened with it bypass the page cache; any
+/// other descriptor works the same. Only the last chunk may be shorter than the others, a file that shrinks while it
+/// is read fails the read.
+///
+/// ```
+/// reader.start(fd, size);
+/// while (reader.next_slot()) { reader.prepare_next(ring, tag(*reader.next_slot())); }
+/// // on completion of slot s: reader.complete(s, result), then send reader.front() and consume what was sent.
+/// ```
+class FileReader
+{
+public:
+  /// Of buffers, offsets and lengths. Covers the logical block size of the usual devices.
+  static constexpr uint32_t alignment = 4096U;
+
+  /// `chunk_size` is rounded up to `alignment`.
+  FileReader(uint32_t chunk_size, uint32_t depth);
+  ~FileReader();
+
+  FileReader(const FileReader&) = delete;
+  FileReader& operator=(const FileReader&) = delete;
+
+  /// Read the first `size` bytes of `fd`. Reads of a previous file must have completed.
+  void start(FD fd, uint64_t size);
+
+  /// Buffer of the next read, nothing when all of them are taken or the whole file was asked for already.
+  [[nodiscard]] std::optional<uint32_t> next_slot() const;
+  /// Read the next chunk into the buffer `next_slot()` returned. The reader must not move until it completes.
+  IoResult prepare_next(Uring& ring, void* user_data);
+  /// The read into `slot` completed with `result`. False when it failed or came back short, the file can not be
+  /// read to its end then.
+  bool complete(uint32_t slot, IoResult result);
+
+  /// The unconsumed part of the current chunk, empty until it was read.
+  [[nodiscard]] std::string_view front() const;
+  /// Drop `bytes` from the front, a chunk that was consumed completely frees its buffer for the next read.
+  void consume(size_t bytes);
+
+  [[nodiscard]] bool done() const
+  {
+    return consumed_ == size_;
+  }
+
+  [[nodiscard]] uint32_t depth() const
+  {
+    return static_cast<uint32_t>(slots_.size());
+  }
+
+private:
+  struct Slot
+  {
+    /// Of the chunk the buffer holds.
+    uint64_t offset{0U};
+    /// Bytes of the file the last read brought in.
+    uint32_t length{0U};
+    bool ready{false};
+  };
+
+  [[nodiscard]] uint32_t slot_of(const uint64_t offset) const
+  {
+    return static_cast<uint32_t>((offset / chunk_size_) % slots_.size());
+  }
+
+  [[nodiscard]] char* buffer(const uint32_t slot) const
+  {
+    return data_ + static_cast<size_t>(slot) * chunk_size_;
+  }
+
+  const uint32_t chunk_size_;
+  std::vector<Slot> slots_;
+  char* data_{nullptr};
+  FD fd_{-1};
+  uint64_t size_{0U};
+  /// Offset of the next read.
+  uint64_t requested_{0U};
+  uint64_t consumed_{0U};
+};
+
+}  // namespace spinscale::nwprog::io
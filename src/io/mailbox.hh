@@ -0,0 +1,105 @@
+#pragma once
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "src/io/uring.hh"
+#include "src/lib/log.hh"
+#include "src/lib/mpsc_queue.hh"
+
+namespace spinscale::nwprog::io
+{
+
+/// Lets any thread hand items to the thread that owns a ring.
+///
+/// Items go through a bounded MPSC queue. The owner keeps a read of the mailbox's eventfd armed on its ring, so a
+/// wakeup is just another completion. Producers only write to the eventfd on the empty to non-empty transition, i.e.
+/// for the first post after the owner started draining; posts that follow while a wakeup is pending cost one atomic
+/// exchange and are picked up by the same drain.
+///
+/// ```
+/// mailbox.arm(ring, mailbox_tag);
+/// // in the completion callback:
+/// case mailbox_tag: mailbox.drain(handle_reply); mailbox.arm(ring, mailbox_tag); break;
+/// ```
+template <class T>
+class Mailbox
+{
+public:
+  explicit Mailbox(const size_t capacity) : queue_(capacity), event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+    log::expects(event_fd_ >= 0, "unable to create the mailbox eventfd.");
+  }
+
+  Mailbox(const Mailbox&) = delete;
+  Mailbox& operator=(const Mailbox&) = delete;
+
+  ~Mailbox()
+  {
+    close(event_fd_);
+  }
+
+  /// Any thread. Returns false when the mailbox is full and leaves `item` alone, so it can be posted again.
+  bool post(T&& item)
+  {
+    if (!queue_.try_push(std::move(item)))
+    {
+      return false;
+    }
+    // Orders the push before reading the flag, pairs with the fence in `drain`.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!wakeup_pending_.exchange(true, std::memory_order_relaxed))
+    {
+      wake();
+    }
+    return true;
+  }
+
+  /// Owner only. Prepare a read of the eventfd which completes with `user_data` when items were posted. Must be
+  /// prepared again after every such completion.
+  IoResult arm(Uring& ring, void* user_data)
+  {
+    return ring.prepare_read(event_fd_, reinterpret_cast<char*>(&wakeups_), sizeof(wakeups_), 0, user_data);
+  }
+
+  /// Owner only. Hand up to `max_batch` posted items to `fn`. When more are left the owner wakes itself, so other
+  /// completions are handled in between batches.
+  template <class F>
+  size_t drain(F&& fn, const size_t max_batch = 64U)
+  {
+    wakeup_pending_.store(false, std::memory_order_relaxed);
+    // Producers that post from now on see the cleared flag and wake us again.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const size_t count = queue_.drain(std::forward<F>(fn), max_batch);
+    if (count == max_batch && !queue_.empty() && !wakeup_pending_.exchange(true, std::memory_order_relaxed))
+    {
+      wake();
+    }
+    return count;
+  }
+
+  [[nodiscard]] FD event_fd() const
+  {
+    return event_fd_;
+  }
+
+private:
+  void wake()
+  {
+    // Only fails with EAGAIN when the counter would overflow, in which case the owner is woken anyway.
+    eventfd_write(event_fd_, 1U);
+  }
+
+  lib::MpscQueue<T> queue_;
+  const FD event_fd_;
+  /// Set from the first post after a drain started until the next drain.
+  alignas(lib::cache_line_size) std::atomic<bool> wakeup_pending_{false};
+  /// Target of the armed eventfd read, only touched by the kernel.
+  alignas(lib::cache_line_size) eventfd_t wakeups_{0U};
+};
+
+}  // namespace spinscale::nwprog::io
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include "src/io/uring.hh"
+#include "src/lib/tsc.hh"
+
+namespace spinscale::nwprog::io
+{
+
+/// Estimates how long completions of an event loop waited in the completion queue before they were handled, the
+/// queue delay signal for admission control.
+///
+/// When completions are ready before the loop waits, they were posted while the previous batch was handled and may
+/// have waited since that batch started. Otherwise the wait blocks and the batch starts with a fresh completion. Under
+/// overload the loop never blocks and the delay grows with the time it takes to handle a batch.
+class QueueDelay
+{
+public:
+  /// Call right before waiting for the next batch of completions.
+  void before_wait(const Uring& ring)
+  {
+    queued_since_ = ring.ready_completions() > 0 ? batch_start_ : 0U;
+    batch_start_ = 0U;
+  }
+
+  /// Delay in ns of a completion handled at `now`, a tsc reading.
+  uint64_t of(const uint64_t now)
+  {
+    if (batch_start_ == 0U)
+    {
+      batch_start_ = now;
+    }
+    const uint64_t since = queued_since_ != 0U ? queued_since_ : batch_start_;
+    return static_cast<uint64_t>(lib::tsc::to_ns(now - since));
+  }
+
+private:
+  /// Tsc readings, zero when unknown.
+  uint64_t batch_start_{0U};
+  uint64_t queued_since_{0U};
+};
+
+}  // namespace spinscale::nwprog::io
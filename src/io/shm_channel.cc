@@ -0,0 +1,206 @@
+#include "src/io/shm_channel.hh"
+
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "src/io/unix_socket.hh"
+
+namespace spinscale::nwprog::io
+{
+
+namespace
+{
+
+size_t page_size()
+{
+  return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+void close_all(const std::vector<int>& fds)
+{
+  for (const int fd : fds)
+  {
+    close(fd);
+  }
+}
+
+}  // namespace
+
+size_t ShmChannel::mapping_size(const size_t capacity)
+{
+  const size_t control_size = (sizeof(Control) + page_size() - 1U) / page_size() * page_size();
+  return control_size + 2U * capacity;
+}
+
+char* ShmChannel::ring_data(void* mapping, const size_t capacity, const uint32_t writer)
+{
+  // The rings follow the control block back to back, the one the server writes to first.
+  return static_cast<char*>(mapping) + mapping_size(capacity) - (2U - writer) * capacity;
+}
+
+std::chrono::nanoseconds ShmChannel::spin_time()
+{
+  static const std::chrono::nanoseconds spin = []()
+  {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    const bool single_cpu = sched_getaffinity(0, sizeof(cpus), &cpus) == 0 && CPU_COUNT(&cpus) <= 1;
+    return single_cpu ? std::chrono::nanoseconds{0} : std::chrono::microseconds{20};
+  }();
+  return spin;
+}
+
+std::optional<ShmChannel> ShmChannel::offer(const FD socket, const size_t capacity)
+{
+  const size_t ring_capacity = std::bit_ceil(std::max(capacity, page_size()));
+  const size_t size = mapping_size(ring_capacity);
+  const int memfd = memfd_create("shm_channel", MFD_CLOEXEC);
+  const int server_doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  const int client_doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  const std::vector<int> fds{memfd, server_doorbell, client_doorbell};
+  if (std::ranges::any_of(fds, [](const int fd) { return fd < 0; }) || ftruncate(memfd, static_cast<off_t>(size)) != 0)
+  {
+    close_all(fds);
+    return std::nullopt;
+  }
+  void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, memfd, 0);
+  if (mapping == MAP_FAILED)
+  {
+    close_all(fds);
+    return std::nullopt;
+  }
+  (new (mapping) Control{})->capacity = ring_capacity;
+  std::optional<ShmChannel> channel(
+    ShmChannel(Side::server, memfd, server_doorbell, client_doorbell, mapping, ring_capacity));
+  // The peer gets descriptors of its own, so the server can not be sure the channel was taken until the peer uses it.
+  if (send_fds(socket, "s", fds).is_error())
+  {
+    return std::nullopt;
+  }
+  return channel;
+}
+
+std::optional<ShmChannel> ShmChannel::accept(const FD socket)
+{
+  char tag = '\0';
+  std::vector<int> fds;
+  const auto received = receive_fds(socket, &tag, sizeof(tag), fds);
+  struct stat memfd_stat
+  {
+  };
+  if (received.value_or(0) <= 0 || fds.size() != 3U || fstat(fds[0], &memfd_stat) != 0 ||
+      static_cast<size_t>(memfd_stat.st_size) < sizeof(Control))
+  {
+    close_all(fds);
+    return std::nullopt;
+  }
+  const auto size = static_cast<size_t>(memfd_stat.st_size);
+  void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fds[0], 0);
+  if (mapping == MAP_FAILED)
+  {
+    close_all(fds);
+    return std::nullopt;
+  }
+  const size_t capacity = static_cast<const Control*>(mapping)->capacity;
+  if (!std::has_single_bit(capacity) || mapping_size(capacity) != size)
+  {
+    munmap(mapping, size);
+    close_all(fds);
+    return std::nullopt;
+  }
+  return ShmChannel(Side::client, fds[0], fds[2], fds[1], mapping, capacity);
+}
+
+ShmChannel::ShmChannel(
+  const Side side, const int memfd, const int own_doorbell, const int peer_doorbell, void* mapping,
+  const size_t capacity)
+  : side_(side)
+  , memfd_(memfd)
+  , own_doorbell_(own_doorbell)
+  , peer_doorbell_(peer_doorbell)
+  , mapping_(mapping)
+  , capacity_(capacity)
+  , control_(static_cast<Control*>(mapping))
+  , outgoing_(control_->rings[side], ring_data(mapping, capacity, side), capacity)
+  , incoming_(control_->rings[1U - side], ring_data(mapping, capacity, 1U - side), capacity)
+{
+}
+
+ShmChannel::ShmChannel(ShmChannel&& other) noexcept
+  : side_(other.side_)
+  , memfd_(std::exchange(other.memfd_, -1))
+  , own_doorbell_(std::exchange(other.own_doorbell_, -1))
+  , peer_doorbell_(std::exchange(other.peer_doorbell_, -1))
+  , mapping_(std::exchange(other.mapping_, nullptr))
+  , capacity_(other.capacity_)
+  , control_(other.control_)
+  , outgoing_(other.outgoing_)
+  , incoming_(other.incoming_)
+{
+}
+
+ShmChannel::~ShmChannel()
+{
+  if (mapping_ == nullptr)
+  {
+    return;
+  }
+  munmap(mapping_, mapping_size(capacity_));
+  close(memfd_);
+  close(own_doorbell_);
+  close(peer_doorbell_);
+}
+
+size_t ShmChannel::write(const struct iovec* iovecs, const uint32_t count)
+{
+  const size_t written = outgoing_.write(iovecs, count);
+  if (written > 0U)
+  {
+    wake_peer();
+  }
+  return written;
+}
+
+size_t ShmChannel::read(const struct iovec* iovecs, const uint32_t count)
+{
+  const size_t read = incoming_.read(iovecs, count);
+  if (read > 0U)
+  {
+    // The peer may be waiting for space.
+    wake_peer();
+  }
+  return read;
+}
+
+IoResult ShmChannel::arm(Uring& ring, void* user_data)
+{
+  return ring.prepare_read(own_doorbell_, reinterpret_cast<char*>(&rings_), sizeof(rings_), 0, user_data);
+}
+
+void ShmChannel::wake_self() const
+{
+  eventfd_write(own_doorbell_, 1U);
+}
+
+void ShmChannel::wake_peer()
+{
+  const Side peer = side_ == Side::server ? Side::client : Side::server;
+  // Orders the index update before reading the flag, pairs with the fence in `sleep_unless`.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (control_->sleeping[peer].value.load(std::memory_order_relaxed) != 0U &&
+      control_->sleeping[peer].value.exchange(0U, std::memory_order_relaxed) != 0U)
+  {
+    eventfd_write(peer_doorbell_, 1U);
+  }
+}
+
+}  // namespace spinscale::nwprog::io
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "src/io/uring.hh"
+#include "src/lib/cache_line.hh"
+#include "src/lib/spsc_byte_ring.hh"
+
+namespace spinscale::nwprog::io
+{
+
+/// A connection between two processes on the same host that moves bytes through shared memory instead of a socket.
+///
+/// A memfd holds a byte ring per direction. Writes and reads are plain copies into and out of the rings, no syscall is
+/// involved as long as both sides are busy. A side that runs out of work announces that it sleeps and waits on its
+/// doorbell, an eventfd, and the other side rings it after its next write or read, so the eventfd is only touched
+/// when a side actually waits. The doorbell read is an op on the ring, like the read of a socket.
+///
+/// The channel is set up over a unix domain socket that stays open for its lifetime: the server side creates it and
+/// passes the memfd and both eventfds with SCM_RIGHTS. Closing the socket is how either side learns that the other
+/// one is gone.
+///
+/// ```
+/// channel.write(iovecs, count);
+/// if (channel.sleep_unless([&] { return channel.readable() > 0; }))
+/// {
+///   channel.arm(ring, doorbell_tag);
+/// }
+/// ```
+class ShmChannel
+{
+public:
+  /// Capacity of each direction.
+  static constexpr size_t default_capacity = 256U * 1024U;
+  /// How long a side that ran out of work should keep polling before it sleeps. A peer that answers within it is
+  /// picked up without either side touching a doorbell, which is what makes round trips take less than a
+  /// microsecond; a wakeup through the eventfd and the ring costs several. Zero when the process may only run on a
+  /// single CPU, polling would only keep the peer from running there.
+  static std::chrono::nanoseconds spin_time();
+
+  /// Server side. Create a channel with rings of `capacity` bytes, rounded up to a power of two, and hand it to the
+  /// peer connected to `socket`. Nothing when either fails.
+  static std::optional<ShmChannel> offer(FD socket, size_t capacity = default_capacity);
+  /// Client side. Map the channel offered by the server at the other end of `socket`, blocks until it arrives.
+  static std::optional<ShmChannel> accept(FD socket);
+
+  ShmChannel(ShmChannel&& other) noexcept;
+  ShmChannel& operator=(ShmChannel&&) = delete;
+  ShmChannel(const ShmChannel&) = delete;
+  ShmChannel& operator=(const ShmChannel&) = delete;
+  ~ShmChannel();
+
+  /// Copy as much of `iovecs` as fits into the outgoing ring, returns the number of bytes copied.
+  size_t write(const struct iovec* iovecs, uint32_t count);
+  /// Copy as many incoming bytes as fit into `iovecs`, returns the number of bytes copied.
+  size_t read(const struct iovec* iovecs, uint32_t count);
+
+  [[nodiscard]] size_t readable() const
+  {
+    return incoming_.size();
+  }
+
+  [[nodiscard]] size_t writable() const
+  {
+    return outgoing_.free_space();
+  }
+
+  /// Whether the peer corrupted the index of either ring. Nothing moves through the channel any more, it should be
+  /// closed.
+  [[nodiscard]] bool broken() const
+  {
+    return incoming_.broken() || outgoing_.broken();
+  }
+
+  /// Announce that this side sleeps unless `has_work()`, which has to look at `readable()` and `writable()` only.
+  /// Returns true when the caller has to wait for the doorbell, false when there is work after all.
+  ///
+  /// The check runs after the announcement, so progress of the peer either shows up in it or sees the announcement
+  /// and rings the doorbell. Doorbells may ring without anything to do, the caller checks again then.
+  template <class Fn>
+  bool sleep_unless(Fn&& has_work)
+  {
+    control_->sleeping[side_].value.store(1U, std::memory_order_relaxed);
+    // Orders the announcement before the checks, pairs with the fence in `wake_peer`.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (has_work())
+    {
+      control_->sleeping[side_].value.store(0U, std::memory_order_relaxed);
+      return false;
+    }
+    return true;
+  }
+
+  /// Prepare a read of this side's doorbell which completes with `user_data` when it rang. Must be prepared again
+  /// after every such completion. The channel must not move while the read is in flight.
+  IoResult arm(Uring& ring, void* user_data);
+
+  /// Ring this side's own doorbell, which completes an armed read so the channel can be released.
+  void wake_self() const;
+
+private:
+  enum Side : uint8_t
+  {
+    server = 0,
+    client = 1,
+  };
+
+  struct alignas(lib::cache_line_size) Flag
+  {
+    std::atomic<uint32_t> value{0U};
+  };
+
+  /// Start of the shared mapping, the rings' data follows on the next page.
+  struct Control
+  {
+    uint64_t capacity;
+    /// Indexed by the side that writes to it.
+    lib::SpscByteRing::Indices rings[2];
+    /// Indexed by side.
+    Flag sleeping[2];
+  };
+
+  ShmChannel(Side side, int memfd, int own_doorbell, int peer_doorbell, void* mapping, size_t capacity);
+
+  static size_t mapping_size(size_t capacity);
+  /// Data of the ring that `writer` writes to.
+  static char* ring_data(void* mapping, size_t capacity, uint32_t writer);
+
+  void wake_peer();
+
+  Side side_;
+  int memfd_;
+  int own_doorbell_;
+  int peer_doorbell_;
+  void* mapping_;
+  size_t capacity_;
+  Control* control_;
+  lib::SpscByteRing outgoing_;
+  lib::SpscByteRing incoming_;
+  /// Target of the doorbell read.
+  uint64_t rings_{0U};
+};
+
+}  // namespace spinscale::nwprog::io
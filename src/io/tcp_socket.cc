@@ -0,0 +1,215 @@
+#include "src/io/tcp_socket.hh"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+
+namespace spinscale::nwprog::io
+{
+
+namespace
+{
+
+bool set_option(const FD fd, const int level, const int name, const int value)
+{
+  return setsockopt(fd, level, name, &value, sizeof(value)) == 0;
+}
+
+bool set_option(const FD fd, const int level, const int name, const std::optional<int> value)
+{
+  return !value.has_value() || set_option(fd, level, name, *value);
+}
+
+/// The options that accepted sockets inherit.
+bool set_connection_options(const FD fd, const TcpOptions& options)
+{
+  return (!options.no_delay || set_option(fd, IPPROTO_TCP, TCP_NODELAY, 1)) &&
+         set_option(fd, SOL_SOCKET, SO_RCVBUF, options.receive_buffer) &&
+         set_option(fd, SOL_SOCKET, SO_SNDBUF, options.send_buffer) &&
+         set_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.not_sent_low_water);
+}
+
+bool set_listener_options(const FD fd, const TcpOptions& options)
+{
+  const std::optional<int> defer_accept =
+    options.defer_accept.has_value() ? std::optional<int>(static_cast<int>(options.defer_accept->count()))
+                                     : std::nullopt;
+  return set_option(fd, SOL_SOCKET, SO_REUSEADDR, 1) &&
+         (!options.reuse_port || set_option(fd, SOL_SOCKET, SO_REUSEPORT, 1)) &&
+         set_option(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, defer_accept) &&
+         set_option(fd, IPPROTO_TCP, TCP_FASTOPEN, options.fast_open_queue) &&
+         set_option(fd, SOL_SOCKET, SO_INCOMING_CPU, options.incoming_cpu) && set_connection_options(fd, options);
+}
+
+/// Binds an IPv6 socket to all addresses of both families, or an IPv4 one to all IPv4 addresses.
+bool bind_any(const FD fd, const int family, const uint16_t port)
+{
+  if (family == AF_INET6)
+  {
+    struct sockaddr_in6 address
+    {
+    };
+    address.sin6_family = AF_INET6;
+    address.sin6_port = htons(port);
+    address.sin6_addr = in6addr_any;
+    return set_option(fd, IPPROTO_IPV6, IPV6_V6ONLY, 0) &&
+           bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+  }
+  struct sockaddr_in address
+  {
+  };
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  return bind(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+}
+
+/// The socket on success, closes it on failure.
+IoResult close_on_error(const FD fd, const bool ok)
+{
+  if (ok)
+  {
+    return lib::Ok(fd);
+  }
+  const lib::Errno error = lib::Errno::last();
+  close(fd);
+  return lib::Err(error);
+}
+
+std::optional<int> parse_int(const std::string_view value)
+{
+  int result = 0;
+  const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+  if (ec != std::errc{} || end != value.data() + value.size() || result < 0)
+  {
+    return std::nullopt;
+  }
+  return result;
+}
+
+bool parse_tcp_option(const std::string_view key, const std::string_view value, TcpOptions& options)
+{
+  // Flags take no value.
+  if (key == "ipv4")
+  {
+    options.dual_stack = false;
+    return value.empty();
+  }
+  if (key == "reuseport")
+  {
+    options.reuse_port = true;
+    return value.empty();
+  }
+  if (key == "nodelay")
+  {
+    options.no_delay = true;
+    return value.empty();
+  }
+  const auto number = parse_int(value);
+  if (!number.has_value())
+  {
+    return false;
+  }
+  if (key == "backlog")
+  {
+    options.backlog = *number;
+  }
+  else if (key == "defer_accept")
+  {
+    options.defer_accept = std::chrono::seconds(*number);
+  }
+  else if (key == "fastopen")
+  {
+    options.fast_open_queue = number;
+  }
+  else if (key == "rcvbuf")
+  {
+    options.receive_buffer = number;
+  }
+  else if (key == "sndbuf")
+  {
+    options.send_buffer = number;
+  }
+  else if (key == "notsent_lowat")
+  {
+    options.not_sent_low_water = number;
+  }
+  else if (key == "incoming_cpu")
+  {
+    options.incoming_cpu = number;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+bool parse_tcp_options(std::string_view list, TcpOptions& options)
+{
+  while (!list.empty())
+  {
+    const size_t comma = list.find(',');
+    const std::string_view option = list.substr(0, comma);
+    list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    // Empty options, as between two commas or after a trailing one, are rejected.
+    if (option.empty() || (comma != std::string_view::npos && list.empty()))
+    {
+      return false;
+    }
+    const size_t equals = option.find('=');
+    const std::string_view key = option.substr(0, equals);
+    const std::string_view value = equals == std::string_view::npos ? std::string_view{} : option.substr(equals + 1);
+    // An '=' without a value is invalid for flags and numbers alike.
+    if ((equals != std::string_view::npos && value.empty()) || !parse_tcp_option(key, value, options))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool take_tcp_options(int& argc, char* argv[], TcpOptions& options)
+{
+  constexpr std::string_view prefix = "--tcp=";
+  if (argc < 2 || !std::string_view(argv[argc - 1]).starts_with(prefix))
+  {
+    return true;
+  }
+  --argc;
+  return parse_tcp_options(std::string_view(argv[argc]).substr(prefix.size()), options);
+}
+
+IoResult listen_tcp(const uint16_t port, const TcpOptions& options)
+{
+  int family = options.dual_stack ? AF_INET6 : AF_INET;
+  FD fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0 && family == AF_INET6 && errno == EAFNOSUPPORT)
+  {
+    family = AF_INET;
+    fd = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  }
+  if (fd < 0)
+  {
+    return lib::Err(lib::Errno::last());
+  }
+  return close_on_error(
+    fd, set_listener_options(fd, options) && bind_any(fd, family, port) && listen(fd, options.backlog) == 0);
+}
+
+IoResult configure_tcp(const FD fd, const TcpOptions& options)
+{
+  if (!set_connection_options(fd, options))
+  {
+    return lib::Err(lib::Errno::last());
+  }
+  return lib::Ok(0);
+}
+
+}  // namespace spinscale::nwprog::io
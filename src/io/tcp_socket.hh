@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "src/io/uring.hh"
+
+namespace spinscale::nwprog::io
+{
+
+/// Options of a TCP listener. Those of the connection are copied by the kernel to every socket the listener accepts,
+/// so accepted sockets need no setsockopt(2) of their own. Unset ones keep the kernel's defaults.
+struct TcpOptions
+{
+  /// Listen on IPv6 and IPv4 at once, IPv4 peers show up with IPv4 mapped addresses. Without it, or on hosts without
+  /// IPv6, the listener only takes IPv4.
+  bool dual_stack{true};
+  /// Share the port with other listeners, the kernel spreads connections over them.
+  bool reuse_port{false};
+  int backlog{1024};
+  /// Send small writes right away instead of coalescing them while an earlier segment is not acknowledged.
+  bool no_delay{false};
+  /// Accept a connection only once its first data arrived or this long passed, a server that reads right after the
+  /// accept never finds the socket empty then.
+  std::optional<std::chrono::seconds> defer_accept{};
+  /// Accept data in the SYN of clients that connected before, up to this many such connections may wait for their
+  /// accept.
+  std::optional<int> fast_open_queue{};
+  /// Bytes of the kernel's socket buffers, which it doubles for its own bookkeeping. Setting them turns off their
+  /// automatic tuning.
+  std::optional<int> receive_buffer{};
+  std::optional<int> send_buffer{};
+  /// The socket is only writable while less than this many bytes wait to be sent, which keeps data in user space
+  /// where it can still be replaced or reordered instead of in the send buffer.
+  std::optional<int> not_sent_low_water{};
+  /// In a `reuse_port` group, connections whose packets arrive on this CPU go to this listener.
+  std::optional<int> incoming_cpu{};
+};
+
+/// Parse a comma separated list of options into `options`, keeping the others as they are, e.g.
+/// "nodelay,rcvbuf=262144,defer_accept=1". Keys are `ipv4`, `reuseport`, `backlog`, `nodelay`, `defer_accept`,
+/// `fastopen`, `rcvbuf`, `sndbuf`, `notsent_lowat` and `incoming_cpu`. False on an unknown key, an invalid value, a
+/// value for a flag or an empty option, e.g. of a doubled or trailing comma.
+bool parse_tcp_options(std::string_view list, TcpOptions& options);
+
+/// Parse a trailing `--tcp=OPTIONS` argument of a command line into `options` and drop it from `argc`, so the
+/// remaining arguments are positional. Without such an argument, nothing changes. False when its options are invalid.
+bool take_tcp_options(int& argc, char* argv[], TcpOptions& options);
+
+/// Listening TCP socket on `port` of all local addresses. It reuses the address, so a restarted server gets its port
+/// back while connections of the previous one linger.
+IoResult listen_tcp(uint16_t port, const TcpOptions& options);
+
+/// Apply the connection options of `options` to a connected socket that did not come from a listener with them, e.g.
+/// one of a client. Fails with the first option the kernel rejected.
+IoResult configure_tcp(FD fd, const TcpOptions& options);
+
+}  // namespace spinscale::nwprog::io
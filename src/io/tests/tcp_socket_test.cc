@@ -0,0 +1,134 @@
+#include "src/io/tcp_socket.hh"
+
+#include <catch2/catch_all.hpp>
+#include <chrono>
+
+namespace spinscale::nwprog::io::test
+{
+
+SCENARIO("parsing TCP options")
+{
+  GIVEN("options with their defaults")
+  {
+    TcpOptions options;
+
+    WHEN("a list of flags and numbers is parsed.")
+    {
+      const bool parsed = parse_tcp_options("ipv4,reuseport,nodelay,backlog=64,defer_accept=1,rcvbuf=262144", options);
+      THEN("all of them are set and the others are kept.")
+      {
+        REQUIRE(parsed);
+        REQUIRE_FALSE(options.dual_stack);
+        REQUIRE(options.reuse_port);
+        REQUIRE(options.no_delay);
+        REQUIRE(options.backlog == 64);
+        REQUIRE(options.defer_accept == std::chrono::seconds(1));
+        REQUIRE(options.receive_buffer == 262144);
+        REQUIRE_FALSE(options.send_buffer.has_value());
+        REQUIRE_FALSE(options.fast_open_queue.has_value());
+      }
+    }
+
+    WHEN("an empty list is parsed.")
+    {
+      THEN("it is valid and changes nothing.")
+      {
+        REQUIRE(parse_tcp_options("", options));
+        REQUIRE(options.dual_stack);
+        REQUIRE(options.backlog == 1024);
+      }
+    }
+
+    WHEN("a flag is given a value.")
+    {
+      THEN("the list is invalid.")
+      {
+        REQUIRE_FALSE(parse_tcp_options("nodelay=1", options));
+        REQUIRE_FALSE(parse_tcp_options("ipv4=", options));
+      }
+    }
+
+    WHEN("a number is negative, missing or followed by anything else.")
+    {
+      THEN("the list is invalid.")
+      {
+        REQUIRE_FALSE(parse_tcp_options("rcvbuf=-1", options));
+        REQUIRE_FALSE(parse_tcp_options("backlog", options));
+        REQUIRE_FALSE(parse_tcp_options("backlog=", options));
+        REQUIRE_FALSE(parse_tcp_options("sndbuf=4k", options));
+      }
+    }
+
+    WHEN("a key is unknown.")
+    {
+      THEN("the list is invalid.")
+      {
+        REQUIRE_FALSE(parse_tcp_options("nodelay,cork", options));
+        REQUIRE_FALSE(parse_tcp_options("cork=1", options));
+        REQUIRE_FALSE(parse_tcp_options("=1", options));
+      }
+    }
+
+    WHEN("the list has empty segments.")
+    {
+      THEN("the list is invalid.")
+      {
+        REQUIRE_FALSE(parse_tcp_options("nodelay,,backlog=64", options));
+        REQUIRE_FALSE(parse_tcp_options(",nodelay", options));
+        REQUIRE_FALSE(parse_tcp_options("nodelay,", options));
+        REQUIRE_FALSE(parse_tcp_options(",", options));
+      }
+    }
+  }
+}
+
+SCENARIO("taking TCP options from a command line")
+{
+  GIVEN("options with their defaults")
+  {
+    TcpOptions options;
+    char program[] = "server";
+    char port[] = "8080";
+
+    WHEN("the last argument holds TCP options.")
+    {
+      char tcp[] = "--tcp=nodelay,backlog=64";
+      char* argv[] = {program, port, tcp, nullptr};
+      int argc = 3;
+      const bool taken = take_tcp_options(argc, argv, options);
+      THEN("they are parsed and dropped from the arguments.")
+      {
+        REQUIRE(taken);
+        REQUIRE(argc == 2);
+        REQUIRE(options.no_delay);
+        REQUIRE(options.backlog == 64);
+      }
+    }
+
+    WHEN("there is no such argument.")
+    {
+      char* argv[] = {program, port, nullptr};
+      int argc = 2;
+      const bool taken = take_tcp_options(argc, argv, options);
+      THEN("the arguments and options stay as they are.")
+      {
+        REQUIRE(taken);
+        REQUIRE(argc == 2);
+        REQUIRE_FALSE(options.no_delay);
+      }
+    }
+
+    WHEN("its options are invalid.")
+    {
+      char tcp[] = "--tcp=cork";
+      char* argv[] = {program, tcp, nullptr};
+      int argc = 2;
+      THEN("taking them fails.")
+      {
+        REQUIRE_FALSE(take_tcp_options(argc, argv, options));
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::io::test
@@ -0,0 +1,119 @@
+#include "src/io/uring_trace.hh"
+
+#include <catch2/catch_all.hpp>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+namespace spinscale::nwprog::io::test
+{
+
+namespace
+{
+
+/// Number of events named `name` in an exported trace.
+size_t count_events(const std::string& trace, const std::string_view name)
+{
+  const std::string needle = "\"name\":\"" + std::string(name) + "\"";
+  size_t count = 0;
+  for (size_t at = trace.find(needle); at != std::string::npos; at = trace.find(needle, at + needle.size()))
+  {
+    ++count;
+  }
+  return count;
+}
+
+/// A completion as `Uring` records it, followed by the return of its callback.
+void complete(UringTracer& tracer, const uint64_t user_data, const int32_t result, const bool more)
+{
+  tracer.record(TracePhase::completed, TraceOp::unknown, user_data, result, more);
+  tracer.record(TracePhase::handled, TraceOp::unknown, user_data, result, more);
+}
+
+std::string export_trace(const UringTracer& tracer)
+{
+  std::ostringstream out;
+  tracer.export_chrome_trace(out);
+  return out.str();
+}
+
+}  // namespace
+
+SCENARIO("uring traces match completions to their ops")
+{
+  GIVEN("an enabled tracer")
+  {
+    UringTracer tracer;
+    tracer.enable(64U);
+
+    WHEN("a single shot op completes.")
+    {
+      tracer.record(TracePhase::prepared, TraceOp::read, 1U);
+      tracer.record(TracePhase::submitted, TraceOp::submit, 0U, 1);
+      complete(tracer, 1U, 16, false);
+      const std::string trace = export_trace(tracer);
+      THEN("it is a span with a single handler and no completion events.")
+      {
+        REQUIRE(count_events(trace, "read") == 2U);
+        REQUIRE(count_events(trace, "in_kernel") == 2U);
+        REQUIRE(count_events(trace, "handler") == 2U);
+        REQUIRE(count_events(trace, "cqe") == 0U);
+      }
+    }
+
+    WHEN("a multishot op completes a few times before it is disarmed.")
+    {
+      tracer.record(TracePhase::prepared, TraceOp::poll, 1U);
+      tracer.record(TracePhase::submitted, TraceOp::submit, 0U, 1);
+      complete(tracer, 1U, 1, true);
+      complete(tracer, 1U, 1, true);
+      complete(tracer, 1U, -125, false);
+      const std::string trace = export_trace(tracer);
+      THEN("it stays one span with an event and a handler for every completion.")
+      {
+        REQUIRE(count_events(trace, "poll") == 2U);
+        REQUIRE(count_events(trace, "in_kernel") == 2U);
+        REQUIRE(count_events(trace, "cqe") == 3U);
+        REQUIRE(count_events(trace, "handler") == 6U);
+        REQUIRE(trace.find("\"result\":-125}}") != std::string::npos);
+      }
+    }
+
+    WHEN("the user data of a disarmed multishot op is reused for the next op.")
+    {
+      tracer.record(TracePhase::prepared, TraceOp::poll, 1U);
+      tracer.record(TracePhase::submitted, TraceOp::submit, 0U, 1);
+      complete(tracer, 1U, 1, true);
+      complete(tracer, 1U, 1, false);
+      tracer.record(TracePhase::prepared, TraceOp::read, 1U);
+      tracer.record(TracePhase::submitted, TraceOp::submit, 0U, 1);
+      complete(tracer, 1U, 16, false);
+      const std::string trace = export_trace(tracer);
+      THEN("the next completion goes to the new op.")
+      {
+        REQUIRE(count_events(trace, "poll") == 2U);
+        REQUIRE(count_events(trace, "read") == 2U);
+        REQUIRE(count_events(trace, "cqe") == 2U);
+        REQUIRE(count_events(trace, "handler") == 6U);
+      }
+    }
+
+    WHEN("a multishot op is still armed at export time.")
+    {
+      tracer.record(TracePhase::prepared, TraceOp::poll, 1U);
+      tracer.record(TracePhase::submitted, TraceOp::submit, 0U, 1);
+      complete(tracer, 1U, 1, true);
+      tracer.record(TracePhase::prepared, TraceOp::read, 2U);
+      tracer.record(TracePhase::submitted, TraceOp::submit, 0U, 1);
+      const std::string trace = export_trace(tracer);
+      THEN("it ends with its last completion while ops without one are left out.")
+      {
+        REQUIRE(count_events(trace, "poll") == 2U);
+        REQUIRE(count_events(trace, "cqe") == 1U);
+        REQUIRE(count_events(trace, "read") == 0U);
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::io::test
@@ -0,0 +1,201 @@
+#include "src/io/unix_socket.hh"
+
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace spinscale::nwprog::io
+{
+
+namespace
+{
+
+/// Fills in `address` and returns its length, or EINVAL for a path that does not fit.
+lib::Result<socklen_t, lib::Errno> make_address(const std::string_view path, struct sockaddr_un& address)
+{
+  address = {};
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path))
+  {
+    return lib::Err(lib::Errno(EINVAL));
+  }
+  std::memcpy(address.sun_path, path.data(), path.size());
+  if (path.front() == '@')
+  {
+    // Abstract names are not NUL terminated, their length is part of the address.
+    address.sun_path[0] = '\0';
+    return lib::Ok(static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path.size()));
+  }
+  return lib::Ok(static_cast<socklen_t>(sizeof(address)));
+}
+
+int socket_type(const UnixSocketType type)
+{
+  return type == UnixSocketType::stream ? SOCK_STREAM : SOCK_SEQPACKET;
+}
+
+/// Whether there is nothing at `path` but possibly a socket, which may be removed.
+bool is_socket_or_missing(const std::string& path)
+{
+  struct stat status
+  {
+  };
+  if (lstat(path.c_str(), &status) != 0)
+  {
+    return errno == ENOENT;
+  }
+  return S_ISSOCK(status.st_mode);
+}
+
+/// The socket on success, closes it on failure.
+IoResult close_on_error(const FD fd, const bool ok)
+{
+  if (ok)
+  {
+    return lib::Ok(fd);
+  }
+  const lib::Errno error = lib::Errno::last();
+  close(fd);
+  return lib::Err(error);
+}
+
+}  // namespace
+
+IoResult listen_unix(const std::string_view path, const UnixSocketType type, const int backlog)
+{
+  struct sockaddr_un address;
+  const auto length = make_address(path, address);
+  if (length.is_error())
+  {
+    return lib::Err(length.error());
+  }
+  if (path.front() != '@' && !is_socket_or_missing(std::string(path)))
+  {
+    return lib::Err(lib::Errno(EEXIST));
+  }
+  const FD fd = socket(AF_UNIX, socket_type(type) | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    return lib::Err(lib::Errno::last());
+  }
+  unlink_unix(path);
+  return close_on_error(
+    fd, bind(fd, reinterpret_cast<struct sockaddr*>(&address), length.value()) == 0 && listen(fd, backlog) == 0);
+}
+
+IoResult connect_unix(const std::string_view path, const UnixSocketType type)
+{
+  struct sockaddr_un address;
+  const auto length = make_address(path, address);
+  if (length.is_error())
+  {
+    return lib::Err(length.error());
+  }
+  const FD fd = socket(AF_UNIX, socket_type(type) | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    return lib::Err(lib::Errno::last());
+  }
+  return close_on_error(fd, connect(fd, reinterpret_cast<struct sockaddr*>(&address), length.value()) == 0);
+}
+
+void unlink_unix(const std::string_view path)
+{
+  if (path.empty() || path.front() == '@')
+  {
+    return;
+  }
+  const std::string file(path);
+  if (is_socket_or_missing(file))
+  {
+    unlink(file.c_str());
+  }
+}
+
+IoResult FdMessage::prepare_send(const std::string_view data, const std::span<const int> fds)
+{
+  if (fds.size() > max_fds)
+  {
+    return lib::Err(lib::Errno(EINVAL));
+  }
+  iov_ = {.iov_base = const_cast<char*>(data.data()), .iov_len = data.size()};
+  msg_ = {};
+  msg_.msg_iov = &iov_;
+  msg_.msg_iovlen = 1;
+  if (fds.empty())
+  {
+    return lib::Ok(0);
+  }
+  const size_t count = fds.size();
+  msg_.msg_control = control_;
+  msg_.msg_controllen = CMSG_SPACE(count * sizeof(int));
+  struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg_);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+  std::memcpy(CMSG_DATA(cmsg), fds.data(), count * sizeof(int));
+  return lib::Ok(0);
+}
+
+void FdMessage::prepare_receive(char* data, const size_t size)
+{
+  iov_ = {.iov_base = data, .iov_len = size};
+  msg_ = {};
+  msg_.msg_iov = &iov_;
+  msg_.msg_iovlen = 1;
+  msg_.msg_control = control_;
+  msg_.msg_controllen = sizeof(control_);
+}
+
+std::vector<int> FdMessage::received_fds() const
+{
+  std::vector<int> fds;
+  for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg_); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(const_cast<struct msghdr*>(&msg_), cmsg))
+  {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    {
+      const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const size_t first = fds.size();
+      fds.resize(first + count);
+      std::memcpy(fds.data() + first, CMSG_DATA(cmsg), count * sizeof(int));
+    }
+  }
+  return fds;
+}
+
+IoResult send_fds(const FD socket, const std::string_view data, const std::span<const int> fds)
+{
+  FdMessage message;
+  if (const IoResult prepared = message.prepare_send(data, fds); prepared.is_error())
+  {
+    return prepared;
+  }
+  const ssize_t sent = sendmsg(socket, message.header(), MSG_NOSIGNAL);
+  if (sent < 0)
+  {
+    return lib::Err(lib::Errno::last());
+  }
+  return lib::Ok(static_cast<int32_t>(sent));
+}
+
+IoResult receive_fds(const FD socket, char* data, const size_t size, std::vector<int>& fds)
+{
+  FdMessage message;
+  message.prepare_receive(data, size);
+  // Received descriptors must not leak into children started by exec.
+  const ssize_t received = recvmsg(socket, message.header(), MSG_CMSG_CLOEXEC);
+  if (received < 0)
+  {
+    return lib::Err(lib::Errno::last());
+  }
+  fds = message.received_fds();
+  return lib::Ok(static_cast<int32_t>(received));
+}
+
+}  // namespace spinscale::nwprog::io
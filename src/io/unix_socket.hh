@@ -0,0 +1,88 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "src/io/uring.hh"
+
+namespace spinscale::nwprog::io
+{
+
+enum class UnixSocketType : uint8_t
+{
+  /// A byte stream like TCP, without the TCP stack.
+  stream,
+  /// Reliable and ordered like a stream, but every write arrives as one message of its own.
+  seqpacket
+};
+
+/// Listening `AF_UNIX` socket at `path`, a stale socket file there is replaced. Fails with EEXIST when anything else
+/// is in the way, which is never removed. A path starting with '@' names a socket in the abstract namespace, which
+/// leaves nothing behind in the file system. Accepted connections work with epoll and with the ring like TCP
+/// connections.
+IoResult listen_unix(std::string_view path, UnixSocketType type, int backlog);
+
+/// Connect to the `AF_UNIX` socket at `path`, '@' as in `listen_unix`.
+IoResult connect_unix(std::string_view path, UnixSocketType type);
+
+/// Remove the socket file of a listener created by `listen_unix`, nothing to do for abstract ones. Files that are not
+/// sockets are left alone.
+void unlink_unix(std::string_view path);
+
+/// A message over an `AF_UNIX` socket that carries descriptors next to its bytes. The header can be passed to
+/// sendmsg(2) and recvmsg(2) or to `Uring::prepare_sendmsg` and `Uring::prepare_recvmsg`, and has to stay in place
+/// until the op completed.
+///
+/// Descriptors arrive as new descriptors of the receiving process that refer to the same open files, so a listener
+/// can accept connections and hand them to a worker process, or a process can pass on memfds and pipes. At least
+/// one byte has to go with them.
+class FdMessage
+{
+public:
+  static constexpr size_t max_fds = 16U;
+
+  FdMessage() = default;
+  FdMessage(const FdMessage&) = delete;
+  FdMessage& operator=(const FdMessage&) = delete;
+
+  /// Send `data` together with up to `max_fds` descriptors, which stay open on the sending side. Fails with EINVAL
+  /// when there are more, without preparing anything.
+  IoResult prepare_send(std::string_view data, std::span<const int> fds);
+  /// Receive up to `size` bytes into `data` together with up to `max_fds` descriptors.
+  void prepare_receive(char* data, size_t size);
+
+  [[nodiscard]] struct msghdr* header()
+  {
+    return &msg_;
+  }
+
+  /// Descriptors that came with a completed receive, owned by the caller. Descriptors beyond `max_fds` were closed by
+  /// the kernel, `truncated()` tells.
+  [[nodiscard]] std::vector<int> received_fds() const;
+  [[nodiscard]] bool truncated() const
+  {
+    return (msg_.msg_flags & MSG_CTRUNC) != 0;
+  }
+
+private:
+  struct msghdr msg_
+  {
+  };
+  struct iovec iov_
+  {
+  };
+  alignas(struct cmsghdr) char control_[CMSG_SPACE(max_fds * sizeof(int))]{};
+};
+
+/// Blocking helpers for sockets that are not driven by a ring. Both return the number of bytes, like send and recv.
+/// Sending more than `FdMessage::max_fds` descriptors fails with EINVAL.
+IoResult send_fds(FD socket, std::string_view data, std::span<const int> fds);
+IoResult receive_fds(FD socket, char* data, size_t size, std::vector<int>& fds);
+
+}  // namespace spinscale::nwprog::io
@@ -4,6 +4,7 @@
 #include <sys/eventfd.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <cstring>
 
 #include "src/lib/log.hh"
@@ -16,25 +17,53 @@ namespace
 using IOUringParams = struct io_uring_params;
 }
 
-Uring::Uring(uint32_t io_uring_size, std::initializer_list<UringFeature> features)
+Uring::Uring(
+  uint32_t io_uring_size, std::initializer_list<UringFeature> features, std::optional<uint32_t> sq_thread_cpu,
+  std::optional<uint32_t> completion_queue_size)
   : io_uring_size_(io_uring_size), cqes_(io_uring_size_, nullptr)
 {
+  const UringCapabilities& capabilities = UringCapabilities::get();
   IOUringParams p{};
+  if (completion_queue_size.has_value())
+  {
+    if (capabilities.has_setup_flag(IORING_SETUP_CQSIZE))
+    {
+      p.flags |= IORING_SETUP_CQSIZE;
+      p.cq_entries = *completion_queue_size;
+    }
+    else
+    {
+      log::warn("the kernel can not size the completion queue, it holds twice the submission queue.");
+    }
+  }
   for (const auto feature : features)
   {
     switch (feature)
     {
       case UringFeature::sq_polling:
       {
+        if (!capabilities.has_setup_flag(IORING_SETUP_SQPOLL))
+        {
+          log::warn("submission queue polling is not available, submitting with system calls instead.");
+          break;
+        }
         p.flags |= IORING_SETUP_SQPOLL;
+        if (sq_thread_cpu.has_value())
+        {
+          p.flags |= IORING_SETUP_SQ_AFF;
+          p.sq_thread_cpu = *sq_thread_cpu;
+        }
         break;
       }
     }
   }
   const int res = io_uring_queue_init_params(io_uring_size_, &ring_, &p);
-  bool feature_available = p.features & IORING_FEAT_FAST_POLL;
-  log::expects(feature_available, "IORING_FEAT_FAST_POLL not available in the kernel, quiting.");
   log::expects(res == 0, "unable to initialize io_uring.");
+  if (!capabilities.fast_poll())
+  {
+    // Still correct, but every op on a socket that is not ready occupies a kernel worker thread until it is.
+    log::warn("IORING_FEAT_FAST_POLL is not available, socket ops that wait block kernel worker threads.");
+  }
 }
 
 Uring::~Uring()
@@ -42,18 +71,36 @@ Uring::~Uring()
   io_uring_queue_exit(&ring_);
 }
 
-FD Uring::register_event_fd()
+IoResult Uring::register_event_fd()
 {
-  log::expects(!is_event_fd_registered(), "attempt to reregister event fd");
-  event_fd_ = eventfd(0, 0);
-  log::expects(io_uring_register_eventfd(&ring_, event_fd_) == 0, "unable to register eventfd.");
-  return event_fd_;
+  if (is_event_fd_registered())
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+  // Non blocking so draining it never stalls the event loop.
+  const FD event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd < 0)
+  {
+    return lib::Err(lib::Errno::last());
+  }
+  if (const int res = io_uring_register_eventfd(&ring_, event_fd); res < 0)
+  {
+    close(event_fd);
+    return lib::Err(lib::Errno::from_negative(res));
+  }
+  event_fd_ = event_fd;
+  return lib::Ok(event_fd_);
 }
 
-void Uring::unregister_event_fd()
+IoResult Uring::unregister_event_fd()
 {
-  log::expects(io_uring_unregister_eventfd(&ring_) == 0, "unable to unregister eventfd");
+  if (const int res = io_uring_unregister_eventfd(&ring_); res < 0)
+  {
+    return lib::Err(lib::Errno::from_negative(res));
+  }
+  close(event_fd_);
   event_fd_ = -1;
+  return lib::Ok(0);
 }
 
 bool Uring::is_event_fd_registered() const
@@ -61,122 +108,313 @@ bool Uring::is_event_fd_registered() const
   return event_fd_ != -1;
 }
 
-void Uring::for_every_completion(CompletionCb completion_cb)
+IoResult Uring::for_every_completion(CompletionCb completion_cb)
 {
-  // drain eventfd if registered.
-  // if (event_fd_ != -1)
-  //{
-  //  eventfd_t v;
-  //  int ret = eventfd_read(event_fd_, &v);
-  //  log::expects(ret == 0, "unable to drain eventfd");
-  //}
+  // Reset the eventfd so whoever waits on it is only woken for completions posted after this point.
+  if (is_event_fd_registered())
+  {
+    eventfd_t count = 0;
+    log::expects(eventfd_read(event_fd_, &count) == 0 || errno == EAGAIN, "unable to drain eventfd.");
+  }
 
-  log::expects(io_uring_wait_cqe(&ring_, &cqes_[0]) != -1, "wait_cqe ended with -1.");
+  if (const int res = io_uring_wait_cqe(&ring_, &cqes_[0]); res < 0)
+  {
+    return lib::Err(lib::Errno::from_negative(res));
+  }
   const unsigned count = io_uring_peek_batch_cqe(&ring_, cqes_.data(), io_uring_size_);
   for (unsigned i = 0; i < count; ++i)
   {
     struct io_uring_cqe* cqe = cqes_[i];
-    completion_cb(reinterpret_cast<void*>(cqe->user_data), cqe->res);
+    trace_completion(TracePhase::completed, cqe);
+    completion_flags_ = cqe->flags;
+    completion_cb(reinterpret_cast<void*>(cqe->user_data), lib::result_from_return_code(cqe->res));
+    trace_completion(TracePhase::handled, cqe);
     ::io_uring_cqe_seen(&ring_, cqe);
   }
+  return lib::Ok(static_cast<int32_t>(count));
+}
+
+uint32_t Uring::ready_completions() const
+{
+  return io_uring_cq_ready(&ring_);
+}
+
+uint32_t Uring::completion_queue_size() const
+{
+  return *ring_.cq.kring_entries;
+}
+
+IoResult Uring::register_buffer_ring(struct io_uring_buf_ring* buffers, const uint32_t entries, const uint16_t group)
+{
+  struct io_uring_buf_reg reg
+  {
+  };
+  reg.ring_addr = reinterpret_cast<uint64_t>(buffers);
+  reg.ring_entries = entries;
+  reg.bgid = group;
+  return lib::result_from_return_code(io_uring_register_buf_ring(&ring_, &reg, 0));
 }
 
-UringResult Uring::prepare_accept(FD fd, struct sockaddr* remote_addr, socklen_t* remote_addr_len, void* user_data)
+IoResult Uring::unregister_buffer_ring(const uint16_t group)
+{
+  return lib::result_from_return_code(io_uring_unregister_buf_ring(&ring_, group));
+}
+
+IoResult Uring::prepare_accept(FD fd, struct sockaddr* remote_addr, socklen_t* remote_addr_len, void* user_data)
 {
   struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
   if (sqe == nullptr)
   {
-    return UringResult::failed;
+    return lib::Err(lib::Errno(EBUSY));
   }
 
   io_uring_prep_accept(sqe, fd, remote_addr, remote_addr_len, 0);
   io_uring_sqe_set_data(sqe, user_data);
-  return UringResult::ok;
+  trace_prepared(TraceOp::accept, user_data);
+  return lib::Ok(0);
 }
 
-UringResult Uring::prepare_connect(FD fd, struct sockaddr* address, const socklen_t addr_len, void* user_data)
+IoResult Uring::prepare_connect(FD fd, struct sockaddr* address, const socklen_t addr_len, void* user_data)
 {
   struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
   if (sqe == nullptr)
   {
-    return UringResult::failed;
+    return lib::Err(lib::Errno(EBUSY));
   }
 
   io_uring_prep_connect(sqe, fd, address, addr_len);
   io_uring_sqe_set_data(sqe, user_data);
-  return UringResult::ok;
+  trace_prepared(TraceOp::connect, user_data);
+  return lib::Ok(0);
 }
 
-UringResult Uring::prepare_readv(FD fd, const struct iovec* iovecs, unsigned nr_vecs, off_t offset, void* user_data)
+IoResult Uring::prepare_readv(FD fd, const struct iovec* iovecs, unsigned nr_vecs, off_t offset, void* user_data)
 {
   struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
   if (sqe == nullptr)
   {
-    return UringResult::failed;
+    return lib::Err(lib::Errno(EBUSY));
   }
 
   io_uring_prep_readv(sqe, fd, iovecs, nr_vecs, offset);
   io_uring_sqe_set_data(sqe, user_data);
-  return UringResult::ok;
+  trace_prepared(TraceOp::readv, user_data);
+  return lib::Ok(0);
 }
 
-UringResult Uring::prepare_writev(FD fd, const struct iovec* iovecs, unsigned nr_vecs, off_t offset, void* user_data)
+IoResult Uring::prepare_writev(FD fd, const struct iovec* iovecs, unsigned nr_vecs, off_t offset, void* user_data)
 {
   struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
   if (sqe == nullptr)
   {
-    return UringResult::failed;
+    return lib::Err(lib::Errno(EBUSY));
   }
 
   io_uring_prep_writev(sqe, fd, iovecs, nr_vecs, offset);
   io_uring_sqe_set_data(sqe, user_data);
-  return UringResult::ok;
+  trace_prepared(TraceOp::writev, user_data);
+  return lib::Ok(0);
 }
 
-UringResult Uring::prepare_read(FD fd, char* buf, unsigned num_bytes, off_t offset, void* user_data)
+IoResult Uring::prepare_read(FD fd, char* buf, unsigned num_bytes, off_t offset, void* user_data)
 {
   struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
   if (sqe == nullptr)
   {
-    return UringResult::failed;
+    return lib::Err(lib::Errno(EBUSY));
   }
 
   io_uring_prep_read(sqe, fd, buf, num_bytes, offset);
   io_uring_sqe_set_data(sqe, user_data);
-  return UringResult::ok;
+  trace_prepared(TraceOp::read, user_data);
+  return lib::Ok(0);
 }
 
-UringResult Uring::prepare_write(FD fd, const char* buf, unsigned num_bytes, off_t offset, void* user_data)
+IoResult Uring::prepare_write(FD fd, const char* buf, unsigned num_bytes, off_t offset, void* user_data)
 {
   struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
   if (sqe == nullptr)
   {
-    return UringResult::failed;
+    return lib::Err(lib::Errno(EBUSY));
   }
 
   io_uring_prep_write(sqe, fd, buf, num_bytes, offset);
   io_uring_sqe_set_data(sqe, user_data);
-  return UringResult::ok;
+  trace_prepared(TraceOp::write, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_sendmsg(FD fd, const struct msghdr* msg, const unsigned flags, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_sendmsg(sqe, fd, msg, flags);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::sendmsg, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_recvmsg(FD fd, struct msghdr* msg, const unsigned flags, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_recvmsg(sqe, fd, msg, flags);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::recvmsg, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_recvmsg_multishot(FD fd, struct msghdr* msg, const uint16_t buffer_group, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_recvmsg_multishot(sqe, fd, msg, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = buffer_group;
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::recvmsg, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_splice(
+  FD fd_in, const int64_t offset_in, FD fd_out, const int64_t offset_out, const unsigned num_bytes,
+  const unsigned flags, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_splice(sqe, fd_in, offset_in, fd_out, offset_out, num_bytes, flags);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::splice, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_poll(FD fd, const unsigned events, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_poll_add(sqe, fd, events);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::poll, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_poll_multishot(FD fd, const unsigned events, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_poll_multishot(sqe, fd, events);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::poll, user_data);
+  return lib::Ok(0);
 }
 
-UringResult Uring::prepare_close(FD fd, void* user_data)
+IoResult Uring::prepare_cancel(void* target, void* user_data)
 {
   struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
   if (sqe == nullptr)
   {
-    return UringResult::failed;
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_cancel(sqe, target, 0);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::cancel, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_openat(
+  FD dir_fd, const char* path, const int flags, const mode_t mode, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_openat(sqe, dir_fd, path, flags, mode);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::openat, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_statx(
+  FD dir_fd, const char* path, const int flags, const unsigned mask, struct statx* statx, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_statx(sqe, dir_fd, path, flags, mask, statx);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::statx, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_close(FD fd, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
   }
 
   io_uring_prep_close(sqe, fd);
   io_uring_sqe_set_data(sqe, user_data);
-  return UringResult::ok;
+  trace_prepared(TraceOp::close, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::prepare_timeout(struct __kernel_timespec* timeout, const unsigned flags, void* user_data)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(&ring_);
+  if (sqe == nullptr)
+  {
+    return lib::Err(lib::Errno(EBUSY));
+  }
+
+  io_uring_prep_timeout(sqe, timeout, 0, flags);
+  io_uring_sqe_set_data(sqe, user_data);
+  trace_prepared(TraceOp::timeout, user_data);
+  return lib::Ok(0);
+}
+
+IoResult Uring::submit()
+{
+  trace_submitted(io_uring_sq_ready(&ring_));
+  return lib::result_from_return_code(io_uring_submit(&ring_));
 }
 
-UringResult Uring::submit()
+bool Uring::submit_or_defer()
 {
-  const int res = io_uring_submit(&ring_);
-  log::expects(res >= 0 || res == -EBUSY, "unable to submit io_uring queue entries");
-  return res == -EBUSY ? UringResult::busy : UringResult::ok;
+  const IoResult submitted = submit();
+  log::expects(submitted.is_ok() || submitted.contains_err(lib::Errno(EBUSY)), "submitting to the ring failed.");
+  return submitted.is_ok();
 }
 
 }  // namespace spinscale::nwprog::io
@@ -3,26 +3,25 @@
 #include <unistd.h>
 
 #include <cstdint>
+#include <optional>
 #include <vector>
 
+#include "src/io/uring_capabilities.hh"
+#include "src/io/uring_trace.hh"
+#include "src/lib/errno.hh"
 #include "src/lib/function.hh"
 
 namespace spinscale::nwprog::io
 {
 
-enum class UringResult : uint8_t
-{
-  ok,
-  busy,
-  failed,
-};
-
 enum class UringFeature : uint8_t
 {
   sq_polling
 };
 
-using CompletionCb = lib::FnRef<void(void* user_data, int32_t result)>;
+/// Result of an operation: a non negative value on success, the errno otherwise. Fits into a register.
+using IoResult = lib::Result<int32_t, lib::Errno>;
+using CompletionCb = lib::FnRef<void(void* user_data, IoResult result)>;
 /// TODO: Prepare a better type for descriptors.
 using FD = int;
 
@@ -33,34 +32,128 @@ class Uring
   using IOUringCQE = struct io_uring_cqe;
 
 public:
-  Uring(const uint32_t io_uring_size, std::initializer_list<UringFeature> features);
+  /// With `sq_polling`, `sq_thread_cpu` pins the kernel polling thread, best next to the thread owning the ring. The
+  /// completion queue holds twice `io_uring_size` completions unless `completion_queue_size` asks for more, which
+  /// servers with many connections and few submissions at a time need. The kernel caps it at 65536.
+  ///
+  /// Kernels that lack a requested feature get a ring without it and a warning, so callers that care check
+  /// `UringCapabilities` first. So do those that pick between variants of an op.
+  Uring(
+    const uint32_t io_uring_size, std::initializer_list<UringFeature> features,
+    std::optional<uint32_t> sq_thread_cpu = std::nullopt, std::optional<uint32_t> completion_queue_size = std::nullopt);
   ~Uring();
 
-  /// Notify cqe events using event fd.
-  FD register_event_fd();
-  void unregister_event_fd();
+  /// Notify cqe events using a non blocking event fd, which is returned. It is reset by `for_every_completion`.
+  IoResult register_event_fd();
+  IoResult unregister_event_fd();
   bool is_event_fd_registered() const;
 
-  /// Poll the cqe and read until empty.
-  void for_every_completion(CompletionCb completion_cb);
-
-  UringResult prepare_accept(FD fd, struct sockaddr* remote_addr, socklen_t* remote_addr_len, void* user_data);
-  UringResult prepare_connect(FD fd, struct sockaddr* address, const socklen_t addr_len, void* user_data);
-
-  UringResult prepare_readv(FD fd, const struct iovec* iovecs, unsigned nr_vecs, off_t offset, void* user_data);
-  UringResult prepare_writev(FD fd, const struct iovec* iovecs, unsigned nr_vecs, off_t offset, void* user_data);
-  UringResult prepare_read(FD fd, char* buf, unsigned num_bytes, off_t offset, void* user_data);
-  UringResult prepare_write(FD fd, const char* buf, unsigned num_bytes, off_t offset, void* user_data);
-
-  UringResult prepare_close(FD fd, void* user_data);
-  UringResult submit();
+  /// Wait for at least one completion and handle all that are ready. Returns the number of completions handled, or the
+  /// error of the wait, e.g. EINTR.
+  IoResult for_every_completion(CompletionCb completion_cb);
+
+  /// Number of completions that can be handled without waiting.
+  [[nodiscard]] uint32_t ready_completions() const;
+  /// Number of completions the ring can hold. Ops beyond that in flight at once make completions overflow.
+  [[nodiscard]] uint32_t completion_queue_size() const;
+  /// Flags of the completion being handled, only valid inside a callback of `for_every_completion`. Multishot ops set
+  /// IORING_CQE_F_MORE as long as they stay armed, ops that picked a provided buffer set IORING_CQE_F_BUFFER.
+  [[nodiscard]] uint32_t completion_flags() const
+  {
+    return completion_flags_;
+  }
+
+  /// Hand the kernel a ring of `entries` provided buffers as group `group`. `buffers` has to be page aligned and stay
+  /// mapped until the group is unregistered.
+  IoResult register_buffer_ring(struct io_uring_buf_ring* buffers, uint32_t entries, uint16_t group);
+  IoResult unregister_buffer_ring(uint16_t group);
+
+  /// All prepare functions fail with EBUSY when the submission queue is full, `submit()` and retry.
+  IoResult prepare_accept(FD fd, struct sockaddr* remote_addr, socklen_t* remote_addr_len, void* user_data);
+  IoResult prepare_connect(FD fd, struct sockaddr* address, const socklen_t addr_len, void* user_data);
+
+  IoResult prepare_readv(FD fd, const struct iovec* iovecs, unsigned nr_vecs, off_t offset, void* user_data);
+  IoResult prepare_writev(FD fd, const struct iovec* iovecs, unsigned nr_vecs, off_t offset, void* user_data);
+  IoResult prepare_read(FD fd, char* buf, unsigned num_bytes, off_t offset, void* user_data);
+  IoResult prepare_write(FD fd, const char* buf, unsigned num_bytes, off_t offset, void* user_data);
+
+  IoResult prepare_sendmsg(FD fd, const struct msghdr* msg, unsigned flags, void* user_data);
+  IoResult prepare_recvmsg(FD fd, struct msghdr* msg, unsigned flags, void* user_data);
+  /// Receive messages until the op fails, each into a buffer picked from `buffer_group` that starts with an
+  /// io_uring_recvmsg_out header followed by room for name and control data as `msg` asks for. Completes once per
+  /// message, the op is only re-armed by preparing it again when a completion lacks IORING_CQE_F_MORE.
+  IoResult prepare_recvmsg_multishot(FD fd, struct msghdr* msg, uint16_t buffer_group, void* user_data);
+
+  /// Move `num_bytes` from `fd_in` to `fd_out` without copying them to user space, one of them has to be a pipe.
+  /// Offsets are -1 for pipes and sockets. The kernel always runs splices on its worker threads, where they block
+  /// until there is data or room, so wait for readiness with `prepare_poll` first when that may take a while.
+  IoResult prepare_splice(
+    FD fd_in, int64_t offset_in, FD fd_out, int64_t offset_out, unsigned num_bytes, unsigned flags, void* user_data);
+  /// Completes with the ready events once `fd` has one of the poll(2) `events`.
+  IoResult prepare_poll(FD fd, unsigned events, void* user_data);
+  /// Like `prepare_poll`, but stays armed and completes every time `fd` gets ready again, with IORING_CQE_F_MORE set
+  /// as long as it does. Ends with `prepare_cancel` or when a completion lacks IORING_CQE_F_MORE.
+  IoResult prepare_poll_multishot(FD fd, unsigned events, void* user_data);
+  /// Cancel the op prepared with `target`. The cancel completes with 0, -ENOENT when the op already completed or
+  /// -EALREADY when it is running and may or may not be interrupted. The op itself completes as usual, with
+  /// -ECANCELED if it was cancelled.
+  IoResult prepare_cancel(void* target, void* user_data);
+
+  /// Open `path` relative to the directory `dir_fd` with the open(2) `flags`, completes with the new descriptor.
+  /// `path` has to stay alive until the op was submitted.
+  IoResult prepare_openat(FD dir_fd, const char* path, int flags, mode_t mode, void* user_data);
+  /// Fill in `statx` with the fields of `mask` for `path` relative to `dir_fd`, or for `dir_fd` itself with an empty
+  /// path and AT_EMPTY_PATH in `flags`. `statx` has to stay alive until the op completes.
+  IoResult prepare_statx(FD dir_fd, const char* path, int flags, unsigned mask, struct statx* statx, void* user_data);
+  IoResult prepare_close(FD fd, void* user_data);
+  /// Completes with -ETIME once `timeout` expires. `flags` are the IORING_TIMEOUT_* flags.
+  IoResult prepare_timeout(struct __kernel_timespec* timeout, unsigned flags, void* user_data);
+  /// Returns the number of submitted entries. Fails with EBUSY when the completion queue overflowed, handle
+  /// completions and retry.
+  IoResult submit();
+  /// `submit()` for event loops that handle completions next. When the completion queue overflowed the ops stay
+  /// queued, handling the completions makes room and the next call submits them. Terminates on any other failure.
+  /// Returns whether the ops were submitted.
+  bool submit_or_defer();
+
+  /// Per op tracing. Disabled until `tracer().enable(capacity)` is called.
+  UringTracer& tracer()
+  {
+    return tracer_;
+  }
 
 private:
+  void trace_prepared(const TraceOp op, const void* user_data)
+  {
+    if (tracer_.enabled()) [[unlikely]]
+    {
+      tracer_.record(TracePhase::prepared, op, reinterpret_cast<uint64_t>(user_data));
+    }
+  }
+
+  void trace_submitted(const int32_t submitted)
+  {
+    if (tracer_.enabled()) [[unlikely]]
+    {
+      tracer_.record(TracePhase::submitted, TraceOp::submit, 0, submitted);
+    }
+  }
+
+  void trace_completion(const TracePhase phase, const IOUringCQE* cqe)
+  {
+    if (tracer_.enabled()) [[unlikely]]
+    {
+      tracer_.record(phase, TraceOp::unknown, cqe->user_data, cqe->res, (cqe->flags & IORING_CQE_F_MORE) != 0U);
+    }
+  }
+
   const uint32_t io_uring_size_;
   IOUring ring_{};
 
   std::vector<IOUringCQE*> cqes_;
+  uint32_t completion_flags_{0U};
   FD event_fd_{-1};
+  UringTracer tracer_;
 };
 
 }  // namespace spinscale::nwprog::io
@@ -0,0 +1,131 @@
+#include "src/io/uring_capabilities.hh"
+
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <array>
+#include <string_view>
+#include <utility>
+
+namespace spinscale::nwprog::io
+{
+namespace
+{
+using IOUringParams = struct io_uring_params;
+
+/// Setup flags worth trying, with the flags each one depends on.
+constexpr std::array<std::pair<uint32_t, uint32_t>, 7> setup_trials{{
+  {IORING_SETUP_SQPOLL, 0U},
+  {IORING_SETUP_CQSIZE, 0U},
+  {IORING_SETUP_SUBMIT_ALL, 0U},
+  {IORING_SETUP_COOP_TASKRUN, 0U},
+  {IORING_SETUP_TASKRUN_FLAG, IORING_SETUP_COOP_TASKRUN},
+  {IORING_SETUP_SINGLE_ISSUER, 0U},
+  {IORING_SETUP_DEFER_TASKRUN, IORING_SETUP_SINGLE_ISSUER},
+}};
+
+/// Set up a ring of a few entries with `flags`, false when the kernel refused them.
+bool try_setup(const uint32_t flags)
+{
+  IOUringParams p{};
+  p.flags = flags;
+  p.cq_entries = 16U;
+  struct io_uring ring
+  {
+  };
+  if (io_uring_queue_init_params(4U, &ring, &p) != 0)
+  {
+    return false;
+  }
+  io_uring_queue_exit(&ring);
+  return true;
+}
+
+bool try_fixed_files(struct io_uring& ring)
+{
+  const int fd = eventfd(0, EFD_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+  const bool registered = io_uring_register_files(&ring, &fd, 1U) == 0;
+  if (registered)
+  {
+    io_uring_unregister_files(&ring);
+  }
+  close(fd);
+  return registered;
+}
+
+void append(std::string& out, const bool available, const std::string_view name)
+{
+  if (available)
+  {
+    out.append(", ").append(name);
+  }
+}
+
+}  // namespace
+
+const UringCapabilities& UringCapabilities::get()
+{
+  static const UringCapabilities capabilities = probe();
+  return capabilities;
+}
+
+UringCapabilities UringCapabilities::probe()
+{
+  UringCapabilities result;
+  IOUringParams p{};
+  struct io_uring ring
+  {
+  };
+  if (io_uring_queue_init_params(4U, &ring, &p) != 0)
+  {
+    // No io_uring at all, e.g. disabled by sysctl or seccomp.
+    return result;
+  }
+  result.features = p.features;
+  if (struct io_uring_probe* probe = io_uring_get_probe_ring(&ring); probe != nullptr)
+  {
+    for (uint32_t op = 0; op < probe->ops_len && op < result.ops.size(); ++op)
+    {
+      result.ops.set(op, (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0U);
+    }
+    io_uring_free_probe(probe);
+  }
+  result.fixed_files = try_fixed_files(ring);
+  io_uring_queue_exit(&ring);
+
+  for (const auto& [flag, required] : setup_trials)
+  {
+    if (result.has_setup_flag(required) && try_setup(flag | required))
+    {
+      result.setup_flags |= flag;
+    }
+  }
+  return result;
+}
+
+std::string UringCapabilities::summary() const
+{
+  if (features == 0U)
+  {
+    return "no io_uring";
+  }
+  std::string out = "ops " + std::to_string(ops.count());
+  append(out, fast_poll(), "fast poll");
+  append(out, multishot_poll(), "multishot poll");
+  append(out, multishot_accept(), "multishot accept");
+  append(out, multishot_receive(), "multishot receive");
+  append(out, provided_buffer_rings(), "provided buffer rings");
+  append(out, zero_copy_send(), "zero copy send");
+  append(out, fixed_files, "fixed files");
+  append(out, has_setup_flag(IORING_SETUP_SQPOLL), "sq polling");
+  append(out, has_setup_flag(IORING_SETUP_COOP_TASKRUN), "cooperative task running");
+  append(out, has_setup_flag(IORING_SETUP_DEFER_TASKRUN), "deferred task running");
+  return out;
+}
+
+}  // namespace spinscale::nwprog::io
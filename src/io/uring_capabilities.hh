@@ -0,0 +1,86 @@
+#pragma once
+#include <liburing.h>
+
+#include <bitset>
+#include <cstdint>
+#include <string>
+
+namespace spinscale::nwprog::io
+{
+
+/// What the running kernel's io_uring offers, so one binary can take the fast variant of an op where it exists and
+/// fall back to an older one elsewhere.
+///
+/// Ops come from IORING_REGISTER_PROBE, features from the flags io_uring_setup(2) reports and setup flags from
+/// setting up a small ring with each of them. Variants of an op that share its opcode, like multishot ones, can not
+/// be probed; they are derived from the opcodes and features of the kernel release that brought them.
+struct UringCapabilities
+{
+  /// Probed on first use, the same for every ring of the process.
+  static const UringCapabilities& get();
+  /// Run the probe. Takes a few rings and milliseconds, prefer `get()`.
+  static UringCapabilities probe();
+
+  /// IORING_FEAT_* flags.
+  uint32_t features{0U};
+  /// IORING_SETUP_* flags a ring can be set up with.
+  uint32_t setup_flags{0U};
+  /// Indexed by IORING_OP_*. Empty on kernels before 5.6, which can not be probed for ops.
+  std::bitset<256> ops{};
+  /// Descriptors can be registered with the ring and referred to by index, which saves looking them up per op.
+  bool fixed_files{false};
+
+  [[nodiscard]] bool supports(const uint8_t op) const
+  {
+    return ops.test(op);
+  }
+
+  [[nodiscard]] bool has_feature(const uint32_t feature) const
+  {
+    return (features & feature) == feature;
+  }
+
+  [[nodiscard]] bool has_setup_flag(const uint32_t flag) const
+  {
+    return (setup_flags & flag) == flag;
+  }
+
+  /// Ops on sockets that are not ready wait for readiness in the kernel instead of blocking a worker thread.
+  [[nodiscard]] bool fast_poll() const
+  {
+    return has_feature(IORING_FEAT_FAST_POLL);
+  }
+
+  /// Linux 5.13, which also brought resource tags.
+  [[nodiscard]] bool multishot_poll() const
+  {
+    return has_feature(IORING_FEAT_RSRC_TAGS);
+  }
+
+  /// Linux 5.19, together with the socket op and provided buffer rings.
+  [[nodiscard]] bool multishot_accept() const
+  {
+    return supports(IORING_OP_SOCKET);
+  }
+
+  [[nodiscard]] bool provided_buffer_rings() const
+  {
+    return supports(IORING_OP_SOCKET);
+  }
+
+  /// Linux 6.0, together with zero copy sends.
+  [[nodiscard]] bool multishot_receive() const
+  {
+    return supports(IORING_OP_SEND_ZC);
+  }
+
+  [[nodiscard]] bool zero_copy_send() const
+  {
+    return supports(IORING_OP_SEND_ZC);
+  }
+
+  /// One line for the log, e.g. "ops 54, fast poll, multishot poll, multishot accept, ...".
+  [[nodiscard]] std::string summary() const;
+};
+
+}  // namespace spinscale::nwprog::io
@@ -0,0 +1,253 @@
+#include "src/io/uring_trace.hh"
+
+#include <deque>
+#include <iomanip>
+#include <string_view>
+#include <unordered_map>
+
+namespace spinscale::nwprog::io
+{
+
+namespace
+{
+
+/// A completion of an op and the return of its callback, 0 while the callback had not returned.
+struct OpCompletion
+{
+  uint64_t completed;
+  uint64_t handled;
+  int32_t result;
+};
+
+/// Lifetime of a single op reassembled from the raw records.
+struct OpSpan
+{
+  TraceOp op;
+  uint64_t user_data;
+  /// Result of the last completion.
+  int32_t result;
+  uint64_t prepared;
+  uint64_t submitted;
+  /// One completion per single shot op, as many as the op got while it stayed armed for multishot ones.
+  std::vector<OpCompletion> completions;
+  /// A completion carried IORING_CQE_F_MORE.
+  bool multishot;
+};
+
+[[nodiscard]] std::string_view op_to_string_view(const TraceOp op)
+{
+  switch (op)
+  {
+    case TraceOp::accept:
+      return "accept";
+    case TraceOp::connect:
+      return "connect";
+    case TraceOp::readv:
+      return "readv";
+    case TraceOp::writev:
+      return "writev";
+    case TraceOp::read:
+      return "read";
+    case TraceOp::write:
+      return "write";
+    case TraceOp::sendmsg:
+      return "sendmsg";
+    case TraceOp::recvmsg:
+      return "recvmsg";
+    case TraceOp::splice:
+      return "splice";
+    case TraceOp::poll:
+      return "poll";
+    case TraceOp::cancel:
+      return "cancel";
+    case TraceOp::openat:
+      return "openat";
+    case TraceOp::statx:
+      return "statx";
+    case TraceOp::close:
+      return "close";
+    case TraceOp::timeout:
+      return "timeout";
+    case TraceOp::submit:
+      return "submit";
+    case TraceOp::unknown:
+      return "unknown";
+  }
+  __builtin_unreachable();
+}
+
+/// Writes trace events. Takes care of the separators and the time base.
+class EventWriter
+{
+public:
+  EventWriter(std::ostream& out, const uint64_t base_tsc) : out_(out), base_tsc_(base_tsc)
+  {
+  }
+
+  void async(const char phase, const std::string_view name, const size_t id, const uint64_t tsc)
+  {
+    begin_event(name, phase, tsc);
+    out_ << ",\"id\":" << id << '}';
+  }
+
+  void async_begin(const std::string_view name, const size_t id, const uint64_t tsc, const OpSpan& span)
+  {
+    begin_event(name, 'b', tsc);
+    out_ << ",\"id\":" << id << ",\"args\":{\"user_data\":\"0x" << std::hex << span.user_data << std::dec
+         << "\",\"result\":" << span.result << "}}";
+  }
+
+  void async_instant(const std::string_view name, const size_t id, const uint64_t tsc, const int32_t result)
+  {
+    begin_event(name, 'n', tsc);
+    out_ << ",\"id\":" << id << ",\"args\":{\"result\":" << result << "}}";
+  }
+
+  void instant(const std::string_view name, const uint64_t tsc, const int32_t count)
+  {
+    begin_event(name, 'i', tsc);
+    out_ << ",\"s\":\"p\",\"args\":{\"count\":" << count << "}}";
+  }
+
+private:
+  void begin_event(const std::string_view name, const char phase, const uint64_t tsc)
+  {
+    out_ << (first_ ? "\n" : ",\n");
+    first_ = false;
+    out_ << "{\"name\":\"" << name << "\",\"cat\":\"uring\",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":1,\"ts\":"
+         << std::fixed << std::setprecision(3) << lib::tsc::to_ns(tsc - base_tsc_) / 1000.0;
+  }
+
+  std::ostream& out_;
+  const uint64_t base_tsc_;
+  bool first_{true};
+};
+
+}  // namespace
+
+void UringTracer::enable(const size_t capacity)
+{
+  records_.assign(capacity, TraceRecord{});
+  next_ = 0;
+  wrapped_ = false;
+  enabled_ = capacity > 0;
+  // Calibrate now rather than in the middle of the hot path.
+  lib::tsc::ticks_per_ns();
+}
+
+void UringTracer::disable()
+{
+  enabled_ = false;
+}
+
+void UringTracer::export_chrome_trace(std::ostream& out) const
+{
+  const size_t count = size();
+  const size_t first = wrapped_ ? next_ : 0;
+
+  std::vector<OpSpan> spans;
+  std::vector<size_t> unsubmitted;
+  // There may be multiple ops in flight with the same user data, completions are matched in FIFO order. A multishot
+  // op stays at the front until its last completion, the one without IORING_CQE_F_MORE.
+  std::unordered_map<uint64_t, std::deque<size_t>> in_flight;
+  std::unordered_map<uint64_t, size_t> in_handler;
+  std::vector<const TraceRecord*> submits;
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    const TraceRecord& record = records_[(first + i) % records_.size()];
+    switch (record.phase)
+    {
+      case TracePhase::prepared:
+      {
+        unsubmitted.push_back(spans.size());
+        in_flight[record.user_data].push_back(spans.size());
+        spans.push_back({record.op, record.user_data, 0, record.tsc, 0, {}, false});
+        break;
+      }
+      case TracePhase::submitted:
+      {
+        for (const size_t index : unsubmitted)
+        {
+          spans[index].submitted = record.tsc;
+        }
+        unsubmitted.clear();
+        submits.push_back(&record);
+        break;
+      }
+      case TracePhase::completed:
+      {
+        auto it = in_flight.find(record.user_data);
+        // The prepare record might have been overwritten already.
+        if (it == in_flight.end() || it->second.empty())
+        {
+          break;
+        }
+        const size_t index = it->second.front();
+        if (!record.more)
+        {
+          it->second.pop_front();
+        }
+        OpSpan& span = spans[index];
+        span.completions.push_back({record.tsc, 0, record.result});
+        span.result = record.result;
+        span.multishot = span.multishot || record.more;
+        in_handler[record.user_data] = index;
+        break;
+      }
+      case TracePhase::handled:
+      {
+        if (const auto it = in_handler.find(record.user_data); it != in_handler.end())
+        {
+          spans[it->second].completions.back().handled = record.tsc;
+          in_handler.erase(it);
+        }
+        break;
+      }
+    }
+  }
+
+  const uint64_t base_tsc = count > 0 ? records_[first].tsc : 0;
+  EventWriter writer(out, base_tsc);
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  for (const TraceRecord* submit : submits)
+  {
+    writer.instant(op_to_string_view(TraceOp::submit), submit->tsc, submit->result);
+  }
+  for (size_t id = 0; id < spans.size(); ++id)
+  {
+    const OpSpan& span = spans[id];
+    // Ops without a completion at export time have no end and are left out. Multishot ops that are still armed end
+    // with their last completion.
+    if (span.completions.empty())
+    {
+      continue;
+    }
+    const OpCompletion& last = span.completions.back();
+    const uint64_t end = last.handled != 0 ? last.handled : last.completed;
+    writer.async_begin(op_to_string_view(span.op), id, span.prepared, span);
+    if (span.submitted != 0)
+    {
+      writer.async('b', "sq_wait", id, span.prepared);
+      writer.async('e', "sq_wait", id, span.submitted);
+      writer.async('b', "in_kernel", id, span.submitted);
+      writer.async('e', "in_kernel", id, span.completions.front().completed);
+    }
+    for (const OpCompletion& completion : span.completions)
+    {
+      if (span.multishot)
+      {
+        writer.async_instant("cqe", id, completion.completed, completion.result);
+      }
+      if (completion.handled != 0)
+      {
+        writer.async('b', "handler", id, completion.completed);
+        writer.async('e', "handler", id, completion.handled);
+      }
+    }
+    writer.async('e', op_to_string_view(span.op), id, end);
+  }
+  out << "\n]}\n";
+}
+
+}  // namespace spinscale::nwprog::io
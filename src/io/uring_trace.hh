@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "src/lib/tsc.hh"
+
+namespace spinscale::nwprog::io
+{
+
+/// Operation kinds recorded by the tracer.
+enum class TraceOp : uint8_t
+{
+  accept,
+  connect,
+  readv,
+  writev,
+  read,
+  write,
+  sendmsg,
+  recvmsg,
+  splice,
+  poll,
+  cancel,
+  openat,
+  statx,
+  close,
+  timeout,
+  /// Not an op. Marks a call to `Uring::submit`.
+  submit,
+  /// Op of a completion, recovered from the matching prepare record on export.
+  unknown,
+};
+
+/// Points in the lifetime of an op that get a timestamp.
+enum class TracePhase : uint8_t
+{
+  /// The sqe was filled in by one of the `prepare_*` calls.
+  prepared,
+  /// The sqes prepared so far are about to be handed to the kernel.
+  submitted,
+  /// The cqe was reaped from the completion queue.
+  completed,
+  /// The completion callback returned.
+  handled,
+};
+
+/// A single timestamped event. Kept small so that a trace of a few million events fits in cache friendly memory.
+struct TraceRecord
+{
+  uint64_t tsc;
+  uint64_t user_data;
+  /// Result of the op for completions, number of sqes ready for submits.
+  int32_t result;
+  /// Only known when the op is prepared. Completions are matched back to it through `user_data`.
+  TraceOp op;
+  TracePhase phase;
+  /// The completion carried IORING_CQE_F_MORE, the op stays armed and more completions of it follow.
+  bool more;
+};
+
+/// Records per op timestamps of a `Uring` into a preallocated ring of records.
+///
+/// The tracer is disabled by default and every recording site checks a single flag, so there is nothing to pay for
+/// it unless it is turned on. Once the ring is full the oldest records are overwritten.
+class UringTracer
+{
+public:
+  UringTracer() = default;
+  UringTracer(const UringTracer&) = delete;
+  UringTracer& operator=(const UringTracer&) = delete;
+
+  /// Start recording into a ring of `capacity` records. Previously recorded events are discarded.
+  void enable(size_t capacity);
+  /// Stop recording. Recorded events are kept around for export.
+  void disable();
+
+  [[nodiscard]] bool enabled() const
+  {
+    return enabled_;
+  }
+
+  /// Number of records currently held.
+  [[nodiscard]] size_t size() const
+  {
+    return wrapped_ ? records_.size() : next_;
+  }
+
+  /// Record an event. Callers are expected to check `enabled()` first.
+  void record(
+    const TracePhase phase, const TraceOp op, const uint64_t user_data, const int32_t result = 0,
+    const bool more = false)
+  {
+    records_[next_] = {lib::tsc::now(), user_data, result, op, phase, more};
+    if (++next_ == records_.size())
+    {
+      next_ = 0;
+      wrapped_ = true;
+    }
+  }
+
+  /// Write the recorded events in the Chrome trace event format (also understood by Perfetto).
+  /// Each op becomes an async slice with nested `sq_wait`, `in_kernel` and `handler` slices. Multishot ops stay open
+  /// until their last completion and get a `cqe` instant and a `handler` slice for every completion.
+  void export_chrome_trace(std::ostream& out) const;
+
+private:
+  std::vector<TraceRecord> records_;
+  size_t next_{0};
+  bool wrapped_{false};
+  bool enabled_{false};
+};
+
+}  // namespace spinscale::nwprog::io
@@ -0,0 +1,73 @@
+#include "src/lib/arena.hh"
+
+#include <sys/mman.h>
+
+#include <new>
+
+#include "src/lib/log.hh"
+#include "src/lib/topology.hh"
+
+namespace spinscale::nwprog::lib
+{
+
+Arena::Arena(const size_t chunk_size, const std::optional<uint32_t> node)
+  : chunk_size_(block_size(chunk_size))
+  , node_(node)
+{
+}
+
+char* Arena::allocate(const size_t size)
+{
+  const size_t block = block_size(size);
+  allocated_bytes_ += block;
+  FreeBlock*& free_list = free_lists_[size_class(block)];
+  if (free_list != nullptr)
+  {
+    FreeBlock* reused = free_list;
+    free_list = reused->next;
+    return reinterpret_cast<char*>(reused);
+  }
+  if (block >= chunk_size_)
+  {
+    return new_chunk(block);
+  }
+  if (static_cast<size_t>(end_ - cursor_) < block)
+  {
+    // The rest of the current chunk stays unused, it is smaller than the block.
+    cursor_ = new_chunk(chunk_size_);
+    end_ = cursor_ + chunk_size_;
+  }
+  char* allocated = cursor_;
+  cursor_ += block;
+  return allocated;
+}
+
+void Arena::deallocate(char* block, const size_t size)
+{
+  const size_t freed = block_size(size);
+  allocated_bytes_ -= freed;
+  FreeBlock*& free_list = free_lists_[size_class(freed)];
+  free_list = new (block) FreeBlock{free_list};
+}
+
+void Arena::Unmap::operator()(char* chunk) const
+{
+  munmap(chunk, size);
+}
+
+char* Arena::new_chunk(const size_t size)
+{
+  // Blocks are multiples of the smallest block carved from the start, and chunks start at a page boundary.
+  void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  log::expects(mapped != MAP_FAILED, "unable to map an arena chunk.");
+  if (node_.has_value())
+  {
+    // Placement is a hint, the chunk works just the same on another node.
+    static_cast<void>(prefer_node(mapped, size, *node_));
+  }
+  auto& chunk = chunks_.emplace_back(static_cast<char*>(mapped), Unmap{size});
+  reserved_bytes_ += size;
+  return chunk.get();
+}
+
+}  // namespace spinscale::nwprog::lib
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace spinscale::nwprog::lib
+{
+
+/// Allocator for many byte strings of varying size that are freed one by one, such as the entries of a cache.
+///
+/// Memory is carved out of large chunks that are only returned to the system when the arena is destroyed. Sizes are
+/// rounded up to a power of two of at least `min_block_size` and freed blocks go to a free list of that size, so
+/// allocating and freeing take a handful of instructions and no malloc once the arena is warm. The price is up to
+/// half of every block as slack. Blocks larger than a chunk get a chunk of their own. Not thread safe, meant to be
+/// owned by one thread.
+///
+/// Chunks are mapped directly. With a `node` their pages prefer that NUMA node, without one they land on the node of
+/// the thread that touches them first, which is the owning thread as long as it is pinned.
+class Arena
+{
+public:
+  static constexpr size_t min_block_size = 16U;
+  static constexpr size_t default_chunk_size = 1U << 20U;
+
+  explicit Arena(size_t chunk_size = default_chunk_size, std::optional<uint32_t> node = std::nullopt);
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  Arena(Arena&&) noexcept = default;
+  Arena& operator=(Arena&&) noexcept = default;
+
+  /// At least `size` bytes, aligned to `min_block_size`.
+  [[nodiscard]] char* allocate(size_t size);
+  /// `size` has to be the size the block was allocated with, or anything with the same `block_size`.
+  void deallocate(char* block, size_t size);
+
+  /// The usable size of a block allocated for `size` bytes.
+  [[nodiscard]] static size_t block_size(const size_t size)
+  {
+    return std::bit_ceil(size < min_block_size ? min_block_size : size);
+  }
+
+  /// Bytes in blocks that are handed out.
+  [[nodiscard]] size_t allocated_bytes() const
+  {
+    return allocated_bytes_;
+  }
+
+  /// Bytes taken from the system.
+  [[nodiscard]] size_t reserved_bytes() const
+  {
+    return reserved_bytes_;
+  }
+
+private:
+  static constexpr size_t num_size_classes = 64U;
+
+  struct FreeBlock
+  {
+    FreeBlock* next;
+  };
+
+  [[nodiscard]] static size_t size_class(const size_t block_size)
+  {
+    return std::countr_zero(block_size);
+  }
+
+  struct Unmap
+  {
+    size_t size;
+    void operator()(char* chunk) const;
+  };
+
+  char* new_chunk(size_t size);
+
+  size_t chunk_size_;
+  std::optional<uint32_t> node_;
+  std::vector<std::unique_ptr<char[], Unmap>> chunks_{};
+  /// Unused rest of the newest chunk.
+  char* cursor_{nullptr};
+  char* end_{nullptr};
+  std::array<FreeBlock*, num_size_classes> free_lists_{};
+  size_t allocated_bytes_{0U};
+  size_t reserved_bytes_{0U};
+};
+
+}  // namespace spinscale::nwprog::lib
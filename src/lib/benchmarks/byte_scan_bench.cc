@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+#include "src/lib/benchmarks/harness.hh"
+#include "src/lib/byte_scan.hh"
+
+namespace spinscale::nwprog::lib::bench
+{
+
+using nwprog::bench::do_not_optimize;
+
+namespace
+{
+
+/// What a browser sends, the lines are the unit the HTTP parser scans for.
+constexpr std::string_view request =
+  "GET /api/v1/items?id=12345&fields=name,price HTTP/1.1\r\n"
+  "Host: www.example.com\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:109.0) Gecko/20100101 Firefox/115.0\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+  "Accept-Language: en-US,en;q=0.5\r\n"
+  "Accept-Encoding: gzip, deflate, br\r\n"
+  "Connection: keep-alive\r\n"
+  "Cookie: session=4f2a9c1e8b7d6a5f4e3d2c1b0a998877; theme=dark\r\n"
+  "Upgrade-Insecure-Requests: 1\r\n"
+  "\r\n";
+
+/// Split the request into lines with `find`, which returns the offset of the next CR or LF.
+template <class Find>
+void count_lines(const uint64_t iterations, Find&& find)
+{
+  uint64_t lines = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    std::string_view rest = request;
+    do_not_optimize(rest);
+    while (!rest.empty())
+    {
+      const size_t end = find(rest);
+      rest.remove_prefix(std::min(end + 2U, rest.size()));
+      ++lines;
+    }
+  }
+  do_not_optimize(lines);
+}
+
+void scalar_scan(const uint64_t iterations)
+{
+  count_lines(
+    iterations, [](const std::string_view data)
+    { return detail::find_first_of_scalar<'\r', '\n'>(data.data(), 0, data.size()); });
+}
+
+void string_view_find_first_of(const uint64_t iterations)
+{
+  count_lines(iterations, [](const std::string_view data) { return data.find_first_of("\r\n"); });
+}
+
+/// A single needle only, but the usual way to get a vectorized search.
+void memchr_scan(const uint64_t iterations)
+{
+  count_lines(
+    iterations,
+    [](const std::string_view data)
+    {
+      const void* found = std::memchr(data.data(), '\r', data.size());
+      return found == nullptr ? data.size() : static_cast<const char*>(found) - data.data();
+    });
+}
+
+#if defined(__x86_64__)
+void sse2_scan(const uint64_t iterations)
+{
+  count_lines(
+    iterations,
+    [](const std::string_view data) { return detail::find_first_of_sse2<'\r', '\n'>(data.data(), data.size()); });
+}
+#endif
+
+/// AVX2 when the CPU has it.
+void dispatched_scan(const uint64_t iterations)
+{
+  count_lines(iterations, [](const std::string_view data) { return find_first_of<'\r', '\n'>(data); });
+}
+
+NWPROG_BENCHMARK(scalar_scan);
+NWPROG_BENCHMARK_VS(string_view_find_first_of, scalar_scan);
+NWPROG_BENCHMARK_VS(memchr_scan, scalar_scan);
+#if defined(__x86_64__)
+NWPROG_BENCHMARK_VS(sse2_scan, scalar_scan);
+#endif
+NWPROG_BENCHMARK_VS(dispatched_scan, scalar_scan);
+
+}  // namespace
+
+}  // namespace spinscale::nwprog::lib::bench
@@ -0,0 +1,170 @@
+#include <array>
+#include <functional>
+
+#include "src/lib/benchmarks/harness.hh"
+#include "src/lib/function.hh"
+
+namespace spinscale::nwprog::lib::bench
+{
+
+using nwprog::bench::do_not_optimize;
+
+namespace
+{
+
+/// The callers are out of line and take the callable through the type under test, which is how completion callbacks
+/// reach `Uring::for_every_completion`. Without that the compiler would see through all of them.
+
+uint64_t counter = 0;
+
+void add(const uint64_t value)
+{
+  counter += value;
+}
+
+[[gnu::noinline]] void call_fn_ptr(void (*fn)(uint64_t), const uint64_t iterations)
+{
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    fn(i);
+  }
+}
+
+template <class Callable>
+[[gnu::noinline]] void call_template(Callable& callable, const uint64_t iterations)
+{
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    callable(i);
+  }
+}
+
+[[gnu::noinline]] void call_fn_ref(const FnRef<void(uint64_t)> fn, const uint64_t iterations)
+{
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    fn(i);
+  }
+}
+
+[[gnu::noinline]] void call_std_function(const std::function<void(uint64_t)>& fn, const uint64_t iterations)
+{
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    fn(i);
+  }
+}
+
+[[gnu::noinline]] void call_inplace_function(InplaceFunction<void(uint64_t)>& fn, const uint64_t iterations)
+{
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    fn(i);
+  }
+}
+
+void raw_function_pointer(const uint64_t iterations)
+{
+  counter = 0;
+  auto* fn = &add;
+  do_not_optimize(fn);
+  call_fn_ptr(fn, iterations);
+  do_not_optimize(counter);
+}
+
+void inlined_lambda(const uint64_t iterations)
+{
+  uint64_t sum = 0;
+  auto lambda = [&sum](const uint64_t value) { sum += value; };
+  call_template(lambda, iterations);
+  do_not_optimize(sum);
+}
+
+void fn_ref(const uint64_t iterations)
+{
+  uint64_t sum = 0;
+  auto lambda = [&sum](const uint64_t value) { sum += value; };
+  call_fn_ref(lambda, iterations);
+  do_not_optimize(sum);
+}
+
+void std_function(const uint64_t iterations)
+{
+  uint64_t sum = 0;
+  call_std_function([&sum](const uint64_t value) { sum += value; }, iterations);
+  do_not_optimize(sum);
+}
+
+/// Constructing the wrapper per call, as when a callback is passed down on every completion.
+void fn_ref_construct(const uint64_t iterations)
+{
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    auto lambda = [&sum, i](const uint64_t value) { sum += value + i; };
+    call_fn_ref(lambda, 1);
+  }
+  do_not_optimize(sum);
+}
+
+/// A capture too large for the small buffer of `std::function`, so every construction allocates.
+void std_function_construct_large(const uint64_t iterations)
+{
+  uint64_t sum = 0;
+  std::array<uint64_t, 8> padding{};
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    padding[0] = i;
+    call_std_function([&sum, padding](const uint64_t value) { sum += value + padding[0]; }, 1);
+  }
+  do_not_optimize(sum);
+}
+
+void fn_ref_construct_large(const uint64_t iterations)
+{
+  uint64_t sum = 0;
+  std::array<uint64_t, 8> padding{};
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    padding[0] = i;
+    auto lambda = [&sum, padding](const uint64_t value) { sum += value + padding[0]; };
+    call_fn_ref(lambda, 1);
+  }
+  do_not_optimize(sum);
+}
+
+/// Storing the callback, as for the continuation of an in flight operation.
+void inplace_function_construct_large(const uint64_t iterations)
+{
+  uint64_t sum = 0;
+  std::array<uint64_t, 8> padding{};
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    padding[0] = i;
+    InplaceFunction<void(uint64_t), 80> fn([&sum, padding](const uint64_t value) { sum += value + padding[0]; });
+    call_fn_ref(fn, 1);
+  }
+  do_not_optimize(sum);
+}
+
+void inplace_function(const uint64_t iterations)
+{
+  uint64_t sum = 0;
+  InplaceFunction<void(uint64_t)> fn([&sum](const uint64_t value) { sum += value; });
+  call_inplace_function(fn, iterations);
+  do_not_optimize(sum);
+}
+
+NWPROG_BENCHMARK(raw_function_pointer);
+NWPROG_BENCHMARK_VS(inlined_lambda, raw_function_pointer);
+NWPROG_BENCHMARK_VS(fn_ref, raw_function_pointer);
+NWPROG_BENCHMARK_VS(std_function, raw_function_pointer);
+NWPROG_BENCHMARK_VS(inplace_function, raw_function_pointer);
+NWPROG_BENCHMARK(fn_ref_construct);
+NWPROG_BENCHMARK_VS(std_function_construct_large, fn_ref_construct);
+NWPROG_BENCHMARK_VS(fn_ref_construct_large, fn_ref_construct);
+NWPROG_BENCHMARK_VS(inplace_function_construct_large, fn_ref_construct);
+
+}  // namespace
+
+}  // namespace spinscale::nwprog::lib::bench
@@ -0,0 +1,272 @@
+#include "src/lib/benchmarks/harness.hh"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "src/lib/log.hh"
+
+namespace spinscale::nwprog::bench
+{
+
+namespace
+{
+
+struct Benchmark
+{
+  std::string name;
+  BenchmarkFn fn;
+  std::string baseline;
+};
+
+struct Measurement
+{
+  double ns_per_op;
+  /// Empty when the instruction counter is not accessible (e.g. perf_event_paranoid or inside a VM).
+  std::optional<double> instructions_per_op;
+};
+
+struct Settings
+{
+  std::string filter{};
+  double min_time{0.2};
+  uint32_t repetitions{5U};
+  bool csv{false};
+};
+
+std::vector<Benchmark>& registry()
+{
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+/// Counts user space instructions retired by this thread.
+class InstructionCounter
+{
+public:
+  InstructionCounter()
+  {
+    struct perf_event_attr attr
+    {
+    };
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+  }
+
+  ~InstructionCounter()
+  {
+    if (available())
+    {
+      close(fd_);
+    }
+  }
+
+  [[nodiscard]] bool available() const
+  {
+    return fd_ >= 0;
+  }
+
+  void start()
+  {
+    if (available())
+    {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  std::optional<uint64_t> stop()
+  {
+    if (!available())
+    {
+      return std::nullopt;
+    }
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t count = 0;
+    if (read(fd_, &count, sizeof(count)) != sizeof(count))
+    {
+      return std::nullopt;
+    }
+    return count;
+  }
+
+private:
+  int fd_{-1};
+};
+
+double seconds_for(const BenchmarkFn fn, const uint64_t iterations)
+{
+  const auto start = std::chrono::steady_clock::now();
+  fn(iterations);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Pick an iteration count that makes a single run last about `min_time`.
+uint64_t calibrate(const BenchmarkFn fn, const double min_time)
+{
+  uint64_t iterations = 1;
+  while (true)
+  {
+    const double seconds = seconds_for(fn, iterations);
+    if (seconds >= min_time / 10.0)
+    {
+      return std::max<uint64_t>(1U, static_cast<uint64_t>(iterations * (min_time / seconds)));
+    }
+    iterations *= 10;
+  }
+}
+
+double median(std::vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+Measurement measure(const Benchmark& benchmark, const Settings& settings, InstructionCounter& counter)
+{
+  const uint64_t iterations = calibrate(benchmark.fn, settings.min_time);
+  std::vector<double> ns_per_op;
+  std::vector<double> instructions_per_op;
+  for (uint32_t i = 0; i < settings.repetitions; ++i)
+  {
+    counter.start();
+    const double seconds = seconds_for(benchmark.fn, iterations);
+    const auto instructions = counter.stop();
+    ns_per_op.push_back(seconds * 1e9 / static_cast<double>(iterations));
+    if (instructions)
+    {
+      instructions_per_op.push_back(static_cast<double>(*instructions) / static_cast<double>(iterations));
+    }
+  }
+  return {
+    median(ns_per_op),
+    instructions_per_op.empty() ? std::nullopt : std::optional<double>(median(instructions_per_op))};
+}
+
+Settings parse_settings(const int argc, char* argv[])
+{
+  Settings settings;
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string_view arg = argv[i];
+    const auto value = arg.substr(std::min(arg.find('=') + 1, arg.size()));
+    if (arg.starts_with("--filter="))
+    {
+      settings.filter = value;
+    }
+    else if (arg.starts_with("--min-time="))
+    {
+      settings.min_time = std::stod(std::string(value));
+    }
+    else if (arg.starts_with("--repetitions="))
+    {
+      settings.repetitions = std::max(1, std::stoi(std::string(value)));
+    }
+    else if (arg == "--format=csv")
+    {
+      settings.csv = true;
+    }
+    else if (arg != "--format=text")
+    {
+      log::error(std::string("unknown argument: ").append(arg));
+      std::cerr << "Usage: [--filter=SUBSTRING] [--min-time=SECONDS] [--repetitions=N] [--format=text|csv]\n";
+      exit(1);
+    }
+  }
+  return settings;
+}
+
+}  // namespace
+
+bool register_benchmark(const std::string_view name, const BenchmarkFn fn, const std::string_view baseline)
+{
+  registry().push_back({std::string(name), fn, std::string(baseline)});
+  return true;
+}
+
+int run_benchmarks(const int argc, char* argv[])
+{
+  const Settings settings = parse_settings(argc, argv);
+  InstructionCounter counter;
+  if (!counter.available() && !settings.csv)
+  {
+    std::cout << "instruction counter unavailable, only reporting time.\n";
+  }
+
+  std::vector<std::pair<const Benchmark*, Measurement>> results;
+  const auto find_result = [&](const std::string& name) -> const Measurement*
+  {
+    for (const auto& [benchmark, measurement] : results)
+    {
+      if (benchmark->name == name)
+      {
+        return &measurement;
+      }
+    }
+    return nullptr;
+  };
+
+  if (settings.csv)
+  {
+    std::cout << "name,ns_per_op,instructions_per_op,baseline,ratio_to_baseline\n";
+  }
+  else
+  {
+    std::cout << std::left << std::setw(48) << "benchmark" << std::right << std::setw(12) << "ns/op" << std::setw(12)
+              << "instr/op" << "  vs baseline\n";
+  }
+
+  for (const auto& benchmark : registry())
+  {
+    if (benchmark.name.find(settings.filter) == std::string::npos)
+    {
+      continue;
+    }
+    const Measurement measurement = measure(benchmark, settings, counter);
+    results.emplace_back(&benchmark, measurement);
+
+    const Measurement* baseline = benchmark.baseline.empty() ? nullptr : find_result(benchmark.baseline);
+    const double ratio = baseline != nullptr ? measurement.ns_per_op / baseline->ns_per_op : 0.0;
+    std::cout << std::fixed << std::setprecision(2);
+    if (settings.csv)
+    {
+      std::cout << benchmark.name << ',' << measurement.ns_per_op << ','
+                << (measurement.instructions_per_op ? std::to_string(*measurement.instructions_per_op) : "") << ','
+                << benchmark.baseline << ',' << (baseline != nullptr ? std::to_string(ratio) : "") << '\n';
+      continue;
+    }
+    std::cout << std::left << std::setw(48) << benchmark.name << std::right << std::setw(12) << measurement.ns_per_op;
+    if (measurement.instructions_per_op)
+    {
+      std::cout << std::setw(12) << *measurement.instructions_per_op;
+    }
+    else
+    {
+      std::cout << std::setw(12) << "-";
+    }
+    if (baseline != nullptr)
+    {
+      std::cout << "  " << ratio << "x " << benchmark.baseline;
+    }
+    std::cout << '\n';
+  }
+  return 0;
+}
+
+}  // namespace spinscale::nwprog::bench
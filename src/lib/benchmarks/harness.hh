@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace spinscale::nwprog::bench
+{
+
+/// A benchmark body. Runs the measured operation `iterations` times.
+using BenchmarkFn = void (*)(uint64_t iterations);
+
+/// Register a benchmark. `baseline` names another benchmark the result is compared against, empty for none.
+/// Prefer the `NWPROG_BENCHMARK` macros over calling this directly.
+bool register_benchmark(std::string_view name, BenchmarkFn fn, std::string_view baseline = {});
+
+/// Keep the compiler from optimizing away the computation of `value`.
+template <class T>
+inline void do_not_optimize(const T& value)
+{
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// Like the const overload, and additionally makes the compiler forget what it knows about `value`. Use it to hide
+/// constants from constant propagation.
+template <class T>
+inline void do_not_optimize(T& value)
+{
+  asm volatile("" : "+m,r"(value) : : "memory");
+}
+
+/// Keep the compiler from assuming anything about memory across this point.
+inline void clobber_memory()
+{
+  asm volatile("" : : : "memory");
+}
+
+/// Run the registered benchmarks and print ns/op and, when the PMU is accessible, instructions/op.
+/// Understands `--filter=SUBSTRING`, `--min-time=SECONDS`, `--repetitions=N` and `--format=text|csv`.
+int run_benchmarks(int argc, char* argv[]);
+
+}  // namespace spinscale::nwprog::bench
+
+#define NWPROG_BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define NWPROG_BENCHMARK_CONCAT(a, b) NWPROG_BENCHMARK_CONCAT_IMPL(a, b)
+
+/// Register `fn` as a benchmark.
+#define NWPROG_BENCHMARK(fn)                                                               \
+  [[maybe_unused]] static const bool NWPROG_BENCHMARK_CONCAT(registered_, __LINE__) = \
+    ::spinscale::nwprog::bench::register_benchmark(#fn, fn)
+
+/// Register `fn` as a benchmark that is reported relative to the benchmark `baseline`.
+#define NWPROG_BENCHMARK_VS(fn, baseline)                                                  \
+  [[maybe_unused]] static const bool NWPROG_BENCHMARK_CONCAT(registered_, __LINE__) = \
+    ::spinscale::nwprog::bench::register_benchmark(#fn, fn, #baseline)
@@ -0,0 +1,6 @@
+#include "src/lib/benchmarks/harness.hh"
+
+int main(int argc, char* argv[])
+{
+  return spinscale::nwprog::bench::run_benchmarks(argc, argv);
+}
@@ -0,0 +1,192 @@
+#include <cerrno>
+#include <stdexcept>
+#include <version>
+
+#if __cpp_lib_expected >= 202202L
+#include <expected>
+#endif
+
+#include "src/lib/benchmarks/harness.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/result.hh"
+
+namespace spinscale::nwprog::lib::bench
+{
+
+using nwprog::bench::do_not_optimize;
+
+namespace
+{
+
+/// Every callee is out of line so the benchmarks measure returning the value through a real call, which is what
+/// crossing a module boundary looks like on the io paths.
+/// `fail_every` is the period of failures, zero never fails. It is hidden from the optimizer so the callees can not be
+/// specialized for it.
+
+[[gnu::noinline]] int error_code_fn(const uint64_t i, const uint64_t fail_every, int* out)
+{
+  if (fail_every != 0 && i % fail_every == 0)
+  {
+    return -EAGAIN;
+  }
+  *out = static_cast<int>(i);
+  return 0;
+}
+
+[[gnu::noinline]] Result<int, int> result_fn(const uint64_t i, const uint64_t fail_every)
+{
+  if (fail_every != 0 && i % fail_every == 0)
+  {
+    return Err(-EAGAIN);
+  }
+  return Ok(static_cast<int>(i));
+}
+
+[[gnu::noinline]] Result<int32_t, Errno> errno_result_fn(const uint64_t i, const uint64_t fail_every)
+{
+  if (fail_every != 0 && i % fail_every == 0)
+  {
+    return Err(Errno(EAGAIN));
+  }
+  return Ok(static_cast<int32_t>(i));
+}
+
+[[gnu::noinline]] int exception_fn(const uint64_t i, const uint64_t fail_every)
+{
+  if (fail_every != 0 && i % fail_every == 0)
+  {
+    throw std::runtime_error("EAGAIN");
+  }
+  return static_cast<int>(i);
+}
+
+#if __cpp_lib_expected >= 202202L
+[[gnu::noinline]] std::expected<int, int> expected_fn(const uint64_t i, const uint64_t fail_every)
+{
+  if (fail_every != 0 && i % fail_every == 0)
+  {
+    return std::unexpected(-EAGAIN);
+  }
+  return static_cast<int>(i);
+}
+#endif
+
+template <uint64_t fail_every>
+void error_code(const uint64_t iterations)
+{
+  uint64_t period = fail_every;
+  do_not_optimize(period);
+  int sum = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    int value = 0;
+    if (error_code_fn(i, period, &value) == 0)
+    {
+      sum += value;
+    }
+  }
+  do_not_optimize(sum);
+}
+
+template <uint64_t fail_every>
+void result(const uint64_t iterations)
+{
+  uint64_t period = fail_every;
+  do_not_optimize(period);
+  int sum = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    const auto res = result_fn(i, period);
+    if (res.is_ok())
+    {
+      sum += res.value();
+    }
+  }
+  do_not_optimize(sum);
+}
+
+template <uint64_t fail_every>
+void errno_result(const uint64_t iterations)
+{
+  uint64_t period = fail_every;
+  do_not_optimize(period);
+  int sum = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    const auto res = errno_result_fn(i, period);
+    if (res.is_ok())
+    {
+      sum += res.value();
+    }
+  }
+  do_not_optimize(sum);
+}
+
+template <uint64_t fail_every>
+void exception(const uint64_t iterations)
+{
+  uint64_t period = fail_every;
+  do_not_optimize(period);
+  int sum = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    try
+    {
+      sum += exception_fn(i, period);
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+  }
+  do_not_optimize(sum);
+}
+
+#if __cpp_lib_expected >= 202202L
+template <uint64_t fail_every>
+void expected(const uint64_t iterations)
+{
+  uint64_t period = fail_every;
+  do_not_optimize(period);
+  int sum = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    const auto res = expected_fn(i, period);
+    if (res.has_value())
+    {
+      sum += *res;
+    }
+  }
+  do_not_optimize(sum);
+}
+#endif
+
+// Success only.
+constexpr auto error_code_ok = error_code<0>;
+constexpr auto result_ok = result<0>;
+constexpr auto errno_result_ok = errno_result<0>;
+constexpr auto exception_ok = exception<0>;
+// Every other call fails, the branch is predictable.
+constexpr auto error_code_half_err = error_code<2>;
+constexpr auto result_half_err = result<2>;
+constexpr auto errno_result_half_err = errno_result<2>;
+constexpr auto exception_half_err = exception<2>;
+
+NWPROG_BENCHMARK(error_code_ok);
+NWPROG_BENCHMARK_VS(result_ok, error_code_ok);
+NWPROG_BENCHMARK_VS(errno_result_ok, error_code_ok);
+NWPROG_BENCHMARK_VS(exception_ok, error_code_ok);
+NWPROG_BENCHMARK(error_code_half_err);
+NWPROG_BENCHMARK_VS(result_half_err, error_code_half_err);
+NWPROG_BENCHMARK_VS(errno_result_half_err, error_code_half_err);
+NWPROG_BENCHMARK_VS(exception_half_err, error_code_half_err);
+
+#if __cpp_lib_expected >= 202202L
+constexpr auto expected_ok = expected<0>;
+constexpr auto expected_half_err = expected<2>;
+NWPROG_BENCHMARK_VS(expected_ok, error_code_ok);
+NWPROG_BENCHMARK_VS(expected_half_err, error_code_half_err);
+#endif
+
+}  // namespace
+
+}  // namespace spinscale::nwprog::lib::bench
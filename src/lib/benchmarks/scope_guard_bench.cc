@@ -0,0 +1,70 @@
+#include "src/lib/benchmarks/harness.hh"
+#include "src/lib/scope_guard.hh"
+
+namespace spinscale::nwprog::lib::bench
+{
+
+using nwprog::bench::do_not_optimize;
+
+namespace
+{
+
+/// Stands in for a resource release such as `close()`, out of line so it is not folded away.
+[[gnu::noinline]] void release(uint64_t& released)
+{
+  ++released;
+}
+
+/// Acquire, maybe bail out early, release on every path.
+[[gnu::noinline]] uint64_t hand_written_step(const uint64_t i, uint64_t& released)
+{
+  if (i % 4 == 0)
+  {
+    release(released);
+    return 0;
+  }
+  const uint64_t value = i * 3;
+  release(released);
+  return value;
+}
+
+[[gnu::noinline]] uint64_t scope_guard_step(const uint64_t i, uint64_t& released)
+{
+  ScopeGuard guard([&released]() { release(released); });
+  if (i % 4 == 0)
+  {
+    return 0;
+  }
+  return i * 3;
+}
+
+void hand_written_cleanup(const uint64_t iterations)
+{
+  uint64_t released = 0;
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    sum += hand_written_step(i, released);
+  }
+  do_not_optimize(sum);
+  do_not_optimize(released);
+}
+
+void scope_guard_cleanup(const uint64_t iterations)
+{
+  uint64_t released = 0;
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < iterations; ++i)
+  {
+    sum += scope_guard_step(i, released);
+  }
+  do_not_optimize(sum);
+  do_not_optimize(released);
+}
+
+NWPROG_BENCHMARK(hand_written_cleanup);
+NWPROG_BENCHMARK_VS(scope_guard_cleanup, hand_written_cleanup);
+
+}  // namespace
+
+}  // namespace spinscale::nwprog::lib::bench
@@ -0,0 +1,179 @@
+#include "src/lib/byte_ring.hh"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <utility>
+
+#include "src/lib/log.hh"
+
+namespace spinscale::nwprog::lib
+{
+
+namespace
+{
+
+/// Map a memfd of `capacity` bytes twice in a row. Returns nullptr on failure.
+char* map_mirrored(const size_t capacity)
+{
+  const int fd = memfd_create("byte_ring", MFD_CLOEXEC);
+  if (fd < 0)
+  {
+    return nullptr;
+  }
+  char* base = nullptr;
+  if (ftruncate(fd, static_cast<off_t>(capacity)) == 0)
+  {
+    // Reserve the whole range first so nothing else can end up between the two halves.
+    void* reserved = mmap(nullptr, 2U * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved != MAP_FAILED)
+    {
+      base = static_cast<char*>(reserved);
+      for (char* half : {base, base + capacity})
+      {
+        if (mmap(half, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+          munmap(base, 2U * capacity);
+          base = nullptr;
+          break;
+        }
+      }
+    }
+  }
+  // The mappings keep the memory alive.
+  close(fd);
+  return base;
+}
+
+}  // namespace
+
+ByteRing::ByteRing(const size_t capacity, const Mapping mapping)
+{
+  size_t size = std::bit_ceil(std::max<size_t>(capacity, 1U));
+  if (mapping == Mapping::mirrored)
+  {
+    size = std::max(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+    data_ = map_mirrored(size);
+    mirrored_ = data_ != nullptr;
+    if (!mirrored_)
+    {
+      log::warn("unable to mirror the byte ring, falling back to a single mapping.");
+    }
+  }
+  if (data_ == nullptr)
+  {
+    data_ = new char[size];
+  }
+  mask_ = size - 1U;
+}
+
+ByteRing::~ByteRing()
+{
+  release();
+}
+
+ByteRing::ByteRing(ByteRing&& other) noexcept
+  : data_(std::exchange(other.data_, nullptr))
+  , mask_(other.mask_)
+  , mirrored_(other.mirrored_)
+  , head_(other.head_)
+  , tail_(other.tail_)
+{
+}
+
+ByteRing& ByteRing::operator=(ByteRing&& other) noexcept
+{
+  if (this != &other)
+  {
+    release();
+    data_ = std::exchange(other.data_, nullptr);
+    mask_ = other.mask_;
+    mirrored_ = other.mirrored_;
+    head_ = other.head_;
+    tail_ = other.tail_;
+  }
+  return *this;
+}
+
+void ByteRing::release()
+{
+  if (data_ == nullptr)
+  {
+    return;
+  }
+  if (mirrored_)
+  {
+    munmap(data_, 2U * capacity());
+  }
+  else
+  {
+    delete[] data_;
+  }
+  data_ = nullptr;
+}
+
+uint32_t ByteRing::writable(struct iovec (&iovecs)[2]) const
+{
+  const size_t free_bytes = free_space();
+  if (free_bytes == 0)
+  {
+    return 0;
+  }
+  const size_t offset = tail_ & mask_;
+  const size_t first = mirrored_ ? free_bytes : std::min(free_bytes, capacity() - offset);
+  iovecs[0] = {data_ + offset, first};
+  if (first == free_bytes)
+  {
+    return 1;
+  }
+  iovecs[1] = {data_, free_bytes - first};
+  return 2;
+}
+
+uint32_t ByteRing::readable(struct iovec (&iovecs)[2], const size_t max_bytes) const
+{
+  const size_t filled_bytes = std::min(size(), max_bytes);
+  if (filled_bytes == 0)
+  {
+    return 0;
+  }
+  const size_t offset = head_ & mask_;
+  const size_t first = mirrored_ ? filled_bytes : std::min(filled_bytes, capacity() - offset);
+  iovecs[0] = {data_ + offset, first};
+  if (first == filled_bytes)
+  {
+    return 1;
+  }
+  iovecs[1] = {data_, filled_bytes - first};
+  return 2;
+}
+
+size_t ByteRing::append(const std::string_view data)
+{
+  struct iovec iovecs[2];
+  const uint32_t count = writable(iovecs);
+  size_t copied = 0;
+  for (uint32_t i = 0; i < count && copied < data.size(); ++i)
+  {
+    const size_t chunk = std::min(iovecs[i].iov_len, data.size() - copied);
+    std::memcpy(iovecs[i].iov_base, data.data() + copied, chunk);
+    copied += chunk;
+  }
+  commit(copied);
+  return copied;
+}
+
+std::string_view ByteRing::filled() const
+{
+  struct iovec iovecs[2];
+  if (readable(iovecs) == 0)
+  {
+    return {};
+  }
+  return {static_cast<const char*>(iovecs[0].iov_base), iovecs[0].iov_len};
+}
+
+}  // namespace spinscale::nwprog::lib
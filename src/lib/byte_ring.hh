@@ -0,0 +1,100 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace spinscale::nwprog::lib
+{
+
+/// Circular byte buffer for stream I/O with a power of two capacity.
+///
+/// Free and filled bytes are exposed as at most two `iovec`s each, so a single readv fills all the free space and a
+/// single writev flushes everything pending, and data never has to be moved to the front. With `Mapping::mirrored` the
+/// buffer is mapped twice back to back, so both regions are always a single contiguous iovec and `filled()` sees
+/// messages that wrap around without copying them.
+class ByteRing
+{
+public:
+  enum class Mapping : uint8_t
+  {
+    /// Plain heap allocation.
+    single,
+    /// A memfd mapped twice, the capacity is rounded up to a multiple of the page size. Falls back to `single` when
+    /// the mapping can not be set up.
+    mirrored,
+  };
+
+  /// `capacity` is rounded up to the next power of two.
+  explicit ByteRing(size_t capacity, Mapping mapping = Mapping::mirrored);
+  ~ByteRing();
+
+  ByteRing(ByteRing&& other) noexcept;
+  ByteRing& operator=(ByteRing&& other) noexcept;
+  ByteRing(const ByteRing&) = delete;
+  ByteRing& operator=(const ByteRing&) = delete;
+
+  /// Describe the free bytes in `iovecs`, returns the number of iovecs used, zero when full. Pass them to a readv and
+  /// `commit` what it read.
+  uint32_t writable(struct iovec (&iovecs)[2]) const;
+  /// Describe up to `max_bytes` of the filled bytes in `iovecs`, returns the number of iovecs used, zero when empty.
+  /// Pass them to a writev and `consume` what it wrote.
+  uint32_t readable(struct iovec (&iovecs)[2], size_t max_bytes = SIZE_MAX) const;
+
+  /// Mark `num_bytes` of the free space as filled.
+  void commit(const size_t num_bytes)
+  {
+    tail_ += num_bytes;
+  }
+
+  /// Drop `num_bytes` from the front.
+  void consume(const size_t num_bytes)
+  {
+    head_ += num_bytes;
+  }
+
+  /// Copy as much of `data` as fits to the back, returns the number of bytes copied.
+  size_t append(std::string_view data);
+
+  /// The filled bytes from the front up to the end of the buffer. That is all of them when mirrored.
+  [[nodiscard]] std::string_view filled() const;
+
+  [[nodiscard]] size_t size() const
+  {
+    return tail_ - head_;
+  }
+
+  [[nodiscard]] size_t free_space() const
+  {
+    return capacity() - size();
+  }
+
+  [[nodiscard]] bool empty() const
+  {
+    return head_ == tail_;
+  }
+
+  [[nodiscard]] size_t capacity() const
+  {
+    return mask_ + 1U;
+  }
+
+  [[nodiscard]] bool mirrored() const
+  {
+    return mirrored_;
+  }
+
+private:
+  void release();
+
+  char* data_{nullptr};
+  size_t mask_{0U};
+  bool mirrored_{false};
+  /// Positions only ever grow, the offset into the buffer is the position modulo the capacity.
+  uint64_t head_{0U};
+  uint64_t tail_{0U};
+};
+
+}  // namespace spinscale::nwprog::lib
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace spinscale::nwprog::lib
+{
+
+namespace detail
+{
+
+template <char... Needles>
+size_t find_first_of_scalar(const char* data, size_t offset, const size_t size)
+{
+  for (; offset < size; ++offset)
+  {
+    if (((data[offset] == Needles) || ...))
+    {
+      return offset;
+    }
+  }
+  return size;
+}
+
+#if defined(__x86_64__)
+
+/// Bytes of `chunk` equal to any of the needles are 0xff, the others 0.
+template <char First, char... Rest>
+__m128i equal_any(const __m128i chunk)
+{
+  __m128i matches = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(First));
+  ((matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(Rest)))), ...);
+  return matches;
+}
+
+/// SSE2 is part of x86-64, so this needs no check.
+template <char... Needles>
+size_t find_first_of_sse2(const char* data, const size_t size)
+{
+  size_t offset = 0;
+  for (; offset + 16U <= size; offset += 16U)
+  {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+    if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(equal_any<Needles...>(chunk))); mask != 0)
+    {
+      return offset + std::countr_zero(mask);
+    }
+  }
+  return find_first_of_scalar<Needles...>(data, offset, size);
+}
+
+template <char First, char... Rest>
+[[gnu::target("avx2")]] __m256i equal_any(const __m256i chunk)
+{
+  __m256i matches = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(First));
+  ((matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(Rest)))), ...);
+  return matches;
+}
+
+template <char... Needles>
+[[gnu::target("avx2")]] size_t find_first_of_avx2(const char* data, const size_t size)
+{
+  size_t offset = 0;
+  for (; offset + 32U <= size; offset += 32U)
+  {
+    const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + offset));
+    if (const auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(equal_any<Needles...>(chunk))); mask != 0)
+    {
+      return offset + std::countr_zero(mask);
+    }
+  }
+  if (offset + 16U <= size)
+  {
+    const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + offset));
+    if (const auto mask = static_cast<uint32_t>(_mm_movemask_epi8(equal_any<Needles...>(chunk))); mask != 0)
+    {
+      return offset + std::countr_zero(mask);
+    }
+    offset += 16U;
+  }
+  return find_first_of_scalar<Needles...>(data, offset, size);
+}
+
+inline bool cpu_has_avx2()
+{
+#if defined(__AVX2__)
+  return true;
+#else
+  static const bool has_avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+  return has_avx2;
+#endif
+}
+
+#endif
+
+}  // namespace detail
+
+/// Offset of the first byte of `data` that equals one of `Needles`, `data.size()` if there is none.
+///
+/// Compares 32 bytes at a time with AVX2 when the CPU has it, which is checked once at runtime so the default x86-64
+/// build benefits too, 16 bytes at a time with SSE2 otherwise. Inputs shorter than a vector and other architectures
+/// use a plain loop. Meant for a handful of needles, every one costs a compare per vector.
+template <char... Needles>
+  requires(sizeof...(Needles) > 0)
+size_t find_first_of(const std::string_view data)
+{
+#if defined(__x86_64__)
+  if (data.size() >= 16U)
+  {
+    return detail::cpu_has_avx2() ? detail::find_first_of_avx2<Needles...>(data.data(), data.size())
+                                  : detail::find_first_of_sse2<Needles...>(data.data(), data.size());
+  }
+#endif
+  return detail::find_first_of_scalar<Needles...>(data.data(), 0, data.size());
+}
+
+}  // namespace spinscale::nwprog::lib
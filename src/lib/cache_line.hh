@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+namespace spinscale::nwprog::lib
+{
+
+/// Size of a cache line on the targets we care about. Align data written by different threads to it to avoid false
+/// sharing. `std::hardware_destructive_interference_size` is not used because its value may differ between
+/// translation units compiled with different flags.
+inline constexpr size_t cache_line_size = 64U;
+
+}  // namespace spinscale::nwprog::lib
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+#include "src/lib/cache_line.hh"
+
+namespace spinscale::nwprog::lib
+{
+
+/// Bounded Chase-Lev work stealing deque.
+///
+/// The owner pushes and pops at the bottom without contention unless a single item is left, any other thread steals
+/// from the top. Follows "Correct and Efficient Work-Stealing for Weak Memory Models" (Lê et al.), with a fixed
+/// buffer instead of a growing one: `push` fails when the deque is full. Items are read speculatively by thieves so
+/// they must be small and trivially copyable, typically pointers.
+template <class T>
+  requires(std::is_trivially_copyable_v<T> && sizeof(T) <= sizeof(uint64_t))
+class ChaseLevDeque
+{
+public:
+  /// `capacity` is rounded up to the next power of two.
+  explicit ChaseLevDeque(const size_t capacity)
+    : mask_(static_cast<int64_t>(std::bit_ceil(std::max<size_t>(capacity, 2U))) - 1)
+    , buffer_(std::make_unique<std::atomic<T>[]>(static_cast<size_t>(mask_) + 1U))
+  {
+  }
+
+  /// Owner only. Returns false when the deque is full.
+  bool push(const T item)
+  {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const int64_t top = top_.load(std::memory_order_acquire);
+    if (bottom - top > mask_)
+    {
+      return false;
+    }
+    buffer_[bottom & mask_].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /// Owner only. Takes the most recently pushed item.
+  std::optional<T> pop()
+  {
+    const int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = top_.load(std::memory_order_relaxed);
+    if (top > bottom)
+    {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return std::nullopt;
+    }
+    const T item = buffer_[bottom & mask_].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+      // Last item, race the thieves for it.
+      const bool won =
+        top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return won ? std::optional<T>(item) : std::nullopt;
+    }
+    return item;
+  }
+
+  /// Any thread. Takes the oldest item. Also fails when losing a race against another thief or the owner.
+  std::optional<T> steal()
+  {
+    int64_t top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom)
+    {
+      return std::nullopt;
+    }
+    const T item = buffer_[top & mask_].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+    {
+      return std::nullopt;
+    }
+    return item;
+  }
+
+  /// Owner only. Upper bound of the number of items, thieves may have taken some since.
+  [[nodiscard]] size_t size() const
+  {
+    const int64_t size = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+    return size > 0 ? static_cast<size_t>(size) : 0U;
+  }
+
+  [[nodiscard]] size_t capacity() const
+  {
+    return static_cast<size_t>(mask_) + 1U;
+  }
+
+private:
+  const int64_t mask_;
+  const std::unique_ptr<std::atomic<T>[]> buffer_;
+  alignas(cache_line_size) std::atomic<int64_t> top_{0};
+  alignas(cache_line_size) std::atomic<int64_t> bottom_{0};
+};
+
+}  // namespace spinscale::nwprog::lib
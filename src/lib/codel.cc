@@ -0,0 +1,37 @@
+#include "src/lib/codel.hh"
+
+#include <algorithm>
+
+namespace spinscale::nwprog::lib
+{
+
+CoDel::CoDel(const uint64_t target_ns, const uint64_t interval_ns) : target_ns_(target_ns), interval_ns_(interval_ns)
+{
+}
+
+bool CoDel::should_shed(const uint64_t now_ns, const uint64_t delay_ns)
+{
+  if (now_ns >= interval_end_ns_)
+  {
+    overloaded_ = overloaded(now_ns);
+    min_delay_ns_ = delay_ns;
+    interval_end_ns_ = now_ns + interval_ns_;
+  }
+  else
+  {
+    min_delay_ns_ = std::min(min_delay_ns_, delay_ns);
+  }
+  return overloaded_ && delay_ns > 2U * target_ns_;
+}
+
+bool CoDel::overloaded(const uint64_t now_ns) const
+{
+  if (now_ns < interval_end_ns_)
+  {
+    return overloaded_;
+  }
+  // The interval ended and no item started the next one yet. Once that one is over too it went by empty.
+  return min_delay_ns_ > target_ns_ && now_ns < interval_end_ns_ + interval_ns_;
+}
+
+}  // namespace spinscale::nwprog::lib
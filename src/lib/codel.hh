@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+namespace spinscale::nwprog::lib
+{
+
+/// Overload detection after CoDel (Nichols and Jacobson, "Controlling Queue Delay") in the variant used for server
+/// request queues.
+///
+/// A burst makes the queue delay spike and then drain on its own, a standing queue never drains. So the queue counts
+/// as overloaded when even the lowest delay seen during a whole interval stayed above the target. While it is
+/// overloaded, items that waited longer than twice the target are shed, which keeps the delay of the rest bounded
+/// instead of letting every item wait longer the longer the spike lasts.
+class CoDel
+{
+public:
+  static constexpr uint64_t default_target_ns = 5'000'000U;
+  static constexpr uint64_t default_interval_ns = 100'000'000U;
+
+  explicit CoDel(uint64_t target_ns = default_target_ns, uint64_t interval_ns = default_interval_ns);
+
+  /// Report an item that leaves the queue at `now_ns` after waiting for `delay_ns`. Returns true if it should be shed.
+  bool should_shed(uint64_t now_ns, uint64_t delay_ns);
+
+  /// The verdict at `now_ns`, that of the last full interval. An interval without any item means the queue stayed
+  /// empty, so the overload ends then even if no item comes along to report it.
+  [[nodiscard]] bool overloaded(uint64_t now_ns) const;
+
+private:
+  const uint64_t target_ns_;
+  const uint64_t interval_ns_;
+  uint64_t interval_end_ns_{0};
+  /// Lowest delay of the current interval. Zero before the first one, so the queue starts out fine.
+  uint64_t min_delay_ns_{0};
+  bool overloaded_{false};
+};
+
+}  // namespace spinscale::nwprog::lib
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace spinscale::nwprog::lib
+{
+
+/// Small integer ids, connections or file descriptors, marked during one iteration of an event loop. Every id is
+/// listed once, in the order it was first marked.
+///
+/// Completion handlers stage output and mark its connection instead of writing right away. The loop drains the list
+/// right before it blocks again, so everything a connection got during the iteration leaves with a single write, no
+/// matter how many completions contributed to it.
+class DirtyList
+{
+public:
+  /// Returns false when `id` is already marked.
+  bool mark(const uint32_t id)
+  {
+    if (id >= marked_.size())
+    {
+      marked_.resize(id + 1U, false);
+    }
+    if (marked_[id])
+    {
+      return false;
+    }
+    marked_[id] = true;
+    ids_.push_back(id);
+    return true;
+  }
+
+  /// Call `fn(id)` for every marked id and unmark it. An id is unmarked before `fn` runs, ids marked by `fn` are
+  /// drained as well.
+  template <class Fn>
+  void drain(Fn&& fn)
+  {
+    for (size_t i = 0; i < ids_.size(); ++i)
+    {
+      const uint32_t id = ids_[i];
+      marked_[id] = false;
+      fn(id);
+    }
+    ids_.clear();
+  }
+
+  [[nodiscard]] bool empty() const
+  {
+    return ids_.empty();
+  }
+
+  [[nodiscard]] size_t size() const
+  {
+    return ids_.size();
+  }
+
+private:
+  std::vector<uint32_t> ids_{};
+  /// Indexed by id, grows with the largest id seen.
+  std::vector<bool> marked_{};
+};
+
+}  // namespace spinscale::nwprog::lib
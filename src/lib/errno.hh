@@ -0,0 +1,399 @@
+#pragma once
+
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+
+#include "src/lib/result.hh"
+
+namespace spinscale::nwprog::lib
+{
+
+namespace detail
+{
+
+/// Largest errno value, errors are encoded in the last page of the address space for pointers like the kernel's
+/// `ERR_PTR` does.
+inline constexpr uintptr_t max_errno = 4095U;
+
+}  // namespace detail
+
+/// A positive errno value.
+class Errno
+{
+public:
+  constexpr explicit Errno(const int32_t value) noexcept : value_(value)
+  {
+    // Zero is success and would read as `Ok` in a `Result`, negative values are return codes that were not negated.
+    assert(value > 0 && static_cast<uintptr_t>(value) <= detail::max_errno);
+  }
+
+  /// From a negative return value as produced by io_uring completions and raw syscalls.
+  static constexpr Errno from_negative(const int32_t result) noexcept
+  {
+    return Errno(-result);
+  }
+
+  /// From `errno` after a failed libc call.
+  static Errno last() noexcept
+  {
+    return Errno(errno);
+  }
+
+  [[nodiscard]] constexpr int32_t value() const noexcept
+  {
+    return value_;
+  }
+
+  [[nodiscard]] std::string_view message() const noexcept
+  {
+    return std::strerror(value_);
+  }
+
+  friend constexpr bool operator==(const Errno&, const Errno&) noexcept = default;
+
+  friend std::ostream& operator<<(std::ostream& out, const Errno& err)
+  {
+    return out << err.message() << " (" << err.value_ << ')';
+  }
+
+private:
+  int32_t value_;
+};
+
+namespace detail
+{
+
+/// Value types that share their storage with an `Errno` in a `Result` of at most 8 bytes.
+template <typename T>
+concept errno_packable = (std::is_integral_v<T> && sizeof(T) <= sizeof(int32_t)) || std::is_pointer_v<T>;
+
+/// Storage of a `Result<T, Errno>` for small integrals: the value next to the error, zero when there is none.
+template <typename T>
+struct ErrnoStorage
+{
+  static constexpr int32_t pending = -1;
+
+  constexpr bool is_pending() const noexcept
+  {
+    return error_ == pending;
+  }
+  constexpr bool is_ok() const noexcept
+  {
+    return error_ == 0;
+  }
+  constexpr bool is_error() const noexcept
+  {
+    return error_ > 0;
+  }
+  constexpr Errno error() const noexcept
+  {
+    return Errno(error_);
+  }
+  constexpr void set_pending() noexcept
+  {
+    value_ = T{};
+    error_ = pending;
+  }
+  constexpr void set_ok(const T value) noexcept
+  {
+    value_ = value;
+    error_ = 0;
+  }
+  constexpr void set_error(const Errno err) noexcept
+  {
+    value_ = T{};
+    error_ = err.value();
+  }
+
+  T value_{};
+  int32_t error_{pending};
+};
+
+/// Storage of a `Result<T*, Errno>`: errors live in the pointer itself, in the last page of the address space.
+template <typename T>
+  requires(std::is_pointer_v<T>)
+struct ErrnoStorage<T>
+{
+  static constexpr uintptr_t pending = -(max_errno + 1U);
+
+  uintptr_t bits() const noexcept
+  {
+    return reinterpret_cast<uintptr_t>(value_);
+  }
+  bool is_pending() const noexcept
+  {
+    return bits() == pending;
+  }
+  bool is_ok() const noexcept
+  {
+    return bits() < pending;
+  }
+  bool is_error() const noexcept
+  {
+    return bits() > pending;
+  }
+  Errno error() const noexcept
+  {
+    return Errno(static_cast<int32_t>(-bits()));
+  }
+  void set_pending() noexcept
+  {
+    value_ = reinterpret_cast<T>(pending);
+  }
+  void set_ok(const T value) noexcept
+  {
+    value_ = value;
+  }
+  void set_error(const Errno err) noexcept
+  {
+    value_ = reinterpret_cast<T>(-static_cast<uintptr_t>(err.value()));
+  }
+
+  T value_{reinterpret_cast<T>(pending)};
+};
+
+}  // namespace detail
+
+/// Compact `Result` for values that come with an errno on failure, which is what every syscall and io_uring
+/// completion produces.
+///
+/// Unlike the generic `Result` it is trivially copyable and at most 8 bytes, so it is returned in a register. Small
+/// integrals are stored next to the errno, pointers encode the errno in the last page of the address space. Moving
+/// from it does not leave the source `Pending`.
+///
+/// ```
+/// Result<int32_t, Errno> x = result_from_return_code(read(fd, buf, len));
+/// const auto bytes = x.value_or(0);
+/// ```
+template <typename T>
+  requires(detail::errno_packable<T>)
+class [[nodiscard]] Result<T, Errno> final
+{
+public:
+  using value_type = T;      // NOLINT(readability-identifier-naming)
+  using error_type = Errno;  // NOLINT(readability-identifier-naming)
+
+  /// Constructs a `Pending` result.
+  constexpr Result() noexcept
+  {
+    storage_.set_pending();
+  }
+  constexpr Result(Pending) noexcept : Result()
+  {
+  }
+
+  template <typename U>
+    requires(std::constructible_from<T, U>)
+  constexpr Result(const Ok<U>& ok) noexcept
+  {
+    storage_.set_ok(static_cast<T>(ok.value()));
+  }
+
+  template <typename U>
+    requires(std::same_as<U, Errno>)
+  constexpr Result(const Err<U>& err) noexcept
+  {
+    storage_.set_error(err.error());
+  }
+
+  ////////////////////////////////////////////////////////////////////////////
+  // Combinators
+  ////////////////////////////////////////////////////////////////////////////
+
+  /// Maps to `Result<U, Errno>` by applying `f` to the `Ok` value. Has no effect with `Pending` or `Err`.
+  template <typename F, typename U = std::invoke_result_t<F, T>>
+  constexpr Result<U, Errno> map(F&& f) const
+  {
+    if (is_ok())
+    {
+      return Ok(std::forward<F>(f)(storage_.value_));
+    }
+    if (is_error())
+    {
+      return Err(storage_.error());
+    }
+    return Pending{};
+  }
+
+  /// Applies `f` to the `Ok` value or `fallback` to the `Err` value.
+  template <typename M, typename F, typename U = std::invoke_result_t<F, T>>
+    requires(std::same_as<U, std::invoke_result_t<M, Errno>>)
+  constexpr U map_or_else(M&& fallback, F&& f) const
+  {
+    nonpending_required();
+    return is_ok() ? std::forward<F>(f)(storage_.value_) : std::forward<M>(fallback)(storage_.error());
+  }
+
+  /// Calls `f` with the `Ok` value, otherwise returns the `Err` of self.
+  template <typename F, typename U = std::invoke_result_t<F, T>>
+    requires(detail::is_result<U> && std::same_as<typename U::error_type, Errno>)
+  constexpr U and_then(F&& f) const
+  {
+    nonpending_required();
+    return is_ok() ? std::forward<F>(f)(storage_.value_) : static_cast<U>(Err(storage_.error()));
+  }
+
+  /// Calls `f` with the `Err` value, otherwise returns the `Ok` of self.
+  template <typename F, typename U = std::invoke_result_t<F, Errno>>
+    requires(detail::is_result<U> && std::same_as<typename U::value_type, T>)
+  constexpr U or_else(F&& f) const
+  {
+    nonpending_required();
+    return is_ok() ? static_cast<U>(Ok(storage_.value_)) : std::forward<F>(f)(storage_.error());
+  }
+
+  ///////////////////////////////////////////////////////////////////////////
+  // Utilities
+  ///////////////////////////////////////////////////////////////////////////
+
+  template <typename U>
+    requires(concepts::equality_comparable<T, U>)
+  constexpr bool contains(const U& x) const noexcept
+  {
+    return is_ok() && storage_.value_ == x;
+  }
+
+  constexpr bool contains_err(const Errno& x) const noexcept
+  {
+    return is_error() && storage_.error() == x;
+  }
+
+  /// The `Ok` value or `deft`.
+  template <typename U>
+  constexpr T value_or(U&& deft) const
+  {
+    return is_ok() ? storage_.value_ : static_cast<T>(std::forward<U>(deft));
+  }
+
+  /// The `Ok` value or `f` applied to the `Err` value.
+  template <typename F>
+    requires(std::same_as<std::invoke_result_t<F, Errno>, T>)
+  constexpr T value_or_else(F&& f) const
+  {
+    nonpending_required();
+    return is_ok() ? storage_.value_ : std::forward<F>(f)(storage_.error());
+  }
+
+  /// Resets to `Pending` state
+  constexpr void reset() noexcept
+  {
+    storage_.set_pending();
+  }
+
+  /// The `Ok` value. Terminates when not `Ok`.
+  constexpr const T& value() const
+  {
+    value_required();
+    return storage_.value_;
+  }
+
+  constexpr const T& expect(const char* s) const
+  {
+    value_required(s);
+    return storage_.value_;
+  }
+
+  /// The `Err` value. Terminates when not `Err`.
+  constexpr Errno error() const
+  {
+    error_required();
+    return storage_.error();
+  }
+
+  constexpr Errno expect_err(const char* s) const
+  {
+    error_required(s);
+    return storage_.error();
+  }
+
+  [[nodiscard]] constexpr bool is_pending() const noexcept
+  {
+    return storage_.is_pending();
+  }
+
+  [[nodiscard]] constexpr bool is_ok() const noexcept
+  {
+    return storage_.is_ok();
+  }
+
+  [[nodiscard]] constexpr bool is_error() const noexcept
+  {
+    return storage_.is_error();
+  }
+
+  /// Checks if the result is not `Pending`
+  constexpr explicit operator bool() const noexcept
+  {
+    return !is_pending();
+  }
+
+  constexpr const T& operator*() const
+  {
+    return value();
+  }
+
+private:
+  constexpr void nonpending_required() const
+  {
+    if (is_pending())
+    {
+      std::cerr << "in non pending required" << std::endl;
+      std::terminate();
+    }
+  }
+
+  constexpr void value_required() const
+  {
+    if (!is_ok())
+    {
+      std::cerr << "in value required" << std::endl;
+      std::terminate();
+    }
+  }
+
+  constexpr void value_required(const char* s) const
+  {
+    if (!is_ok())
+    {
+      std::cerr << s << ": " << storage_.error() << std::endl;
+      std::terminate();
+    }
+  }
+
+  constexpr void error_required() const
+  {
+    if (!is_error())
+    {
+      std::cerr << "in error required" << std::endl;
+      std::terminate();
+    }
+  }
+
+  constexpr void error_required(const char* s) const
+  {
+    if (!is_error())
+    {
+      std::cerr << s << std::endl;
+      std::terminate();
+    }
+  }
+
+  detail::ErrnoStorage<T> storage_;
+};
+
+/// Convert a syscall style return value, non negative on success and a negative errno on failure.
+constexpr Result<int32_t, Errno> result_from_return_code(const int32_t result) noexcept
+{
+  if (result < 0)
+  {
+    return Err(Errno::from_negative(result));
+  }
+  return Ok(result);
+}
+
+}  // namespace spinscale::nwprog::lib
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+#include "src/lib/errno.hh"
+
+namespace spinscale::nwprog::lib::framing
+{
+
+/// Every frame starts with its payload length as a 32 bit big endian integer.
+inline constexpr uint32_t header_size = 4U;
+/// Default upper bound of a payload, larger announced lengths are treated as a protocol error.
+inline constexpr uint32_t default_max_payload_size = 16U * 1024U * 1024U;
+
+inline void encode_header(const uint32_t payload_size, char* header)
+{
+  header[0] = static_cast<char>(payload_size >> 24U);
+  header[1] = static_cast<char>(payload_size >> 16U);
+  header[2] = static_cast<char>(payload_size >> 8U);
+  header[3] = static_cast<char>(payload_size);
+}
+
+inline uint32_t decode_header(const char* header)
+{
+  return (uint32_t{static_cast<uint8_t>(header[0])} << 24U) | (uint32_t{static_cast<uint8_t>(header[1])} << 16U) |
+         (uint32_t{static_cast<uint8_t>(header[2])} << 8U) | uint32_t{static_cast<uint8_t>(header[3])};
+}
+
+/// Call `fn(std::string_view payload)` for every complete frame at the front of `data`, in order. The payloads are
+/// views into `data`, nothing is copied. A frame that is cut off at the end is left alone so it can be completed by
+/// the next read.
+///
+/// Returns the number of bytes of all complete frames, which the caller may drop once done with the payloads, or
+/// EMSGSIZE when a header announces more than `max_payload_size`. Frames before the bad one were handled already.
+template <class F>
+Result<int32_t, Errno> for_each_frame(
+  std::string_view data, F&& fn, const uint32_t max_payload_size = default_max_payload_size)
+{
+  int32_t consumed = 0;
+  while (data.size() >= header_size)
+  {
+    const uint32_t payload_size = decode_header(data.data());
+    if (payload_size > max_payload_size)
+    {
+      return Err(Errno(EMSGSIZE));
+    }
+    if (data.size() - header_size < payload_size)
+    {
+      break;
+    }
+    fn(data.substr(header_size, payload_size));
+    data.remove_prefix(header_size + payload_size);
+    consumed += static_cast<int32_t>(header_size + payload_size);
+  }
+  return Ok(consumed);
+}
+
+}  // namespace spinscale::nwprog::lib::framing
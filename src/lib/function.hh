@@ -1,5 +1,11 @@
+#pragma once
+
 #include <concepts>
+#include <cstddef>
+#include <functional>
 #include <iostream>
+#include <new>
+#include <type_traits>
 #include <utility>
 
 namespace spinscale::nwprog::lib
@@ -17,19 +23,20 @@ struct FnBase
 
   /// Constructor from ref and const ref.
   template <class Callable>
-    requires(is_const, std::invocable<Callable, Args...>)
+    requires(is_const && std::is_invocable_r_v<R, const Callable&, Args...>)
   FnBase(const Callable& callable) : storage_(&callable)
   {
-    static constexpr auto invoke = [](Storage storage, Args... args)
-    { (*static_cast<const Callable*>(storage))(args...); };
+    static constexpr auto invoke = [](Storage storage, Args... args) -> R
+    { return std::invoke(*static_cast<const Callable*>(storage), std::forward<Args>(args)...); };
     invoke_ = invoke;
   };
 
   template <class Callable>
-    requires(!is_const, std::invocable<Callable, Args...>)
+    requires(!is_const && std::is_invocable_r_v<R, Callable&, Args...>)
   FnBase(Callable& callable) : storage_(&callable)
   {
-    static constexpr auto invoke = [](Storage storage, Args... args) { (*static_cast<Callable*>(storage))(args...); };
+    static constexpr auto invoke = [](Storage storage, Args... args) -> R
+    { return std::invoke(*static_cast<Callable*>(storage), std::forward<Args>(args)...); };
     invoke_ = invoke;
   };
 
@@ -63,10 +70,119 @@ public:
 template <class R, class... Args>
 class FnRef<R(Args...) const> final : public impl::FnBase</* is_const */ true, R, Args...>
 {
-  using Base = impl::FnBase<false, R, Args...>;
+  using Base = impl::FnBase<true, R, Args...>;
 
 public:
   using Base::Base;
 };
 
+/// An owning, move only function type which stores the callable in an inline buffer of `Capacity` bytes. There is no
+/// heap fallback, constructing it from a callable that does not fit fails to compile. Use it to keep callbacks alive
+/// past the call that created them, e.g. continuations of in flight operations, without allocating.
+template <class Sig, size_t Capacity = 32U>
+class InplaceFunction;
+
+template <class R, class... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> final
+{
+public:
+  /// Constructs an empty function.
+  InplaceFunction() noexcept = default;
+
+  InplaceFunction(std::nullptr_t) noexcept
+  {
+  }
+
+  /// Constructor from a callable, which is moved or copied into the inline buffer. Only participates when the
+  /// callable fits and can be relocated without throwing.
+  template <class Callable, class Stored = std::decay_t<Callable>>
+    requires(!std::same_as<Stored, InplaceFunction> && std::is_invocable_r_v<R, Stored&, Args...> &&
+             sizeof(Stored) <= Capacity && alignof(Stored) <= alignof(std::max_align_t) &&
+             std::is_nothrow_move_constructible_v<Stored>)
+  InplaceFunction(Callable&& callable) noexcept(std::is_nothrow_constructible_v<Stored, Callable&&>)
+  {
+    ::new (static_cast<void*>(buffer_)) Stored(std::forward<Callable>(callable));
+    ops_ = &ops_for<Stored>;
+  }
+
+  InplaceFunction(InplaceFunction&& other) noexcept
+  {
+    take(other);
+  }
+
+  InplaceFunction& operator=(InplaceFunction&& other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      take(other);
+    }
+    return *this;
+  }
+
+  InplaceFunction(const InplaceFunction&) = delete;
+  InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+  ~InplaceFunction()
+  {
+    reset();
+  }
+
+  /// Destroy the stored callable, leaving the function empty.
+  void reset() noexcept
+  {
+    if (ops_ != nullptr)
+    {
+      ops_->destroy(buffer_);
+      ops_ = nullptr;
+    }
+  }
+
+  /// Whether a callable is stored.
+  explicit operator bool() const noexcept
+  {
+    return ops_ != nullptr;
+  }
+
+  /// Invoke the function. Must not be empty.
+  R operator()(Args... args)
+  {
+    return ops_->invoke(buffer_, std::forward<Args>(args)...);
+  }
+
+private:
+  /// Type erased operations on the stored callable.
+  struct Ops
+  {
+    R (*invoke)(void* storage, Args... args);
+    /// Move construct into `to` and destroy the source.
+    void (*relocate)(void* from, void* to) noexcept;
+    void (*destroy)(void* storage) noexcept;
+  };
+
+  template <class Stored>
+  static constexpr Ops ops_for{
+    [](void* storage, Args... args) -> R
+    { return std::invoke(*static_cast<Stored*>(storage), std::forward<Args>(args)...); },
+    [](void* from, void* to) noexcept
+    {
+      ::new (to) Stored(std::move(*static_cast<Stored*>(from)));
+      static_cast<Stored*>(from)->~Stored();
+    },
+    [](void* storage) noexcept { static_cast<Stored*>(storage)->~Stored(); },
+  };
+
+  void take(InplaceFunction& other) noexcept
+  {
+    if (other.ops_ != nullptr)
+    {
+      other.ops_->relocate(other.buffer_, buffer_);
+      ops_ = std::exchange(other.ops_, nullptr);
+    }
+  }
+
+  alignas(std::max_align_t) std::byte buffer_[Capacity];
+  const Ops* ops_{nullptr};
+};
+
 }  // namespace spinscale::nwprog::lib
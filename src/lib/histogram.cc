@@ -0,0 +1,101 @@
+#include "src/lib/histogram.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <string>
+
+namespace spinscale::nwprog::lib
+{
+
+Histogram::Histogram() : counts_(bucket_count, 0U)
+{
+}
+
+void Histogram::merge(const Histogram& other)
+{
+  for (uint32_t i = 0; i < bucket_count; ++i)
+  {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  sum_ += other.sum_;
+  min_ = std::min(min_, other.min_);
+  max_ = std::max(max_, other.max_);
+}
+
+void Histogram::reset()
+{
+  std::fill(counts_.begin(), counts_.end(), 0U);
+  count_ = 0;
+  sum_ = 0;
+  min_ = std::numeric_limits<uint64_t>::max();
+  max_ = 0;
+}
+
+uint64_t Histogram::highest_equivalent_value(const uint32_t index)
+{
+  if (index < sub_bucket_count)
+  {
+    return index;
+  }
+  const uint32_t shift = index / sub_bucket_count - 1U;
+  const uint64_t mantissa = index % sub_bucket_count;
+  const uint64_t lowest = (sub_bucket_count + mantissa) << shift;
+  return lowest + ((uint64_t{1} << shift) - 1U);
+}
+
+uint64_t Histogram::percentile(const double percentile) const
+{
+  if (count_ == 0)
+  {
+    return 0;
+  }
+  const double clamped = std::clamp(percentile, 0.0, 100.0);
+  const auto target = std::max<uint64_t>(1U, static_cast<uint64_t>(std::ceil(clamped / 100.0 * count_)));
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < bucket_count; ++i)
+  {
+    seen += counts_[i];
+    if (seen >= target)
+    {
+      // Never report more than was actually recorded.
+      return std::min(highest_equivalent_value(i), max_);
+    }
+  }
+  return max_;
+}
+
+void Histogram::print(std::ostream& out, const double scale, const char* unit) const
+{
+  const auto flags = out.flags();
+  out << std::fixed << std::setprecision(2);
+  out << "  count: " << count_ << '\n';
+  out << "  min: " << min() / scale << unit << "  mean: " << mean() / scale << unit << "  max: " << max() / scale
+      << unit << '\n';
+  for (const double p : {50.0, 75.0, 90.0, 99.0, 99.9, 99.99})
+  {
+    out << "  p" << std::setprecision(p < 99.9 ? 0 : 2) << p << std::setprecision(2) << ": "
+        << percentile(p) / scale << unit << '\n';
+  }
+
+  // Coarse distribution, one line per power of two.
+  out << "  distribution:\n";
+  uint64_t bucket_sum = 0;
+  for (uint32_t i = 0; i < bucket_count; ++i)
+  {
+    bucket_sum += counts_[i];
+    const uint64_t upper = highest_equivalent_value(i);
+    const bool last_of_power = ((upper + 1U) & upper) == 0U;
+    if (last_of_power && bucket_sum > 0)
+    {
+      const double share = 100.0 * static_cast<double>(bucket_sum) / static_cast<double>(count_);
+      out << "    <= " << std::setw(12) << upper / scale << unit << ' ' << std::setw(12) << bucket_sum << ' '
+          << std::setw(6) << share << "% " << std::string(static_cast<size_t>(share / 2.0), '#') << '\n';
+      bucket_sum = 0;
+    }
+  }
+  out.flags(flags);
+}
+
+}  // namespace spinscale::nwprog::lib
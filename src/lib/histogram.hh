@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+namespace spinscale::nwprog::lib
+{
+
+/// A log linear histogram for latencies in the spirit of HdrHistogram.
+///
+/// Values below 2^sub_bucket_bits are recorded exactly. Every power of two above that is split into 2^sub_bucket_bits
+/// linear sub buckets, so the relative error of any reported value is below 1/64. Recording is a couple of
+/// instructions and never allocates which makes it fine to use on the measurement hot path.
+class Histogram
+{
+public:
+  static constexpr uint32_t sub_bucket_bits = 6U;
+  static constexpr uint32_t sub_bucket_count = 1U << sub_bucket_bits;
+  static constexpr uint32_t bucket_count = (64U - sub_bucket_bits + 1U) * sub_bucket_count;
+
+  Histogram();
+
+  /// Record a single value.
+  void record(const uint64_t value)
+  {
+    ++counts_[index_of(value)];
+    ++count_;
+    sum_ += value;
+    min_ = value < min_ ? value : min_;
+    max_ = value > max_ ? value : max_;
+  }
+
+  /// Add all values recorded by `other` to this histogram.
+  void merge(const Histogram& other);
+  /// Drop all recorded values.
+  void reset();
+
+  [[nodiscard]] uint64_t count() const
+  {
+    return count_;
+  }
+
+  [[nodiscard]] uint64_t min() const
+  {
+    return count_ == 0 ? 0 : min_;
+  }
+
+  [[nodiscard]] uint64_t max() const
+  {
+    return max_;
+  }
+
+  [[nodiscard]] double mean() const
+  {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / static_cast<double>(count_);
+  }
+
+  /// Value at or below which `percentile` percent of the recorded values fall. `percentile` is in [0, 100].
+  [[nodiscard]] uint64_t percentile(double percentile) const;
+
+  /// Print a percentile summary followed by a power of two bucketed distribution. Values are divided by `scale`
+  /// and suffixed with `unit` when printed.
+  void print(std::ostream& out, double scale = 1.0, const char* unit = "") const;
+
+  /// Index of the bucket holding `value`.
+  [[nodiscard]] static uint32_t index_of(const uint64_t value)
+  {
+    if (value < sub_bucket_count)
+    {
+      return static_cast<uint32_t>(value);
+    }
+    const uint32_t exponent = 63U - static_cast<uint32_t>(__builtin_clzll(value));
+    const uint32_t shift = exponent - sub_bucket_bits;
+    const auto mantissa = static_cast<uint32_t>(value >> shift) & (sub_bucket_count - 1U);
+    return (shift + 1U) * sub_bucket_count + mantissa;
+  }
+
+  /// Highest value that maps to the bucket at `index`.
+  [[nodiscard]] static uint64_t highest_equivalent_value(uint32_t index);
+
+private:
+  std::vector<uint64_t> counts_;
+  uint64_t count_{0};
+  uint64_t sum_{0};
+  uint64_t min_{std::numeric_limits<uint64_t>::max()};
+  uint64_t max_{0};
+};
+
+}  // namespace spinscale::nwprog::lib
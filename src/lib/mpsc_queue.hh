@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "src/lib/cache_line.hh"
+
+namespace spinscale::nwprog::lib
+{
+
+/// Bounded lock free queue for many producers and a single consumer.
+///
+/// Every slot carries a sequence number that tells producers and the consumer whose turn it is, so producers only
+/// contend on a single fetch position and never on the consumer's. Pushing fails instead of blocking when the queue
+/// is full. Based on Dmitry Vyukov's bounded MPMC queue, with the consumer side reduced to plain loads and stores.
+template <class T>
+  requires(std::is_nothrow_move_constructible_v<T>)
+class MpscQueue
+{
+public:
+  /// `capacity` is rounded up to the next power of two.
+  explicit MpscQueue(const size_t capacity)
+    : mask_(std::bit_ceil(std::max<size_t>(capacity, 2U)) - 1U), slots_(std::make_unique<Slot[]>(mask_ + 1U))
+  {
+    for (size_t i = 0; i <= mask_; ++i)
+    {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  ~MpscQueue()
+  {
+    while (try_pop())
+    {
+    }
+  }
+
+  /// Any thread. Returns false when the queue is full.
+  template <class... Args>
+  bool try_emplace(Args&&... args)
+  {
+    size_t position = enqueue_position_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    while (true)
+    {
+      slot = &slots_[position & mask_];
+      const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(sequence - position);
+      if (diff == 0)
+      {
+        if (enqueue_position_.compare_exchange_weak(position, position + 1U, std::memory_order_relaxed))
+        {
+          break;
+        }
+      }
+      else if (diff < 0)
+      {
+        // The consumer has not freed this slot yet.
+        return false;
+      }
+      else
+      {
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+    ::new (static_cast<void*>(slot->storage)) T(std::forward<Args>(args)...);
+    slot->sequence.store(position + 1U, std::memory_order_release);
+    return true;
+  }
+
+  bool try_push(T&& item)
+  {
+    return try_emplace(std::move(item));
+  }
+
+  /// Consumer only.
+  std::optional<T> try_pop()
+  {
+    Slot& slot = slots_[dequeue_position_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1U)
+    {
+      return std::nullopt;
+    }
+    std::optional<T> item(std::move(*slot.item()));
+    release(slot);
+    return item;
+  }
+
+  /// Consumer only. Hand up to `max_items` items to `fn` in FIFO order, returns how many were handled.
+  template <class F>
+  size_t drain(F&& fn, const size_t max_items)
+  {
+    size_t count = 0;
+    while (count < max_items)
+    {
+      Slot& slot = slots_[dequeue_position_ & mask_];
+      if (slot.sequence.load(std::memory_order_acquire) != dequeue_position_ + 1U)
+      {
+        break;
+      }
+      fn(std::move(*slot.item()));
+      release(slot);
+      ++count;
+    }
+    return count;
+  }
+
+  /// Consumer only. Items pushed concurrently may or may not be seen.
+  [[nodiscard]] bool empty() const
+  {
+    return slots_[dequeue_position_ & mask_].sequence.load(std::memory_order_acquire) != dequeue_position_ + 1U;
+  }
+
+  [[nodiscard]] size_t capacity() const
+  {
+    return mask_ + 1U;
+  }
+
+private:
+  struct Slot
+  {
+    T* item()
+    {
+      return std::launder(reinterpret_cast<T*>(storage));
+    }
+
+    std::atomic<size_t> sequence;
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+
+  void release(Slot& slot)
+  {
+    slot.item()->~T();
+    // Hand the slot to the producers of the next lap.
+    slot.sequence.store(dequeue_position_ + mask_ + 1U, std::memory_order_release);
+    ++dequeue_position_;
+  }
+
+  const size_t mask_;
+  const std::unique_ptr<Slot[]> slots_;
+  alignas(cache_line_size) std::atomic<size_t> enqueue_position_{0U};
+  alignas(cache_line_size) size_t dequeue_position_{0U};
+};
+
+}  // namespace spinscale::nwprog::lib
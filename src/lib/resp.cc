@@ -0,0 +1,223 @@
+#include "src/lib/resp.hh"
+
+#include <charconv>
+
+#include "src/lib/byte_scan.hh"
+
+namespace spinscale::nwprog::lib::resp
+{
+
+namespace
+{
+
+enum class Status : uint8_t
+{
+  complete,
+  incomplete,
+  malformed,
+};
+
+/// Read the CRLF terminated line at `position` and move past it.
+Status read_line(const std::string_view data, size_t& position, std::string_view& line)
+{
+  const std::string_view rest = data.substr(position);
+  const size_t end = lib::find_first_of<'\r'>(rest);
+  if (end + 1U >= rest.size())
+  {
+    return Status::incomplete;
+  }
+  if (rest[end + 1U] != '\n')
+  {
+    return Status::malformed;
+  }
+  line = rest.substr(0, end);
+  position += end + 2U;
+  return Status::complete;
+}
+
+/// Read a line of the form `<type><integer>` and move past it.
+Status read_number(const std::string_view data, size_t& position, const char type, int64_t& number)
+{
+  if (position >= data.size())
+  {
+    return Status::incomplete;
+  }
+  if (data[position] != type)
+  {
+    return Status::malformed;
+  }
+  size_t after_type = position + 1U;
+  std::string_view line;
+  if (const Status status = read_line(data, after_type, line); status != Status::complete)
+  {
+    return status;
+  }
+  const auto [end, ec] = std::from_chars(line.data(), line.data() + line.size(), number);
+  if (ec != std::errc{} || end != line.data() + line.size() || line.empty())
+  {
+    return Status::malformed;
+  }
+  position = after_type;
+  return Status::complete;
+}
+
+/// Move past the reply at `position`.
+Status skip_reply(const std::string_view data, size_t& position, const uint32_t depth)
+{
+  if (position >= data.size())
+  {
+    return Status::incomplete;
+  }
+  int64_t number = 0;
+  switch (data[position])
+  {
+    case '+':
+    case '-':
+    case ':':
+    {
+      ++position;
+      std::string_view line;
+      return read_line(data, position, line);
+    }
+    case '$':
+    {
+      if (const Status status = read_number(data, position, '$', number); status != Status::complete)
+      {
+        return status;
+      }
+      if (number < 0)
+      {
+        return Status::complete;
+      }
+      const size_t end = position + static_cast<size_t>(number) + 2U;
+      if (end > data.size())
+      {
+        return Status::incomplete;
+      }
+      position = end;
+      return Status::complete;
+    }
+    case '*':
+    {
+      if (depth == 0)
+      {
+        return Status::malformed;
+      }
+      if (const Status status = read_number(data, position, '*', number); status != Status::complete)
+      {
+        return status;
+      }
+      for (int64_t i = 0; i < number; ++i)
+      {
+        if (const Status status = skip_reply(data, position, depth - 1U); status != Status::complete)
+        {
+          return status;
+        }
+      }
+      return Status::complete;
+    }
+    default:
+      return Status::malformed;
+  }
+}
+
+size_t decimal_digits(size_t value)
+{
+  size_t digits = 1;
+  while (value >= 10U)
+  {
+    value /= 10U;
+    ++digits;
+  }
+  return digits;
+}
+
+}  // namespace
+
+lib::Result<int32_t, lib::Errno> parse_command(
+  const std::string_view data, std::vector<std::string_view>& args, const uint32_t max_command_size)
+{
+  const std::string_view window = data.substr(0, max_command_size);
+  const auto fail = [&](const Status status) -> lib::Result<int32_t, lib::Errno>
+  {
+    if (status == Status::malformed)
+    {
+      return lib::Err(lib::Errno(EBADMSG));
+    }
+    // A command that is not complete within the limit is too large.
+    if (data.size() >= max_command_size)
+    {
+      return lib::Err(lib::Errno(EMSGSIZE));
+    }
+    return lib::Ok(0);
+  };
+
+  size_t position = 0;
+  int64_t count = 0;
+  if (const Status status = read_number(window, position, '*', count); status != Status::complete)
+  {
+    return fail(status);
+  }
+  if (count < 1 || count > max_arguments)
+  {
+    return lib::Err(lib::Errno(EBADMSG));
+  }
+  args.clear();
+  for (int64_t i = 0; i < count; ++i)
+  {
+    int64_t size = 0;
+    if (const Status status = read_number(window, position, '$', size); status != Status::complete)
+    {
+      return fail(status);
+    }
+    if (size < 0)
+    {
+      return lib::Err(lib::Errno(EBADMSG));
+    }
+    if (static_cast<uint64_t>(size) + 2U > max_command_size)
+    {
+      return lib::Err(lib::Errno(EMSGSIZE));
+    }
+    const size_t end = position + static_cast<size_t>(size);
+    if (end + 2U > window.size())
+    {
+      return fail(Status::incomplete);
+    }
+    if (window[end] != '\r' || window[end + 1U] != '\n')
+    {
+      return lib::Err(lib::Errno(EBADMSG));
+    }
+    args.push_back(window.substr(position, static_cast<size_t>(size)));
+    position = end + 2U;
+  }
+  return lib::Ok(static_cast<int32_t>(position));
+}
+
+size_t bulk_size(const std::optional<std::string_view> value)
+{
+  if (!value)
+  {
+    return 5U;
+  }
+  // "$<digits>\r\n<value>\r\n"
+  return 1U + decimal_digits(value->size()) + 2U + value->size() + 2U;
+}
+
+lib::Result<int32_t, lib::Errno> reply_size(const std::string_view data)
+{
+  // Deep enough for everything the server sends, shallow enough to not blow the stack on garbage.
+  constexpr uint32_t max_depth = 8U;
+  size_t position = 0;
+  switch (skip_reply(data, position, max_depth))
+  {
+    case Status::complete:
+      return lib::Ok(static_cast<int32_t>(position));
+    case Status::incomplete:
+      return lib::Ok(0);
+    case Status::malformed:
+      break;
+  }
+  return lib::Err(lib::Errno(EBADMSG));
+}
+
+}  // namespace spinscale::nwprog::lib::resp
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "src/lib/errno.hh"
+
+namespace spinscale::nwprog::lib::resp
+{
+
+/// Upper bound of a command including all its arguments. Larger ones are rejected with EMSGSIZE.
+inline constexpr uint32_t default_max_command_size = 64U * 1024U;
+/// Upper bound of the number of arguments of a command.
+inline constexpr uint32_t max_arguments = 1024U;
+
+/// Parse the command at the front of `data`, an array of bulk strings as every Redis client sends them, which may be
+/// followed by more pipelined commands. The arguments are views into `data` and replace the contents of `args`.
+///
+/// Returns the size of the command, or zero when it is incomplete and more data is needed. Fails with EBADMSG for
+/// anything else, inline commands included, and with EMSGSIZE when the command does not fit into `max_command_size`.
+lib::Result<int32_t, lib::Errno> parse_command(
+  std::string_view data, std::vector<std::string_view>& args, uint32_t max_command_size = default_max_command_size);
+
+/// Replies. `Out` is anything with `append(std::string_view)`, e.g. a std::string or a lib::ByteRing with enough free
+/// space, see the `*_size` functions.
+template <class Out>
+void append_simple(Out& out, const std::string_view status)
+{
+  out.append("+");
+  out.append(status);
+  out.append("\r\n");
+}
+
+template <class Out>
+void append_error(Out& out, const std::string_view message)
+{
+  out.append("-ERR ");
+  out.append(message);
+  out.append("\r\n");
+}
+
+template <class Out>
+void append_integer(Out& out, const int64_t value)
+{
+  char digits[24];
+  const auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+  out.append(":");
+  out.append({digits, static_cast<size_t>(end - digits)});
+  out.append("\r\n");
+}
+
+template <class Out>
+void append_array_header(Out& out, const size_t size)
+{
+  char digits[24];
+  const auto end = std::to_chars(digits, digits + sizeof(digits), size).ptr;
+  out.append("*");
+  out.append({digits, static_cast<size_t>(end - digits)});
+  out.append("\r\n");
+}
+
+/// A bulk string, or the null bulk string for a missing value.
+template <class Out>
+void append_bulk(Out& out, const std::optional<std::string_view> value)
+{
+  if (!value)
+  {
+    out.append("$-1\r\n");
+    return;
+  }
+  char digits[24];
+  const auto end = std::to_chars(digits, digits + sizeof(digits), value->size()).ptr;
+  out.append("$");
+  out.append({digits, static_cast<size_t>(end - digits)});
+  out.append("\r\n");
+  out.append(*value);
+  out.append("\r\n");
+}
+
+/// Encoded size of `append_bulk(out, value)`.
+size_t bulk_size(std::optional<std::string_view> value);
+
+/// Size of the reply at the front of `data`, zero while it is incomplete. Understands the reply types the server
+/// sends, nested arrays included, and fails with EBADMSG for anything else.
+lib::Result<int32_t, lib::Errno> reply_size(std::string_view data);
+
+}  // namespace spinscale::nwprog::lib::resp
@@ -233,7 +233,7 @@ concept is_error = concepts::is_instantiation_of<T, Err>;
 /// details.
 template <typename T, typename E>
   requires(!std::is_reference_v<T>, !std::is_abstract_v<T>)
-class Result final
+class [[nodiscard]] Result final
 {
 
 public:
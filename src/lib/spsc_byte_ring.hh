@@ -0,0 +1,140 @@
+#pragma once
+
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "src/lib/cache_line.hh"
+
+namespace spinscale::nwprog::lib
+{
+
+/// Byte stream from a single producer to a single consumer, which may live in different processes.
+///
+/// The ring does not own any memory: both sides construct it over the same `Indices` and data, usually parts of one
+/// shared mapping. Each index is only written by its own side and sits on a cache line of its own, so the sides only
+/// exchange the line of the other side's index, and only when it moved. Neither side ever blocks, waiting for data or
+/// space is up to the user.
+///
+/// Each side trusts only its own index. A peer index that is more than `capacity` away from it can only come from a
+/// broken or hostile peer: the ring is `broken()` from then on and copies nothing, and the user closes it.
+class SpscByteRing
+{
+public:
+  /// Positions as running byte counts, they never wrap in practice.
+  struct Indices
+  {
+    /// Bytes written so far, only stored to by the producer.
+    alignas(cache_line_size) std::atomic<uint64_t> written{0U};
+    /// Bytes read so far, only stored to by the consumer.
+    alignas(cache_line_size) std::atomic<uint64_t> read{0U};
+  };
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "indices are shared between processes.");
+
+  /// `capacity` has to be a power of two.
+  SpscByteRing(Indices& indices, char* data, const size_t capacity)
+    : indices_(indices), data_(data), capacity_(capacity)
+  {
+  }
+
+  /// Producer only. Copy as much of `iovecs` as fits, returns the number of bytes copied.
+  size_t write(const struct iovec* iovecs, const uint32_t count)
+  {
+    const uint64_t written = indices_.written.load(std::memory_order_relaxed);
+    const size_t free = capacity_ - checked_size(written, indices_.read.load(std::memory_order_acquire));
+    size_t copied = 0;
+    for (uint32_t i = 0; i < count && copied < free; ++i)
+    {
+      const size_t size = std::min(iovecs[i].iov_len, free - copied);
+      copy_in(written + copied, static_cast<const char*>(iovecs[i].iov_base), size);
+      copied += size;
+    }
+    indices_.written.store(written + copied, std::memory_order_release);
+    return copied;
+  }
+
+  /// Consumer only. Copy as many bytes as are there and fit into `iovecs`, returns the number of bytes copied.
+  size_t read(const struct iovec* iovecs, const uint32_t count)
+  {
+    const uint64_t read = indices_.read.load(std::memory_order_relaxed);
+    const size_t stored = checked_size(indices_.written.load(std::memory_order_acquire), read);
+    const size_t available = broken_ ? 0U : stored;
+    size_t copied = 0;
+    for (uint32_t i = 0; i < count && copied < available; ++i)
+    {
+      const size_t size = std::min(iovecs[i].iov_len, available - copied);
+      copy_out(read + copied, static_cast<char*>(iovecs[i].iov_base), size);
+      copied += size;
+    }
+    indices_.read.store(read + copied, std::memory_order_release);
+    return copied;
+  }
+
+  /// Bytes the consumer may read. Exact on the consumer side, a lower bound on the producer side. Never more than
+  /// `capacity`, even when the ring is broken.
+  [[nodiscard]] size_t size() const
+  {
+    return std::min(distance(), capacity_);
+  }
+
+  /// Bytes the producer may write. Exact on the producer side, a lower bound on the consumer side.
+  [[nodiscard]] size_t free_space() const
+  {
+    return capacity_ - size();
+  }
+
+  [[nodiscard]] size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  /// Whether the peer ever moved its index out of range. `write` and `read` copy nothing once it did.
+  [[nodiscard]] bool broken() const
+  {
+    return broken_ || distance() > capacity_;
+  }
+
+private:
+  [[nodiscard]] uint64_t distance() const
+  {
+    return indices_.written.load(std::memory_order_acquire) - indices_.read.load(std::memory_order_acquire);
+  }
+
+  /// Bytes between the indices, `capacity` when they are out of range, which also marks the ring as broken.
+  size_t checked_size(const uint64_t written, const uint64_t read)
+  {
+    if (written - read > capacity_)
+    {
+      broken_ = true;
+    }
+    return broken_ ? capacity_ : written - read;
+  }
+
+  void copy_in(const uint64_t position, const char* data, const size_t size)
+  {
+    const size_t offset = position & (capacity_ - 1U);
+    const size_t first = std::min(size, capacity_ - offset);
+    std::memcpy(data_ + offset, data, first);
+    std::memcpy(data_, data + first, size - first);
+  }
+
+  void copy_out(const uint64_t position, char* data, const size_t size) const
+  {
+    const size_t offset = position & (capacity_ - 1U);
+    const size_t first = std::min(size, capacity_ - offset);
+    std::memcpy(data, data_ + offset, first);
+    std::memcpy(data + first, data_, size - first);
+  }
+
+  Indices& indices_;
+  char* const data_;
+  const size_t capacity_;
+  bool broken_{false};
+};
+
+}  // namespace spinscale::nwprog::lib
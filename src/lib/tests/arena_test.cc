@@ -0,0 +1,69 @@
+#include "src/lib/arena.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstring>
+#include <vector>
+
+namespace spinscale::nwprog::lib::test
+{
+
+SCENARIO("arena allocation")
+{
+  GIVEN("an arena with small chunks")
+  {
+    Arena arena(4096);
+
+    THEN("sizes are rounded up to a power of two.")
+    {
+      REQUIRE(Arena::block_size(1) == Arena::min_block_size);
+      REQUIRE(Arena::block_size(16) == 16);
+      REQUIRE(Arena::block_size(17) == 32);
+      REQUIRE(Arena::block_size(1000) == 1024);
+    }
+
+    WHEN("blocks are allocated.")
+    {
+      std::vector<char*> blocks;
+      for (size_t i = 1; i <= 100; ++i)
+      {
+        char* block = arena.allocate(i);
+        std::memset(block, static_cast<int>(i), i);
+        blocks.push_back(block);
+      }
+      THEN("they are aligned and do not overlap.")
+      {
+        for (size_t i = 1; i <= 100; ++i)
+        {
+          REQUIRE(reinterpret_cast<uintptr_t>(blocks[i - 1]) % Arena::min_block_size == 0);
+          for (size_t j = 0; j < i; ++j)
+          {
+            REQUIRE(blocks[i - 1][j] == static_cast<char>(i));
+          }
+        }
+        REQUIRE(arena.allocated_bytes() <= arena.reserved_bytes());
+      }
+
+      THEN("freed blocks are reused for the same size class.")
+      {
+        char* freed = blocks[40];
+        arena.deallocate(freed, 41);
+        REQUIRE(arena.allocate(64) == freed);
+      }
+    }
+
+    WHEN("a block larger than a chunk is allocated.")
+    {
+      char* large = arena.allocate(10000);
+      std::memset(large, 'x', 10000);
+      THEN("it gets a chunk of its own and is reused after being freed.")
+      {
+        REQUIRE(arena.reserved_bytes() == 16384);
+        arena.deallocate(large, 10000);
+        REQUIRE(arena.allocated_bytes() == 0);
+        REQUIRE(arena.allocate(9000) == large);
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,107 @@
+#include "src/lib/byte_ring.hh"
+
+#include <catch2/catch_all.hpp>
+#include <cstring>
+#include <string>
+
+namespace spinscale::nwprog::lib::test
+{
+
+SCENARIO("byte ring with a single mapping")
+{
+  GIVEN("a ring with a capacity that is not a power of two")
+  {
+    ByteRing ring(12, ByteRing::Mapping::single);
+    struct iovec iovecs[2];
+    THEN("the capacity is rounded up and all of it is writable.")
+    {
+      REQUIRE(ring.capacity() == 16);
+      REQUIRE(!ring.mirrored());
+      REQUIRE(ring.empty());
+      REQUIRE(ring.writable(iovecs) == 1);
+      REQUIRE(iovecs[0].iov_len == 16);
+      REQUIRE(ring.readable(iovecs) == 0);
+    }
+
+    WHEN("data wraps around the end.")
+    {
+      REQUIRE(ring.append("0123456789") == 10);
+      ring.consume(8);
+      REQUIRE(ring.append("abcdefghijklmnop") == 14);
+      THEN("it is full and the filled bytes come in two pieces.")
+      {
+        REQUIRE(ring.free_space() == 0);
+        REQUIRE(ring.writable(iovecs) == 0);
+        REQUIRE(ring.readable(iovecs) == 2);
+        const std::string first(static_cast<const char*>(iovecs[0].iov_base), iovecs[0].iov_len);
+        const std::string second(static_cast<const char*>(iovecs[1].iov_base), iovecs[1].iov_len);
+        REQUIRE(first + second == "89abcdefghijklmn");
+        REQUIRE(ring.filled() == first);
+      }
+
+      THEN("the filled bytes can be limited.")
+      {
+        REQUIRE(ring.readable(iovecs, 5) == 1);
+        REQUIRE(iovecs[0].iov_len == 5);
+        REQUIRE(ring.readable(iovecs, 10) == 2);
+        REQUIRE(iovecs[0].iov_len + iovecs[1].iov_len == 10);
+      }
+
+      THEN("the free bytes come in two pieces once the front is consumed.")
+      {
+        ring.consume(4);
+        REQUIRE(ring.writable(iovecs) == 1);
+        REQUIRE(iovecs[0].iov_len == 4);
+        ring.consume(8);
+        REQUIRE(ring.writable(iovecs) == 2);
+        REQUIRE(iovecs[0].iov_len + iovecs[1].iov_len == 12);
+      }
+    }
+  }
+}
+
+SCENARIO("byte ring with a mirrored mapping")
+{
+  GIVEN("a mirrored ring")
+  {
+    ByteRing ring(100, ByteRing::Mapping::mirrored);
+    struct iovec iovecs[2];
+    REQUIRE(ring.mirrored());
+    REQUIRE(ring.capacity() >= 4096);
+
+    WHEN("data wraps around the end.")
+    {
+      const std::string filler(ring.capacity() - 3, 'x');
+      REQUIRE(ring.append(filler) == filler.size());
+      ring.consume(filler.size());
+      REQUIRE(ring.append("hello world") == 11);
+      THEN("it is still a single contiguous region.")
+      {
+        REQUIRE(ring.readable(iovecs) == 1);
+        REQUIRE(ring.filled() == "hello world");
+        REQUIRE(ring.writable(iovecs) == 1);
+        REQUIRE(iovecs[0].iov_len == ring.capacity() - 11);
+      }
+
+      THEN("both halves show the same bytes.")
+      {
+        const char* front = ring.filled().data();
+        std::memcpy(const_cast<char*>(front), "H", 1);
+        REQUIRE(ring.filled() == "Hello world");
+      }
+    }
+
+    WHEN("it is moved.")
+    {
+      ring.append("abc");
+      ByteRing moved(std::move(ring));
+      THEN("the contents move along.")
+      {
+        REQUIRE(moved.filled() == "abc");
+        REQUIRE(moved.mirrored());
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,51 @@
+#include "src/lib/byte_scan.hh"
+
+#include <catch2/catch_all.hpp>
+#include <string>
+
+namespace spinscale::nwprog::lib::test
+{
+
+SCENARIO("finding the first of a set of bytes")
+{
+  GIVEN("inputs of every length up to a few vectors")
+  {
+    THEN("a needle is found at every position, even at the unaligned tail.")
+    {
+      for (size_t size = 1; size <= 100; ++size)
+      {
+        for (size_t position = 0; position < size; ++position)
+        {
+          std::string data(size, 'a');
+          data[position] = ':';
+          REQUIRE(find_first_of<'\r', ':'>(data) == position);
+#if defined(__x86_64__)
+          // The public function picks AVX2 when it is available, the fallback must work as well.
+          REQUIRE(detail::find_first_of_sse2<'\r', ':'>(data.data(), data.size()) == position);
+#endif
+        }
+      }
+    }
+
+    THEN("the size is returned when there is no needle.")
+    {
+      for (size_t size = 0; size <= 100; ++size)
+      {
+        REQUIRE(find_first_of<'\r', '\n'>(std::string(size, 'a')) == size);
+      }
+    }
+  }
+
+  GIVEN("a request with several needles")
+  {
+    const std::string data = "GET /a/long/enough/path/to/span/two/vectors HTTP/1.1\r\nHost: x\r\n\r\n";
+    THEN("the earliest one wins regardless of the order of the needles.")
+    {
+      REQUIRE(find_first_of<'\n', '\r'>(data) == data.find('\r'));
+      REQUIRE(find_first_of<'\r', ' '>(data) == 3);
+      REQUIRE(find_first_of<':'>(std::string_view(data).substr(4)) == data.find(':') - 4);
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,110 @@
+#include "src/lib/chase_lev_deque.hh"
+
+#include <atomic>
+#include <catch2/catch_all.hpp>
+#include <thread>
+#include <vector>
+
+namespace spinscale::nwprog::lib::test
+{
+
+SCENARIO("chase lev deque on a single thread")
+{
+  GIVEN("a deque with a few items")
+  {
+    ChaseLevDeque<uint32_t> deque(4);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+      REQUIRE(deque.push(i));
+    }
+    THEN("it is full.")
+    {
+      REQUIRE(deque.size() == 4);
+      REQUIRE(!deque.push(4));
+    }
+
+    THEN("the owner pops the newest and thieves steal the oldest.")
+    {
+      REQUIRE(deque.pop() == 3U);
+      REQUIRE(deque.steal() == 0U);
+      REQUIRE(deque.steal() == 1U);
+      REQUIRE(deque.pop() == 2U);
+      REQUIRE(!deque.pop().has_value());
+      REQUIRE(!deque.steal().has_value());
+    }
+  }
+}
+
+SCENARIO("chase lev deque with concurrent thieves")
+{
+  GIVEN("an owner pushing and popping while thieves steal")
+  {
+    constexpr uint32_t num_items = 200000;
+    constexpr uint32_t num_thieves = 3;
+    ChaseLevDeque<uint32_t> deque(256);
+    std::vector<std::atomic<uint32_t>> taken(num_items);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> thieves;
+    for (uint32_t i = 0; i < num_thieves; ++i)
+    {
+      thieves.emplace_back(
+        [&]()
+        {
+          while (!done.load())
+          {
+            if (const auto item = deque.steal())
+            {
+              taken[*item].fetch_add(1);
+            }
+            else
+            {
+              std::this_thread::yield();
+            }
+          }
+        });
+    }
+
+    WHEN("every item was taken by someone.")
+    {
+      for (uint32_t i = 0; i < num_items; ++i)
+      {
+        while (!deque.push(i))
+        {
+          if (const auto item = deque.pop())
+          {
+            taken[*item].fetch_add(1);
+          }
+        }
+        if (i % 3 == 0)
+        {
+          if (const auto item = deque.pop())
+          {
+            taken[*item].fetch_add(1);
+          }
+        }
+      }
+      while (const auto item = deque.pop())
+      {
+        taken[*item].fetch_add(1);
+      }
+      done.store(true);
+      for (auto& thief : thieves)
+      {
+        thief.join();
+      }
+
+      THEN("no item was lost or taken twice.")
+      {
+        bool exactly_once = true;
+        for (const auto& count : taken)
+        {
+          exactly_once = exactly_once && count.load() == 1;
+        }
+        REQUIRE(exactly_once);
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
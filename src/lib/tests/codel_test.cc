@@ -0,0 +1,90 @@
+#include "src/lib/codel.hh"
+
+#include <catch2/catch_all.hpp>
+
+namespace spinscale::nwprog::lib::test
+{
+
+namespace
+{
+
+constexpr uint64_t target = 5U;
+constexpr uint64_t interval = 100U;
+
+/// Feed one item per time unit with the given delay, returns how many were shed.
+uint32_t feed(CoDel& codel, uint64_t& now, const uint64_t duration, const uint64_t delay)
+{
+  uint32_t shed = 0;
+  for (const uint64_t end = now + duration; now < end; ++now)
+  {
+    shed += codel.should_shed(now, delay) ? 1U : 0U;
+  }
+  return shed;
+}
+
+}  // namespace
+
+SCENARIO("detecting overload from queue delays")
+{
+  GIVEN("a queue with a 5 unit target and a 100 unit interval")
+  {
+    CoDel codel(target, interval);
+    uint64_t now = 0;
+
+    THEN("short delays are never shed.")
+    {
+      REQUIRE(feed(codel, now, 10U * interval, target) == 0U);
+      REQUIRE_FALSE(codel.overloaded(now));
+    }
+
+    WHEN("a burst raises the delay for part of an interval")
+    {
+      feed(codel, now, interval, 1U);
+      feed(codel, now, interval / 2U, 50U);
+      const uint32_t shed = feed(codel, now, interval / 2U, 1U);
+
+      THEN("nothing is shed because the queue drained within the interval.")
+      {
+        REQUIRE(shed == 0U);
+        REQUIRE(feed(codel, now, interval, 50U) == 0U);
+      }
+    }
+
+    WHEN("the delay stays above the target for a whole interval")
+    {
+      feed(codel, now, interval, 1U);
+      feed(codel, now, interval, 6U);
+
+      THEN("the queue is overloaded and only items above twice the target are shed.")
+      {
+        REQUIRE(feed(codel, now, 1U, 6U) == 0U);
+        REQUIRE(codel.overloaded(now));
+        REQUIRE(feed(codel, now, 10U, 11U) == 10U);
+        REQUIRE(feed(codel, now, 10U, 10U) == 0U);
+      }
+
+      THEN("an interval with a short delay ends the overload.")
+      {
+        feed(codel, now, interval, 1U);
+        REQUIRE_FALSE(codel.overloaded(now));
+        REQUIRE(feed(codel, now, interval, 50U) == 0U);
+      }
+    }
+
+    WHEN("the queue is overloaded, then idle past the interval")
+    {
+      feed(codel, now, interval, 1U);
+      feed(codel, now, 2U * interval, 50U);
+      REQUIRE(codel.overloaded(now));
+      now += 2U * interval;
+
+      THEN("it is no longer overloaded and the next items are not shed.")
+      {
+        REQUIRE_FALSE(codel.overloaded(now));
+        REQUIRE(feed(codel, now, 10U, 50U) == 0U);
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
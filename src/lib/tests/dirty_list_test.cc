@@ -0,0 +1,58 @@
+#include "src/lib/dirty_list.hh"
+
+#include <catch2/catch_all.hpp>
+#include <vector>
+
+namespace spinscale::nwprog::lib::test
+{
+
+SCENARIO("marking ids during a loop iteration")
+{
+  GIVEN("a list with ids marked several times")
+  {
+    DirtyList list;
+    REQUIRE(list.mark(7U));
+    REQUIRE(list.mark(2U));
+    REQUIRE_FALSE(list.mark(7U));
+    REQUIRE(list.mark(1000U));
+    REQUIRE_FALSE(list.mark(2U));
+
+    THEN("every id is drained once in the order it was first marked.")
+    {
+      std::vector<uint32_t> drained;
+      list.drain([&](const uint32_t id) { drained.push_back(id); });
+      REQUIRE(drained == std::vector<uint32_t>{7U, 2U, 1000U});
+      REQUIRE(list.empty());
+    }
+
+    THEN("drained ids can be marked again.")
+    {
+      list.drain([](uint32_t) {});
+      REQUIRE(list.mark(7U));
+      REQUIRE(list.size() == 1U);
+    }
+
+    WHEN("the callback marks ids")
+    {
+      std::vector<uint32_t> drained;
+      list.drain(
+        [&](const uint32_t id)
+        {
+          drained.push_back(id);
+          if (id == 7U)
+          {
+            list.mark(3U);
+            list.mark(2U);
+          }
+        });
+
+      THEN("new ones are drained in the same pass, pending ones are not repeated.")
+      {
+        REQUIRE(drained == std::vector<uint32_t>{7U, 2U, 1000U, 3U});
+        REQUIRE(list.empty());
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
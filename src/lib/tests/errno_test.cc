@@ -0,0 +1,135 @@
+#include "src/lib/errno.hh"
+
+#include <catch2/catch_all.hpp>
+#include <type_traits>
+
+namespace spinscale::nwprog::lib::test
+{
+
+using IntResult = Result<int32_t, Errno>;
+using PtrResult = Result<int*, Errno>;
+
+static_assert(sizeof(IntResult) <= 8 && std::is_trivially_copyable_v<IntResult>);
+static_assert(sizeof(PtrResult) == sizeof(void*) && std::is_trivially_copyable_v<PtrResult>);
+static_assert(sizeof(Result<uint16_t, Errno>) <= 8);
+
+SCENARIO("compact errno results")
+{
+  GIVEN("syscall style return values.")
+  {
+    WHEN("the value is non negative.")
+    {
+      const auto result = result_from_return_code(42);
+      THEN("it is ok.")
+      {
+        REQUIRE(result.is_ok());
+        REQUIRE(result.value() == 42);
+        REQUIRE(result.value_or(0) == 42);
+      }
+    }
+
+    WHEN("the value is negative.")
+    {
+      const auto result = result_from_return_code(-EAGAIN);
+      THEN("it carries the errno.")
+      {
+        REQUIRE(result.is_error());
+        REQUIRE(result.error() == Errno(EAGAIN));
+        REQUIRE(result.contains_err(Errno(EAGAIN)));
+        REQUIRE(result.value_or(-1) == -1);
+      }
+    }
+
+    WHEN("it is default constructed.")
+    {
+      const IntResult result;
+      THEN("it is pending.")
+      {
+        REQUIRE(result.is_pending());
+        REQUIRE(!result);
+      }
+    }
+  }
+
+  GIVEN("the combinators.")
+  {
+    const auto ok = result_from_return_code(2);
+    const auto err = result_from_return_code(-EINTR);
+    const auto twice = [](int32_t value) { return value * 2; };
+    const auto half = [](int32_t value) -> IntResult
+    {
+      if (value % 2 != 0)
+      {
+        return Err(Errno(EINVAL));
+      }
+      return Ok(value / 2);
+    };
+
+    THEN("map only touches ok values.")
+    {
+      REQUIRE(ok.map(twice).contains(4));
+      REQUIRE(err.map(twice).contains_err(Errno(EINTR)));
+    }
+
+    THEN("and_then chains and short circuits.")
+    {
+      REQUIRE(ok.and_then(half).contains(1));
+      REQUIRE(ok.and_then(half).and_then(half).contains_err(Errno(EINVAL)));
+      REQUIRE(err.and_then(half).contains_err(Errno(EINTR)));
+    }
+
+    THEN("or_else recovers from errors.")
+    {
+      REQUIRE(err.or_else([](Errno) -> IntResult { return Ok(0); }).contains(0));
+    }
+  }
+
+  GIVEN("pointer results.")
+  {
+    int value = 7;
+    WHEN("it holds a pointer.")
+    {
+      const PtrResult result{Ok(&value)};
+      THEN("the pointer is returned.")
+      {
+        REQUIRE(result.is_ok());
+        REQUIRE(*result.value() == 7);
+      }
+    }
+
+    WHEN("it holds a null pointer.")
+    {
+      const PtrResult result{Ok(static_cast<int*>(nullptr))};
+      THEN("it is still ok.")
+      {
+        REQUIRE(result.is_ok());
+        REQUIRE(result.value() == nullptr);
+      }
+    }
+
+    WHEN("it holds an error.")
+    {
+      const PtrResult result{Err(Errno(ENOMEM))};
+      THEN("the errno is encoded in the pointer.")
+      {
+        REQUIRE(result.is_error());
+        REQUIRE(!result.is_pending());
+        REQUIRE(result.error() == Errno(ENOMEM));
+        REQUIRE(result.value_or(&value) == &value);
+      }
+    }
+
+    WHEN("it is default constructed.")
+    {
+      const PtrResult result;
+      THEN("it is pending.")
+      {
+        REQUIRE(result.is_pending());
+        REQUIRE(!result.is_ok());
+        REQUIRE(!result.is_error());
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,88 @@
+#include "src/lib/framing.hh"
+
+#include <catch2/catch_all.hpp>
+#include <string>
+#include <vector>
+
+namespace spinscale::nwprog::lib::test
+{
+
+namespace
+{
+
+std::string frame(const std::string_view payload)
+{
+  std::string out(framing::header_size, '\0');
+  framing::encode_header(static_cast<uint32_t>(payload.size()), out.data());
+  out.append(payload);
+  return out;
+}
+
+}  // namespace
+
+SCENARIO("length prefixed framing")
+{
+  GIVEN("a buffer with two complete frames and the start of a third")
+  {
+    const std::string first = frame("hello");
+    const std::string second = frame("");
+    const std::string third = frame("a payload that is cut off");
+    const std::string data = first + second + third.substr(0, 10);
+
+    WHEN("the frames are parsed.")
+    {
+      std::vector<std::string_view> payloads;
+      const auto consumed =
+        framing::for_each_frame(data, [&](std::string_view payload) { payloads.push_back(payload); });
+      THEN("the complete frames are handed out as views into the buffer.")
+      {
+        REQUIRE(consumed.contains(static_cast<int32_t>(first.size() + second.size())));
+        REQUIRE(payloads.size() == 2);
+        REQUIRE(payloads[0] == "hello");
+        REQUIRE(payloads[0].data() == data.data() + framing::header_size);
+        REQUIRE(payloads[1].empty());
+      }
+    }
+
+    WHEN("the rest of the third frame arrives.")
+    {
+      const std::string rest = data.substr(first.size() + second.size()) + third.substr(10);
+      std::vector<std::string_view> payloads;
+      const auto consumed =
+        framing::for_each_frame(rest, [&](std::string_view payload) { payloads.push_back(payload); });
+      THEN("it is complete.")
+      {
+        REQUIRE(consumed.contains(static_cast<int32_t>(third.size())));
+        REQUIRE(payloads.size() == 1);
+        REQUIRE(payloads[0] == "a payload that is cut off");
+      }
+    }
+  }
+
+  GIVEN("a header that announces a huge payload")
+  {
+    const std::string data = frame("ok") + frame(std::string(100, 'x'));
+    WHEN("it is parsed with a small limit.")
+    {
+      uint32_t frames = 0;
+      const auto consumed = framing::for_each_frame(data, [&](std::string_view) { ++frames; }, 64);
+      THEN("the frames before it are handled and an error is returned.")
+      {
+        REQUIRE(frames == 1);
+        REQUIRE(consumed.contains_err(Errno(EMSGSIZE)));
+      }
+    }
+  }
+
+  GIVEN("a header with the high bit set")
+  {
+    char header[framing::header_size];
+    framing::encode_header(0x80000001U, header);
+    THEN("it round trips.")
+    {
+      REQUIRE(framing::decode_header(header) == 0x80000001U);
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,128 @@
+#include "src/lib/function.hh"
+
+#include <array>
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <string>
+
+namespace spinscale::nwprog::lib::test
+{
+
+SCENARIO("function references forward return values")
+{
+  GIVEN("a callable returning a value.")
+  {
+    int calls = 0;
+    auto add = [&calls](int lhs, int rhs)
+    {
+      ++calls;
+      return lhs + rhs;
+    };
+
+    WHEN("it is invoked through a mutable reference.")
+    {
+      FnRef<int(int, int)> ref(add);
+      THEN("the result is returned.")
+      {
+        REQUIRE(ref(1, 2) == 3);
+        REQUIRE(calls == 1);
+      }
+    }
+
+    WHEN("it is invoked through a const reference.")
+    {
+      const auto& const_add = add;
+      FnRef<int(int, int) const> ref(const_add);
+      THEN("the result is returned.")
+      {
+        REQUIRE(ref(2, 2) == 4);
+        REQUIRE(calls == 1);
+      }
+    }
+  }
+}
+
+SCENARIO("inplace functions own their callable")
+{
+  GIVEN("an empty function.")
+  {
+    InplaceFunction<int()> fn;
+    THEN("it converts to false.")
+    {
+      REQUIRE(!fn);
+    }
+
+    WHEN("a callable is assigned.")
+    {
+      fn = []() { return 42; };
+      THEN("it can be invoked.")
+      {
+        REQUIRE(fn);
+        REQUIRE(fn() == 42);
+      }
+    }
+  }
+
+  GIVEN("a function holding a move only capture.")
+  {
+    auto value = std::make_shared<int>(7);
+    std::weak_ptr<int> observer = value;
+    InplaceFunction<int(int)> fn([value = std::move(value)](int offset) { return *value + offset; });
+    REQUIRE(fn(1) == 8);
+
+    WHEN("it is moved.")
+    {
+      InplaceFunction<int(int)> moved(std::move(fn));
+      THEN("the capture moves along and the source is empty.")
+      {
+        REQUIRE(!fn);
+        REQUIRE(moved(2) == 9);
+        REQUIRE(observer.use_count() == 1);
+      }
+    }
+
+    WHEN("it is reset.")
+    {
+      fn.reset();
+      THEN("the capture is destroyed.")
+      {
+        REQUIRE(!fn);
+        REQUIRE(observer.expired());
+      }
+    }
+
+    WHEN("another function is move assigned over it.")
+    {
+      fn = InplaceFunction<int(int)>([](int offset) { return offset; });
+      THEN("the previous capture is destroyed.")
+      {
+        REQUIRE(observer.expired());
+        REQUIRE(fn(3) == 3);
+      }
+    }
+  }
+
+  GIVEN("a callable returning a string.")
+  {
+    InplaceFunction<std::string(const std::string&)> fn([](const std::string& name) { return "hello " + name; });
+    THEN("the result is returned.")
+    {
+      REQUIRE(fn("world") == "hello world");
+    }
+  }
+
+  GIVEN("callables of different sizes.")
+  {
+    using Small = decltype([]() {});
+    std::array<char, 64> large_capture{};
+    using Large = decltype([large_capture]() { return large_capture[0]; });
+    THEN("only those fitting into the buffer are accepted.")
+    {
+      STATIC_REQUIRE(std::is_constructible_v<InplaceFunction<void(), 16>, Small>);
+      STATIC_REQUIRE(!std::is_constructible_v<InplaceFunction<char(), 32>, Large>);
+      STATIC_REQUIRE(std::is_constructible_v<InplaceFunction<char(), 64>, Large>);
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,87 @@
+#include "src/lib/histogram.hh"
+
+#include <catch2/catch_all.hpp>
+
+namespace spinscale::nwprog::lib::test
+{
+
+SCENARIO("histogram percentiles")
+{
+  GIVEN("an empty histogram")
+  {
+    Histogram histogram;
+    THEN("it reports zeros.")
+    {
+      REQUIRE(histogram.count() == 0);
+      REQUIRE(histogram.percentile(99.0) == 0);
+    }
+
+    WHEN("small values are recorded.")
+    {
+      for (uint64_t i = 1; i <= 50; ++i)
+      {
+        histogram.record(i);
+      }
+      THEN("they are reported exactly.")
+      {
+        REQUIRE(histogram.count() == 50);
+        REQUIRE(histogram.min() == 1);
+        REQUIRE(histogram.max() == 50);
+        REQUIRE(histogram.percentile(50.0) == 25);
+        REQUIRE(histogram.percentile(100.0) == 50);
+      }
+    }
+
+    WHEN("large values are recorded.")
+    {
+      for (uint64_t i = 1; i <= 1000; ++i)
+      {
+        histogram.record(i * 1000);
+      }
+      THEN("percentiles are within the relative error of a sub bucket.")
+      {
+        const auto p99 = static_cast<double>(histogram.percentile(99.0));
+        REQUIRE(p99 >= 990000.0);
+        REQUIRE(p99 <= 990000.0 * (1.0 + 1.0 / Histogram::sub_bucket_count));
+        REQUIRE(histogram.percentile(100.0) == 1000000);
+      }
+    }
+  }
+
+  GIVEN("two histograms")
+  {
+    Histogram lhs;
+    Histogram rhs;
+    lhs.record(10);
+    rhs.record(1U << 20U);
+    WHEN("they are merged.")
+    {
+      lhs.merge(rhs);
+      THEN("the result holds the values of both.")
+      {
+        REQUIRE(lhs.count() == 2);
+        REQUIRE(lhs.min() == 10);
+        REQUIRE(lhs.max() == (1U << 20U));
+      }
+    }
+  }
+}
+
+SCENARIO("histogram bucket boundaries")
+{
+  GIVEN("values around a power of two")
+  {
+    THEN("every value maps to a bucket whose range contains it.")
+    {
+      for (uint64_t value : {63ULL, 64ULL, 65ULL, 127ULL, 128ULL, 129ULL, 1ULL << 40U, ~0ULL})
+      {
+        const uint32_t index = Histogram::index_of(value);
+        REQUIRE(index < Histogram::bucket_count);
+        REQUIRE(Histogram::highest_equivalent_value(index) >= value);
+        REQUIRE((index == 0 || Histogram::highest_equivalent_value(index - 1) < value));
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,120 @@
+#include "src/lib/mpsc_queue.hh"
+
+#include <catch2/catch_all.hpp>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace spinscale::nwprog::lib::test
+{
+
+SCENARIO("mpsc queue on a single thread")
+{
+  GIVEN("a queue with a capacity that is not a power of two")
+  {
+    MpscQueue<std::unique_ptr<int>> queue(3);
+    THEN("the capacity is rounded up.")
+    {
+      REQUIRE(queue.capacity() == 4);
+      REQUIRE(queue.empty());
+    }
+
+    WHEN("it is filled.")
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        REQUIRE(queue.try_push(std::make_unique<int>(i)));
+      }
+      THEN("further pushes fail.")
+      {
+        REQUIRE(!queue.try_push(std::make_unique<int>(4)));
+      }
+
+      THEN("items come out in order.")
+      {
+        for (int i = 0; i < 4; ++i)
+        {
+          const auto item = queue.try_pop();
+          REQUIRE(item.has_value());
+          REQUIRE(**item == i);
+        }
+        REQUIRE(!queue.try_pop().has_value());
+      }
+
+      THEN("drain stops at the batch size.")
+      {
+        int sum = 0;
+        REQUIRE(queue.drain([&sum](std::unique_ptr<int> item) { sum += *item; }, 3) == 3);
+        REQUIRE(sum == 0 + 1 + 2);
+        REQUIRE(!queue.empty());
+        REQUIRE(queue.try_push(std::make_unique<int>(4)));
+        REQUIRE(queue.drain([&sum](std::unique_ptr<int> item) { sum += *item; }, 8) == 2);
+        REQUIRE(sum == 0 + 1 + 2 + 3 + 4);
+        REQUIRE(queue.empty());
+      }
+    }
+  }
+}
+
+SCENARIO("mpsc queue with concurrent producers")
+{
+  GIVEN("several producers pushing into a small queue")
+  {
+    constexpr uint32_t producers = 4;
+    constexpr uint32_t items_per_producer = 20000;
+    MpscQueue<uint64_t> queue(64);
+    std::vector<std::thread> threads;
+    for (uint32_t producer = 0; producer < producers; ++producer)
+    {
+      threads.emplace_back(
+        [&queue, producer]()
+        {
+          for (uint32_t i = 0; i < items_per_producer; ++i)
+          {
+            while (!queue.try_push((uint64_t{producer} << 32U) | i))
+            {
+              std::this_thread::yield();
+            }
+          }
+        });
+    }
+
+    WHEN("the consumer drains until everything arrived.")
+    {
+      std::vector<uint32_t> next(producers, 0);
+      bool in_order = true;
+      uint64_t received = 0;
+      while (received < producers * items_per_producer)
+      {
+        const size_t count = queue.drain(
+          [&](const uint64_t item)
+          {
+            const auto producer = static_cast<uint32_t>(item >> 32U);
+            in_order = in_order && static_cast<uint32_t>(item) == next[producer];
+            ++next[producer];
+          },
+          16);
+        if (count == 0)
+        {
+          std::this_thread::yield();
+        }
+        received += count;
+      }
+      for (auto& thread : threads)
+      {
+        thread.join();
+      }
+      THEN("every item arrived once and in the order of its producer.")
+      {
+        REQUIRE(in_order);
+        REQUIRE(queue.empty());
+        for (const uint32_t count : next)
+        {
+          REQUIRE(count == items_per_producer);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
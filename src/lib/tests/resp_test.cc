@@ -0,0 +1,85 @@
+#include "src/lib/resp.hh"
+
+#include <catch2/catch_all.hpp>
+#include <string>
+
+namespace spinscale::nwprog::lib::resp::test
+{
+
+SCENARIO("parsing RESP commands")
+{
+  std::vector<std::string_view> args;
+
+  GIVEN("two pipelined commands")
+  {
+    const std::string first = "*2\r\n$3\r\nGET\r\n$3\r\nkey\r\n";
+    const std::string second = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$13\r\nvalue\r\nwith\r\n\r\n";
+    const std::string data = first + second;
+
+    THEN("they are parsed one after the other.")
+    {
+      REQUIRE(parse_command(data, args).contains(static_cast<int32_t>(first.size())));
+      REQUIRE(args == std::vector<std::string_view>{"GET", "key"});
+      REQUIRE(parse_command(std::string_view(data).substr(first.size()), args)
+                .contains(static_cast<int32_t>(second.size())));
+      REQUIRE(args == std::vector<std::string_view>{"SET", "key", "value\r\nwith\r\n"});
+    }
+
+    THEN("every cut off prefix is incomplete.")
+    {
+      for (size_t size = 0; size < second.size(); ++size)
+      {
+        REQUIRE(parse_command(std::string_view(second).substr(0, size), args).contains(0));
+      }
+    }
+  }
+
+  GIVEN("commands the server does not understand")
+  {
+    THEN("they are rejected.")
+    {
+      REQUIRE(parse_command("GET key\r\n", args).contains_err(lib::Errno(EBADMSG)));
+      REQUIRE(parse_command("*0\r\n", args).contains_err(lib::Errno(EBADMSG)));
+      REQUIRE(parse_command("*1\r\n$3\r\nGETX\r\n", args).contains_err(lib::Errno(EBADMSG)));
+      REQUIRE(parse_command("*1\r\n$x\r\n", args).contains_err(lib::Errno(EBADMSG)));
+      REQUIRE(parse_command("*1\r\n$100000\r\n", args).contains_err(lib::Errno(EMSGSIZE)));
+      REQUIRE(parse_command("*1\r\n$50\r\n" + std::string(40, 'x'), args, 32).contains_err(lib::Errno(EMSGSIZE)));
+    }
+  }
+}
+
+SCENARIO("encoding and measuring RESP replies")
+{
+  GIVEN("a reply of every type")
+  {
+    std::string out;
+    append_array_header(out, 2);
+    append_bulk(out, "value");
+    append_bulk(out, std::nullopt);
+    append_simple(out, "OK");
+    append_integer(out, -42);
+    append_error(out, "unknown command");
+
+    THEN("they are encoded as RESP.")
+    {
+      REQUIRE(out == "*2\r\n$5\r\nvalue\r\n$-1\r\n+OK\r\n:-42\r\n-ERR unknown command\r\n");
+      REQUIRE(bulk_size("value") == 11);
+      REQUIRE(bulk_size(std::string(10, 'x')) == 17);
+      REQUIRE(bulk_size(std::nullopt) == 5);
+    }
+
+    THEN("their sizes are found one by one.")
+    {
+      std::string_view rest = out;
+      for (const size_t expected : {20U, 5U, 6U, 22U})
+      {
+        REQUIRE(reply_size(rest).contains(static_cast<int32_t>(expected)));
+        rest.remove_prefix(expected);
+      }
+      REQUIRE(reply_size(std::string_view(out).substr(0, 19)).contains(0));
+      REQUIRE(reply_size("?").contains_err(lib::Errno(EBADMSG)));
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::resp::test
@@ -0,0 +1,186 @@
+#include "src/lib/spsc_byte_ring.hh"
+
+#include <catch2/catch_all.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace spinscale::nwprog::lib::test
+{
+
+namespace
+{
+
+struct iovec to_iovec(std::string& data)
+{
+  return {.iov_base = data.data(), .iov_len = data.size()};
+}
+
+}  // namespace
+
+SCENARIO("spsc byte ring on a single thread")
+{
+  GIVEN("a ring of 8 bytes")
+  {
+    SpscByteRing::Indices indices;
+    char data[8];
+    SpscByteRing ring(indices, data, sizeof(data));
+    REQUIRE(ring.size() == 0U);
+    REQUIRE(ring.free_space() == 8U);
+
+    WHEN("more is written than fits")
+    {
+      std::string first = "abcde";
+      std::string second = "fghij";
+      const struct iovec iovecs[] = {to_iovec(first), to_iovec(second)};
+      REQUIRE(ring.write(iovecs, 2U) == 8U);
+
+      THEN("the rest is left to the caller and the ring is full.")
+      {
+        REQUIRE(ring.size() == 8U);
+        REQUIRE(ring.free_space() == 0U);
+        REQUIRE(ring.write(iovecs, 2U) == 0U);
+      }
+
+      THEN("the bytes come out in order, across several iovecs.")
+      {
+        std::string out(3U, '\0');
+        std::string rest(8U, '\0');
+        const struct iovec out_iovecs[] = {to_iovec(out), to_iovec(rest)};
+        REQUIRE(ring.read(out_iovecs, 2U) == 8U);
+        REQUIRE(out == "abc");
+        REQUIRE(rest.substr(0U, 5U) == "defgh");
+        REQUIRE(ring.size() == 0U);
+      }
+    }
+
+    WHEN("a write wraps around the end")
+    {
+      std::string filler = "123456";
+      const struct iovec filler_iovec = to_iovec(filler);
+      REQUIRE(ring.write(&filler_iovec, 1U) == 6U);
+      std::string skipped(6U, '\0');
+      const struct iovec skipped_iovec = to_iovec(skipped);
+      REQUIRE(ring.read(&skipped_iovec, 1U) == 6U);
+
+      std::string wrapping = "wrapped";
+      const struct iovec wrapping_iovec = to_iovec(wrapping);
+      REQUIRE(ring.write(&wrapping_iovec, 1U) == 7U);
+
+      THEN("it reads back in one piece.")
+      {
+        std::string out(16U, '\0');
+        const struct iovec out_iovec = to_iovec(out);
+        REQUIRE(ring.read(&out_iovec, 1U) == 7U);
+        REQUIRE(out.substr(0U, 7U) == "wrapped");
+      }
+    }
+  }
+}
+
+SCENARIO("spsc byte ring with a corrupted peer index")
+{
+  GIVEN("a ring of 8 bytes holding a few")
+  {
+    SpscByteRing::Indices indices;
+    char data[8];
+    SpscByteRing ring(indices, data, sizeof(data));
+    std::string bytes = "abc";
+    const struct iovec iovec = to_iovec(bytes);
+    REQUIRE(ring.write(&iovec, 1U) == 3U);
+    REQUIRE_FALSE(ring.broken());
+
+    WHEN("the producer's index runs past the capacity")
+    {
+      indices.written.store(1000U);
+
+      THEN("the size is clamped, the ring is broken and nothing is read.")
+      {
+        REQUIRE(ring.size() == 8U);
+        REQUIRE(ring.broken());
+        std::string out(8U, '\0');
+        const struct iovec out_iovec = to_iovec(out);
+        REQUIRE(ring.read(&out_iovec, 1U) == 0U);
+        REQUIRE(indices.read.load() == 0U);
+      }
+    }
+
+    WHEN("the consumer's index runs ahead of the producer's")
+    {
+      indices.read.store(4U);
+
+      THEN("there is no free space, the ring is broken and nothing is written.")
+      {
+        REQUIRE(ring.free_space() == 0U);
+        REQUIRE(ring.broken());
+        REQUIRE(ring.write(&iovec, 1U) == 0U);
+        REQUIRE(indices.written.load() == 3U);
+      }
+    }
+
+    WHEN("a corrupted index is put back")
+    {
+      indices.written.store(1000U);
+      std::string out(8U, '\0');
+      const struct iovec out_iovec = to_iovec(out);
+      REQUIRE(ring.read(&out_iovec, 1U) == 0U);
+      indices.written.store(3U);
+
+      THEN("the ring stays broken.")
+      {
+        REQUIRE(ring.broken());
+        REQUIRE(ring.read(&out_iovec, 1U) == 0U);
+      }
+    }
+  }
+}
+
+SCENARIO("spsc byte ring between two threads")
+{
+  GIVEN("a producer streaming more bytes than the ring holds")
+  {
+    constexpr size_t total = 1U << 20U;
+    SpscByteRing::Indices indices;
+    std::vector<char> data(256U);
+    SpscByteRing producer_view(indices, data.data(), data.size());
+    SpscByteRing consumer_view(indices, data.data(), data.size());
+
+    std::thread producer(
+      [&]()
+      {
+        std::string chunk(100U, '\0');
+        size_t sent = 0;
+        while (sent < total)
+        {
+          for (size_t i = 0; i < chunk.size(); ++i)
+          {
+            chunk[i] = static_cast<char>((sent + i) % 251U);
+          }
+          const struct iovec iovec{.iov_base = chunk.data(), .iov_len = std::min(chunk.size(), total - sent)};
+          sent += producer_view.write(&iovec, 1U);
+        }
+      });
+
+    THEN("the consumer sees every byte in order.")
+    {
+      std::string chunk(64U, '\0');
+      size_t received = 0;
+      bool in_order = true;
+      while (received < total)
+      {
+        const struct iovec iovec = to_iovec(chunk);
+        const size_t count = consumer_view.read(&iovec, 1U);
+        for (size_t i = 0; i < count; ++i)
+        {
+          in_order = in_order && chunk[i] == static_cast<char>((received + i) % 251U);
+        }
+        received += count;
+      }
+      producer.join();
+      REQUIRE(in_order);
+      REQUIRE(consumer_view.size() == 0U);
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,101 @@
+#include "src/lib/thread_pool.hh"
+
+#include <atomic>
+#include <catch2/catch_all.hpp>
+#include <chrono>
+#include <thread>
+
+namespace spinscale::nwprog::lib::test
+{
+
+namespace
+{
+
+/// Wait until `count` reached `expected`, false when that took longer than a few seconds.
+bool wait_for(const std::atomic<uint32_t>& count, const uint32_t expected)
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (count.load() < expected)
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+    {
+      return false;
+    }
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+}  // namespace
+
+SCENARIO("thread pool runs submitted tasks")
+{
+  GIVEN("a pool with a few workers")
+  {
+    ThreadPool pool(3);
+    std::atomic<uint32_t> done{0};
+
+    WHEN("tasks are submitted from outside the pool.")
+    {
+      constexpr uint32_t num_tasks = 10000;
+      bool kept_rejected_tasks = true;
+      for (uint32_t i = 0; i < num_tasks; ++i)
+      {
+        ThreadPool::Task task([&done]() { done.fetch_add(1); });
+        while (!pool.submit(std::move(task)))
+        {
+          kept_rejected_tasks = kept_rejected_tasks && static_cast<bool>(task);
+          std::this_thread::yield();
+        }
+      }
+      THEN("all of them run.")
+      {
+        REQUIRE(kept_rejected_tasks);
+        REQUIRE(wait_for(done, num_tasks));
+        REQUIRE(done.load() == num_tasks);
+      }
+    }
+
+    WHEN("tasks spawn more tasks.")
+    {
+      constexpr uint32_t fan_out = 100;
+      std::atomic<uint32_t> accepted{0};
+      pool.submit(
+        [&pool, &done, &accepted]()
+        {
+          for (uint32_t i = 0; i < fan_out; ++i)
+          {
+            accepted.fetch_add(pool.submit([&done]() { done.fetch_add(1); }) ? 1U : 0U);
+          }
+        });
+      THEN("the spawned tasks run as well.")
+      {
+        REQUIRE(wait_for(done, fan_out));
+        REQUIRE(accepted.load() == fan_out);
+        REQUIRE(done.load() == fan_out);
+      }
+    }
+
+    WHEN("tasks come from outside after some came from inside the pool.")
+    {
+      std::atomic<uint32_t> inner{0};
+      pool.submit([&pool, &inner]() { pool.submit([&inner]() { inner.fetch_add(1); }); });
+      const bool inner_ran = wait_for(inner, 1U);
+      // Give the workers time to go back to sleep, every outside task lands in another worker's queue.
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      constexpr uint32_t num_tasks = 6;
+      for (uint32_t i = 0; i < num_tasks; ++i)
+      {
+        pool.submit([&done]() { done.fetch_add(1); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      }
+      THEN("each of them runs without waiting for a later submit.")
+      {
+        REQUIRE(inner_ran);
+        REQUIRE(wait_for(done, num_tasks));
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
@@ -0,0 +1,105 @@
+#include "src/lib/topology.hh"
+
+#include <unistd.h>
+
+#include <catch2/catch_all.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace spinscale::nwprog::lib::test
+{
+
+namespace
+{
+
+void write_file(const std::filesystem::path& path, const std::string& contents)
+{
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path) << contents << '\n';
+}
+
+/// Two nodes with two cores each, every core with two SMT siblings numbered like x86 does: 0-3 are the first
+/// threads of all cores, 4-7 their siblings.
+std::filesystem::path fake_sysfs()
+{
+  const auto root = std::filesystem::temp_directory_path() / ("topology_test." + std::to_string(getpid()));
+  std::filesystem::remove_all(root);
+  write_file(root / "cpu/online", "0-7");
+  write_file(root / "node/online", "0-1");
+  write_file(root / "node/node0/cpulist", "0-1,4-5");
+  write_file(root / "node/node1/cpulist", "2-3,6-7");
+  for (uint32_t id = 0; id < 8U; ++id)
+  {
+    const auto topology = root / ("cpu/cpu" + std::to_string(id)) / "topology";
+    write_file(topology / "physical_package_id", std::to_string((id % 4U) / 2U));
+    write_file(topology / "core_id", std::to_string(id % 2U));
+  }
+  return root;
+}
+
+}  // namespace
+
+SCENARIO("parsing cpu lists")
+{
+  REQUIRE(parse_cpu_list("0-3,8,10-11") == std::vector<uint32_t>{0U, 1U, 2U, 3U, 8U, 10U, 11U});
+  REQUIRE(parse_cpu_list("5") == std::vector<uint32_t>{5U});
+  REQUIRE(parse_cpu_list("").empty());
+}
+
+SCENARIO("reading the topology of a machine with SMT and two nodes")
+{
+  GIVEN("a sysfs tree")
+  {
+    const auto root = fake_sysfs();
+    const auto topology = Topology::read(root.string(), parse_cpu_list("0-7"));
+    const auto restricted = Topology::read(root.string(), parse_cpu_list("1-3,5"));
+    const auto unrelated = Topology::read(root.string(), parse_cpu_list("8-9"));
+    std::filesystem::remove_all(root);
+
+    THEN("cores are unique across packages and siblings share one.")
+    {
+      REQUIRE(topology.cpus().size() == 8U);
+      REQUIRE(topology.num_cores() == 4U);
+      REQUIRE(topology.num_nodes() == 2U);
+      REQUIRE(topology.node_of(6U) == 1U);
+      REQUIRE(topology.siblings(1U) == std::vector<uint32_t>{1U, 5U});
+    }
+
+    THEN("threads go to physical cores first, node by node, and then wrap around.")
+    {
+      REQUIRE(topology.placement(2U) == std::vector<uint32_t>{0U, 1U});
+      REQUIRE(topology.placement(4U) == std::vector<uint32_t>{0U, 1U, 2U, 3U});
+      REQUIRE(topology.placement(6U) == std::vector<uint32_t>{0U, 1U, 2U, 3U, 4U, 5U});
+      REQUIRE(topology.placement(9U).back() == 0U);
+    }
+
+    THEN("a restricted process only counts and places on the CPUs it may run on.")
+    {
+      REQUIRE(restricted.cpus().size() == 4U);
+      REQUIRE(restricted.num_cores() == 3U);
+      REQUIRE(restricted.num_nodes() == 2U);
+      REQUIRE(restricted.placement(4U) == std::vector<uint32_t>{1U, 2U, 3U, 5U});
+    }
+
+    THEN("an allowed set without any online CPU keeps all of them.")
+    {
+      REQUIRE(unrelated.cpus().size() == 8U);
+    }
+  }
+
+  GIVEN("a tree without any files")
+  {
+    const auto topology = Topology::read("/nonexistent");
+
+    THEN("every CPU is a core of its own on node zero.")
+    {
+      REQUIRE_FALSE(topology.cpus().empty());
+      REQUIRE(topology.num_cores() == topology.cpus().size());
+      REQUIRE(topology.num_nodes() == 1U);
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::lib::test
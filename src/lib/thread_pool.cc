@@ -0,0 +1,240 @@
+#include "src/lib/thread_pool.hh"
+
+#include <algorithm>
+
+namespace spinscale::nwprog::lib
+{
+
+namespace
+{
+
+/// Tasks moved from the injection queue into the deque at once, so thieves can take them.
+constexpr size_t injection_batch = 32U;
+
+/// The pool and worker the current thread belongs to, if any.
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local uint32_t current_worker = 0U;
+
+uint64_t next_random(uint64_t& state)
+{
+  state ^= state >> 12U;
+  state ^= state << 25U;
+  state ^= state >> 27U;
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+}  // namespace
+
+ThreadPool::ThreadPool(const uint32_t num_workers, const size_t queue_capacity)
+{
+  for (uint32_t i = 0; i < std::max(num_workers, 1U); ++i)
+  {
+    workers_.push_back(std::make_unique<Worker>(queue_capacity));
+  }
+  const size_t per_worker = workers_[0]->deque.capacity() + workers_[0]->injected.capacity() + 1U;
+  const auto num_slots = static_cast<uint32_t>(workers_.size() * per_worker);
+  slots_ = std::make_unique<Slot[]>(num_slots);
+  for (uint32_t i = 0; i < num_slots; ++i)
+  {
+    slots_[i].next.store(i + 1U == num_slots ? no_slot : i + 1U, std::memory_order_relaxed);
+  }
+  free_slots_.store(0U);
+  for (uint32_t i = 0; i < workers_.size(); ++i)
+  {
+    workers_[i]->thread = std::thread([this, i]() { run(i); });
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  stopping_.store(true);
+  for (auto& worker : workers_)
+  {
+    worker->wake.fetch_add(1U);
+    worker->wake.notify_one();
+  }
+  for (auto& worker : workers_)
+  {
+    worker->thread.join();
+  }
+  // Tasks still queued are destroyed with their slots.
+}
+
+bool ThreadPool::submit(Task&& task)
+{
+  const auto slot = allocate_slot();
+  if (!slot.has_value())
+  {
+    return false;
+  }
+  slots_[*slot].task = std::move(task);
+  if (current_pool == this && workers_[current_worker]->deque.push(*slot))
+  {
+    wake_any();
+    return true;
+  }
+  for (uint32_t attempt = 0; attempt < workers_.size(); ++attempt)
+  {
+    const uint32_t index = next_worker_.fetch_add(1U, std::memory_order_relaxed) % workers_.size();
+    uint32_t queued = *slot;
+    if (workers_[index]->injected.try_push(std::move(queued)))
+    {
+      // Only the owner takes from its injection queue, waking any other worker would leave the task there.
+      wake(*workers_[index]);
+      return true;
+    }
+  }
+  task = std::move(slots_[*slot].task);
+  free_slot(*slot);
+  return false;
+}
+
+bool ThreadPool::wake(Worker& worker)
+{
+  // Pairs with the fence in `run`: either the sleeper sees the new task or we see the sleeper.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (!worker.sleeping.load() || !worker.sleeping.exchange(false))
+  {
+    return false;
+  }
+  worker.wake.fetch_add(1U);
+  worker.wake.notify_one();
+  return true;
+}
+
+void ThreadPool::wake_any()
+{
+  const auto num_workers = static_cast<uint32_t>(workers_.size());
+  const uint32_t start = current_pool == this ? current_worker + 1U : 0U;
+  for (uint32_t i = 0; i < num_workers; ++i)
+  {
+    if (wake(*workers_[(start + i) % num_workers]))
+    {
+      return;
+    }
+  }
+}
+
+std::optional<uint32_t> ThreadPool::allocate_slot()
+{
+  uint64_t head = free_slots_.load(std::memory_order_acquire);
+  while (true)
+  {
+    const auto slot = static_cast<uint32_t>(head);
+    if (slot == no_slot)
+    {
+      return std::nullopt;
+    }
+    // The slot may be taken and freed again meanwhile, then the count in the upper half changed and the exchange fails.
+    const uint32_t next = slots_[slot].next.load(std::memory_order_relaxed);
+    const uint64_t new_head = ((head >> 32U) + 1U) << 32U | next;
+    if (free_slots_.compare_exchange_weak(head, new_head, std::memory_order_acquire, std::memory_order_acquire))
+    {
+      return slot;
+    }
+  }
+}
+
+void ThreadPool::free_slot(const uint32_t slot)
+{
+  uint64_t head = free_slots_.load(std::memory_order_relaxed);
+  do
+  {
+    slots_[slot].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+  } while (!free_slots_.compare_exchange_weak(
+    head, (head & 0xFFFFFFFF00000000ULL) | slot, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void ThreadPool::run_task(const uint32_t slot)
+{
+  Task& task = slots_[slot].task;
+  task();
+  task.reset();
+  free_slot(slot);
+}
+
+std::optional<uint32_t> ThreadPool::find_task(const uint32_t index, uint64_t& rng)
+{
+  Worker& self = *workers_[index];
+  if (const auto slot = self.deque.pop())
+  {
+    return slot;
+  }
+
+  std::optional<uint32_t> first;
+  const size_t room = std::min(injection_batch, self.deque.capacity() - self.deque.size());
+  self.injected.drain(
+    [&](const uint32_t slot)
+    {
+      if (!first.has_value())
+      {
+        first = slot;
+      }
+      else
+      {
+        // Can not fail, only the owner pushes and there was enough room.
+        self.deque.push(slot);
+      }
+    },
+    room);
+  if (first.has_value())
+  {
+    // Others may steal what was moved to the deque.
+    if (self.deque.size() > 0U)
+    {
+      wake_any();
+    }
+    return first;
+  }
+
+  const auto num_workers = static_cast<uint32_t>(workers_.size());
+  const auto start = static_cast<uint32_t>(next_random(rng) % num_workers);
+  for (uint32_t i = 0; i < num_workers; ++i)
+  {
+    const uint32_t victim = (start + i) % num_workers;
+    if (victim == index)
+    {
+      continue;
+    }
+    if (const auto slot = workers_[victim]->deque.steal())
+    {
+      return slot;
+    }
+  }
+  return std::nullopt;
+}
+
+void ThreadPool::run(const uint32_t index)
+{
+  current_pool = this;
+  current_worker = index;
+  uint64_t rng = 0x9E3779B97F4A7C15ULL * (index + 1U);
+  Worker& self = *workers_[index];
+
+  while (!stopping_.load(std::memory_order_relaxed))
+  {
+    if (const auto slot = find_task(index, rng))
+    {
+      run_task(*slot);
+      continue;
+    }
+
+    const uint32_t epoch = self.wake.load();
+    self.sleeping.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // Look once more, a task may have been submitted before we announced ourselves.
+    if (const auto slot = find_task(index, rng))
+    {
+      self.sleeping.store(false);
+      run_task(*slot);
+      continue;
+    }
+    if (!stopping_.load())
+    {
+      self.wake.wait(epoch);
+    }
+    self.sleeping.store(false);
+  }
+}
+
+}  // namespace spinscale::nwprog::lib
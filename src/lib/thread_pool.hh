@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "src/lib/cache_line.hh"
+#include "src/lib/chase_lev_deque.hh"
+#include "src/lib/function.hh"
+#include "src/lib/mpsc_queue.hh"
+
+namespace spinscale::nwprog::lib
+{
+
+/// Work stealing thread pool for CPU bound work that must not run on an io thread.
+///
+/// Every worker owns a Chase-Lev deque. Tasks submitted by a worker go to its own deque, tasks submitted by any other
+/// thread, e.g. an io thread, go round robin into the workers' injection queues, from where the owner moves them into
+/// its deque. Idle workers steal from the others before going to sleep.
+///
+/// A task injected into a worker's queue wakes that worker, only its owner takes from it. A task pushed to a deque
+/// wakes any sleeping worker, all of them may steal it. Tasks are kept in slots allocated once with the pool, the
+/// queues only move slot indices around, so submitting does not allocate.
+///
+/// To get a result back to the ring that asked for it, post it to that ring's `io::Mailbox` from the task.
+class ThreadPool
+{
+public:
+  using Task = InplaceFunction<void(), 64U>;
+
+  explicit ThreadPool(uint32_t num_workers, size_t queue_capacity = 1024U);
+  /// Stops the workers. Tasks that did not start yet are dropped.
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Any thread. Returns false and leaves `task` untouched when all queues are full, the caller may then run it itself.
+  bool submit(Task&& task);
+
+  [[nodiscard]] uint32_t size() const
+  {
+    return static_cast<uint32_t>(workers_.size());
+  }
+
+private:
+  struct Worker
+  {
+    explicit Worker(const size_t queue_capacity) : deque(queue_capacity), injected(queue_capacity)
+    {
+    }
+
+    /// Both hold indices into `slots_`.
+    ChaseLevDeque<uint32_t> deque;
+    MpscQueue<uint32_t> injected;
+    /// Bumped to wake the worker, which waits for it to change while `sleeping`.
+    alignas(cache_line_size) std::atomic<uint32_t> wake{0U};
+    std::atomic<bool> sleeping{false};
+    std::thread thread{};
+  };
+
+  struct Slot
+  {
+    Task task{};
+    /// Next free slot while this one is free.
+    std::atomic<uint32_t> next{0U};
+  };
+
+  static constexpr uint32_t no_slot = UINT32_MAX;
+
+  void run(uint32_t index);
+  std::optional<uint32_t> find_task(uint32_t index, uint64_t& rng);
+  void run_task(uint32_t slot);
+  /// Wake `worker` if it sleeps, true if it did.
+  bool wake(Worker& worker);
+  void wake_any();
+
+  std::optional<uint32_t> allocate_slot();
+  void free_slot(uint32_t slot);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  /// Enough for a full deque and injection queue per worker and a task running on each.
+  std::unique_ptr<Slot[]> slots_;
+  /// Treiber stack of free slots, the upper half counts pops so a slot freed and taken again in between is noticed.
+  alignas(cache_line_size) std::atomic<uint64_t> free_slots_{no_slot};
+  alignas(cache_line_size) std::atomic<uint32_t> next_worker_{0U};
+  std::atomic<bool> stopping_{false};
+};
+
+}  // namespace spinscale::nwprog::lib
@@ -0,0 +1,243 @@
+#include "src/lib/topology.hh"
+
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+namespace spinscale::nwprog::lib
+{
+
+namespace
+{
+
+/// Contents of a sysfs file without the trailing newline, empty when it can not be read.
+std::string read_file(const std::string& path)
+{
+  std::ifstream in(path);
+  std::stringstream contents;
+  contents << in.rdbuf();
+  std::string text = contents.str();
+  while (!text.empty() && (text.back() == '\n' || text.back() == ' '))
+  {
+    text.pop_back();
+  }
+  return text;
+}
+
+/// The number in a sysfs file, `fallback` when it can not be read.
+uint32_t read_number(const std::string& path, const uint32_t fallback)
+{
+  const std::string text = read_file(path);
+  uint32_t value = 0;
+  const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  return ec == std::errc{} && end == text.data() + text.size() && !text.empty() ? value : fallback;
+}
+
+}  // namespace
+
+std::vector<uint32_t> parse_cpu_list(std::string_view list)
+{
+  std::vector<uint32_t> ids;
+  while (!list.empty())
+  {
+    const size_t comma = list.find(',');
+    const std::string_view range = list.substr(0, comma);
+    list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1U);
+
+    uint32_t first = 0;
+    const auto [dash, first_ec] = std::from_chars(range.data(), range.data() + range.size(), first);
+    if (first_ec != std::errc{})
+    {
+      continue;
+    }
+    uint32_t last = first;
+    if (dash != range.data() + range.size() && *dash == '-')
+    {
+      std::from_chars(dash + 1, range.data() + range.size(), last);
+    }
+    for (uint32_t id = first; id <= last; ++id)
+    {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+std::vector<uint32_t> allowed_cpus()
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) != 0)
+  {
+    return {};
+  }
+  std::vector<uint32_t> ids;
+  for (uint32_t id = 0; id < CPU_SETSIZE; ++id)
+  {
+    if (CPU_ISSET(id, &set))
+    {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+Topology Topology::read(const std::string& root, const std::vector<uint32_t>& allowed)
+{
+  std::vector<uint32_t> online = parse_cpu_list(read_file(root + "/cpu/online"));
+  if (online.empty())
+  {
+    for (uint32_t id = 0; id < std::max(std::thread::hardware_concurrency(), 1U); ++id)
+    {
+      online.push_back(id);
+    }
+  }
+  // Before cores are numbered, so that cores without an allowed CPU are not counted.
+  std::vector<uint32_t> usable;
+  std::copy_if(
+    online.begin(), online.end(), std::back_inserter(usable),
+    [&allowed](const uint32_t id) { return std::find(allowed.begin(), allowed.end(), id) != allowed.end(); });
+  if (!usable.empty())
+  {
+    online = std::move(usable);
+  }
+
+  std::map<uint32_t, uint32_t> node_of_cpu;
+  for (const uint32_t node : parse_cpu_list(read_file(root + "/node/online")))
+  {
+    for (const uint32_t id : parse_cpu_list(read_file(root + "/node/node" + std::to_string(node) + "/cpulist")))
+    {
+      node_of_cpu[id] = node;
+    }
+  }
+
+  // Core ids are only unique within a package.
+  std::map<std::pair<uint32_t, uint32_t>, uint32_t> core_index;
+  std::vector<Cpu> cpus;
+  for (const uint32_t id : online)
+  {
+    const std::string topology = root + "/cpu/cpu" + std::to_string(id) + "/topology/";
+    const uint32_t package = read_number(topology + "physical_package_id", 0U);
+    const uint32_t core_id = read_number(topology + "core_id", id);
+    const auto [core, inserted] = core_index.try_emplace({package, core_id}, core_index.size());
+    const auto node = node_of_cpu.find(id);
+    cpus.push_back({id, core->second, package, node == node_of_cpu.end() ? 0U : node->second});
+  }
+  return Topology(std::move(cpus));
+}
+
+Topology::Topology(std::vector<Cpu> cpus) : cpus_(std::move(cpus))
+{
+}
+
+uint32_t Topology::num_cores() const
+{
+  uint32_t cores = 0;
+  for (const Cpu& cpu : cpus_)
+  {
+    cores = std::max(cores, cpu.core + 1U);
+  }
+  return cores;
+}
+
+uint32_t Topology::num_nodes() const
+{
+  uint32_t nodes = 0;
+  for (const Cpu& cpu : cpus_)
+  {
+    nodes = std::max(nodes, cpu.node + 1U);
+  }
+  return nodes;
+}
+
+uint32_t Topology::node_of(const uint32_t id) const
+{
+  const auto cpu = std::find_if(cpus_.begin(), cpus_.end(), [id](const Cpu& cpu) { return cpu.id == id; });
+  return cpu == cpus_.end() ? 0U : cpu->node;
+}
+
+std::vector<uint32_t> Topology::siblings(const uint32_t id) const
+{
+  const auto cpu = std::find_if(cpus_.begin(), cpus_.end(), [id](const Cpu& cpu) { return cpu.id == id; });
+  if (cpu == cpus_.end())
+  {
+    return {id};
+  }
+  std::vector<uint32_t> ids;
+  for (const Cpu& other : cpus_)
+  {
+    if (other.core == cpu->core)
+    {
+      ids.push_back(other.id);
+    }
+  }
+  return ids;
+}
+
+std::vector<uint32_t> Topology::placement(const uint32_t count) const
+{
+  // Rank every CPU by how many siblings of its core come before it, then by node, then by id.
+  std::vector<uint32_t> rank(cpus_.size());
+  std::map<uint32_t, uint32_t> seen_per_core;
+  for (size_t i = 0; i < cpus_.size(); ++i)
+  {
+    rank[i] = seen_per_core[cpus_[i].core]++;
+  }
+  std::vector<size_t> order(cpus_.size());
+  for (size_t i = 0; i < order.size(); ++i)
+  {
+    order[i] = i;
+  }
+  std::stable_sort(
+    order.begin(), order.end(),
+    [&](const size_t a, const size_t b)
+    { return std::pair(rank[a], cpus_[a].node) < std::pair(rank[b], cpus_[b].node); });
+
+  std::vector<uint32_t> ids;
+  for (uint32_t i = 0; i < count && !order.empty(); ++i)
+  {
+    ids.push_back(cpus_[order[i % order.size()]].id);
+  }
+  return ids;
+}
+
+Result<int32_t, Errno> pin_thread(const uint32_t id)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(id, &set);
+  if (const int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); res != 0)
+  {
+    return Err(Errno(res));
+  }
+  return Ok(0);
+}
+
+Result<int32_t, Errno> prefer_node(void* data, const size_t size, const uint32_t node)
+{
+  constexpr size_t bits_per_mask = 8U * sizeof(unsigned long);
+  if (node >= bits_per_mask)
+  {
+    return Err(Errno(EINVAL));
+  }
+  const unsigned long mask = 1UL << node;
+  // Called directly, libnuma is not needed for a single call.
+  if (syscall(SYS_mbind, data, size, MPOL_PREFERRED, &mask, bits_per_mask, 0U) != 0)
+  {
+    return Err(Errno::last());
+  }
+  return Ok(0);
+}
+
+}  // namespace spinscale::nwprog::lib
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "src/lib/errno.hh"
+
+namespace spinscale::nwprog::lib
+{
+
+/// A logical CPU as the kernel numbers it.
+struct Cpu
+{
+  uint32_t id;
+  /// Index of the physical core, shared by SMT siblings and unique across packages.
+  uint32_t core;
+  uint32_t package;
+  /// NUMA node, zero on machines without NUMA.
+  uint32_t node;
+};
+
+/// Ids of the CPUs the calling thread may run on, as sched_getaffinity(2) reports them. Empty when they can not be
+/// read.
+std::vector<uint32_t> allowed_cpus();
+
+/// The online CPUs of the machine with their cores, SMT siblings and NUMA nodes, as `/sys/devices/system` describes
+/// them. Used to place ring threads, and the memory they use, on the same node.
+class Topology
+{
+public:
+  /// Read the topology below `root`. Missing files are not an error: without NUMA support all CPUs are on node zero,
+  /// without topology files, as in some containers, every CPU is a core of its own.
+  ///
+  /// Only the online CPUs in `allowed` are kept, so a process restricted by taskset or a cgroup cpuset neither counts
+  /// nor gets placed on CPUs it can not run on. All online CPUs are kept when `allowed` is empty or has none of them.
+  static Topology read(
+    const std::string& root = "/sys/devices/system", const std::vector<uint32_t>& allowed = allowed_cpus());
+
+  /// `cpus` sorted by id.
+  explicit Topology(std::vector<Cpu> cpus);
+
+  [[nodiscard]] const std::vector<Cpu>& cpus() const
+  {
+    return cpus_;
+  }
+
+  [[nodiscard]] uint32_t num_cores() const;
+  [[nodiscard]] uint32_t num_nodes() const;
+
+  /// Node of the CPU with `id`, zero for CPUs that are not online.
+  [[nodiscard]] uint32_t node_of(uint32_t id) const;
+
+  /// Ids of the CPUs sharing a core with `id`, `id` included.
+  [[nodiscard]] std::vector<uint32_t> siblings(uint32_t id) const;
+
+  /// CPUs for `count` threads that each drive a ring. Every physical core gets a thread before any SMT sibling does,
+  /// so rings do not compete for a core while others idle, and node by node, so threads that talk to each other share
+  /// a node as long as it has cores left. Wraps around when there are more threads than CPUs.
+  [[nodiscard]] std::vector<uint32_t> placement(uint32_t count) const;
+
+private:
+  std::vector<Cpu> cpus_;
+};
+
+/// Parse a CPU or node list such as "0-3,8,10-11".
+std::vector<uint32_t> parse_cpu_list(std::string_view list);
+
+/// Pin the calling thread to the CPU with `id`.
+Result<int32_t, Errno> pin_thread(uint32_t id);
+
+/// Prefer `node` for the pages of [data, data + size), which has to start at a page boundary. Only pages that are
+/// touched afterwards are placed, and they fall back to other nodes when `node` runs out of memory.
+Result<int32_t, Errno> prefer_node(void* data, size_t size, uint32_t node);
+
+}  // namespace spinscale::nwprog::lib
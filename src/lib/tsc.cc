@@ -0,0 +1,35 @@
+#include "src/lib/tsc.hh"
+
+#include <chrono>
+#include <thread>
+
+namespace spinscale::nwprog::lib::tsc
+{
+
+namespace
+{
+
+double calibrate()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  using Clock = std::chrono::steady_clock;
+  const auto start_time = Clock::now();
+  const uint64_t start_ticks = now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  const uint64_t end_ticks = now();
+  const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time).count();
+  return static_cast<double>(end_ticks - start_ticks) / static_cast<double>(elapsed);
+#else
+  return 1.0;
+#endif
+}
+
+}  // namespace
+
+double ticks_per_ns()
+{
+  static const double ticks = calibrate();
+  return ticks;
+}
+
+}  // namespace spinscale::nwprog::lib::tsc
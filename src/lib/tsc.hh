@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+namespace spinscale::nwprog::lib::tsc
+{
+
+/// Read the time stamp counter. Cheap enough to call on every op of the hot path.
+/// Falls back to the steady clock (in ns) on targets without an invariant TSC.
+inline uint64_t now() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+#endif
+}
+
+/// Number of ticks per nanosecond. Calibrated against the steady clock on first use.
+double ticks_per_ns();
+
+/// Convert a tick delta to nanoseconds.
+inline double to_ns(const uint64_t ticks)
+{
+  return static_cast<double>(ticks) / ticks_per_ns();
+}
+
+}  // namespace spinscale::nwprog::lib::tsc
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+#include "src/lib/codel.hh"
+
+namespace spinscale::nwprog::server
+{
+
+/// How much a server loop takes on before it sheds load at the door.
+struct Admission
+{
+  /// Connections served at once per ring. Accepting pauses at the limit and further clients wait in the listen
+  /// backlog. Lowered further when the ops of that many connections would not fit into the completion queue.
+  uint32_t max_connections{4096U};
+  /// Queue delay target and interval of the overload detection, see lib::CoDel. While overloaded, new connections are
+  /// closed right away and commands that waited too long are answered with an error instead of being served late.
+  uint64_t target_delay_ns{lib::CoDel::default_target_ns};
+  uint64_t interval_ns{lib::CoDel::default_interval_ns};
+};
+
+/// What a server loop shed instead of serving.
+struct ShedStats
+{
+  /// Accepting paused at the connection or in flight limit.
+  uint64_t accept_pauses{0};
+  /// Connections closed right after accepting them while overloaded.
+  uint64_t rejected_connections{0};
+  /// Requests answered with an overload error.
+  uint64_t shed_requests{0};
+
+  void merge(const ShedStats& other)
+  {
+    accept_pauses += other.accept_pauses;
+    rejected_connections += other.rejected_connections;
+    shed_requests += other.shed_requests;
+  }
+};
+
+}  // namespace spinscale::nwprog::server
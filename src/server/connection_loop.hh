@@ -0,0 +1,462 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/io/queue_delay.hh"
+#include "src/io/uring.hh"
+#include "src/lib/byte_ring.hh"
+#include "src/lib/codel.hh"
+#include "src/lib/dirty_list.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/log.hh"
+#include "src/lib/tsc.hh"
+#include "src/server/admission.hh"
+
+namespace spinscale::nwprog::server
+{
+
+/// Ops of `ConnectionLoop` itself. Servers number their own ops from `first_server_op` on.
+enum class LoopOp : uint8_t
+{
+  accept,
+  read,
+  write,
+};
+
+constexpr uint8_t first_server_op = 3U;
+
+/// User data of an op: what it is, the connection it belongs to and a small index of the server's choosing.
+union OpData
+{
+  struct
+  {
+    uint8_t type;
+    uint8_t slot;
+    uint32_t connection;
+  } unpacked;
+  uint64_t packed;
+};
+
+/// Sizes and op budget of the connections of a server.
+struct ConnectionLayout
+{
+  /// Requests are parsed in place, so the input buffer is mirrored and a request that wraps around is contiguous.
+  uint32_t input_size;
+  /// Answers of pipelined requests pile up in the output until they are written.
+  uint32_t output_size;
+  /// Ops a connection has in flight at most, its read and write included.
+  uint32_t ops_per_connection;
+  /// Ops of the server that belong to no connection, the accept included.
+  uint32_t loop_ops;
+};
+
+/// The part of a connection every server has. Servers derive their connections from it and add what their protocol
+/// needs.
+struct StreamConnection
+{
+  StreamConnection(const int fd, const uint32_t generation, lib::ByteRing input, const uint32_t output_size)
+    : fd(fd)
+    , generation(generation)
+    , input(std::move(input))
+    , output(std::in_place, output_size, lib::ByteRing::Mapping::single)
+  {
+  }
+
+  int fd;
+  /// Tells answers that arrive for an earlier connection with the same id apart.
+  uint32_t generation;
+  /// Released once the connection is closed.
+  std::optional<lib::ByteRing> input;
+  std::optional<lib::ByteRing> output;
+  /// The iovecs have to stay alive until their op was submitted.
+  struct iovec read_iovecs[2];
+  struct iovec write_iovecs[2];
+  bool reading{false};
+  bool writing{false};
+  /// The client shut down its side, pending answers are still flushed.
+  bool read_done{false};
+  /// The last answer announced the close, or answered a broken request, nothing more is parsed.
+  bool closing{false};
+  bool failed{false};
+};
+
+/// The accept, read and write loop of a request/response server on a ring, shared by the HTTP and key value servers.
+/// `Server` derives from it and parses and answers what arrives on a `Connection`, which derives from
+/// `StreamConnection`.
+///
+/// Accepted connections get a mirrored input and an output buffer and a read into all free input space. Completions
+/// only mark their connection, all answers of a loop iteration leave with one writev per connection. A connection is
+/// closed once the client is done or the server closes it and everything is flushed, its id is reused by the next one.
+///
+/// Load beyond `Admission` is shed at the door: accepting pauses at the connection limit, when the ops of another
+/// connection would not fit into the completion queue and while out of descriptors. While the queue delay says the
+/// loop is overloaded new connections are closed right away, and servers ask `shedding()` whether to answer late
+/// requests with an error.
+///
+/// The server provides, as members the loop calls:
+///   void on_read(uint32_t id)     the input got data, answer what is complete
+///   void on_written(uint32_t id)  the output got room, go on with what was held back
+///   void on_op(OpData, io::IoResult)  completion of one of the server's own ops
+/// and may replace these defaults:
+///   bool may_read(const Connection&)   false holds back reads while too many answers are queued
+///   bool flushed(const Connection&)    answers the server still holds outside the output
+///   bool keeps_open(uint32_t id)       the server closes the connection later, e.g. after a file
+///   void on_release(Connection&)       drop the server's state of a closed connection
+///   void end_iteration()               right before the loop submits and waits again
+template <class Server, class Connection>
+class ConnectionLoop
+{
+public:
+  ConnectionLoop(const int listen_fd, io::Uring& ring, const Admission& admission, const ConnectionLayout& layout)
+    : ring_(ring)
+    , listen_fd_(listen_fd)
+    , layout_(layout)
+    , max_connections_(std::min(
+        admission.max_connections, (ring.completion_queue_size() - layout.loop_ops) / layout.ops_per_connection))
+    , codel_(admission.target_delay_ns, admission.interval_ns)
+  {
+    log::expects(max_connections_ > 0, "the ring is too small to serve a single connection.");
+  }
+
+  ConnectionLoop(const ConnectionLoop&) = delete;
+  ConnectionLoop& operator=(const ConnectionLoop&) = delete;
+
+  /// Completion callback.
+  void operator()(void* user_data, const io::IoResult result)
+  {
+    const OpData op{.packed = reinterpret_cast<uint64_t>(user_data)};
+    const uint32_t id = op.unpacked.connection;
+    --in_flight_;
+    if (op.unpacked.type >= first_server_op)
+    {
+      server().on_op(op, result);
+      return;
+    }
+    switch (static_cast<LoopOp>(op.unpacked.type))
+    {
+      case LoopOp::accept:
+      {
+        accepting_ = false;
+        if (result.is_ok())
+        {
+          admit(result.value());
+        }
+        else if (result.contains_err(lib::Errno(EMFILE)) || result.contains_err(lib::Errno(ENFILE)))
+        {
+          // Accepting again would fail right away, wait for a descriptor to be released.
+          log::warn("out of descriptors, accepting pauses until a connection closes.");
+          out_of_descriptors_ = true;
+        }
+        else
+        {
+          log::warn(std::string("accept failed: ").append(result.error().message()));
+        }
+        resume_accept();
+        break;
+      }
+      case LoopOp::read:
+      {
+        Connection& connection = connections_[id];
+        connection.reading = false;
+        // Failed reads are treated like a closed connection.
+        if (result.value_or(0) <= 0)
+        {
+          connection.read_done = true;
+        }
+        else
+        {
+          connection.input->commit(result.value());
+          server().on_read(id);
+        }
+        resume(id);
+        break;
+      }
+      case LoopOp::write:
+      {
+        Connection& connection = connections_[id];
+        connection.writing = false;
+        if (result.value_or(0) <= 0)
+        {
+          connection.failed = true;
+        }
+        else
+        {
+          connection.output->consume(result.value());
+          server().on_written(id);
+        }
+        resume(id);
+        break;
+      }
+    }
+  }
+
+protected:
+  /// Accept and serve until `stopped()`, which is checked whenever waiting for completions returns. Closes the
+  /// connections that are still open.
+  template <class StopFn>
+  void serve(StopFn&& stopped)
+  {
+    resume_accept();
+    ring_.submit_or_defer();
+    while (!stopped())
+    {
+      queue_delay_.before_wait(ring_);
+      const auto handled = ring_.for_every_completion(*this);
+      log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+      pending_writes_.drain([this](const uint32_t id) { start_write(id); });
+      server().end_iteration();
+      ring_.submit_or_defer();
+    }
+    for (const Connection& connection : connections_)
+    {
+      if (connection.input)
+      {
+        close(connection.fd);
+      }
+    }
+  }
+
+  /// Prepare an op of `type`, a `LoopOp` or one of the server's, with a submit in between when the submission queue
+  /// is full. False when there is no room even then.
+  template <class PrepareFn, class Type>
+  bool prepare(PrepareFn&& prepare_fn, const Type type, const uint32_t id, const uint8_t slot = 0U)
+  {
+    const OpData op{.unpacked{.type = static_cast<uint8_t>(type), .slot = slot, .connection = id}};
+    void* user_data = reinterpret_cast<void*>(op.packed);
+    if (prepare_fn(user_data).is_error())
+    {
+      // The submission queue is full, make room and try once more.
+      ring_.submit_or_defer();
+      if (prepare_fn(user_data).is_error())
+      {
+        return false;
+      }
+    }
+    ++in_flight_;
+    return true;
+  }
+
+  /// Whether requests handled now waited too long while the loop is overloaded. Call once per batch of requests.
+  bool shedding()
+  {
+    const uint64_t now = lib::tsc::now();
+    return codel_.should_shed(static_cast<uint64_t>(lib::tsc::to_ns(now)), queue_delay_.of(now));
+  }
+
+  /// Start whatever the connection can do next and close it when it is done. The write waits for the end of the loop
+  /// iteration.
+  void resume(const uint32_t id)
+  {
+    pending_writes_.mark(id);
+    start_read(id);
+    release_if_done(id);
+  }
+
+  /// Close the socket and free the buffers once the connection is finished and no op refers to them anymore.
+  void release_if_done(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    if (!connection.input || server().keeps_open(id))
+    {
+      return;
+    }
+    const bool flushed = connection.output->empty() && server().flushed(connection);
+    const bool done = connection.failed || ((connection.read_done || connection.closing) && flushed);
+    if (!done)
+    {
+      return;
+    }
+    if (connection.reading)
+    {
+      // A read is still armed on a connection that is closed by the server, wake it up.
+      shutdown(connection.fd, SHUT_RDWR);
+      return;
+    }
+    if (!connection.writing)
+    {
+      close(connection.fd);
+      connection.input.reset();
+      connection.output.reset();
+      server().on_release(connection);
+      free_ids_.push_back(id);
+      --open_connections_;
+      out_of_descriptors_ = false;
+      resume_accept();
+    }
+  }
+
+  /// Defaults of the hooks a server may replace.
+  bool may_read(const Connection& /*connection*/) const
+  {
+    return true;
+  }
+
+  bool flushed(const Connection& /*connection*/) const
+  {
+    return true;
+  }
+
+  bool keeps_open(const uint32_t /*id*/) const
+  {
+    return false;
+  }
+
+  void on_release(Connection& /*connection*/)
+  {
+  }
+
+  void end_iteration()
+  {
+  }
+
+  /// Accepted connections and the shed load, for the server's stats.
+  [[nodiscard]] uint64_t accepted() const
+  {
+    return accepted_;
+  }
+
+  io::Uring& ring_;
+  ShedStats shed_{};
+  /// A deque keeps connections in place while new ones are added, ids of closed ones are reused.
+  std::deque<Connection> connections_{};
+  /// Connections with answers staged during the current loop iteration.
+  lib::DirtyList pending_writes_{};
+
+private:
+  Server& server()
+  {
+    return static_cast<Server&>(*this);
+  }
+
+  /// Accept the next connection unless one is being accepted already or the limits are reached. Connections waiting
+  /// in the listen backlog are cheap, ops that do not fit into the completion queue are not.
+  void resume_accept()
+  {
+    if (accepting_)
+    {
+      return;
+    }
+    if (open_connections_ >= max_connections_ || out_of_descriptors_ ||
+        in_flight_ + layout_.ops_per_connection + 1U > ring_.completion_queue_size())
+    {
+      if (!accept_paused_)
+      {
+        accept_paused_ = true;
+        ++shed_.accept_pauses;
+      }
+      return;
+    }
+    accept_paused_ = false;
+    accepting_ = prepare(
+      [&](void* user_data)
+      { return ring_.prepare_accept(listen_fd_, (struct sockaddr*)&client_addr_, &client_addr_len_, user_data); },
+      LoopOp::accept, 0);
+    log::expects(accepting_, "unable to prepare the next accept.");
+  }
+
+  /// Serve a new connection, or close it right away while overloaded. Turning it away costs less than serving all
+  /// connections late.
+  void admit(const int fd)
+  {
+    if (codel_.overloaded(static_cast<uint64_t>(lib::tsc::to_ns(lib::tsc::now()))))
+    {
+      ++shed_.rejected_connections;
+      close(fd);
+      return;
+    }
+    lib::ByteRing input(layout_.input_size);
+    if (!input.mirrored())
+    {
+      // Mirroring takes a descriptor for a moment, the accept got the last one.
+      out_of_descriptors_ = true;
+      close(fd);
+      return;
+    }
+    ++accepted_;
+    ++open_connections_;
+    uint32_t id = 0;
+    if (free_ids_.empty())
+    {
+      id = connections_.size();
+      connections_.emplace_back(fd, 0U, std::move(input), layout_.output_size);
+    }
+    else
+    {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+      connections_[id] = Connection(fd, connections_[id].generation + 1U, std::move(input), layout_.output_size);
+    }
+    start_read(id);
+  }
+
+  /// Read into all free input space unless a read is in flight, the input is full or the server holds reads back.
+  /// Reads resume once answers are written and the requests they belong to are dropped.
+  void start_read(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    if (!connection.input || connection.reading || connection.read_done || connection.closing || connection.failed)
+    {
+      return;
+    }
+    const uint32_t count = connection.input->writable(connection.read_iovecs);
+    if (count == 0 || !server().may_read(connection))
+    {
+      return;
+    }
+    connection.reading = prepare(
+      [&](void* user_data) { return ring_.prepare_readv(connection.fd, connection.read_iovecs, count, 0, user_data); },
+      LoopOp::read, id);
+  }
+
+  /// Write all pending answers at once unless a write is in flight.
+  void start_write(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    if (!connection.input || connection.writing || connection.failed)
+    {
+      return;
+    }
+    const uint32_t count = connection.output->readable(connection.write_iovecs);
+    if (count == 0)
+    {
+      return;
+    }
+    connection.writing = prepare(
+      [&](void* user_data)
+      { return ring_.prepare_writev(connection.fd, connection.write_iovecs, count, 0, user_data); },
+      LoopOp::write, id);
+  }
+
+  const int listen_fd_;
+  const ConnectionLayout layout_;
+  const uint32_t max_connections_;
+  uint32_t open_connections_{0};
+  uint64_t accepted_{0};
+  /// Ops prepared and not completed yet, never more than the completion queue holds.
+  uint32_t in_flight_{0};
+  bool accepting_{false};
+  bool accept_paused_{false};
+  /// The last accept ran out of descriptors.
+  bool out_of_descriptors_{false};
+  lib::CoDel codel_;
+  io::QueueDelay queue_delay_{};
+  std::vector<uint32_t> free_ids_{};
+  // There is a single accept in flight, so a single address is enough. It has room for IPv6 peers.
+  struct sockaddr_storage client_addr_
+  {
+  };
+  socklen_t client_addr_len_{sizeof(client_addr_)};
+};
+
+}  // namespace spinscale::nwprog::server
@@ -0,0 +1,311 @@
+#include "src/server/http.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "src/lib/byte_scan.hh"
+
+namespace spinscale::nwprog::server::http
+{
+
+namespace
+{
+
+enum class LineStatus : uint8_t
+{
+  complete,
+  incomplete,
+  malformed,
+};
+
+/// Cut the next CRLF terminated line off the front of `data`. Bare CRs and LFs are malformed.
+LineStatus next_line(std::string_view& data, std::string_view& line)
+{
+  const size_t end = lib::find_first_of<'\r', '\n'>(data);
+  if (end < data.size() && data[end] == '\n')
+  {
+    return LineStatus::malformed;
+  }
+  if (end + 1U >= data.size())
+  {
+    return LineStatus::incomplete;
+  }
+  if (data[end + 1U] != '\n')
+  {
+    return LineStatus::malformed;
+  }
+  line = data.substr(0, end);
+  data.remove_prefix(end + 2U);
+  return LineStatus::complete;
+}
+
+/// Case insensitive comparison with `lower`, which has to be lower case already.
+bool equals_lower(const std::string_view value, const std::string_view lower)
+{
+  return value.size() == lower.size() &&
+         std::equal(
+           value.begin(), value.end(), lower.begin(),
+           [](const char a, const char b) { return (a >= 'A' && a <= 'Z' ? a + ('a' - 'A') : a) == b; });
+}
+
+std::string_view trim(std::string_view value)
+{
+  while (!value.empty() && (value.front() == ' ' || value.front() == '\t'))
+  {
+    value.remove_prefix(1);
+  }
+  while (!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+  {
+    value.remove_suffix(1);
+  }
+  return value;
+}
+
+Method parse_method(const std::string_view method)
+{
+  if (method == "GET")
+  {
+    return Method::get;
+  }
+  if (method == "HEAD")
+  {
+    return Method::head;
+  }
+  if (method == "POST")
+  {
+    return Method::post;
+  }
+  if (method == "PUT")
+  {
+    return Method::put;
+  }
+  return Method::other;
+}
+
+/// "METHOD SP target SP HTTP/1.x"
+bool parse_request_line(std::string_view line, Request& request)
+{
+  const size_t method_end = lib::find_first_of<' '>(line);
+  if (method_end == 0 || method_end == line.size())
+  {
+    return false;
+  }
+  request.method = parse_method(line.substr(0, method_end));
+  line.remove_prefix(method_end + 1U);
+
+  const size_t target_end = lib::find_first_of<' '>(line);
+  if (target_end == 0 || target_end == line.size())
+  {
+    return false;
+  }
+  request.target = line.substr(0, target_end);
+  line.remove_prefix(target_end + 1U);
+
+  if (line.size() != 8U || !line.starts_with("HTTP/1.") || (line[7] != '0' && line[7] != '1'))
+  {
+    return false;
+  }
+  request.minor_version = static_cast<uint8_t>(line[7] - '0');
+  request.keep_alive = request.minor_version == 1U;
+  return true;
+}
+
+/// Apply the tokens of a Connection header, e.g. "keep-alive, Upgrade".
+void parse_connection(std::string_view value, Request& request)
+{
+  while (!value.empty())
+  {
+    const size_t comma = lib::find_first_of<','>(value);
+    const std::string_view token = trim(value.substr(0, comma));
+    if (equals_lower(token, "close"))
+    {
+      request.keep_alive = false;
+    }
+    else if (equals_lower(token, "keep-alive"))
+    {
+      request.keep_alive = true;
+    }
+    value.remove_prefix(std::min(comma + 1U, value.size()));
+  }
+}
+
+}  // namespace
+
+lib::Result<int32_t, lib::Errno> parse_request(
+  const std::string_view data, Request& request, const uint32_t max_request_size)
+{
+  request = Request{};
+  // Everything beyond the limit is left alone, a request that is not complete within it is too large.
+  const std::string_view window = data.substr(0, max_request_size);
+  std::string_view rest = window;
+  const auto incomplete = [&]() -> lib::Result<int32_t, lib::Errno>
+  {
+    if (data.size() >= max_request_size)
+    {
+      return lib::Err(lib::Errno(EMSGSIZE));
+    }
+    return lib::Ok(0);
+  };
+
+  std::string_view line;
+  switch (next_line(rest, line))
+  {
+    case LineStatus::incomplete:
+      return incomplete();
+    case LineStatus::malformed:
+      return lib::Err(lib::Errno(EBADMSG));
+    case LineStatus::complete:
+      break;
+  }
+  if (!parse_request_line(line, request))
+  {
+    return lib::Err(lib::Errno(line.find(" HTTP/") != std::string_view::npos ? ENOTSUP : EBADMSG));
+  }
+
+  std::optional<uint32_t> content_length;
+  while (true)
+  {
+    switch (next_line(rest, line))
+    {
+      case LineStatus::incomplete:
+        return incomplete();
+      case LineStatus::malformed:
+        return lib::Err(lib::Errno(EBADMSG));
+      case LineStatus::complete:
+        break;
+    }
+    if (line.empty())
+    {
+      break;
+    }
+    const size_t colon = lib::find_first_of<':'>(line);
+    if (colon == 0 || colon == line.size() || line[colon - 1U] == ' ' || line[colon - 1U] == '\t')
+    {
+      return lib::Err(lib::Errno(EBADMSG));
+    }
+    const std::string_view name = line.substr(0, colon);
+    const std::string_view value = trim(line.substr(colon + 1U));
+    if (equals_lower(name, "content-length"))
+    {
+      uint32_t length = 0;
+      const auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+      // Conflicting lengths are a classic request smuggling vector.
+      if (ec != std::errc{} || end != value.data() + value.size() || (content_length && *content_length != length))
+      {
+        return lib::Err(lib::Errno(EBADMSG));
+      }
+      content_length = length;
+    }
+    else if (equals_lower(name, "connection"))
+    {
+      parse_connection(value, request);
+    }
+    else if (equals_lower(name, "transfer-encoding"))
+    {
+      return lib::Err(lib::Errno(ENOTSUP));
+    }
+  }
+
+  const size_t head_size = window.size() - rest.size();
+  const size_t body_size = content_length.value_or(0U);
+  if (head_size + body_size > max_request_size)
+  {
+    return lib::Err(lib::Errno(EMSGSIZE));
+  }
+  if (data.size() < head_size + body_size)
+  {
+    return lib::Ok(0);
+  }
+  request.body = data.substr(head_size, body_size);
+  return lib::Ok(static_cast<int32_t>(head_size + body_size));
+}
+
+std::string render_head(
+  const std::string_view status, const std::string_view content_type, const uint64_t content_length,
+  const bool keep_alive)
+{
+  std::string head;
+  head.append("HTTP/1.1 ").append(status).append("\r\n");
+  head.append("Content-Type: ").append(content_type).append("\r\n");
+  head.append("Content-Length: ").append(std::to_string(content_length)).append("\r\n");
+  head.append("Connection: ").append(keep_alive ? "keep-alive" : "close").append("\r\n\r\n");
+  return head;
+}
+
+std::optional<std::string_view> file_path(const std::string_view target, const std::string_view prefix)
+{
+  if (!target.starts_with(prefix))
+  {
+    return std::nullopt;
+  }
+  const std::string_view path = target.substr(prefix.size(), target.find('?') - prefix.size());
+  if (path.empty())
+  {
+    return std::nullopt;
+  }
+  size_t start = 0;
+  while (start <= path.size())
+  {
+    const size_t end = std::min(path.find('/', start), path.size());
+    const std::string_view segment = path.substr(start, end - start);
+    if (segment.empty() || segment == "." || segment == "..")
+    {
+      return std::nullopt;
+    }
+    start = end + 1U;
+  }
+  return path;
+}
+
+std::string_view content_type_of(const std::string_view path)
+{
+  constexpr std::pair<std::string_view, std::string_view> types[] = {
+    {".html", "text/html"},
+    {".txt", "text/plain"},
+    {".css", "text/css"},
+    {".js", "text/javascript"},
+    {".json", "application/json"},
+    {".png", "image/png"},
+    {".jpg", "image/jpeg"},
+    {".svg", "image/svg+xml"},
+  };
+  for (const auto& [extension, type] : types)
+  {
+    if (path.ends_with(extension))
+    {
+      return type;
+    }
+  }
+  return "application/octet-stream";
+}
+
+Response::Response(const std::string_view status, const std::string_view content_type, const std::string_view body)
+  : keep_alive_(render_head(status, content_type, body.size(), true))
+  , close_(render_head(status, content_type, body.size(), false))
+  , keep_alive_head_size_(keep_alive_.size())
+  , close_head_size_(close_.size())
+{
+  keep_alive_.append(body);
+  close_.append(body);
+}
+
+std::string_view Response::bytes(const Request& request) const
+{
+  const std::string_view response = request.keep_alive ? keep_alive_ : close_;
+  if (request.method == Method::head)
+  {
+    return response.substr(0, request.keep_alive ? keep_alive_head_size_ : close_head_size_);
+  }
+  return response;
+}
+
+std::string_view Response::closing_bytes() const
+{
+  return close_;
+}
+
+}  // namespace spinscale::nwprog::server::http
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "src/lib/errno.hh"
+
+namespace spinscale::nwprog::server::http
+{
+
+/// Upper bound of a request including its body. Larger ones are rejected with EMSGSIZE.
+inline constexpr uint32_t default_max_request_size = 8U * 1024U;
+
+enum class Method : uint8_t
+{
+  get,
+  head,
+  post,
+  put,
+  other,
+};
+
+/// The parts of a request the server acts on. All views point into the parsed buffer.
+struct Request
+{
+  Method method{Method::other};
+  std::string_view target{};
+  /// 0 for HTTP/1.0, 1 for HTTP/1.1.
+  uint8_t minor_version{1U};
+  /// Persistent by default for HTTP/1.1, on request for HTTP/1.0, see the Connection header.
+  bool keep_alive{true};
+  std::string_view body{};
+};
+
+/// Parse the request at the front of `data`, which may hold more pipelined requests after it.
+///
+/// Returns the size of the request including its body, or zero when it is incomplete and more data is needed. Fails
+/// with EBADMSG for malformed requests, EMSGSIZE when the request does not fit into `max_request_size` and ENOTSUP
+/// for what is not implemented, e.g. chunked bodies or HTTP/2. Lines are found with the vectorized byte scanner, so
+/// the usual request is looked at 16 to 32 bytes at a time.
+lib::Result<int32_t, lib::Errno> parse_request(
+  std::string_view data, Request& request, uint32_t max_request_size = default_max_request_size);
+
+/// Status line and headers of a response whose body of `content_length` bytes is sent on its own, e.g. from a file.
+std::string render_head(
+  std::string_view status, std::string_view content_type, uint64_t content_length, bool keep_alive);
+
+/// The path below `prefix` that `target` asks for, without the query. Nothing when `target` is not below `prefix` or
+/// the path is empty, absolute or has empty, `.` or `..` segments, so it can not leave the directory it is looked up
+/// in, at least not without following a symlink.
+std::optional<std::string_view> file_path(std::string_view target, std::string_view prefix);
+
+/// Content type by the extension of `path`, application/octet-stream for the ones not known.
+std::string_view content_type_of(std::string_view path);
+
+/// A complete response rendered once up front, so answering a request is a single copy of ready bytes.
+class Response
+{
+public:
+  /// `status` is the code and reason, e.g. "200 OK".
+  Response(std::string_view status, std::string_view content_type, std::string_view body);
+
+  /// The bytes to send in reply to `request`: without the body for HEAD and announcing the close when the connection
+  /// is not kept alive.
+  [[nodiscard]] std::string_view bytes(const Request& request) const;
+  /// The bytes to send when the request could not be parsed, the connection is closed afterwards.
+  [[nodiscard]] std::string_view closing_bytes() const;
+
+private:
+  std::string keep_alive_;
+  std::string close_;
+  /// Size of the status line and the headers, which is all a HEAD request gets.
+  size_t keep_alive_head_size_;
+  size_t close_head_size_;
+};
+
+}  // namespace spinscale::nwprog::server::http
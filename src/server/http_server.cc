@@ -0,0 +1,673 @@
+#include "src/server/http_server.hh"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "src/io/file_reader.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/log.hh"
+#include "src/server/connection_loop.hh"
+#include "src/server/http.hh"
+
+namespace spinscale::nwprog::server
+{
+
+namespace
+{
+
+/// Requests are parsed in place, so the input buffer is mirrored and a request that wraps around is contiguous.
+constexpr uint32_t input_buffer_size = 16U * 1024U;
+/// Answers of pipelined requests pile up here until they are written.
+constexpr uint32_t output_buffer_size = 16U * 1024U;
+/// A read and a write per connection.
+constexpr uint32_t ops_per_connection = 2U;
+constexpr std::string_view static_prefix = "/static/";
+/// Of a splice from a file into the pipe, which holds 64KiB unless it was resized.
+constexpr uint32_t pipe_chunk_size = 64U * 1024U;
+/// Of reads in direct mode, and how many of them are read ahead of the socket.
+constexpr uint32_t file_chunk_size = 64U * 1024U;
+constexpr uint32_t file_readahead = 4U;
+
+enum class OpType : uint8_t
+{
+  /// Of the file a response is sent from.
+  open = first_server_op,
+  stat,
+  close,
+  /// File to pipe in splice mode, file to one of the reader's buffers in direct mode.
+  file_splice,
+  file_read,
+  /// Pipe to socket in splice mode and the wait for room when the socket is full, buffer to socket in direct mode.
+  body_splice,
+  body_poll,
+  body_write,
+};
+
+/// All answers the server gives, rendered once.
+struct Responses
+{
+  const http::Response& route(const http::Request& request) const
+  {
+    const bool known = request.target == "/health" || request.target == "/json";
+    if (!known)
+    {
+      return not_found;
+    }
+    if (request.method != http::Method::get && request.method != http::Method::head)
+    {
+      return method_not_allowed;
+    }
+    return request.target == "/health" ? health : json;
+  }
+
+  /// The answer to a request that failed to parse with `error`.
+  const http::Response& reject(const lib::Errno error) const
+  {
+    switch (error.value())
+    {
+      case EMSGSIZE:
+        return too_large;
+      case ENOTSUP:
+        return not_implemented;
+      default:
+        return bad_request;
+    }
+  }
+
+  const http::Response health{"200 OK", "text/plain", "OK\n"};
+  const http::Response json{"200 OK", "application/json", "{\"status\":\"ok\",\"service\":\"nwprog\"}\n"};
+  const http::Response not_found{"404 Not Found", "text/plain", "not found\n"};
+  const http::Response method_not_allowed{"405 Method Not Allowed", "text/plain", "method not allowed\n"};
+  const http::Response bad_request{"400 Bad Request", "text/plain", "bad request\n"};
+  const http::Response too_large{"413 Content Too Large", "text/plain", "request too large\n"};
+  const http::Response not_implemented{"501 Not Implemented", "text/plain", "not implemented\n"};
+  const http::Response unavailable{"503 Service Unavailable", "text/plain", "overloaded\n"};
+};
+
+enum class FileStage : uint8_t
+{
+  opening,
+  stating,
+  /// The head is in the output, the body follows once it was written.
+  sending,
+  closing,
+};
+
+/// A response sent from a file. Only one op of it is in flight at a time, except for the reads in direct mode.
+struct FileTransfer
+{
+  /// Below the root, null terminated for the open.
+  std::string path;
+  /// The parts of the request the answer depends on, its views are gone with the input.
+  http::Request request;
+  FileStage stage{FileStage::opening};
+  int fd{-1};
+  /// Opened with O_DIRECT. A file system that does not support it fails the open, which is tried again without then.
+  bool direct{false};
+  struct statx stat
+  {
+  };
+  uint64_t size{0U};
+  /// Splice mode: bytes spliced from the file so far, and those of them still in the pipe.
+  uint64_t offset{0U};
+  uint32_t piped{0U};
+  std::array<int, 2> pipe{-1, -1};
+  /// Direct mode.
+  std::unique_ptr<io::FileReader> reader{};
+  /// File ops in flight.
+  uint32_t ops{0U};
+  /// A splice from the file is in flight, and one to the socket or the wait for room.
+  bool filling{false};
+  bool sending{false};
+};
+
+struct Connection : StreamConnection
+{
+  using StreamConnection::StreamConnection;
+
+  /// The response being sent from a file, requests pipelined after it wait until it is done.
+  std::optional<FileTransfer> file{};
+};
+
+class HttpServer : public ConnectionLoop<HttpServer, Connection>
+{
+public:
+  HttpServer(const int listen_fd, io::Uring& ring, const Admission& admission, const StaticFiles& files)
+    // The accept is the one op that is not a connection's.
+    : ConnectionLoop(
+        listen_fd, ring, admission, {input_buffer_size, output_buffer_size, ops_per_connection + file_ops(files), 1U})
+    , file_mode_(files.mode)
+  {
+    if (!files.root.empty())
+    {
+      // Looked up once, files are opened relative to it.
+      root_fd_ = open(files.root.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+      log::expects(root_fd_ >= 0, "unable to open the directory of the static files.");
+    }
+  }
+
+  HttpStats run(const std::atomic<bool>& stop)
+  {
+    serve([&stop]() { return stop.load(std::memory_order_relaxed); });
+    for (Connection& connection : connections_)
+    {
+      if (connection.file && connection.file->fd >= 0)
+      {
+        close(connection.file->fd);
+      }
+      if (connection.file)
+      {
+        release_pipe(connection.file->pipe, false);
+      }
+    }
+    for (const auto& pipe : idle_pipes_)
+    {
+      release_pipe(pipe, false);
+    }
+    if (root_fd_ >= 0)
+    {
+      close(root_fd_);
+    }
+    stats_.connections = accepted();
+    stats_.shed = shed_;
+    return stats_;
+  }
+
+private:
+  friend ConnectionLoop;
+
+  void on_read(const uint32_t id)
+  {
+    handle_requests(id);
+  }
+
+  void on_written(const uint32_t id)
+  {
+    // Requests that did not fit into the output buffer may be answered now, and the body of a file follows once its
+    // head is out.
+    handle_requests(id);
+    pump_file(id);
+  }
+
+  /// The connection ends with its file, which calls back.
+  bool keeps_open(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    if (!connection.file)
+    {
+      return false;
+    }
+    if (connection.failed)
+    {
+      finish_file(id);
+    }
+    return true;
+  }
+
+  /// Ops a connection has in flight for a file at most, on top of its read and write.
+  static uint32_t file_ops(const StaticFiles& files)
+  {
+    if (files.root.empty())
+    {
+      return 0U;
+    }
+    // The reads ahead and the write of the current chunk in direct mode, a single op after the other in splice mode.
+    return files.mode == FileMode::direct ? file_readahead + 1U : 1U;
+  }
+
+  /// Answer every complete request in the input buffer, as long as the answers fit into the output buffer. Requests
+  /// that waited too long while the loop is overloaded are answered with 503 instead. A request for a file stops
+  /// the loop until the file is sent.
+  void handle_requests(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    const bool shed = shedding();
+    http::Request request;
+    while (!connection.closing && !connection.failed && !connection.file)
+    {
+      const auto parsed = http::parse_request(connection.input->filled(), request);
+      if (parsed.contains(0))
+      {
+        return;
+      }
+      if (parsed.is_error())
+      {
+        // Nothing after a broken request can be trusted, answer and close.
+        const std::string_view answer = responses_.reject(parsed.error()).closing_bytes();
+        if (connection.output->free_space() < answer.size())
+        {
+          return;
+        }
+        connection.output->append(answer);
+        connection.closing = true;
+        ++stats_.bad_requests;
+        return;
+      }
+      const auto path = root_fd_ >= 0 ? http::file_path(request.target, static_prefix) : std::nullopt;
+      const bool get_or_head = request.method == http::Method::get || request.method == http::Method::head;
+      if (!shed && path && get_or_head)
+      {
+        // The head of the file goes first into an empty output, behind the answers before it.
+        if (!connection.output->empty())
+        {
+          return;
+        }
+        open_file(id, *path, request);
+        connection.input->consume(parsed.value());
+        connection.closing = !request.keep_alive;
+        ++stats_.requests;
+        return;
+      }
+      const http::Response& response = shed                  ? responses_.unavailable
+                                       : path && !get_or_head ? responses_.method_not_allowed
+                                                              : responses_.route(request);
+      const std::string_view answer = response.bytes(request);
+      if (connection.output->free_space() < answer.size())
+      {
+        return;
+      }
+      connection.output->append(answer);
+      connection.input->consume(parsed.value());
+      connection.closing = !request.keep_alive;
+      if (shed)
+      {
+        ++shed_.shed_requests;
+      }
+      else
+      {
+        ++stats_.requests;
+      }
+    }
+  }
+
+  void open_file(const uint32_t id, const std::string_view path, const http::Request& request)
+  {
+    Connection& connection = connections_[id];
+    FileTransfer& file = connection.file.emplace();
+    file.path = path;
+    file.request = http::Request{
+      .method = request.method, .minor_version = request.minor_version, .keep_alive = request.keep_alive};
+    file.direct = file_mode_ == FileMode::direct;
+    start_open(id);
+  }
+
+  void start_open(const uint32_t id)
+  {
+    FileTransfer& file = *connections_[id].file;
+    const int flags = O_RDONLY | O_CLOEXEC | (file.direct ? O_DIRECT : 0);
+    file_op(
+      id, [&](void* user_data) { return ring_.prepare_openat(root_fd_, file.path.c_str(), flags, 0, user_data); },
+      OpType::open);
+  }
+
+  /// Prepare an op of the file, the connection fails when there is no room for it.
+  template <class PrepareFn>
+  bool file_op(const uint32_t id, PrepareFn&& prepare_fn, const OpType type, const uint8_t slot = 0U)
+  {
+    Connection& connection = connections_[id];
+    if (!prepare(prepare_fn, type, id, slot))
+    {
+      connection.failed = true;
+      return false;
+    }
+    ++connection.file->ops;
+    return true;
+  }
+
+  void on_op(const OpData op, const io::IoResult result)
+  {
+    const uint32_t id = op.unpacked.connection;
+    Connection& connection = connections_[id];
+    FileTransfer& file = *connection.file;
+    --file.ops;
+    switch (static_cast<OpType>(op.unpacked.type))
+    {
+      case OpType::open:
+      {
+        if (result.is_ok())
+        {
+          file.fd = result.value();
+        }
+        if (connection.failed)
+        {
+          break;
+        }
+        if (result.contains_err(lib::Errno(EINVAL)) && file.direct)
+        {
+          file.direct = false;
+          start_open(id);
+        }
+        else if (result.is_error())
+        {
+          answer_missing(id);
+        }
+        else
+        {
+          file.stage = FileStage::stating;
+          file_op(
+            id,
+            [&](void* user_data)
+            { return ring_.prepare_statx(file.fd, "", AT_EMPTY_PATH, STATX_TYPE | STATX_SIZE, &file.stat, user_data); },
+            OpType::stat);
+        }
+        break;
+      }
+      case OpType::stat:
+      {
+        if (connection.failed)
+        {
+          break;
+        }
+        if (result.is_error() || !S_ISREG(file.stat.stx_mode))
+        {
+          answer_missing(id);
+          break;
+        }
+        file.size = file.stat.stx_size;
+        connection.output->append(http::render_head(
+          "200 OK", http::content_type_of(file.path), file.size, file.request.keep_alive));
+        pending_writes_.mark(id);
+        file.stage = FileStage::sending;
+        if (file.request.method == http::Method::head || file.size == 0U)
+        {
+          file.stage = FileStage::closing;
+        }
+        else if (file_mode_ == FileMode::direct)
+        {
+          file.reader = take_reader();
+          file.reader->start(file.fd, file.size);
+        }
+        else
+        {
+          file.pipe = take_pipe();
+          connection.failed = file.pipe[0] < 0;
+        }
+        break;
+      }
+      case OpType::file_splice:
+      {
+        file.filling = false;
+        if (result.value_or(0) <= 0)
+        {
+          // Nothing more to read means the file shrank below the length already announced.
+          connection.failed = true;
+          break;
+        }
+        file.offset += static_cast<uint32_t>(result.value());
+        file.piped += static_cast<uint32_t>(result.value());
+        break;
+      }
+      case OpType::file_read:
+      {
+        connection.failed = connection.failed || !file.reader->complete(op.unpacked.slot, result);
+        break;
+      }
+      case OpType::body_splice:
+      {
+        file.sending = false;
+        if (result.contains_err(lib::Errno(EAGAIN)))
+        {
+          // The socket is full, splices of it run on a kernel worker that would block there. Wait for room instead.
+          file.sending = file_op(
+            id, [&](void* user_data) { return ring_.prepare_poll(connection.fd, POLLOUT, user_data); },
+            OpType::body_poll);
+          break;
+        }
+        if (result.value_or(0) <= 0)
+        {
+          connection.failed = true;
+          break;
+        }
+        file.piped -= static_cast<uint32_t>(result.value());
+        stats_.file_bytes += static_cast<uint32_t>(result.value());
+        break;
+      }
+      case OpType::body_poll:
+      {
+        file.sending = false;
+        // Errors show up in the next splice.
+        break;
+      }
+      case OpType::body_write:
+      {
+        file.sending = false;
+        if (result.value_or(0) <= 0)
+        {
+          connection.failed = true;
+          break;
+        }
+        file.reader->consume(static_cast<uint32_t>(result.value()));
+        stats_.file_bytes += static_cast<uint32_t>(result.value());
+        break;
+      }
+      case OpType::close:
+      {
+        end_file(id);
+        return;
+      }
+    }
+    pump_file(id);
+  }
+
+  /// Answer the request for a file that can not be served with 404.
+  void answer_missing(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    connection.output->append(responses_.not_found.bytes(connection.file->request));
+    pending_writes_.mark(id);
+    connection.file->stage = FileStage::closing;
+  }
+
+  /// Start what the file can do next: read ahead, and send once the head is written. Ends the file when it is done
+  /// or the connection failed.
+  void pump_file(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    if (!connection.file)
+    {
+      return;
+    }
+    if (!connection.failed && connection.file->stage != FileStage::closing)
+    {
+      start_file_ops(id);
+    }
+    // Preparing an op may have failed the connection, and the file may have ended already.
+    if (connection.file && (connection.failed || connection.file->stage == FileStage::closing))
+    {
+      finish_file(id);
+    }
+  }
+
+  void start_file_ops(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    FileTransfer& file = *connection.file;
+    if (file.stage != FileStage::sending)
+    {
+      return;
+    }
+    const bool head_sent = connection.output->empty() && !connection.writing;
+    if (file.reader)
+    {
+      while (file.reader->next_slot().has_value())
+      {
+        const auto slot = static_cast<uint8_t>(*file.reader->next_slot());
+        if (!file_op(
+              id, [&](void* user_data) { return file.reader->prepare_next(ring_, user_data); }, OpType::file_read,
+              slot))
+        {
+          return;
+        }
+      }
+      const std::string_view chunk = file.reader->front();
+      if (head_sent && !file.sending && !chunk.empty())
+      {
+        file.sending = file_op(
+          id,
+          [&](void* user_data)
+          {
+            return ring_.prepare_write(
+              connection.fd, chunk.data(), static_cast<unsigned>(chunk.size()), 0, user_data);
+          },
+          OpType::body_write);
+      }
+      if (file.reader->done())
+      {
+        ++stats_.files;
+        file.stage = FileStage::closing;
+      }
+      return;
+    }
+    // Splice mode moves one chunk at a time, into the pipe and from there into the socket.
+    if (file.filling || file.sending)
+    {
+      return;
+    }
+    if (file.piped > 0U)
+    {
+      if (head_sent)
+      {
+        file.sending = file_op(
+          id,
+          [&](void* user_data)
+          {
+            return ring_.prepare_splice(
+              file.pipe[0], -1, connection.fd, -1, file.piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK, user_data);
+          },
+          OpType::body_splice);
+      }
+    }
+    else if (file.offset < file.size)
+    {
+      const auto count = static_cast<uint32_t>(std::min<uint64_t>(pipe_chunk_size, file.size - file.offset));
+      file.filling = file_op(
+        id,
+        [&](void* user_data)
+        {
+          return ring_.prepare_splice(
+            file.fd, static_cast<int64_t>(file.offset), file.pipe[1], -1, count, SPLICE_F_MOVE, user_data);
+        },
+        OpType::file_splice);
+    }
+    else
+    {
+      ++stats_.files;
+      file.stage = FileStage::closing;
+    }
+  }
+
+  /// Close the file once none of its ops is in flight anymore, the last one to complete calls this again.
+  void finish_file(const uint32_t id)
+  {
+    FileTransfer& file = *connections_[id].file;
+    file.stage = FileStage::closing;
+    if (file.ops > 0U)
+    {
+      return;
+    }
+    if (file.fd < 0)
+    {
+      end_file(id);
+      return;
+    }
+    const int fd = std::exchange(file.fd, -1);
+    if (!file_op(id, [&](void* user_data) { return ring_.prepare_close(fd, user_data); }, OpType::close))
+    {
+      close(fd);
+      end_file(id);
+    }
+  }
+
+  /// The file is closed, go on with the requests after it.
+  void end_file(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    FileTransfer& file = *connection.file;
+    // A pipe of a failed transfer may still hold bytes of it.
+    release_pipe(file.pipe, file.piped == 0U);
+    if (file.reader)
+    {
+      idle_readers_.push_back(std::move(file.reader));
+    }
+    connection.file.reset();
+    if (!connection.failed)
+    {
+      handle_requests(id);
+    }
+    resume(id);
+  }
+
+  std::array<int, 2> take_pipe()
+  {
+    std::array<int, 2> pipe{-1, -1};
+    if (!idle_pipes_.empty())
+    {
+      pipe = idle_pipes_.back();
+      idle_pipes_.pop_back();
+    }
+    else if (pipe2(pipe.data(), O_CLOEXEC) != 0)
+    {
+      return {-1, -1};
+    }
+    return pipe;
+  }
+
+  /// Keep the pipe for the next file, or close it.
+  void release_pipe(const std::array<int, 2>& pipe, const bool reuse)
+  {
+    if (pipe[0] < 0)
+    {
+      return;
+    }
+    if (reuse)
+    {
+      idle_pipes_.push_back(pipe);
+      return;
+    }
+    close(pipe[0]);
+    close(pipe[1]);
+  }
+
+  std::unique_ptr<io::FileReader> take_reader()
+  {
+    if (idle_readers_.empty())
+    {
+      return std::make_unique<io::FileReader>(file_chunk_size, file_readahead);
+    }
+    auto reader = std::move(idle_readers_.back());
+    idle_readers_.pop_back();
+    return reader;
+  }
+
+  const FileMode file_mode_;
+  const Responses responses_{};
+  /// Directory of the static files, -1 when none are served.
+  int root_fd_{-1};
+  /// Pipes and buffers of files that were sent, for the next ones. Only as many as files were sent at once.
+  std::vector<std::array<int, 2>> idle_pipes_{};
+  std::vector<std::unique_ptr<io::FileReader>> idle_readers_{};
+  HttpStats stats_{};
+};
+
+}  // namespace
+
+HttpStats run_http_server(
+  const int listen_fd, io::Uring& ring, const std::atomic<bool>& stop, const Admission& admission,
+  const StaticFiles& files)
+{
+  HttpServer server(listen_fd, ring, admission, files);
+  return server.run(stop);
+}
+
+}  // namespace spinscale::nwprog::server
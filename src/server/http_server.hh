@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "src/io/uring.hh"
+#include "src/server/admission.hh"
+
+namespace spinscale::nwprog::server
+{
+
+enum class FileMode : uint8_t
+{
+  /// File data goes from the page cache through a pipe to the socket and never enters user space.
+  splice,
+  /// File data is read with O_DIRECT, past the page cache, into buffers a few chunks ahead of the socket and written
+  /// from there. Files on file systems without O_DIRECT are read through the page cache the same way.
+  direct,
+};
+
+/// Files served below /static/.
+struct StaticFiles
+{
+  /// Directory the files are looked up in, nothing is served when empty.
+  std::string root{};
+  FileMode mode{FileMode::splice};
+};
+
+/// Counters of an HTTP server loop.
+struct HttpStats
+{
+  uint64_t connections{0};
+  uint64_t requests{0};
+  /// Requests answered with an error status, after which the connection was closed.
+  uint64_t bad_requests{0};
+  /// Responses whose body was sent from a file, and the bytes of those bodies.
+  uint64_t files{0};
+  uint64_t file_bytes{0};
+  /// Overloaded requests are answered with 503 and count here, not as requests.
+  ShedStats shed{};
+};
+
+/// Serve HTTP/1.1 keep-alive connections accepted on `listen_fd` from `ring` until `stop` is set. It is checked
+/// whenever waiting for completions returns, so set it from a signal handler, which interrupts the wait.
+///
+/// Every read is parsed for as many pipelined requests as it holds, and the answers, which are rendered at startup, are
+/// copied into the connection's output buffer and leave with a single writev. Endpoints:
+///   GET|HEAD /health  plain text "OK"
+///   GET|HEAD /json    a small JSON document
+///   GET|HEAD /static/<path>  the file at <path> below `files.root`, if it is set
+/// Anything else is answered with 404 or 405.
+///
+/// Files never block the loop: they are opened, looked at and closed with ops on the ring, and their data moves with
+/// splices or reads on it as well. Requests pipelined after a file wait until its body is sent.
+///
+/// Load beyond `admission` is shed: accepting pauses at the connection limit, and while the queue delay says the loop
+/// is overloaded new connections are closed right away and late requests are answered with 503.
+HttpStats run_http_server(
+  int listen_fd, io::Uring& ring, const std::atomic<bool>& stop, const Admission& admission = {},
+  const StaticFiles& files = {});
+
+}  // namespace spinscale::nwprog::server
@@ -0,0 +1,662 @@
+#include "src/server/kv_server.hh"
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "src/io/mailbox.hh"
+#include "src/io/uring.hh"
+#include "src/lib/errno.hh"
+#include "src/lib/log.hh"
+#include "src/lib/resp.hh"
+#include "src/lib/topology.hh"
+#include "src/server/connection_loop.hh"
+#include "src/server/kv_table.hh"
+
+namespace spinscale::nwprog::server
+{
+
+namespace
+{
+
+constexpr uint32_t ring_size = 4096U;
+/// Commands are parsed in place, so the input buffer is mirrored and a command that wraps around is contiguous.
+constexpr uint32_t input_buffer_size = 2U * lib::resp::default_max_command_size;
+constexpr uint32_t output_buffer_size = 64U * 1024U;
+constexpr size_t mailbox_capacity = 16U * 1024U;
+constexpr size_t initial_table_capacity = 1024U;
+/// Replies a connection may have queued before the server stops reading its commands.
+constexpr size_t max_pending_replies = 4096U;
+/// How soon messages that did not fit into a full mailbox are posted again.
+constexpr long retry_delay_ns = 50000;
+/// A read and a write per connection.
+constexpr uint32_t ops_per_connection = 2U;
+/// The accept, the mailbox read and the retry timeout.
+constexpr uint32_t shard_ops = 3U;
+
+enum class OpType : uint8_t
+{
+  mailbox = first_server_op,
+  retry,
+};
+
+/// What shards send each other.
+struct Message
+{
+  enum class Kind : uint8_t
+  {
+    get,
+    set,
+    del,
+    /// The answer to one of the above.
+    reply,
+    stop,
+  };
+
+  Kind kind{Kind::stop};
+  /// The shard that serves the connection and gets the reply.
+  uint32_t origin{0};
+  uint32_t connection{0};
+  uint32_t generation{0};
+  /// Sequence number of the reply within the connection.
+  uint64_t reply{0};
+  /// The key, or the encoded reply.
+  std::string data{};
+  std::string value{};
+  /// Number of deleted keys for DEL.
+  int64_t count{0};
+};
+
+/// A reply of a connection that has to wait for replies before it, or for answers of other shards.
+struct PendingReply
+{
+  std::string bytes{};
+  /// Answers of other shards that are still missing.
+  uint32_t waiting{0};
+  /// DEL: the answers are counts that add up to an integer reply.
+  bool counts{false};
+  int64_t count{0};
+};
+
+struct Connection : StreamConnection
+{
+  using StreamConnection::StreamConnection;
+
+  /// Replies that can not go to the output directly, oldest first. Empty in the common case of local keys.
+  std::deque<PendingReply> pending{};
+  /// Sequence number of the front of `pending`.
+  uint64_t first_pending{0};
+};
+
+using Mailboxes = std::vector<std::unique_ptr<io::Mailbox<Message>>>;
+
+/// Case insensitive comparison with `upper`, which has to be upper case already.
+bool equals_upper(const std::string_view value, const std::string_view upper)
+{
+  if (value.size() != upper.size())
+  {
+    return false;
+  }
+  for (size_t i = 0; i < value.size(); ++i)
+  {
+    const char c = value[i] >= 'a' && value[i] <= 'z' ? static_cast<char>(value[i] - ('a' - 'A')) : value[i];
+    if (c != upper[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+class Shard : public ConnectionLoop<Shard, Connection>
+{
+public:
+  Shard(
+    const uint32_t id, const int listen_fd, io::Uring& ring, Mailboxes& mailboxes, const Admission& admission,
+    const std::optional<uint32_t> node)
+    : ConnectionLoop(listen_fd, ring, admission, {input_buffer_size, output_buffer_size, ops_per_connection, shard_ops})
+    , id_(id)
+    , mailboxes_(mailboxes)
+    , table_(initial_table_capacity, node)
+    , backlog_(mailboxes.size())
+  {
+  }
+
+  KvStats run()
+  {
+    arm_mailbox();
+    serve([this]() { return stopping_; });
+    stats_.connections = accepted();
+    stats_.shed = shed_;
+    return stats_;
+  }
+
+private:
+  friend ConnectionLoop;
+
+  void on_read(const uint32_t id)
+  {
+    advance(id);
+  }
+
+  void on_written(const uint32_t id)
+  {
+    // Commands that were held back by a full output may be handled now.
+    advance(id);
+  }
+
+  void on_op(const OpData op, const io::IoResult /*result*/)
+  {
+    switch (static_cast<OpType>(op.unpacked.type))
+    {
+      case OpType::mailbox:
+      {
+        mailboxes_[id_]->drain([this](Message&& message) { on_message(std::move(message)); });
+        arm_mailbox();
+        break;
+      }
+      case OpType::retry:
+      {
+        retry_armed_ = false;
+        break;
+      }
+    }
+  }
+
+  /// Too many queued replies hold back reads, and with them further commands.
+  bool may_read(const Connection& connection) const
+  {
+    return connection.pending.size() < max_pending_replies;
+  }
+
+  bool flushed(const Connection& connection) const
+  {
+    return connection.pending.empty();
+  }
+
+  void on_release(Connection& connection)
+  {
+    connection.pending.clear();
+  }
+
+  /// Messages that did not fit into a mailbox are posted again once per loop iteration.
+  void end_iteration()
+  {
+    flush_backlog();
+  }
+
+  void arm_mailbox()
+  {
+    const bool prepared =
+      prepare([&](void* user_data) { return mailboxes_[id_]->arm(ring_, user_data); }, OpType::mailbox, 0);
+    log::expects(prepared, "unable to arm the mailbox.");
+  }
+
+  [[nodiscard]] uint32_t owner(const std::string_view key) const
+  {
+    // The table takes its bucket from the low bits and its tags from the top bits, the shard uses neither.
+    return static_cast<uint32_t>((kv::Table::hash(key) >> 32U) % mailboxes_.size());
+  }
+
+  /// Execute every complete command in the input buffer until the connection has too many replies queued. Commands
+  /// that waited too long while the shard is overloaded are answered with an error instead.
+  void handle_commands(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    const bool shed = shedding();
+    while (!connection.closing && !connection.failed && connection.pending.size() < max_pending_replies)
+    {
+      const auto parsed = lib::resp::parse_command(connection.input->filled(), args_);
+      if (parsed.contains(0))
+      {
+        return;
+      }
+      ++stats_.commands;
+      if (parsed.is_error())
+      {
+        // Like Redis, answer a protocol error and close the connection, nothing after it can be trusted.
+        ++stats_.errors;
+        std::string bytes;
+        lib::resp::append_error(
+          bytes, parsed.contains_err(lib::Errno(EMSGSIZE)) ? "command too large" : "protocol error");
+        reply(connection, bytes);
+        connection.closing = true;
+        return;
+      }
+      if (shed)
+      {
+        ++shed_.shed_requests;
+        reply(connection, "-ERR server overloaded\r\n");
+      }
+      else
+      {
+        execute(id);
+      }
+      connection.input->consume(parsed.value());
+    }
+  }
+
+  void execute(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    const std::string_view command = args_[0];
+    if (equals_upper(command, "GET") && args_.size() == 2U)
+    {
+      if (const uint32_t shard = owner(args_[1]); shard != id_)
+      {
+        forward(connection, id, shard, Message::Kind::get);
+        return;
+      }
+      reply_value(connection, table_.get(args_[1]));
+    }
+    else if (equals_upper(command, "SET") && args_.size() == 3U)
+    {
+      if (const uint32_t shard = owner(args_[1]); shard != id_)
+      {
+        forward(connection, id, shard, Message::Kind::set);
+        return;
+      }
+      table_.set(args_[1], args_[2]);
+      reply(connection, "+OK\r\n");
+    }
+    else if (equals_upper(command, "DEL") && args_.size() >= 2U)
+    {
+      delete_keys(connection, id);
+    }
+    else if (equals_upper(command, "MGET") && args_.size() >= 2U)
+    {
+      get_keys(connection, id);
+    }
+    else if (equals_upper(command, "PING") && args_.size() == 1U)
+    {
+      reply(connection, "+PONG\r\n");
+    }
+    else if (equals_upper(command, "COMMAND") || equals_upper(command, "CONFIG"))
+    {
+      // Clients and benchmarks ask on startup, an empty answer makes them go on with their defaults.
+      reply(connection, "*0\r\n");
+    }
+    else
+    {
+      ++stats_.errors;
+      const bool known = equals_upper(command, "GET") || equals_upper(command, "SET") ||
+                         equals_upper(command, "DEL") || equals_upper(command, "MGET") || equals_upper(command, "PING");
+      std::string bytes;
+      lib::resp::append_error(bytes, known ? "wrong number of arguments" : "unknown command");
+      reply(connection, bytes);
+    }
+  }
+
+  void delete_keys(Connection& connection, const uint32_t id)
+  {
+    int64_t deleted = 0;
+    uint32_t forwarded = 0;
+    for (size_t i = 1; i < args_.size(); ++i)
+    {
+      if (owner(args_[i]) == id_)
+      {
+        deleted += table_.erase(args_[i]) ? 1 : 0;
+      }
+      else
+      {
+        ++forwarded;
+      }
+    }
+    if (forwarded == 0)
+    {
+      std::string bytes;
+      lib::resp::append_integer(bytes, deleted);
+      reply(connection, bytes);
+      return;
+    }
+    // One pending reply collects the counts of all shards.
+    connection.pending.push_back({.waiting = forwarded, .counts = true, .count = deleted});
+    const uint64_t sequence = connection.first_pending + connection.pending.size() - 1U;
+    for (size_t i = 1; i < args_.size(); ++i)
+    {
+      if (const uint32_t shard = owner(args_[i]); shard != id_)
+      {
+        send(shard, make_message(connection, id, Message::Kind::del, sequence, args_[i]));
+      }
+    }
+  }
+
+  void get_keys(Connection& connection, const uint32_t id)
+  {
+    bool all_local = true;
+    for (size_t i = 1; i < args_.size() && all_local; ++i)
+    {
+      all_local = owner(args_[i]) == id_;
+    }
+    if (all_local && connection.pending.empty())
+    {
+      // The common case goes straight to the output, unless it does not fit.
+      size_t size = 16U;
+      for (size_t i = 1; i < args_.size(); ++i)
+      {
+        size += lib::resp::bulk_size(table_.get(args_[i]));
+      }
+      if (size <= connection.output->free_space())
+      {
+        lib::resp::append_array_header(*connection.output, args_.size() - 1U);
+        for (size_t i = 1; i < args_.size(); ++i)
+        {
+          lib::resp::append_bulk(*connection.output, table_.get(args_[i]));
+        }
+        return;
+      }
+    }
+    // Every key gets its own pending reply, they are written in order once all shards answered.
+    std::string header;
+    lib::resp::append_array_header(header, args_.size() - 1U);
+    connection.pending.push_back({.bytes = std::move(header)});
+    for (size_t i = 1; i < args_.size(); ++i)
+    {
+      if (const uint32_t shard = owner(args_[i]); shard != id_)
+      {
+        forward(connection, id, shard, Message::Kind::get, args_[i]);
+      }
+      else
+      {
+        std::string bytes;
+        lib::resp::append_bulk(bytes, table_.get(args_[i]));
+        connection.pending.push_back({.bytes = std::move(bytes)});
+      }
+    }
+  }
+
+  /// Answer with the value, straight into the output when nothing is queued before it and it fits.
+  void reply_value(Connection& connection, const std::optional<std::string_view> value)
+  {
+    if (connection.pending.empty() && lib::resp::bulk_size(value) <= connection.output->free_space())
+    {
+      lib::resp::append_bulk(*connection.output, value);
+      return;
+    }
+    std::string bytes;
+    lib::resp::append_bulk(bytes, value);
+    connection.pending.push_back({.bytes = std::move(bytes)});
+  }
+
+  void reply(Connection& connection, const std::string_view bytes)
+  {
+    if (connection.pending.empty() && bytes.size() <= connection.output->free_space())
+    {
+      connection.output->append(bytes);
+      return;
+    }
+    connection.pending.push_back({.bytes = std::string(bytes)});
+  }
+
+  Message make_message(
+    const Connection& connection, const uint32_t id, const Message::Kind kind, const uint64_t sequence,
+    const std::string_view key)
+  {
+    ++stats_.forwarded;
+    return {
+      .kind = kind,
+      .origin = id_,
+      .connection = id,
+      .generation = connection.generation,
+      .reply = sequence,
+      .data = std::string(key)};
+  }
+
+  /// Queue a reply that waits for `shard` and send it the current command for `key`, the first argument by default.
+  void forward(
+    Connection& connection, const uint32_t id, const uint32_t shard, const Message::Kind kind,
+    std::optional<std::string_view> key = std::nullopt)
+  {
+    connection.pending.push_back({.waiting = 1U});
+    const uint64_t sequence = connection.first_pending + connection.pending.size() - 1U;
+    Message message = make_message(connection, id, kind, sequence, key.value_or(args_[1]));
+    if (kind == Message::Kind::set)
+    {
+      message.value = std::string(args_[2]);
+    }
+    send(shard, std::move(message));
+  }
+
+  /// Post in order, messages wait in the backlog while the mailbox is full.
+  void send(const uint32_t shard, Message&& message)
+  {
+    auto& backlog = backlog_[shard];
+    if (backlog.empty() && mailboxes_[shard]->post(std::move(message)))
+    {
+      return;
+    }
+    backlog.push_back(std::move(message));
+    arm_retry();
+  }
+
+  void flush_backlog()
+  {
+    bool left = false;
+    for (uint32_t shard = 0; shard < backlog_.size(); ++shard)
+    {
+      auto& backlog = backlog_[shard];
+      while (!backlog.empty() && mailboxes_[shard]->post(std::move(backlog.front())))
+      {
+        backlog.pop_front();
+      }
+      left = left || !backlog.empty();
+    }
+    if (left)
+    {
+      arm_retry();
+    }
+  }
+
+  /// The ring may have nothing else to wait for, a timeout makes sure the backlog is flushed again soon.
+  void arm_retry()
+  {
+    if (retry_armed_)
+    {
+      return;
+    }
+    retry_armed_ = prepare(
+      [&](void* user_data) { return ring_.prepare_timeout(&retry_timeout_, 0, user_data); }, OpType::retry, 0);
+  }
+
+  void on_message(Message&& message)
+  {
+    switch (message.kind)
+    {
+      case Message::Kind::get:
+      {
+        const auto value = table_.get(message.data);
+        message.data.clear();
+        lib::resp::append_bulk(message.data, value);
+        break;
+      }
+      case Message::Kind::set:
+      {
+        table_.set(message.data, message.value);
+        message.data = "+OK\r\n";
+        message.value.clear();
+        break;
+      }
+      case Message::Kind::del:
+      {
+        message.count = table_.erase(message.data) ? 1 : 0;
+        message.data.clear();
+        break;
+      }
+      case Message::Kind::reply:
+      {
+        on_reply(std::move(message));
+        return;
+      }
+      case Message::Kind::stop:
+      {
+        stopping_ = true;
+        return;
+      }
+    }
+    const uint32_t origin = message.origin;
+    message.kind = Message::Kind::reply;
+    send(origin, std::move(message));
+  }
+
+  void on_reply(Message&& message)
+  {
+    Connection& connection = connections_[message.connection];
+    // The connection may be gone, or its id reused, by now.
+    if (!connection.input || connection.generation != message.generation)
+    {
+      return;
+    }
+    PendingReply& pending = connection.pending[message.reply - connection.first_pending];
+    if (pending.counts)
+    {
+      pending.count += message.count;
+    }
+    else
+    {
+      pending.bytes = std::move(message.data);
+    }
+    --pending.waiting;
+    advance(message.connection);
+    resume(message.connection);
+  }
+
+  /// Handle what the connection has, with complete replies moved to the output before and after. Replies that did not
+  /// even fit into an empty output, e.g. a large MGET of local keys, are complete when they are queued, no write or
+  /// answer of another shard would move them.
+  void advance(const uint32_t id)
+  {
+    Connection& connection = connections_[id];
+    flush_pending(connection);
+    handle_commands(id);
+    flush_pending(connection);
+  }
+
+  /// Move complete pending replies to the output in order, as far as they fit.
+  void flush_pending(Connection& connection)
+  {
+    while (!connection.pending.empty() && connection.pending.front().waiting == 0)
+    {
+      PendingReply& front = connection.pending.front();
+      if (front.counts)
+      {
+        lib::resp::append_integer(front.bytes, front.count);
+        front.counts = false;
+      }
+      // Replies larger than the output go out in pieces.
+      const size_t written = connection.output->append(front.bytes);
+      if (written < front.bytes.size())
+      {
+        front.bytes.erase(0, written);
+        return;
+      }
+      connection.pending.pop_front();
+      ++connection.first_pending;
+    }
+  }
+
+  const uint32_t id_;
+  Mailboxes& mailboxes_;
+  kv::Table table_;
+  /// Messages per shard that did not fit into its mailbox yet.
+  std::vector<std::deque<Message>> backlog_;
+  bool retry_armed_{false};
+  struct __kernel_timespec retry_timeout_
+  {
+    .tv_sec = 0, .tv_nsec = retry_delay_ns
+  };
+  /// Arguments of the command being executed, reused to avoid allocations.
+  std::vector<std::string_view> args_{};
+  KvStats stats_{};
+  bool stopping_{false};
+};
+
+}  // namespace
+
+void KvStats::merge(const KvStats& other)
+{
+  connections += other.connections;
+  commands += other.commands;
+  forwarded += other.forwarded;
+  errors += other.errors;
+  shed.merge(other.shed);
+}
+
+KvStats run_kv_server(
+  const int listen_fd, const uint32_t num_shards, const std::atomic<bool>& stop, const Admission& admission,
+  const lib::Topology* topology)
+{
+  log::expects(num_shards > 0, "the key value server needs at least one shard.");
+  Mailboxes mailboxes;
+  for (uint32_t i = 0; i < num_shards; ++i)
+  {
+    mailboxes.push_back(std::make_unique<io::Mailbox<Message>>(mailbox_capacity));
+  }
+
+  // Shards inherit the blocked signals, so only this thread is interrupted by them.
+  sigset_t stop_signals;
+  sigset_t previous;
+  sigemptyset(&stop_signals);
+  sigaddset(&stop_signals, SIGINT);
+  sigaddset(&stop_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop_signals, &previous);
+
+  const std::vector<uint32_t> cpus = topology != nullptr ? topology->placement(num_shards) : std::vector<uint32_t>{};
+  std::vector<KvStats> stats(num_shards);
+  std::vector<std::thread> shards;
+  for (uint32_t i = 0; i < num_shards; ++i)
+  {
+    shards.emplace_back(
+      [&, i]()
+      {
+        // Pinned before the ring and shard exist, so they and their buffers are first touched on its own node.
+        std::optional<uint32_t> node;
+        if (!cpus.empty())
+        {
+          if (lib::pin_thread(cpus[i]).is_ok())
+          {
+            node = topology->node_of(cpus[i]);
+          }
+          else
+          {
+            log::warn("unable to pin a shard, it runs unpinned.");
+          }
+        }
+        io::Uring ring(ring_size, {});
+        Shard shard(i, listen_fd, ring, mailboxes, admission, node);
+        stats[i] = shard.run();
+      });
+  }
+
+  while (!stop.load(std::memory_order_relaxed))
+  {
+    sigsuspend(&previous);
+  }
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+  for (auto& mailbox : mailboxes)
+  {
+    while (!mailbox->post(Message{.kind = Message::Kind::stop}))
+    {
+      std::this_thread::yield();
+    }
+  }
+  KvStats total;
+  for (uint32_t i = 0; i < num_shards; ++i)
+  {
+    shards[i].join();
+    total.merge(stats[i]);
+  }
+  return total;
+}
+
+}  // namespace spinscale::nwprog::server
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "src/lib/topology.hh"
+#include "src/server/admission.hh"
+
+namespace spinscale::nwprog::server
+{
+
+/// Counters of all shards of a key value server.
+struct KvStats
+{
+  uint64_t connections{0};
+  uint64_t commands{0};
+  /// Keys that were handled by another shard than the one owning the connection.
+  uint64_t forwarded{0};
+  /// Commands answered with an error.
+  uint64_t errors{0};
+  /// Overloaded commands are answered with an error and count here, not as errors.
+  ShedStats shed{};
+
+  void merge(const KvStats& other);
+};
+
+/// Serve a subset of the Redis protocol, GET, SET, DEL and MGET plus PING, on connections accepted from `listen_fd`.
+///
+/// Runs `num_shards` threads with a ring each, meant to be one per core. Keys are partitioned by hash and every shard
+/// owns the table of its keys, so no table is ever shared or locked. Connections are served by whichever shard
+/// accepted them. Commands for keys of another shard are forwarded through that shard's mailbox and the answer comes
+/// back the same way. Replies are kept in order per connection, so pipelining works across shards.
+///
+/// Every shard applies `admission` on its own: it pauses accepting at the connection limit, and while its queue delay
+/// says it is overloaded it closes new connections right away and answers late commands with an error.
+///
+/// With a `topology` every shard is pinned to a CPU of its own, physical cores first, and keeps its table on the
+/// NUMA node of that CPU.
+///
+/// Blocks the calling thread until `stop` is set, SIGINT and SIGTERM are blocked on all shard threads and the calling
+/// thread waits for them, so set `stop` from a handler for those.
+KvStats run_kv_server(
+  int listen_fd, uint32_t num_shards, const std::atomic<bool>& stop, const Admission& admission = {},
+  const lib::Topology* topology = nullptr);
+
+}  // namespace spinscale::nwprog::server
@@ -0,0 +1,236 @@
+#include "src/server/kv_table.hh"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace spinscale::nwprog::server::kv
+{
+
+namespace
+{
+
+/// Entries are a header followed by the key and the value.
+struct EntryHeader
+{
+  uint32_t key_size;
+  uint32_t value_size;
+};
+
+constexpr uint8_t overflow_saturated = 255U;
+
+size_t entry_size(const size_t key_size, const size_t value_size)
+{
+  return sizeof(EntryHeader) + key_size + value_size;
+}
+
+EntryHeader& header(char* entry)
+{
+  return *reinterpret_cast<EntryHeader*>(entry);
+}
+
+const EntryHeader& header(const char* entry)
+{
+  return *reinterpret_cast<const EntryHeader*>(entry);
+}
+
+std::string_view entry_key(const char* entry)
+{
+  return {entry + sizeof(EntryHeader), header(entry).key_size};
+}
+
+std::string_view entry_value(const char* entry)
+{
+  return {entry + sizeof(EntryHeader) + header(entry).key_size, header(entry).value_size};
+}
+
+uint8_t tag_of(const uint64_t hash)
+{
+  return static_cast<uint8_t>(0x80U | (hash >> 57U));
+}
+
+/// Bit i is set if tag i equals `tag`. Zero finds the empty slots.
+template <class Bucket>
+uint32_t match_tags(const Bucket& bucket, const uint8_t tag)
+{
+  // The overflow count is loaded along with the tags and masked off.
+  constexpr uint32_t slot_mask = 0x7FU;
+#if defined(__x86_64__)
+  const __m128i tags = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(bucket.tags));
+  const __m128i matches = _mm_cmpeq_epi8(tags, _mm_set1_epi8(static_cast<char>(tag)));
+  return static_cast<uint32_t>(_mm_movemask_epi8(matches)) & slot_mask;
+#else
+  uint32_t matches = 0;
+  for (uint32_t slot = 0; slot < 7U; ++slot)
+  {
+    matches |= static_cast<uint32_t>(bucket.tags[slot] == tag) << slot;
+  }
+  return matches & slot_mask;
+#endif
+}
+
+}  // namespace
+
+Table::Table(const size_t capacity, const std::optional<uint32_t> node)
+  : arena_(lib::Arena::default_chunk_size, node)
+  , buckets_()
+  , bucket_mask_(std::bit_ceil(std::max<size_t>(capacity * 8U / 7U / slots_per_bucket, 1U)) - 1U)
+{
+  buckets_ = std::make_unique<Bucket[]>(bucket_mask_ + 1U);
+}
+
+Table::~Table() = default;
+
+uint64_t Table::hash(const std::string_view key)
+{
+  // The tag comes from the top bits and the bucket from the bottom bits, spread both over the whole hash.
+  const uint64_t hash = std::hash<std::string_view>{}(key);
+  return (hash ^ (hash >> 32U)) * 0x9E3779B97F4A7C15ULL;
+}
+
+std::optional<std::string_view> Table::get(const std::string_view key) const
+{
+  const auto location = find(key, hash(key));
+  if (!location)
+  {
+    return std::nullopt;
+  }
+  return entry_value(buckets_[location->bucket].entries[location->slot]);
+}
+
+void Table::set(const std::string_view key, const std::string_view value)
+{
+  const uint64_t key_hash = hash(key);
+  if (const auto location = find(key, key_hash))
+  {
+    char*& entry = buckets_[location->bucket].entries[location->slot];
+    const size_t old_size = entry_size(key.size(), header(entry).value_size);
+    if (lib::Arena::block_size(old_size) == lib::Arena::block_size(entry_size(key.size(), value.size())))
+    {
+      header(entry).value_size = static_cast<uint32_t>(value.size());
+      std::memcpy(entry + sizeof(EntryHeader) + key.size(), value.data(), value.size());
+      return;
+    }
+    char* replaced = entry;
+    entry = make_entry(key, value);
+    free_entry(replaced);
+    return;
+  }
+  if (size_ + 1U > (bucket_mask_ + 1U) * slots_per_bucket * 7U / 8U)
+  {
+    grow();
+  }
+  insert(make_entry(key, value), key_hash);
+}
+
+bool Table::erase(const std::string_view key)
+{
+  const uint64_t key_hash = hash(key);
+  const auto location = find(key, key_hash);
+  if (!location)
+  {
+    return false;
+  }
+  Bucket& bucket = buckets_[location->bucket];
+  free_entry(bucket.entries[location->slot]);
+  bucket.tags[location->slot] = 0U;
+  bucket.entries[location->slot] = nullptr;
+  --size_;
+  // The entry no longer passes the buckets between its home and where it was stored.
+  for (size_t index = key_hash & bucket_mask_; index != location->bucket; index = (index + 1U) & bucket_mask_)
+  {
+    if (buckets_[index].overflow != overflow_saturated)
+    {
+      --buckets_[index].overflow;
+    }
+  }
+  return true;
+}
+
+std::optional<Table::Location> Table::find(const std::string_view key, const uint64_t hash) const
+{
+  const uint8_t tag = tag_of(hash);
+  size_t index = hash & bucket_mask_;
+  for (size_t probes = 0; probes <= bucket_mask_; ++probes)
+  {
+    const Bucket& bucket = buckets_[index];
+    for (uint32_t matches = match_tags(bucket, tag); matches != 0; matches &= matches - 1U)
+    {
+      const auto slot = static_cast<uint32_t>(std::countr_zero(matches));
+      if (entry_key(bucket.entries[slot]) == key)
+      {
+        return Location{index, slot};
+      }
+    }
+    if (bucket.overflow == 0)
+    {
+      return std::nullopt;
+    }
+    index = (index + 1U) & bucket_mask_;
+  }
+  return std::nullopt;
+}
+
+void Table::insert(char* entry, const uint64_t hash)
+{
+  size_t index = hash & bucket_mask_;
+  while (true)
+  {
+    Bucket& bucket = buckets_[index];
+    if (const uint32_t empty = match_tags(bucket, 0U); empty != 0)
+    {
+      const auto slot = static_cast<uint32_t>(std::countr_zero(empty));
+      bucket.tags[slot] = tag_of(hash);
+      bucket.entries[slot] = entry;
+      ++size_;
+      return;
+    }
+    if (bucket.overflow != overflow_saturated)
+    {
+      ++bucket.overflow;
+    }
+    index = (index + 1U) & bucket_mask_;
+  }
+}
+
+void Table::grow()
+{
+  const size_t old_num_buckets = bucket_mask_ + 1U;
+  auto old_buckets = std::exchange(buckets_, std::make_unique<Bucket[]>(2U * old_num_buckets));
+  bucket_mask_ = 2U * old_num_buckets - 1U;
+  size_ = 0U;
+  // Only the pointers move, keys and values stay where they are.
+  for (size_t index = 0; index < old_num_buckets; ++index)
+  {
+    const Bucket& bucket = old_buckets[index];
+    for (uint32_t slot = 0; slot < slots_per_bucket; ++slot)
+    {
+      if (bucket.tags[slot] != 0U)
+      {
+        insert(bucket.entries[slot], hash(entry_key(bucket.entries[slot])));
+      }
+    }
+  }
+}
+
+char* Table::make_entry(const std::string_view key, const std::string_view value)
+{
+  char* entry = arena_.allocate(entry_size(key.size(), value.size()));
+  header(entry) = {static_cast<uint32_t>(key.size()), static_cast<uint32_t>(value.size())};
+  std::memcpy(entry + sizeof(EntryHeader), key.data(), key.size());
+  std::memcpy(entry + sizeof(EntryHeader) + key.size(), value.data(), value.size());
+  return entry;
+}
+
+void Table::free_entry(char* entry)
+{
+  arena_.deallocate(entry, entry_size(header(entry).key_size, header(entry).value_size));
+}
+
+}  // namespace spinscale::nwprog::server::kv
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include "src/lib/arena.hh"
+#include "src/lib/cache_line.hh"
+
+namespace spinscale::nwprog::server::kv
+{
+
+/// Hash map from byte string keys to byte string values, owned by a single thread.
+///
+/// Open addressing over buckets of one cache line each: 7 one byte tags, an overflow count and 7 entry pointers. A
+/// lookup hashes once, loads the home bucket and compares the 7 bits of hash in all tags with a single SSE2 compare,
+/// so usually a single cache line is touched besides the entry itself, and the key is only compared for matching tags.
+/// Full buckets spill into the next ones. The overflow count of a bucket says how many entries passed it that way, a
+/// lookup stops at the first bucket without overflow instead of searching for an empty slot.
+///
+/// Keys and values live together in one block of an `lib::Arena`.
+class Table
+{
+public:
+  /// Room for about `capacity` entries before the first resize. Entries prefer NUMA `node` when one is given.
+  explicit Table(size_t capacity = 1024U, std::optional<uint32_t> node = std::nullopt);
+  ~Table();
+
+  Table(const Table&) = delete;
+  Table& operator=(const Table&) = delete;
+
+  /// The value is valid until `key` is set or erased.
+  [[nodiscard]] std::optional<std::string_view> get(std::string_view key) const;
+  void set(std::string_view key, std::string_view value);
+  /// Returns whether the key was present.
+  bool erase(std::string_view key);
+
+  [[nodiscard]] size_t size() const
+  {
+    return size_;
+  }
+
+  [[nodiscard]] const lib::Arena& arena() const
+  {
+    return arena_;
+  }
+
+  static uint64_t hash(std::string_view key);
+
+private:
+  static constexpr uint32_t slots_per_bucket = 7U;
+
+  struct alignas(lib::cache_line_size) Bucket
+  {
+    /// Zero for an empty slot, the top 7 bits of the hash with the high bit set otherwise.
+    uint8_t tags[slots_per_bucket];
+    /// Number of entries with an earlier home bucket that are stored after this one, saturates at 255.
+    uint8_t overflow;
+    char* entries[slots_per_bucket];
+  };
+  static_assert(sizeof(Bucket) == lib::cache_line_size);
+
+  struct Location
+  {
+    size_t bucket;
+    uint32_t slot;
+  };
+
+  [[nodiscard]] std::optional<Location> find(std::string_view key, uint64_t hash) const;
+  void insert(char* entry, uint64_t hash);
+  void grow();
+  char* make_entry(std::string_view key, std::string_view value);
+  void free_entry(char* entry);
+
+  lib::Arena arena_;
+  std::unique_ptr<Bucket[]> buckets_;
+  size_t bucket_mask_;
+  size_t size_{0U};
+};
+
+}  // namespace spinscale::nwprog::server::kv
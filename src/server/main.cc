@@ -1,11 +1,113 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <string_view>
+
+#include "src/io/tcp_socket.hh"
+#include "src/io/uring.hh"
+#include "src/lib/log.hh"
+#include "src/lib/topology.hh"
+#include "src/server/http_server.hh"
+#include "src/server/kv_server.hh"
+#include "src/server/process.hh"
 
-namespace server
+namespace
 {
 
+namespace log = spinscale::nwprog::log;
+namespace io = spinscale::nwprog::io;
+namespace lib = spinscale::nwprog::lib;
+namespace server = spinscale::nwprog::server;
+
+constexpr uint16_t default_port = 8080U;
+constexpr uint32_t ring_size = 4096U;
+
+std::atomic<bool> stop{false};
+
+void print_shed(const server::ShedStats& shed)
+{
+  std::cout << "shed: rejected connections: " << shed.rejected_connections
+            << "  shed requests: " << shed.shed_requests << "  accept pauses: " << shed.accept_pauses << std::endl;
 }
 
-int main()
+}  // namespace
+
+int main(int argc, char* argv[])
 {
-  std::cout << "hello from server!" << std::endl;
+  const io::TcpOptions tcp_options = server::take_listen_options(argc, argv);
+  if (argc > 5 || (argc >= 2 && std::strcmp(argv[1], "--help") == 0))
+  {
+    log::error("Usage: ./server [port] [http [static root] [splice|direct] | kv [shards]] [--tcp=OPTIONS]");
+    return 1;
+  }
+  const auto port = argc >= 2 ? static_cast<uint16_t>(std::strtol(argv[1], nullptr, 10)) : default_port;
+  const std::string_view mode = argc >= 3 ? argv[2] : "http";
+  if (mode != "http" && mode != "kv")
+  {
+    log::error("Unknown mode, expected http or kv.");
+    return 1;
+  }
+  if (mode == "kv" && argc > 4)
+  {
+    log::error("The key value server only takes a shard count.");
+    return 1;
+  }
+  // One shard per physical core the process may run on by default, the key value server is meant to scale with them.
+  const auto topology = lib::Topology::read();
+  const auto num_shards =
+    argc == 4 ? static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10)) : std::max(topology.num_cores(), 1U);
+
+  server::install_signal_handlers(stop);
+  const int listen_fd = server::setup_listen_socket(port, tcp_options);
+
+  if (mode == "kv")
+  {
+    log::info(
+      "key value server listening on port " + std::to_string(port) + " with " + std::to_string(num_shards) +
+      " shards on " + std::to_string(topology.num_cores()) + " cores and " + std::to_string(topology.num_nodes()) +
+      " nodes.");
+    const auto stats = server::run_kv_server(listen_fd, num_shards, stop, {}, &topology);
+    close(listen_fd);
+    std::cout << "connections: " << stats.connections << "  commands: " << stats.commands
+              << "  forwarded: " << stats.forwarded << "  errors: " << stats.errors << std::endl;
+    print_shed(stats.shed);
+    return 0;
+  }
+
+  server::StaticFiles files;
+  if (argc >= 4)
+  {
+    files.root = argv[3];
+  }
+  if (argc == 5)
+  {
+    const std::string_view file_mode = argv[4];
+    if (file_mode != "splice" && file_mode != "direct")
+    {
+      log::error("Unknown file mode, expected splice or direct.");
+      return 1;
+    }
+    files.mode = file_mode == "direct" ? server::FileMode::direct : server::FileMode::splice;
+  }
+
+  log::info("http server listening on port " + std::to_string(port) + ".");
+  if (!files.root.empty())
+  {
+    log::info("serving the files in " + files.root + " below /static/.");
+  }
+  io::Uring ring(ring_size, {});
+  const auto stats = server::run_http_server(listen_fd, ring, stop, {}, files);
+  close(listen_fd);
+
+  std::cout << "connections: " << stats.connections << "  requests: " << stats.requests
+            << "  bad requests: " << stats.bad_requests << "  files: " << stats.files
+            << "  file bytes: " << stats.file_bytes << std::endl;
+  print_shed(stats.shed);
 }
@@ -0,0 +1,51 @@
+#include "src/server/process.hh"
+
+#include <signal.h>
+
+#include "src/lib/log.hh"
+
+namespace spinscale::nwprog::server
+{
+
+namespace
+{
+
+constexpr int listen_backlog = 4096;
+
+std::atomic<bool>* stop_flag = nullptr;
+
+void on_signal(int)
+{
+  stop_flag->store(true, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+void install_signal_handlers(std::atomic<bool>& stop)
+{
+  stop_flag = &stop;
+  struct sigaction action
+  {
+  };
+  action.sa_handler = on_signal;
+  sigemptyset(&action.sa_mask);
+  log::expects(sigaction(SIGINT, &action, nullptr) == 0, "unable to handle SIGINT.");
+  log::expects(sigaction(SIGTERM, &action, nullptr) == 0, "unable to handle SIGTERM.");
+  signal(SIGPIPE, SIG_IGN);
+}
+
+io::TcpOptions take_listen_options(int& argc, char* argv[])
+{
+  io::TcpOptions options{.backlog = listen_backlog};
+  log::expects(io::take_tcp_options(argc, argv, options), "Usage Error: invalid TCP options.");
+  return options;
+}
+
+int setup_listen_socket(const uint16_t port, const io::TcpOptions& options)
+{
+  const auto listening = io::listen_tcp(port, options);
+  log::expects(listening.is_ok(), "Error listening on the TCP port.");
+  return listening.value();
+}
+
+}  // namespace spinscale::nwprog::server
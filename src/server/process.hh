@@ -0,0 +1,23 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "src/io/tcp_socket.hh"
+
+namespace spinscale::nwprog::server
+{
+
+/// Set `stop` on SIGINT and SIGTERM, which `stop` has to outlive. Without SA_RESTART they interrupt the wait for
+/// completions, so a loop sees `stop` right away. SIGPIPE is ignored: writes to peers that already closed fail
+/// instead of killing the process.
+void install_signal_handlers(std::atomic<bool>& stop);
+
+/// Listener options of a server binary with a trailing `--tcp=OPTIONS` argument applied and dropped from `argc`, see
+/// `io::take_tcp_options`. Exits on invalid options.
+io::TcpOptions take_listen_options(int& argc, char* argv[]);
+
+/// Listening socket on `port`, exits when there is none.
+int setup_listen_socket(uint16_t port, const io::TcpOptions& options);
+
+}  // namespace spinscale::nwprog::server
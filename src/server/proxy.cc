@@ -0,0 +1,658 @@
+#include "src/server/proxy.hh"
+
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/lib/errno.hh"
+#include "src/lib/log.hh"
+
+namespace spinscale::nwprog::server
+{
+
+namespace
+{
+
+/// Largest chunk a direction moves at once, the default capacity of a pipe.
+constexpr uint32_t chunk_size = 64U * 1024U;
+/// An op per direction and a cancel for each of them. The connect comes before any of them.
+constexpr uint32_t ops_per_session = 4U;
+
+enum class OpType : uint8_t
+{
+  accept,
+  connect,
+  /// Splice mode: wait until the source of a direction is readable.
+  poll,
+  /// Take a chunk from the source of a direction.
+  fill,
+  /// Pass the chunk on to the destination.
+  drain,
+  /// Splice mode: wait until the destination of a direction has room again.
+  room,
+  cancel,
+};
+
+union OpData
+{
+  struct
+  {
+    OpType type : 8;
+    uint8_t direction;
+    uint32_t session;
+  } unpacked;
+  uint64_t packed;
+};
+
+enum Direction : uint8_t
+{
+  /// From the client to the backend.
+  upstream = 0,
+  /// From the backend to the client.
+  downstream = 1,
+};
+
+/// One direction of a session.
+struct Pump
+{
+  int from{-1};
+  int to{-1};
+  /// Splice mode: the pipe chunks pass through, read end first.
+  int pipe[2]{-1, -1};
+  /// Copy mode.
+  std::unique_ptr<char[]> buffer{};
+  /// Bytes taken from `from` and not passed on to `to` yet.
+  uint32_t pending{0};
+  /// Copy mode: where the rest of a short write starts.
+  uint32_t offset{0};
+  /// The op in flight, if any.
+  bool polling{false};
+  bool filling{false};
+  bool draining{false};
+  bool awaiting_room{false};
+};
+
+struct Session
+{
+  int client{-1};
+  int backend{-1};
+  Pump pumps[2];
+  bool connecting{false};
+  uint32_t cancels{0};
+  /// No more ops are started, the session is released once the ones in flight completed.
+  bool ending{false};
+  /// The session ended without an error, its backend connection may serve the next client.
+  bool clean{false};
+  /// The last bytes that were passed on went to the backend, its reply may still be on the way.
+  bool awaiting_reply{false};
+  /// The client shut down its sending side with a reply on the way, the backend's was shut down as well.
+  bool half_closed{false};
+  bool open{false};
+};
+
+[[nodiscard]] bool in_flight(const Pump& pump)
+{
+  return pump.polling || pump.filling || pump.draining || pump.awaiting_room;
+}
+
+void set_no_delay(const int fd)
+{
+  // Forwarded small messages must not wait for Nagle.
+  const int no_delay = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+}
+
+/// An idle backend connection is only handed out while the backend neither closed it nor sent anything since.
+[[nodiscard]] bool idle_backend_usable(const int fd)
+{
+  char byte = 0;
+  return recv(fd, &byte, sizeof(byte), MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+class Proxy
+{
+public:
+  Proxy(const int listen_fd, io::Uring& ring, const ProxyConfig& config)
+    : listen_fd_(listen_fd)
+    , ring_(ring)
+    , config_(config)
+    // The accept is the one op that is not a session's.
+    , max_sessions_((ring.completion_queue_size() - 1U) / ops_per_session)
+  {
+    log::expects(max_sessions_ > 0, "the ring is too small to serve a single client.");
+  }
+
+  ProxyStats run(const std::atomic<bool>& stop)
+  {
+    resume_accept();
+    ring_.submit_or_defer();
+    while (!stop.load(std::memory_order_relaxed))
+    {
+      const auto handled = ring_.for_every_completion(*this);
+      log::expects(handled.is_ok() || handled.contains_err(lib::Errno(EINTR)), "waiting for completions failed.");
+      ring_.submit_or_defer();
+    }
+    for (Session& session : sessions_)
+    {
+      if (session.open)
+      {
+        close_session_fds(session);
+        if (session.backend >= 0)
+        {
+          close(session.backend);
+        }
+      }
+    }
+    for (const int fd : idle_backends_)
+    {
+      close(fd);
+    }
+    return stats_;
+  }
+
+  /// Completion callback.
+  void operator()(void* user_data, const io::IoResult result)
+  {
+    const OpData op{.packed = reinterpret_cast<uint64_t>(user_data)};
+    if (op.unpacked.type == OpType::accept)
+    {
+      accepting_ = false;
+      if (result.is_ok())
+      {
+        open_session(result.value());
+      }
+      else if (result.contains_err(lib::Errno(EMFILE)) || result.contains_err(lib::Errno(ENFILE)))
+      {
+        // Accepting again would fail right away, wait for a descriptor to be released.
+        log::warn("out of descriptors, accepting pauses until a session ends.");
+        out_of_descriptors_ = true;
+      }
+      else
+      {
+        log::warn(std::string("accept failed: ").append(result.error().message()));
+      }
+      resume_accept();
+      return;
+    }
+
+    const uint32_t id = op.unpacked.session;
+    Session& session = sessions_[id];
+    Pump& pump = session.pumps[op.unpacked.direction];
+    switch (op.unpacked.type)
+    {
+      case OpType::connect:
+      {
+        session.connecting = false;
+        if (result.is_error())
+        {
+          log::warn(std::string("connecting to the backend failed: ").append(result.error().message()));
+          end(id, false);
+        }
+        else
+        {
+          ++stats_.backend_connects;
+          start(id);
+        }
+        break;
+      }
+      case OpType::poll:
+      {
+        pump.polling = false;
+        if (session.ending)
+        {
+          break;
+        }
+        if (result.is_error())
+        {
+          end(id, false);
+        }
+        else
+        {
+          start_fill(id, op.unpacked.direction);
+        }
+        break;
+      }
+      case OpType::fill:
+      {
+        pump.filling = false;
+        on_fill(id, op.unpacked.direction, result);
+        break;
+      }
+      case OpType::drain:
+      {
+        pump.draining = false;
+        if (result.contains_err(lib::Errno(EAGAIN)))
+        {
+          start_wait_for_room(id, op.unpacked.direction);
+          break;
+        }
+        if (result.value_or(0) <= 0)
+        {
+          // A client that shut down its side may well be gone before the rest of its reply.
+          end(id, session.half_closed && op.unpacked.direction == downstream);
+          break;
+        }
+        session.awaiting_reply = op.unpacked.direction == upstream;
+        pump.pending -= result.value();
+        pump.offset = pump.pending == 0U ? 0U : pump.offset + result.value();
+        if (pump.pending > 0U)
+        {
+          start_drain(id, op.unpacked.direction);
+        }
+        else
+        {
+          start_wait(id, op.unpacked.direction);
+        }
+        break;
+      }
+      case OpType::room:
+      {
+        pump.awaiting_room = false;
+        if (session.ending)
+        {
+          break;
+        }
+        if (result.is_error())
+        {
+          end(id, false);
+        }
+        else
+        {
+          start_drain(id, op.unpacked.direction);
+        }
+        break;
+      }
+      case OpType::cancel:
+      {
+        --session.cancels;
+        break;
+      }
+      case OpType::accept:
+        break;
+    }
+    release_if_done(id);
+  }
+
+private:
+  template <class PrepareFn>
+  bool prepare(PrepareFn&& prepare_fn, const OpType type, const uint32_t id, const uint8_t direction = 0U)
+  {
+    const OpData op{.unpacked{.type = type, .direction = direction, .session = id}};
+    void* user_data = reinterpret_cast<void*>(op.packed);
+    if (prepare_fn(user_data).is_error())
+    {
+      // The submission queue is full, make room and try once more.
+      ring_.submit_or_defer();
+      if (prepare_fn(user_data).is_error())
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  [[nodiscard]] bool splice() const
+  {
+    return config_.mode == ProxyMode::splice;
+  }
+
+  /// Accept the next client unless one is being accepted already, the ring could not take its ops or descriptors ran
+  /// out.
+  void resume_accept()
+  {
+    if (accepting_ || out_of_descriptors_ || open_sessions_ >= max_sessions_)
+    {
+      return;
+    }
+    accepting_ = prepare(
+      [&](void* user_data) { return ring_.prepare_accept(listen_fd_, nullptr, nullptr, user_data); }, OpType::accept,
+      0);
+    log::expects(accepting_, "unable to prepare the next accept.");
+  }
+
+  /// Set up the pumps of a new client and get it a backend connection, an idle one if there is one.
+  void open_session(const int client)
+  {
+    ++stats_.clients;
+    ++open_sessions_;
+    uint32_t id = 0;
+    if (free_ids_.empty())
+    {
+      id = sessions_.size();
+      sessions_.emplace_back();
+    }
+    else
+    {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+    }
+    Session& session = sessions_[id];
+    session = Session{};
+    session.open = true;
+    session.client = client;
+    set_no_delay(client);
+    for (Pump& pump : session.pumps)
+    {
+      if (!splice())
+      {
+        pump.buffer = std::make_unique<char[]>(chunk_size);
+      }
+      else if (pipe2(pump.pipe, O_CLOEXEC) != 0)
+      {
+        // The next client would run out of descriptors the same way, it waits in the backlog instead.
+        out_of_descriptors_ = errno == EMFILE || errno == ENFILE;
+        log::warn("unable to create a pipe.");
+        end(id, false);
+        release_if_done(id);
+        return;
+      }
+    }
+
+    while (!idle_backends_.empty())
+    {
+      const int backend = idle_backends_.back();
+      idle_backends_.pop_back();
+      if (idle_backend_usable(backend))
+      {
+        ++stats_.backend_reuses;
+        session.backend = backend;
+        start(id);
+        return;
+      }
+      close(backend);
+    }
+
+    session.backend = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (session.backend < 0)
+    {
+      out_of_descriptors_ = errno == EMFILE || errno == ENFILE;
+      log::warn("unable to create a backend socket.");
+      end(id, false);
+      release_if_done(id);
+      return;
+    }
+    set_no_delay(session.backend);
+    session.connecting = prepare(
+      [&](void* user_data)
+      {
+        return ring_.prepare_connect(
+          session.backend, (struct sockaddr*)&config_.backend, sizeof(config_.backend), user_data);
+      },
+      OpType::connect, id);
+    if (!session.connecting)
+    {
+      end(id, false);
+      release_if_done(id);
+    }
+  }
+
+  /// The backend is connected, start moving bytes in both directions.
+  void start(const uint32_t id)
+  {
+    Session& session = sessions_[id];
+    session.pumps[upstream].from = session.client;
+    session.pumps[upstream].to = session.backend;
+    session.pumps[downstream].from = session.backend;
+    session.pumps[downstream].to = session.client;
+    start_wait(id, upstream);
+    start_wait(id, downstream);
+  }
+
+  /// Wait for the source of a direction to have something. In copy mode the read itself waits, the kernel only runs
+  /// it once the socket is readable. Splices would wait on a kernel worker thread each, so they wait for a poll.
+  void start_wait(const uint32_t id, const uint8_t direction)
+  {
+    Session& session = sessions_[id];
+    Pump& pump = session.pumps[direction];
+    if (session.ending)
+    {
+      return;
+    }
+    if (!splice())
+    {
+      start_fill(id, direction);
+      return;
+    }
+    pump.polling = prepare(
+      [&](void* user_data) { return ring_.prepare_poll(pump.from, POLLIN, user_data); }, OpType::poll, id, direction);
+    if (!pump.polling)
+    {
+      end(id, false);
+    }
+  }
+
+  void start_fill(const uint32_t id, const uint8_t direction)
+  {
+    Session& session = sessions_[id];
+    Pump& pump = session.pumps[direction];
+    if (session.ending)
+    {
+      return;
+    }
+    pump.filling = prepare(
+      [&](void* user_data)
+      {
+        // The source is readable, the splice does not have to block on it. Without anything there the pipe stays
+        // empty and the splice fails with EAGAIN.
+        return splice()
+                 ? ring_.prepare_splice(
+                     pump.from, -1, pump.pipe[1], -1, chunk_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK, user_data)
+                 : ring_.prepare_read(pump.from, pump.buffer.get(), chunk_size, 0, user_data);
+      },
+      OpType::fill, id, direction);
+    if (!pump.filling)
+    {
+      end(id, false);
+    }
+  }
+
+  void on_fill(const uint32_t id, const uint8_t direction, const io::IoResult result)
+  {
+    Session& session = sessions_[id];
+    Pump& pump = session.pumps[direction];
+    if (session.ending)
+    {
+      // Cancelled, or it raced with the cancel. Whatever it took is dropped with the session.
+      pump.pending = static_cast<uint32_t>(std::max(result.value_or(0), 0));
+      return;
+    }
+    if (result.contains_err(lib::Errno(EAGAIN)))
+    {
+      // The readiness was gone by the time the splice ran.
+      start_wait(id, direction);
+      return;
+    }
+    if (result.is_ok() && result.value() == 0 && direction == upstream &&
+        (session.awaiting_reply || session.pumps[downstream].pending > 0U))
+    {
+      // The client shut down its sending side while its reply is still coming, e.g. to mark the end of its request.
+      // The backend gets to see that too, and the reply keeps flowing until it closes.
+      session.half_closed = true;
+      if (shutdown(session.backend, SHUT_WR) != 0)
+      {
+        end(id, false);
+      }
+      return;
+    }
+    if (result.value_or(0) <= 0)
+    {
+      // Only a client that went away cleanly leaves the backend connection in a known state. A backend that closes
+      // after the client shut down its side finished the reply.
+      end(id, result.is_ok() && (direction == upstream || session.half_closed));
+      return;
+    }
+    stats_.bytes += static_cast<uint64_t>(result.value());
+    pump.pending = result.value();
+    start_drain(id, direction);
+  }
+
+  /// Pass the pending bytes on. Ends with bytes still pending when the session ends meanwhile. A splice that finds the
+  /// destination full fails with EAGAIN instead of blocking a kernel worker thread on it.
+  void start_drain(const uint32_t id, const uint8_t direction)
+  {
+    Session& session = sessions_[id];
+    Pump& pump = session.pumps[direction];
+    if (session.ending)
+    {
+      return;
+    }
+    pump.draining = prepare(
+      [&](void* user_data)
+      {
+        return splice() ? ring_.prepare_splice(
+                            pump.pipe[0], -1, pump.to, -1, pump.pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK, user_data)
+                        : ring_.prepare_write(pump.to, pump.buffer.get() + pump.offset, pump.pending, 0, user_data);
+      },
+      OpType::drain, id, direction);
+    if (!pump.draining)
+    {
+      end(id, false);
+    }
+  }
+
+  /// The destination of a direction is full, drain again once it has room.
+  void start_wait_for_room(const uint32_t id, const uint8_t direction)
+  {
+    Session& session = sessions_[id];
+    Pump& pump = session.pumps[direction];
+    if (session.ending)
+    {
+      return;
+    }
+    pump.awaiting_room = prepare(
+      [&](void* user_data) { return ring_.prepare_poll(pump.to, POLLOUT, user_data); }, OpType::room, id, direction);
+    if (!pump.awaiting_room)
+    {
+      end(id, false);
+    }
+  }
+
+  /// Stop starting new ops and cancel the ones that may wait for a peer indefinitely: the waits for a readable source
+  /// or a destination with room, and reads and writes in copy mode. Splices never wait and finish on their own.
+  void end(const uint32_t id, const bool clean)
+  {
+    Session& session = sessions_[id];
+    if (session.ending)
+    {
+      session.clean = session.clean && clean;
+      return;
+    }
+    session.ending = true;
+    session.clean = clean;
+    if (!clean)
+    {
+      ++stats_.errors;
+    }
+    for (uint8_t direction = upstream; direction <= downstream; ++direction)
+    {
+      const Pump& pump = session.pumps[direction];
+      OpType type = OpType::poll;
+      if (pump.awaiting_room)
+      {
+        type = OpType::room;
+      }
+      else if (!splice() && pump.filling)
+      {
+        type = OpType::fill;
+      }
+      else if (!splice() && pump.draining)
+      {
+        type = OpType::drain;
+      }
+      else if (!pump.polling)
+      {
+        continue;
+      }
+      const OpData target{.unpacked{.type = type, .direction = direction, .session = id}};
+      if (prepare(
+            [&](void* user_data) { return ring_.prepare_cancel(reinterpret_cast<void*>(target.packed), user_data); },
+            OpType::cancel, id, direction))
+      {
+        ++session.cancels;
+      }
+    }
+  }
+
+  /// Close the client, and keep the backend connection for the next one when the session ended cleanly with nothing
+  /// in flight, once no op refers to the session anymore.
+  void release_if_done(const uint32_t id)
+  {
+    Session& session = sessions_[id];
+    if (!session.open || !session.ending || session.connecting || session.cancels > 0U ||
+        in_flight(session.pumps[upstream]) || in_flight(session.pumps[downstream]))
+    {
+      return;
+    }
+    const bool reusable = session.clean && !session.awaiting_reply && !session.half_closed &&
+                          session.backend >= 0 && session.pumps[upstream].pending == 0U &&
+                          session.pumps[downstream].pending == 0U;
+    close_session_fds(session);
+    if (reusable && idle_backends_.size() < config_.max_idle_backends)
+    {
+      idle_backends_.push_back(session.backend);
+    }
+    else if (session.backend >= 0)
+    {
+      close(session.backend);
+    }
+    // A session that never got a backend freed no more descriptors than the next one needs.
+    if (session.backend >= 0)
+    {
+      out_of_descriptors_ = false;
+    }
+    session = Session{};
+    free_ids_.push_back(id);
+    --open_sessions_;
+    resume_accept();
+  }
+
+  /// Everything of the session but its backend connection.
+  static void close_session_fds(Session& session)
+  {
+    close(session.client);
+    for (Pump& pump : session.pumps)
+    {
+      for (const int fd : pump.pipe)
+      {
+        if (fd >= 0)
+        {
+          close(fd);
+        }
+      }
+    }
+  }
+
+  const int listen_fd_;
+  io::Uring& ring_;
+  const ProxyConfig config_;
+  const uint32_t max_sessions_;
+  uint32_t open_sessions_{0};
+  bool accepting_{false};
+  /// The last accept or session setup ran out of descriptors.
+  bool out_of_descriptors_{false};
+  /// A deque keeps sessions in place while new ones are added, ids of released ones are reused.
+  std::deque<Session> sessions_{};
+  std::vector<uint32_t> free_ids_{};
+  /// Connected backend connections that no client uses, newest last.
+  std::vector<int> idle_backends_{};
+  ProxyStats stats_{};
+};
+
+}  // namespace
+
+ProxyStats run_proxy(const int listen_fd, io::Uring& ring, const ProxyConfig& config, const std::atomic<bool>& stop)
+{
+  Proxy proxy(listen_fd, ring, config);
+  return proxy.run(stop);
+}
+
+}  // namespace spinscale::nwprog::server
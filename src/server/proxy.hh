@@ -0,0 +1,60 @@
+#pragma once
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "src/io/uring.hh"
+
+namespace spinscale::nwprog::server
+{
+
+enum class ProxyMode : uint8_t
+{
+  /// Bytes move from socket to pipe to socket with splice and never enter user space.
+  splice,
+  /// Bytes are read into a buffer and written from there, like a plain user space proxy does.
+  copy,
+};
+
+struct ProxyConfig
+{
+  struct sockaddr_in backend
+  {
+  };
+  ProxyMode mode{ProxyMode::splice};
+  /// Backend connections kept open for later clients once theirs went away, more are closed.
+  uint32_t max_idle_backends{64U};
+};
+
+/// Counters of a proxy loop.
+struct ProxyStats
+{
+  uint64_t clients{0};
+  /// Bytes moved, in both directions.
+  uint64_t bytes{0};
+  /// Backend connections that were opened, and clients that got an idle one instead.
+  uint64_t backend_connects{0};
+  uint64_t backend_reuses{0};
+  /// Clients that could not be connected to the backend or whose session broke off.
+  uint64_t errors{0};
+};
+
+/// Forward every connection accepted on `listen_fd` to the backend with `ring` until `stop` is set, which is checked
+/// whenever waiting for completions returns.
+///
+/// Each client gets a backend connection of its own for as long as it stays, and each direction moves one chunk at a
+/// time: it waits until the source is readable, takes what is there, and passes all of it on before taking more. In
+/// splice mode the chunk goes through a pipe of the session and the proxy never touches the payload.
+///
+/// When a client closes its connection while nothing is in flight, the backend connection goes to a pool and serves
+/// the next client, which saves the connect. That assumes a request and response protocol, where the backend does
+/// not send anything unasked between requests. A session whose last transfer went to the backend is not pooled, the
+/// reply may still be on its way, but a client that hangs up with several pipelined requests outstanding can not be
+/// told apart from an idle one; the pool only checks that nothing arrived before it hands a connection out. A client
+/// that shuts down its sending side while a reply is on the way has the backend's shut down as well, and the session
+/// lasts until the backend closes.
+ProxyStats run_proxy(int listen_fd, io::Uring& ring, const ProxyConfig& config, const std::atomic<bool>& stop);
+
+}  // namespace spinscale::nwprog::server
@@ -0,0 +1,80 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "src/io/tcp_socket.hh"
+#include "src/io/uring.hh"
+#include "src/lib/log.hh"
+#include "src/server/process.hh"
+#include "src/server/proxy.hh"
+
+namespace
+{
+
+namespace log = spinscale::nwprog::log;
+namespace io = spinscale::nwprog::io;
+namespace server = spinscale::nwprog::server;
+
+constexpr uint32_t ring_size = 4096U;
+
+std::atomic<bool> stop{false};
+
+/// "host:port" with a numeric IPv4 host.
+struct sockaddr_in parse_backend(const std::string_view backend)
+{
+  const size_t colon = backend.rfind(':');
+  log::expects(colon != std::string_view::npos, "Usage Error: the backend has to be given as host:port.");
+  const std::string host(backend.substr(0, colon));
+  const std::string port(backend.substr(colon + 1));
+  struct sockaddr_in address
+  {
+  };
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<uint16_t>(std::strtoul(port.c_str(), nullptr, 10)));
+  log::expects(inet_pton(AF_INET, host.c_str(), &address.sin_addr) == 1, "Usage Error: invalid backend address.");
+  return address;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  const io::TcpOptions tcp_options = server::take_listen_options(argc, argv);
+  if (argc < 3 || argc > 5 || std::strcmp(argv[1], "--help") == 0)
+  {
+    log::error("Usage: ./proxy [port] [backend host:port] [splice|copy] [max idle backends] [--tcp=OPTIONS]");
+    return 1;
+  }
+  const auto port = static_cast<uint16_t>(std::strtol(argv[1], nullptr, 10));
+  server::ProxyConfig config{.backend = parse_backend(argv[2])};
+  const std::string_view mode = argc >= 4 ? argv[3] : "splice";
+  if (mode != "splice" && mode != "copy")
+  {
+    log::error("Unknown mode, expected splice or copy.");
+    return 1;
+  }
+  config.mode = mode == "splice" ? server::ProxyMode::splice : server::ProxyMode::copy;
+  if (argc == 5)
+  {
+    config.max_idle_backends = static_cast<uint32_t>(std::strtoul(argv[4], nullptr, 10));
+  }
+
+  server::install_signal_handlers(stop);
+  const int listen_fd = server::setup_listen_socket(port, tcp_options);
+  log::info(
+    std::string(mode) + " proxy listening on port " + std::to_string(port) + ", forwarding to " + argv[2] + ".");
+  io::Uring ring(ring_size, {});
+  const auto stats = server::run_proxy(listen_fd, ring, config, stop);
+  close(listen_fd);
+  std::cout << "clients: " << stats.clients << "  bytes: " << stats.bytes
+            << "  backend connects: " << stats.backend_connects << "  backend reuses: " << stats.backend_reuses
+            << "  errors: " << stats.errors << std::endl;
+}
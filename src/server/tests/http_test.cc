@@ -0,0 +1,153 @@
+#include "src/server/http.hh"
+
+#include <catch2/catch_all.hpp>
+#include <string>
+
+namespace spinscale::nwprog::server::http::test
+{
+
+SCENARIO("parsing HTTP requests")
+{
+  Request request;
+
+  GIVEN("two pipelined requests")
+  {
+    const std::string first = "GET /health HTTP/1.1\r\nHost: localhost\r\nUser-Agent: test\r\n\r\n";
+    const std::string second = "POST /submit HTTP/1.1\r\ncontent-length: 5\r\nConnection: close\r\n\r\nhello";
+    const std::string data = first + second;
+
+    WHEN("the first one is parsed.")
+    {
+      const auto parsed = parse_request(data, request);
+      THEN("only it is consumed and it is kept alive by default.")
+      {
+        REQUIRE(parsed.contains(static_cast<int32_t>(first.size())));
+        REQUIRE(request.method == Method::get);
+        REQUIRE(request.target == "/health");
+        REQUIRE(request.minor_version == 1);
+        REQUIRE(request.keep_alive);
+        REQUIRE(request.body.empty());
+      }
+    }
+
+    WHEN("the second one is parsed.")
+    {
+      const auto parsed = parse_request(std::string_view(data).substr(first.size()), request);
+      THEN("its body and the close are picked up.")
+      {
+        REQUIRE(parsed.contains(static_cast<int32_t>(second.size())));
+        REQUIRE(request.method == Method::post);
+        REQUIRE(request.body == "hello");
+        REQUIRE(!request.keep_alive);
+      }
+    }
+
+    THEN("every cut off prefix is incomplete.")
+    {
+      for (size_t size = 0; size < second.size(); ++size)
+      {
+        REQUIRE(parse_request(std::string_view(second).substr(0, size), request).contains(0));
+      }
+    }
+  }
+
+  GIVEN("an HTTP/1.0 request")
+  {
+    THEN("it is closed unless asked to keep it alive.")
+    {
+      REQUIRE(parse_request("GET / HTTP/1.0\r\n\r\n", request).is_ok());
+      REQUIRE(!request.keep_alive);
+      REQUIRE(parse_request("GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n", request).is_ok());
+      REQUIRE(request.keep_alive);
+    }
+  }
+
+  GIVEN("requests the server can not handle")
+  {
+    THEN("they fail with a matching error.")
+    {
+      REQUIRE(parse_request("GET /\r\n\r\n", request).contains_err(lib::Errno(EBADMSG)));
+      REQUIRE(parse_request("GET / HTTP/1.1\nHost: x\n\n", request).contains_err(lib::Errno(EBADMSG)));
+      REQUIRE(parse_request("GET / HTTP/1.1\r\nHost : x\r\n\r\n", request).contains_err(lib::Errno(EBADMSG)));
+      REQUIRE(parse_request("GET / HTTP/2.0\r\n\r\n", request).contains_err(lib::Errno(ENOTSUP)));
+      REQUIRE(parse_request("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", request)
+                .contains_err(lib::Errno(ENOTSUP)));
+      REQUIRE(parse_request("POST / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\nab", request)
+                .contains_err(lib::Errno(EBADMSG)));
+    }
+
+    THEN("requests larger than the limit are rejected even when incomplete.")
+    {
+      const std::string huge_header = "GET / HTTP/1.1\r\nX-Filler: " + std::string(100, 'x');
+      REQUIRE(parse_request(huge_header, request, 64).contains_err(lib::Errno(EMSGSIZE)));
+      REQUIRE(parse_request("POST / HTTP/1.1\r\nContent-Length: 100\r\n\r\n", request, 64)
+                .contains_err(lib::Errno(EMSGSIZE)));
+    }
+  }
+}
+
+SCENARIO("preformatted responses")
+{
+  GIVEN("a response")
+  {
+    const Response response("200 OK", "text/plain", "OK\n");
+    Request request;
+    THEN("it is complete for GET and has no body for HEAD.")
+    {
+      REQUIRE(parse_request("GET / HTTP/1.1\r\n\r\n", request).is_ok());
+      const std::string_view get = response.bytes(request);
+      REQUIRE(get.starts_with("HTTP/1.1 200 OK\r\n"));
+      REQUIRE(get.find("Content-Length: 3\r\n") != std::string_view::npos);
+      REQUIRE(get.ends_with("\r\n\r\nOK\n"));
+
+      REQUIRE(parse_request("HEAD / HTTP/1.1\r\n\r\n", request).is_ok());
+      REQUIRE(response.bytes(request) == get.substr(0, get.size() - 3));
+    }
+
+    THEN("it announces the close when the connection is not kept alive.")
+    {
+      REQUIRE(parse_request("GET / HTTP/1.1\r\nConnection: close\r\n\r\n", request).is_ok());
+      REQUIRE(response.bytes(request).find("Connection: close\r\n") != std::string_view::npos);
+      REQUIRE(response.closing_bytes() == response.bytes(request));
+    }
+  }
+}
+
+SCENARIO("serving files")
+{
+  GIVEN("targets below a prefix")
+  {
+    THEN("the path below it is found without the query.")
+    {
+      REQUIRE(file_path("/static/index.html", "/static/") == "index.html");
+      REQUIRE(file_path("/static/css/site.css?v=2", "/static/") == "css/site.css");
+    }
+
+    THEN("paths that are empty or could climb out of the directory are refused.")
+    {
+      REQUIRE_FALSE(file_path("/health", "/static/").has_value());
+      REQUIRE_FALSE(file_path("/static/", "/static/").has_value());
+      REQUIRE_FALSE(file_path("/static/?x", "/static/").has_value());
+      REQUIRE_FALSE(file_path("/static//etc/passwd", "/static/").has_value());
+      REQUIRE_FALSE(file_path("/static/../secret", "/static/").has_value());
+      REQUIRE_FALSE(file_path("/static/a/../../secret", "/static/").has_value());
+      REQUIRE_FALSE(file_path("/static/a/./b", "/static/").has_value());
+      REQUIRE_FALSE(file_path("/static/a/", "/static/").has_value());
+    }
+  }
+
+  GIVEN("the head of a file response")
+  {
+    const std::string head = render_head("200 OK", content_type_of("page.html"), 1234U, false);
+    THEN("it announces the length of the body that follows.")
+    {
+      REQUIRE(head.starts_with("HTTP/1.1 200 OK\r\n"));
+      REQUIRE(head.find("Content-Type: text/html\r\n") != std::string::npos);
+      REQUIRE(head.find("Content-Length: 1234\r\n") != std::string::npos);
+      REQUIRE(head.ends_with("Connection: close\r\n\r\n"));
+      REQUIRE(content_type_of("archive.tar") == "application/octet-stream");
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::server::http::test
@@ -0,0 +1,139 @@
+#include "src/server/kv_server.hh"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <catch2/catch_all.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "src/io/tcp_socket.hh"
+
+namespace spinscale::nwprog::server::test
+{
+
+namespace
+{
+
+/// A key value server with a single shard on a free port of the loopback address, stopped when it goes out of scope.
+class TestServer
+{
+public:
+  TestServer()
+  {
+    // The server only waits for the stop flag while SIGINT interrupts it.
+    signal(SIGINT, [](int) {});
+    io::TcpOptions options;
+    options.dual_stack = false;
+    listen_fd_ = io::listen_tcp(0U, options).value();
+    struct sockaddr_in address
+    {
+    };
+    socklen_t length = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<struct sockaddr*>(&address), &length);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread([this]() { run_kv_server(listen_fd_, 1U, stop_); });
+  }
+
+  ~TestServer()
+  {
+    stop_ = true;
+    pthread_kill(thread_.native_handle(), SIGINT);
+    thread_.join();
+    close(listen_fd_);
+  }
+
+  [[nodiscard]] int connect() const
+  {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address
+    {
+    };
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port_);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    REQUIRE(::connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0);
+    return fd;
+  }
+
+private:
+  int listen_fd_{-1};
+  uint16_t port_{0};
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+};
+
+void send_all(const int fd, std::string_view data)
+{
+  while (!data.empty())
+  {
+    const ssize_t sent = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    REQUIRE(sent > 0);
+    data.remove_prefix(static_cast<size_t>(sent));
+  }
+}
+
+/// Read until `size` bytes arrived, or until nothing arrived for a second.
+std::string receive(const int fd, const size_t size)
+{
+  std::string data;
+  char buffer[16384];
+  struct pollfd readable
+  {
+    .fd = fd, .events = POLLIN
+  };
+  while (data.size() < size && poll(&readable, 1, 1000) == 1)
+  {
+    const ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+    if (received <= 0)
+    {
+      break;
+    }
+    data.append(buffer, static_cast<size_t>(received));
+  }
+  return data;
+}
+
+std::string command(const std::string_view name, const std::string_view key, const std::string_view value = {})
+{
+  const auto bulk = [](const std::string_view arg)
+  { return "$" + std::to_string(arg.size()) + "\r\n" + std::string(arg) + "\r\n"; };
+  return (value.empty() ? "*2\r\n" : "*3\r\n") + bulk(name) + bulk(key) + (value.empty() ? "" : bulk(value));
+}
+
+}  // namespace
+
+SCENARIO("key value server replies")
+{
+  GIVEN("a server with two large values")
+  {
+    TestServer server;
+    const int fd = server.connect();
+    const std::string value(40000U, 'v');
+    send_all(fd, command("SET", "a", value) + command("SET", "b", value));
+    REQUIRE(receive(fd, 10U) == "+OK\r\n+OK\r\n");
+
+    WHEN("both are fetched with one MGET, which does not fit into the output buffer.")
+    {
+      send_all(fd, "*3\r\n$4\r\nMGET\r\n$1\r\na\r\n$1\r\nb\r\n" + command("GET", "missing"));
+      const std::string bulk = "$40000\r\n" + value + "\r\n";
+      const std::string expected = "*2\r\n" + bulk + bulk + "$-1\r\n";
+      const std::string reply = receive(fd, expected.size());
+      THEN("the whole reply arrives, followed by the reply of the next command.")
+      {
+        REQUIRE(reply.size() == expected.size());
+        REQUIRE(reply == expected);
+      }
+    }
+    close(fd);
+  }
+}
+
+}  // namespace spinscale::nwprog::server::test
@@ -0,0 +1,80 @@
+#include "src/server/kv_table.hh"
+
+#include <catch2/catch_all.hpp>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+namespace spinscale::nwprog::server::kv::test
+{
+
+SCENARIO("key value table")
+{
+  GIVEN("an empty table")
+  {
+    Table table(16);
+    THEN("keys can be set, overwritten and erased.")
+    {
+      REQUIRE(!table.get("a"));
+      table.set("a", "1");
+      REQUIRE(table.get("a") == "1");
+      table.set("a", "a much longer value that needs a larger block");
+      REQUIRE(table.get("a") == "a much longer value that needs a larger block");
+      table.set("a", "");
+      REQUIRE(table.get("a") == "");
+      REQUIRE(table.size() == 1);
+      REQUIRE(table.erase("a"));
+      REQUIRE(!table.erase("a"));
+      REQUIRE(!table.get("a"));
+      REQUIRE(table.size() == 0);
+      REQUIRE(table.arena().allocated_bytes() == 0);
+    }
+  }
+
+  GIVEN("random operations on a table that has to grow many times")
+  {
+    Table table(16);
+    std::unordered_map<std::string, std::string> reference;
+    std::mt19937 rng(42);
+    THEN("it agrees with std::unordered_map.")
+    {
+      for (uint32_t i = 0; i < 200000; ++i)
+      {
+        const std::string key = "key:" + std::to_string(rng() % 20000);
+        switch (rng() % 4)
+        {
+          case 0:
+          case 1:
+          {
+            const std::string value(rng() % 100, static_cast<char>('a' + i % 26));
+            table.set(key, value);
+            reference[key] = value;
+            break;
+          }
+          case 2:
+          {
+            REQUIRE(table.erase(key) == (reference.erase(key) == 1));
+            break;
+          }
+          default:
+          {
+            const auto value = table.get(key);
+            const auto expected = reference.find(key);
+            REQUIRE(value.has_value() == (expected != reference.end()));
+            if (value)
+            {
+              REQUIRE(*value == expected->second);
+            }
+          }
+        }
+      }
+      REQUIRE(table.size() == reference.size());
+      for (const auto& [key, value] : reference)
+      {
+        REQUIRE(table.get(key) == value);
+      }
+    }
+  }
+}
+
+}  // namespace spinscale::nwprog::server::kv::test